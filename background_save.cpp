@@ -0,0 +1,123 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "background_save.hpp"
+#include <chrono>
+#include <stdexcept>
+
+using namespace std;
+
+BackgroundSaver::~BackgroundSaver()
+{
+    {
+        lock_guard<mutex> lock(m_lock);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) m_thread.join();
+}
+
+void BackgroundSaver::save(const PipelineLayoutModel& model, const std::string& fileName, JsonStreamWriter::Style style,
+                           std::function<void(const std::string&)> beforeReplace)
+{
+    auto t0 = chrono::steady_clock::now();
+    Job job;
+    job.snapshot = make_unique<PipelineLayoutSnapshot>();
+    model.snapshot(*job.snapshot);
+    job.fileName = PipelineLayoutModel::normalizeFileName(fileName);
+    job.style = style;
+    job.beforeReplace = move(beforeReplace);
+    job.snapshotMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+    {
+        lock_guard<mutex> lock(m_lock);
+        // A queued save of the same file has not started yet: the newer snapshot supersedes it.
+        bool replaced = false;
+        for (auto& queued: m_queue) {
+            if (queued.fileName == job.fileName) {
+                queued = move(job);
+                replaced = true;
+                break;
+            }
+        }
+        if (!replaced) m_queue.push_back(move(job));
+        if (!m_thread.joinable()) m_thread = thread(&BackgroundSaver::workerMain, this);
+    }
+    m_wake.notify_one();
+}
+
+bool BackgroundSaver::busy(void) const
+{
+    lock_guard<mutex> lock(m_lock);
+    return m_writing || !m_queue.empty();
+}
+
+bool BackgroundSaver::poll(Result& result)
+{
+    lock_guard<mutex> lock(m_lock);
+    if (m_results.empty()) return false;
+    result = move(m_results.front());
+    m_results.pop_front();
+    return true;
+}
+
+void BackgroundSaver::wait(void)
+{
+    unique_lock<mutex> lock(m_lock);
+    m_idle.wait(lock, [this]() { return !m_writing && m_queue.empty(); });
+}
+
+void BackgroundSaver::workerMain(void)
+{
+    unique_lock<mutex> lock(m_lock);
+    while (true) {
+        m_wake.wait(lock, [this]() { return m_quit || !m_queue.empty(); });
+        if (m_queue.empty()) break;     // Quitting, and everything queued has been written.
+
+        Job job = move(m_queue.front());
+        m_queue.pop_front();
+        m_writing = true;
+        lock.unlock();
+
+        Result result;
+        result.fileName = job.fileName;
+        result.snapshotMs = job.snapshotMs;
+        auto t0 = chrono::steady_clock::now();
+        try {
+            PipelineLayoutModel model;
+            model.restore(*job.snapshot);
+            model.writeFile(job.fileName, job.style, job.beforeReplace);
+            result.ok = true;
+        } catch (const exception& e) {
+            result.error = e.what();
+        }
+        result.writeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        // Kept, the snapshot would go on sharing the model's storage and make its next edits copy.
+        job.snapshot.reset();
+
+        lock.lock();
+        m_writing = false;
+        m_results.push_back(move(result));
+        m_idle.notify_all();
+    }
+}
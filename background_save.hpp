@@ -0,0 +1,85 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _BACKGROUND_SAVE_
+#define _BACKGROUND_SAVE_
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <functional>
+#include "pipelinelayout_model.hpp"
+
+// Saves projects on a worker thread. save() takes a snapshot of the model on the calling thread and
+// returns; serialization and the atomic file replace happen on the worker. Results come back through
+// poll(), which never blocks, so the editor can call it once per frame. If saves are requested faster
+// than they complete, only the newest pending snapshot of each file is written. beforeReplace is
+// passed on to PipelineLayoutModel::writeFile() and runs on the worker.
+class BackgroundSaver
+{
+public:
+    struct Result {
+        std::string fileName;
+        bool ok = false;
+        std::string error;
+        double snapshotMs = 0.0;    // Spent on the calling thread.
+        double writeMs = 0.0;       // Spent on the worker.
+    };
+
+    BackgroundSaver() {}
+    ~BackgroundSaver();             // Finishes every queued save.
+    BackgroundSaver(const BackgroundSaver&) = delete;
+    BackgroundSaver& operator=(const BackgroundSaver&) = delete;
+
+    void save(const PipelineLayoutModel& model, const std::string& fileName,
+              JsonStreamWriter::Style style = JsonStreamWriter::STYLE_PRETTY,
+              std::function<void(const std::string&)> beforeReplace = nullptr);
+    bool busy(void) const;
+    bool poll(Result& result);
+    void wait(void);
+
+private:
+    struct Job {
+        std::unique_ptr<PipelineLayoutSnapshot> snapshot;
+        std::string fileName;
+        JsonStreamWriter::Style style;
+        std::function<void(const std::string&)> beforeReplace;
+        double snapshotMs;
+    };
+
+    std::thread m_thread;
+    mutable std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::deque<Job> m_queue;
+    std::deque<Result> m_results;
+    bool m_writing = false;
+    bool m_quit = false;
+
+    void workerMain(void);
+};
+
+#endif // _BACKGROUND_SAVE_
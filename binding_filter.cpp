@@ -0,0 +1,175 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "binding_filter.hpp"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BINDING_FILTER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+static inline bool Matches(int32_t type, uint32_t stages, uint32_t typeMask, uint32_t stageMask)
+{
+    if (typeMask != BINDING_TYPES_ANY && (type < 0 || type > 31 || !((typeMask >> type) & 1))) return false;
+    return stageMask == 0 || (stages & stageMask) != 0;
+}
+
+static inline bool Update(int32_t type, uint32_t& stages, uint32_t typeMask, uint32_t stageMask, uint32_t setBits,
+                          uint32_t clearBits)
+{
+    if (!Matches(type, stages, typeMask, stageMask)) return false;
+    uint32_t bits = (stages & ~clearBits) | setBits;
+    if (bits == stages) return false;
+    stages = bits;
+    return true;
+}
+
+void FilterBindingsScalar(const int32_t* types, const uint32_t* stages, size_t count, uint32_t typeMask,
+                          uint32_t stageMask, std::vector<int>& out)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (Matches(types[i], stages[i], typeMask, stageMask)) out.push_back((int) i);
+    }
+}
+
+void UpdateBindingStagesScalar(const int32_t* types, uint32_t* stages, size_t count, uint32_t typeMask,
+                               uint32_t stageMask, uint32_t setBits, uint32_t clearBits, std::vector<int>& changed)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (Update(types[i], stages[i], typeMask, stageMask, setBits, clearBits)) changed.push_back((int) i);
+    }
+}
+
+#ifdef BINDING_FILTER_SSE2
+
+// All-ones lanes for the bindings that match: a compare per type in typeMask, then the stage test.
+class MatchMask
+{
+    __m128i m_types[32];
+    int m_numTypes = 0;
+    bool m_anyType;
+    __m128i m_stageMask;
+    bool m_anyStage;
+
+public:
+    MatchMask(uint32_t typeMask, uint32_t stageMask)
+        : m_anyType(typeMask == BINDING_TYPES_ANY), m_stageMask(_mm_set1_epi32((int) stageMask)), m_anyStage(stageMask == 0)
+    {
+        for (int t = 0; t < 32 && !m_anyType; t++) {
+            if ((typeMask >> t) & 1) m_types[m_numTypes++] = _mm_set1_epi32(t);
+        }
+    }
+
+    __m128i operator()(__m128i types, __m128i stages) const
+    {
+        __m128i m = _mm_set1_epi32(-1);
+        if (!m_anyType) {
+            m = _mm_setzero_si128();
+            for (int t = 0; t < m_numTypes; t++) m = _mm_or_si128(m, _mm_cmpeq_epi32(types, m_types[t]));
+        }
+        if (!m_anyStage) {
+            __m128i none = _mm_cmpeq_epi32(_mm_and_si128(stages, m_stageMask), _mm_setzero_si128());
+            m = _mm_andnot_si128(none, m);
+        }
+        return m;
+    }
+};
+
+// Lane k of a movemask is binding base + k.
+static inline void AppendLanes(int bits, size_t base, std::vector<int>& out)
+{
+    for (int k = 0; bits; k++, bits >>= 1) {
+        if (bits & 1) out.push_back((int) (base + k));
+    }
+}
+
+void FilterBindings(const int32_t* types, const uint32_t* stages, size_t count, uint32_t typeMask, uint32_t stageMask,
+                    std::vector<int>& out)
+{
+    MatchMask match(typeMask, stageMask);
+    size_t i = 0;
+    // Writes all four indices of a group and advances past the matching ones, which leaves nothing for
+    // the branch predictor to guess; out grows a block at a time to make room.
+    const size_t BLOCK = 1024;
+    size_t n = out.size();
+    while (i + 4 <= count) {
+        size_t end = min(count & ~size_t(3), i + BLOCK);
+        out.resize(n + (end - i));
+        int* dst = out.data();
+        for (; i < end; i += 4) {
+            __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(types + i));
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(stages + i));
+            int bits = _mm_movemask_ps(_mm_castsi128_ps(match(t, s)));
+            for (int k = 0; k < 4; k++) {
+                dst[n] = (int) (i + k);
+                n += (bits >> k) & 1;
+            }
+        }
+        out.resize(n);
+    }
+    for (; i < count; i++) {
+        if (Matches(types[i], stages[i], typeMask, stageMask)) out.push_back((int) i);
+    }
+}
+
+void UpdateBindingStages(const int32_t* types, uint32_t* stages, size_t count, uint32_t typeMask, uint32_t stageMask,
+                         uint32_t setBits, uint32_t clearBits, std::vector<int>& changed)
+{
+    MatchMask match(typeMask, stageMask);
+    __m128i keep = _mm_set1_epi32((int) ~clearBits);
+    __m128i set = _mm_set1_epi32((int) setBits);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(types + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<__m128i*>(stages + i));
+        __m128i m = match(t, s);
+        __m128i updated = _mm_or_si128(_mm_and_si128(s, keep), set);
+        __m128i r = _mm_or_si128(_mm_and_si128(m, updated), _mm_andnot_si128(m, s));
+        int bits = 15 & ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(r, s)));
+        if (!bits) continue;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(stages + i), r);
+        AppendLanes(bits, i, changed);
+    }
+    for (; i < count; i++) {
+        if (Update(types[i], stages[i], typeMask, stageMask, setBits, clearBits)) changed.push_back((int) i);
+    }
+}
+
+#else
+
+void FilterBindings(const int32_t* types, const uint32_t* stages, size_t count, uint32_t typeMask, uint32_t stageMask,
+                    std::vector<int>& out)
+{
+    FilterBindingsScalar(types, stages, count, typeMask, stageMask, out);
+}
+
+void UpdateBindingStages(const int32_t* types, uint32_t* stages, size_t count, uint32_t typeMask, uint32_t stageMask,
+                         uint32_t setBits, uint32_t clearBits, std::vector<int>& changed)
+{
+    UpdateBindingStagesScalar(types, stages, count, typeMask, stageMask, setBits, clearBits, changed);
+}
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _BINDING_FILTER_
+#define _BINDING_FILTER_
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Passes over binding columns: types[i] and stages[i] are typeIdx and stageFlagBits of binding i.
+// A binding matches when its type is in typeMask (bit t for typeIdx t; BINDING_TYPES_ANY for any type,
+// including ones outside 0..31) and it has any of the bits in stageMask (0 for any stages).
+// SSE2 where the target has it, four bindings at a time; the Scalar versions are the reference.
+#define BINDING_TYPES_ANY 0xffffffffu
+
+// Appends the index of every matching binding to out, in order.
+void FilterBindings(const int32_t* types, const uint32_t* stages, size_t count, uint32_t typeMask, uint32_t stageMask,
+                    std::vector<int>& out);
+void FilterBindingsScalar(const int32_t* types, const uint32_t* stages, size_t count, uint32_t typeMask,
+                          uint32_t stageMask, std::vector<int>& out);
+
+// stages[i] = (stages[i] & ~clearBits) | setBits for every matching binding; appends the index of each
+// one that changed to changed, in order.
+void UpdateBindingStages(const int32_t* types, uint32_t* stages, size_t count, uint32_t typeMask, uint32_t stageMask,
+                         uint32_t setBits, uint32_t clearBits, std::vector<int>& changed);
+void UpdateBindingStagesScalar(const int32_t* types, uint32_t* stages, size_t count, uint32_t typeMask,
+                               uint32_t stageMask, uint32_t setBits, uint32_t clearBits, std::vector<int>& changed);
+
+#endif // _BINDING_FILTER_
@@ -0,0 +1,214 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "binding_numbers.hpp"
+#include "json_stream.hpp"
+#include <assert.h>
+#include <unordered_set>
+
+using namespace std;
+
+void BindingNumbers::clear(void)
+{
+    m_sets.clear();
+    m_setIndex.clear();
+    m_renumbered.clear();
+    m_numAdded = 0;
+    m_numDropped = 0;
+}
+
+const BindingNumbers::NumberedSet* BindingNumbers::findSet(const std::string& name) const
+{
+    auto it = m_setIndex.find(name);
+    return it == m_setIndex.end() ? nullptr : &m_sets[it->second];
+}
+
+int BindingNumbers::number(const std::string& set, const std::string& binding) const
+{
+    const NumberedSet* s = findSet(set);
+    if (!s) return -1;
+    auto it = s->numbers.find(binding);
+    return it == s->numbers.end() ? -1 : it->second;
+}
+
+int BindingNumbers::count(const std::string& set) const
+{
+    const NumberedSet* s = findSet(set);
+    return s ? (int) s->bindings.size() : 0;
+}
+
+void BindingNumbers::assign(const PipelineLayoutModel& model, const BindingNumbers* previous)
+{
+    assert(previous != this);
+    clear();
+    auto& names = model.names();
+
+    // Sets of the same name are one set here; setOf maps the model's set indexes onto m_sets.
+    vector<size_t> setOf(model.dsets().size());
+    for (size_t s = 0; s < model.dsets().size(); s++) {
+        string name = names.str(model.dsets()[s]);
+        auto added = m_setIndex.emplace(name, m_sets.size());
+        if (added.second) {
+            m_sets.emplace_back();
+            m_sets.back().name = move(name);
+        }
+        setOf[s] = added.first->second;
+    }
+
+    // The bindings of each set, in order of first use.
+    vector< vector<NameId> > used(m_sets.size());
+    unordered_set<uint64_t> seen;
+    for (auto& pl: model.layouts()) {
+        for (auto& dset: pl.descsets) {
+            if (dset.index >= setOf.size()) continue;
+            size_t k = setOf[dset.index];
+            for (BindingHandle h: dset.dlayouts) {
+                NameId name = model.binding(h)->name;
+                if (seen.insert((uint64_t) k << 32 | name).second) used[k].push_back(name);
+            }
+        }
+    }
+
+    size_t numPrevious = 0, numKept = 0;
+    if (previous) {
+        for (auto& set: previous->m_sets) numPrevious += set.bindings.size();
+    }
+    vector<int> before, after;
+    vector<bool> taken;
+    for (size_t k = 0; k < m_sets.size(); k++) {
+        auto& set = m_sets[k];
+        const NumberedSet* prev = previous ? previous->findSet(set.name) : nullptr;
+        size_t n = used[k].size();
+        set.bindings.resize(n);
+        for (size_t i = 0; i < n; i++) set.bindings[i] = names.str(used[k][i]);
+
+        // Numbers below n stay; the rest go to the lowest free ones.
+        before.assign(n, -1);
+        after.assign(n, -1);
+        taken.assign(n, false);
+        for (size_t i = 0; i < n && prev; i++) {
+            auto it = prev->numbers.find(set.bindings[i]);
+            if (it == prev->numbers.end()) continue;
+            before[i] = it->second;
+            numKept++;
+            if (before[i] < (int) n) {
+                after[i] = before[i];
+                taken[before[i]] = true;
+            }
+        }
+        size_t free = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (after[i] >= 0) continue;
+            while (taken[free]) free++;
+            after[i] = (int) free;
+            taken[free] = true;
+            if (before[i] < 0) {
+                m_numAdded++;
+            } else {
+                m_renumbered.push_back(Renumbered{ set.name, set.bindings[i], before[i], after[i] });
+            }
+        }
+
+        vector<string> byNumber(n);
+        set.numbers.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            set.numbers[set.bindings[i]] = after[i];
+            byNumber[after[i]] = move(set.bindings[i]);
+        }
+        set.bindings.swap(byNumber);
+    }
+    m_numDropped = numPrevious - numKept;
+}
+
+void BindingNumbers::invalidatedLayouts(const PipelineLayoutModel& model, std::vector<int>& out) const
+{
+    out.clear();
+    if (m_renumbered.empty()) return;
+    unordered_map< string, unordered_set<string> > moved;
+    for (auto& r: m_renumbered) moved[r.set].insert(r.binding);
+    auto& names = model.names();
+    for (int l = 0; l < (int) model.layouts().size(); l++) {
+        bool invalidated = false;
+        for (auto& dset: model.layouts()[l].descsets) {
+            if (dset.index >= model.dsets().size()) continue;
+            auto set = moved.find(names.str(model.dsets()[dset.index]));
+            if (set == moved.end()) continue;
+            for (BindingHandle h: dset.dlayouts) {
+                if (set->second.count(names.str(model.binding(h)->name))) {
+                    invalidated = true;
+                    break;
+                }
+            }
+            if (invalidated) break;
+        }
+        if (invalidated) out.push_back(l);
+    }
+}
+
+void BindingNumbers::serialize(std::string& out) const
+{
+    out.clear();
+    JsonStreamWriter w(out, JsonStreamWriter::STYLE_PRETTY);
+    w.beginObject();
+    w.key("sets");
+    w.beginObject();
+    for (auto& set: m_sets) {
+        w.key(set.name);
+        w.beginArray();
+        for (auto& b: set.bindings) w.value(b);
+        w.endArray();
+    }
+    w.endObject();
+    w.endObject();
+    w.finish();
+}
+
+void BindingNumbers::deserialize(const char* begin, const char* end)
+{
+    clear();
+    JsonStreamReader r(begin, end);
+    string key, name;
+    r.beginObject();
+    while (r.nextKey(key)) {
+        if (key != "sets") {
+            r.skipValue();
+            continue;
+        }
+        r.beginObject();
+        while (r.nextKey(key)) {
+            if (!m_setIndex.emplace(key, m_sets.size()).second) r.fail("set '" + key + "' listed more than once");
+            m_sets.emplace_back();
+            auto& set = m_sets.back();
+            set.name = key;
+            r.beginArray();
+            while (r.nextElement()) {
+                r.readString(name);
+                if (!set.numbers.emplace(name, (int) set.bindings.size()).second) {
+                    r.fail("binding '" + name + "' listed more than once in set '" + key + "'");
+                }
+                set.bindings.push_back(name);
+            }
+        }
+    }
+    r.finish();
+}
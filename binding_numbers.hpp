@@ -0,0 +1,89 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _BINDING_NUMBERS_
+#define _BINDING_NUMBERS_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "pipelinelayout_model.hpp"
+
+// Vulkan binding numbers for the descriptor sets of a project. The model only orders the bindings of a set
+// within each pipeline layout; here every binding used in a set gets one number, shared by all the pipeline
+// layouts that use the set, and each set's numbers are dense: 0..n-1 for the n bindings used in it anywhere.
+// Sets and bindings are keyed by name, so numbers carry over between loads and can be kept next to the
+// project as JSON.
+class BindingNumbers
+{
+public:
+    // A binding whose number assign() changed: shaders built against the old one need rebuilding.
+    struct Renumbered {
+        std::string set;
+        std::string binding;
+        int from;
+        int to;
+    };
+
+    // Numbers every binding used in each of the model's sets. One that previous numbered in the set keeps
+    // its number if that is below the set's new count; the others take the lowest free numbers, in order
+    // of first use (pipeline layout, then position in the set). Closing the gaps a removal leaves thus
+    // moves only the bindings numbered at or above the new count. previous may be null, but not this.
+    void assign(const PipelineLayoutModel& model, const BindingNumbers* previous);
+    void clear(void);
+
+    // -1 if the binding is not used in the set.
+    int number(const std::string& set, const std::string& binding) const;
+    // Bindings used in the set; 0 for an unknown set.
+    int count(const std::string& set) const;
+
+    // Against the previous numbering given to assign().
+    const std::vector<Renumbered>& renumbered(void) const { return m_renumbered; }
+    size_t numAdded(void) const { return m_numAdded; }
+    size_t numDropped(void) const { return m_numDropped; }
+    // Indexes of the pipeline layouts that use a renumbered binding, in order. model as given to assign().
+    void invalidatedLayouts(const PipelineLayoutModel& model, std::vector<int>& out) const;
+
+    // { "sets" : { "<set>" : [ "<binding numbered 0>", "<binding numbered 1>", ... ], ... } }, sets in
+    // model order.
+    void serialize(std::string& out) const;
+    // Throws std::runtime_error on malformed input or a set / binding listed twice.
+    void deserialize(const char* begin, const char* end);
+
+private:
+    struct NumberedSet {
+        std::string name;
+        std::vector<std::string> bindings;                  // By number.
+        std::unordered_map<std::string, int> numbers;
+    };
+
+    const NumberedSet* findSet(const std::string& name) const;
+
+    std::vector<NumberedSet> m_sets;
+    std::unordered_map<std::string, size_t> m_setIndex;    // Set name -> m_sets index.
+    std::vector<Renumbered> m_renumbered;
+    size_t m_numAdded = 0;
+    size_t m_numDropped = 0;
+};
+
+#endif // _BINDING_NUMBERS_
@@ -0,0 +1,186 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "build_cache.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <functional>
+#include <stdexcept>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char* CACHE_MAGIC = "VKPLC-CACHE 1";
+
+// -------------------------------------------------------- File helpers -----------------------------------------------
+
+bool ReadFile(const std::string& path, std::string& out)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    struct stat sb;
+    bool ok = fstat(fileno(f), &sb) == 0;
+    if (ok) {
+        // One exact allocation; growing the string while reading doubles the peak for large files.
+        out.resize((size_t) sb.st_size);
+        ok = fread(&out[0], 1, out.size(), f) == out.size();
+    }
+    fclose(f);
+    return ok;
+}
+
+static bool WriteFileAtomic(const std::string& path, const std::string& content)
+{
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), ".tmp%d.%zx", (int) getpid(), hash<thread::id>()(this_thread::get_id()));
+    string tmp = path + suffix;
+    {
+        ofstream ofs(tmp.c_str(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+        if (!ofs.is_open()) return false;
+        ofs.write(content.data(), content.size());
+        if (!ofs.good()) {
+            ofs.close();
+            remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool WriteFileIfChanged(const std::string& path, const std::string& content)
+{
+    struct stat sb;
+    if (stat(path.c_str(), &sb) == 0 && (size_t) sb.st_size == content.size()) {
+        string existing;
+        if (ReadFile(path, existing) && existing == content) return false;
+    }
+    if (!WriteFileAtomic(path, content)) {
+        throw std::runtime_error("Could not write " + path + ".");
+    }
+    return true;
+}
+
+// 64-bit multiply / xor-shift hash over 8-byte words. Not cryptographic; collisions only matter
+// as far as two different inputs would share a cache entry, and keys combine two seeds plus the size.
+uint64_t HashBytes(const char* data, size_t size, uint64_t seed)
+{
+    const uint64_t m = 0x9E3779B97F4A7C15ull;
+    uint64_t h = seed ^ (size * m);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t k;
+        memcpy(&k, data + i, 8);
+        k *= 0xBF58476D1CE4E5B9ull;
+        k ^= k >> 31;
+        h = (h ^ k) * m;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    for (size_t j = 0; i + j < size; j++) {
+        tail |= (uint64_t) (unsigned char) data[i + j] << (8 * j);
+    }
+    h = (h ^ (tail * 0x94D049BB133111EBull)) * m;
+    h ^= h >> 32;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 29;
+    return h;
+}
+
+// -------------------------------------------------------- BuildCache -----------------------------------------------
+
+BuildCache::BuildCache(const std::string& dir, const std::string& toolVersion)
+    : m_dir(dir), m_version(toolVersion)
+{
+    if (mkdir(m_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Could not create cache directory " + m_dir + ".");
+    }
+}
+
+std::string BuildCache::entryPath(const std::string& key) const
+{
+    return m_dir + "/" + key;
+}
+
+std::string BuildCache::key(const std::string& content) const
+{
+    uint64_t seed = HashBytes(m_version.data(), m_version.size(), 0x5EED);
+    uint64_t h0 = HashBytes(content.data(), content.size(), seed);
+    uint64_t h1 = HashBytes(content.data(), content.size(), ~seed);
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%016llx%016llx-%zx", (unsigned long long) h0, (unsigned long long) h1, content.size());
+    return buf;
+}
+
+bool BuildCache::lookup(const std::string& key, BuildCacheEntry& out) const
+{
+    string raw;
+    if (!ReadFile(entryPath(key), raw)) return false;
+
+    istringstream iss(raw);
+    string line, tag;
+    size_t numErrors = 0, outputSize = 0;
+    if (!getline(iss, line) || line != CACHE_MAGIC) return false;
+    int ok = 0;
+    if (!(iss >> tag >> ok) || tag != "ok") return false;
+    if (!(iss >> tag >> out.costMs) || tag != "cost_ms") return false;
+    if (!(iss >> tag >> numErrors) || tag != "errors") return false;
+    getline(iss, line);
+    out.ok = !!ok;
+    out.errors.clear();
+    for (size_t i = 0; i < numErrors; i++) {
+        if (!getline(iss, line)) return false;
+        out.errors.push_back(line);
+    }
+    if (!(iss >> tag >> outputSize) || tag != "output") return false;
+    getline(iss, line);
+    size_t offset = (size_t) iss.tellg();
+    if (offset + outputSize != raw.size()) return false;
+    out.output = raw.substr(offset);
+    return true;
+}
+
+void BuildCache::store(const std::string& key, const BuildCacheEntry& entry) const
+{
+    ostringstream oss;
+    oss << CACHE_MAGIC << "\n";
+    oss << "ok " << (entry.ok ? 1 : 0) << "\n";
+    oss << "cost_ms " << entry.costMs << "\n";
+    oss << "errors " << entry.errors.size() << "\n";
+    for (auto err: entry.errors) {
+        for (auto& c: err) if (c == '\n' || c == '\r') c = ' ';
+        oss << err << "\n";
+    }
+    oss << "output " << entry.output.size() << "\n";
+    oss << entry.output;
+    // A failed store only costs a future miss.
+    WriteFileAtomic(entryPath(key), oss.str());
+}
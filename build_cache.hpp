@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _BUILD_CACHE_
+#define _BUILD_CACHE_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// -------------------------------------------------------- File helpers -----------------------------------------------
+
+bool ReadFile(const std::string& path, std::string& out);
+
+// Writes through a temp file plus rename. Leaves the file (and its timestamp) untouched when
+// the bytes on disk already match. Returns true if the file was written.
+bool WriteFileIfChanged(const std::string& path, const std::string& content);
+
+uint64_t HashBytes(const char* data, size_t size, uint64_t seed);
+
+// -------------------------------------------------------- BuildCache -----------------------------------------------
+
+// Result of processing one input: validation verdict, the re-emitted text and what it cost to produce.
+struct BuildCacheEntry {
+    bool ok = false;
+    double costMs = 0.0;
+    std::vector<std::string> errors;
+    std::string output;
+};
+
+// Persistent on-disk cache of processed .vkpipeline.json files, one entry file per key.
+// Keys are a content hash of the input bytes mixed with the tool version, so bumping
+// PIPELINE_LAYOUT_TOOL_VERSION invalidates everything. Safe to share between threads and processes.
+class BuildCache
+{
+    std::string m_dir;
+    std::string m_version;
+
+    std::string entryPath(const std::string& key) const;
+
+public:
+    BuildCache(const std::string& dir, const std::string& toolVersion);
+
+    std::string key(const std::string& content) const;
+    bool lookup(const std::string& key, BuildCacheEntry& out) const;
+    void store(const std::string& key, const BuildCacheEntry& entry) const;
+};
+
+#endif // _BUILD_CACHE_
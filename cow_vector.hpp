@@ -0,0 +1,223 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _COW_VECTOR_
+#define _COW_VECTOR_
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <iterator>
+#include <utility>
+#include <cstddef>
+
+// A std::vector stand-in whose copies share their elements until one of them is written to. Elements
+// sit in chunks of CHUNK behind shared pointers, and the chunk pointers in a table that is shared as
+// well: a copy takes one reference on the table, O(1), and the first write to either side afterwards
+// copies the table and the chunk written to. N copies that differ in a few elements take little more
+// than one. Element types that are CowVectors themselves nest: copying a chunk of them is shallow.
+//
+// Reads never copy, so element access is const; writes go through edit() and the members below, which
+// invalidate references into chunks they copy. One copy may be written while other threads read
+// other copies, but a single copy is no more thread-safe than a std::vector.
+template <typename T, size_t CHUNK = 64>
+class CowVector
+{
+    typedef std::vector<T> Chunk;
+    typedef std::vector< std::shared_ptr<Chunk> > Table;
+
+    std::shared_ptr<Table> m_table;         // ceil(m_size / CHUNK) chunks, all but the last full.
+    size_t m_size = 0;
+
+    // Nothing else refers to p, and nothing can start to: it may be written in place. The fence orders
+    // that after whatever another thread did with it before dropping its reference.
+    template <typename P>
+    static bool Unique(const std::shared_ptr<P>& p)
+    {
+        if (p.use_count() != 1) return false;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    Table& table(void)
+    {
+        if (!m_table) m_table = std::make_shared<Table>();
+        else if (!Unique(m_table)) m_table = std::make_shared<Table>(*m_table);
+        return *m_table;
+    }
+
+    Chunk& chunk(size_t c)
+    {
+        std::shared_ptr<Chunk>& p = table()[c];
+        if (!Unique(p)) p = std::make_shared<Chunk>(*p);
+        return *p;
+    }
+
+    void truncate(size_t n)
+    {
+        if (n >= m_size) return;
+        Table& t = table();
+        t.resize((n + CHUNK - 1) / CHUNK);
+        if (n % CHUNK) {
+            Chunk& c = chunk(n / CHUNK);
+            c.erase(c.begin() + n % CHUNK, c.end());
+        }
+        m_size = n;
+    }
+
+public:
+    typedef T value_type;
+    typedef size_t size_type;
+
+    class const_iterator
+    {
+        const CowVector* m_v = nullptr;
+        size_t m_i = 0;
+
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        const_iterator() {}
+        const_iterator(const CowVector* v, size_t i) : m_v(v), m_i(i) {}
+        size_t index(void) const { return m_i; }
+
+        reference operator*() const { return (*m_v)[m_i]; }
+        pointer operator->() const { return &(*m_v)[m_i]; }
+        reference operator[](difference_type n) const { return (*m_v)[m_i + n]; }
+        const_iterator& operator++() { m_i++; return *this; }
+        const_iterator& operator--() { m_i--; return *this; }
+        const_iterator operator++(int) { const_iterator it = *this; m_i++; return it; }
+        const_iterator operator--(int) { const_iterator it = *this; m_i--; return it; }
+        const_iterator& operator+=(difference_type n) { m_i += n; return *this; }
+        const_iterator& operator-=(difference_type n) { m_i -= n; return *this; }
+        const_iterator operator+(difference_type n) const { return const_iterator(m_v, m_i + n); }
+        const_iterator operator-(difference_type n) const { return const_iterator(m_v, m_i - n); }
+        difference_type operator-(const const_iterator& o) const { return (difference_type) m_i - (difference_type) o.m_i; }
+        bool operator==(const const_iterator& o) const { return m_i == o.m_i; }
+        bool operator!=(const const_iterator& o) const { return m_i != o.m_i; }
+        bool operator<(const const_iterator& o) const { return m_i < o.m_i; }
+        bool operator>(const const_iterator& o) const { return m_i > o.m_i; }
+        bool operator<=(const const_iterator& o) const { return m_i <= o.m_i; }
+        bool operator>=(const const_iterator& o) const { return m_i >= o.m_i; }
+    };
+    typedef const_iterator iterator;
+
+    CowVector() {}
+    explicit CowVector(size_t n, const T& value = T()) { resize(n, value); }
+    template <typename It>
+    CowVector(It first, It last) { assign(first, last); }
+
+    size_t size(void) const { return m_size; }
+    bool empty(void) const { return m_size == 0; }
+    const T& operator[](size_t i) const { return (*(*m_table)[i / CHUNK])[i % CHUNK]; }
+    const T& front(void) const { return (*this)[0]; }
+    const T& back(void) const { return (*this)[m_size - 1]; }
+    const_iterator begin(void) const { return const_iterator(this, 0); }
+    const_iterator end(void) const { return const_iterator(this, m_size); }
+
+    // Whether this and o are copies that still share all their storage.
+    bool shares(const CowVector& o) const { return m_table == o.m_table && m_size == o.m_size; }
+
+    // The element, copying its chunk first if another copy shares it.
+    T& edit(size_t i) { return chunk(i / CHUNK)[i % CHUNK]; }
+    T& editBack(void) { return edit(m_size - 1); }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        if (m_size % CHUNK == 0) {
+            Table& t = table();
+            t.push_back(std::make_shared<Chunk>());
+            t.back()->reserve(m_size ? CHUNK : 1);
+        }
+        Chunk& c = chunk(m_size / CHUNK);
+        c.emplace_back(std::forward<Args>(args)...);
+        m_size++;
+        return c.back();
+    }
+    void push_back(const T& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+    void pop_back(void) { truncate(m_size - 1); }
+
+    void insert(size_t i, T value)
+    {
+        push_back(std::move(value));
+        for (size_t k = m_size - 1; k > i; k--) std::swap(edit(k), edit(k - 1));
+    }
+    void erase(size_t i) { erase(i, i + 1); }
+    void erase(size_t first, size_t last)
+    {
+        if (first >= last) return;
+        for (size_t k = last; k < m_size; k++) edit(first + k - last) = std::move(edit(k));
+        truncate(m_size - (last - first));
+    }
+    // Drops every element pred holds for, keeping the order of the rest. Returns how many went; writes
+    // nothing when that is none.
+    template <typename Pred>
+    size_t eraseIf(Pred pred)
+    {
+        size_t i = 0;
+        while (i < m_size && !pred((*this)[i])) i++;
+        if (i == m_size) return 0;
+        size_t out = i;
+        for (i++; i < m_size; i++) {
+            if (!pred((*this)[i])) {
+                T& to = edit(out++);
+                to = std::move(edit(i));
+            }
+        }
+        size_t erased = m_size - out;
+        truncate(out);
+        return erased;
+    }
+    void swapAt(size_t a, size_t b)
+    {
+        if (a == b) return;
+        T& x = edit(a);
+        std::swap(x, edit(b));
+    }
+
+    void resize(size_t n, const T& value = T())
+    {
+        truncate(n);
+        while (m_size < n) push_back(value);
+    }
+    template <typename It>
+    void assign(It first, It last)
+    {
+        clear();
+        for (; first != last; ++first) push_back(*first);
+    }
+    void reserve(size_t n) { table().reserve((n + CHUNK - 1) / CHUNK); }
+    void clear(void)
+    {
+        m_table.reset();
+        m_size = 0;
+    }
+};
+
+#endif // _COW_VECTOR_
@@ -0,0 +1,326 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "descriptor_pools.hpp"
+#include "layout_export.hpp"
+#include "json_stream.hpp"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+// Bytes per descriptor by typeIdx, roughly what desktop drivers use. Only a guide: the real figures
+// are device properties, and "descriptor_bytes" in the input takes them.
+static const uint32_t DEFAULT_DESCRIPTOR_BYTES[] = {
+    16,     // SAMPLER
+    48,     // COMBINED_IMAGE_SAMPLER
+    32,     // SAMPLED_IMAGE
+    32,     // STORAGE_IMAGE
+    16,     // UNIFORM_TEXEL_BUFFER
+    16,     // STORAGE_TEXEL_BUFFER
+    16,     // UNIFORM_BUFFER
+    16,     // STORAGE_BUFFER
+    16,     // UNIFORM_BUFFER_DYNAMIC
+    16,     // STORAGE_BUFFER_DYNAMIC
+    32,     // INPUT_ATTACHMENT
+};
+
+PoolSizingInput::PoolSizingInput()
+{
+    descriptorBytes.assign(descLayoutTypes.size(), 32);
+    for (size_t t = 0; t < descriptorBytes.size() && t < sizeof(DEFAULT_DESCRIPTOR_BYTES) / sizeof(uint32_t); t++) {
+        descriptorBytes[t] = DEFAULT_DESCRIPTOR_BYTES[t];
+    }
+}
+
+static uint32_t ReadCount(JsonStreamReader& r)
+{
+    int64_t v = r.readInt();
+    if (v < 0 || v > UINT32_MAX) r.fail("count out of range");
+    return (uint32_t) v;
+}
+
+void PoolSizingInput::deserialize(const char* begin, const char* end)
+{
+    JsonStreamReader r(begin, end);
+    string key, name;
+    r.beginObject();
+    while (r.nextKey(key)) {
+        if (key == "frames_in_flight") {
+            framesInFlight = ReadCount(r);
+            if (!framesInFlight) r.fail("frames_in_flight must be at least 1");
+        } else if (key == "sets") {
+            r.beginObject();
+            while (r.nextKey(name)) {
+                SetCount count;
+                if (r.peekType() == JsonStreamReader::TYPE_OBJECT) {
+                    r.beginObject();
+                    while (r.nextKey(key)) {
+                        if (key == "instances") count.instances = ReadCount(r);
+                        else if (key == "per_frame") count.perFrame = r.readInt() != 0;
+                        else r.skipValue();
+                    }
+                } else {
+                    count.instances = ReadCount(r);
+                }
+                sets[name] = count;
+            }
+        } else if (key == "layouts") {
+            r.beginObject();
+            while (r.nextKey(name)) {
+                auto& counts = layouts[name];
+                r.beginObject();
+                while (r.nextKey(key)) counts[key] = ReadCount(r);
+            }
+        } else if (key == "descriptor_bytes") {
+            r.beginObject();
+            while (r.nextKey(key)) {
+                auto type = find(descLayoutTypes.begin(), descLayoutTypes.end(), key);
+                if (type == descLayoutTypes.end()) r.fail("unknown descriptor type '" + key + "'");
+                descriptorBytes[type - descLayoutTypes.begin()] = ReadCount(r);
+            }
+        } else {
+            r.skipValue();
+        }
+    }
+    r.finish();
+}
+
+void PlanDescriptorPools(const PipelineLayoutModel& model, const PoolSizingInput& input, DescriptorPoolPlan& out)
+{
+    out = DescriptorPoolPlan();
+    out.framesInFlight = input.framesInFlight;
+    auto& names = model.names();
+    size_t numTypes = descLayoutTypes.size();
+
+    // Variants by set index and the bindings in it, whatever their order, in order of first use.
+    vector<DescriptorPoolPlan::Variant> variants;
+    vector<uint32_t> variantSet;
+    vector<bool> overridden;
+    map< pair<uint32_t, vector<BindingHandle>>, size_t > variantOf;
+    vector<BindingHandle> bindings;
+    for (auto& pl: model.layouts()) {
+        string layout = names.str(pl.name);
+        auto counts = input.layouts.find(layout);
+        for (auto& dset: pl.descsets) {
+            if (dset.index >= model.dsets().size()) continue;
+            bindings.assign(dset.dlayouts.begin(), dset.dlayouts.end());
+            sort(bindings.begin(), bindings.end());
+            bindings.erase(unique(bindings.begin(), bindings.end()), bindings.end());
+            auto added = variantOf.emplace(make_pair(dset.index, bindings), variants.size());
+            if (added.second) {
+                variants.emplace_back();
+                auto& v = variants.back();
+                v.set = names.str(model.dsets()[dset.index]);
+                v.descriptors.assign(numTypes, 0);
+                for (BindingHandle h: bindings) {
+                    const DescriptorLayout* dl = model.binding(h);
+                    if (dl->typeIdx < 0 || dl->typeIdx >= (int) numTypes) {
+                        throw std::runtime_error("binding '" + names.str(dl->name) + "' has invalid type " + to_string(dl->typeIdx) + ".");
+                    }
+                    v.descriptors[dl->typeIdx]++;
+                }
+                auto count = input.sets.find(v.set);
+                PoolSizingInput::SetCount setCount = count == input.sets.end() ? PoolSizingInput::SetCount() : count->second;
+                v.instances = setCount.instances;
+                v.perFrame = setCount.perFrame;
+                variantSet.push_back(dset.index);
+                overridden.push_back(false);
+            }
+            size_t i = added.first->second;
+            auto& v = variants[i];
+            v.layouts.push_back(layout);
+            if (counts == input.layouts.end()) continue;
+            auto count = counts->second.find(v.set);
+            if (count == counts->second.end()) continue;
+            v.instances = overridden[i] ? max(v.instances, count->second) : count->second;
+            overridden[i] = true;
+        }
+    }
+    vector<size_t> order(variants.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&variantSet](size_t a, size_t b) { return variantSet[a] < variantSet[b]; });
+    for (size_t i: order) out.variants.push_back(move(variants[i]));
+
+    uint32_t frames = input.framesInFlight;
+    auto newPool = [numTypes](DescriptorPoolPlan::Strategy& s, const string& name, uint32_t copies) -> DescriptorPoolPlan::Pool& {
+        s.pools.emplace_back();
+        s.pools.back().name = name;
+        s.pools.back().copies = copies;
+        s.pools.back().poolSizes.assign(numTypes, 0);
+        return s.pools.back();
+    };
+    auto addSets = [numTypes](DescriptorPoolPlan::Pool& pool, const DescriptorPoolPlan::Variant& v, uint64_t times) {
+        pool.maxSets += v.instances * times;
+        for (size_t t = 0; t < numTypes; t++) pool.poolSizes[t] += (uint64_t) v.descriptors[t] * v.instances * times;
+    };
+
+    // A pool is only made for some set to go in: Vulkan wants maxSets above 0.
+    out.strategies.resize(3);
+    auto& global = out.strategies[0];
+    global.name = "global";
+    global.description = "one pool for everything";
+    if (!out.variants.empty()) {
+        auto& all = newPool(global, "global", 1);
+        for (auto& v: out.variants) addSets(all, v, v.perFrame ? frames : 1);
+    }
+
+    auto& perFrame = out.strategies[1];
+    perFrame.name = "per_frame";
+    perFrame.description = "one pool per frame in flight with the per-frame sets, and one shared pool with the others";
+    for (bool each: { true, false }) {
+        DescriptorPoolPlan::Pool* pool = nullptr;
+        for (auto& v: out.variants) {
+            if (v.perFrame != each) continue;
+            if (!pool) pool = &newPool(perFrame, each ? "frame" : "shared", each ? frames : 1);
+            addSets(*pool, v, 1);
+        }
+    }
+
+    auto& perFrequency = out.strategies[2];
+    perFrequency.name = "per_frequency";
+    perFrequency.description = "one pool per set, per frame in flight if the set is allocated per frame";
+    for (size_t i = 0; i < out.variants.size(); i++) {
+        auto& v = out.variants[i];
+        if (!i || v.set != out.variants[i - 1].set) newPool(perFrequency, v.set, v.perFrame ? frames : 1);
+        addSets(perFrequency.pools.back(), v, 1);
+    }
+
+    for (auto& s: out.strategies) {
+        for (auto& pool: s.pools) {
+            for (size_t t = 0; t < numTypes; t++) pool.bytes += pool.poolSizes[t] * input.descriptorBytes[t];
+            s.totalSets += pool.maxSets * pool.copies;
+            s.totalBytes += pool.bytes * pool.copies;
+        }
+    }
+}
+
+static void WriteTypeCounts(JsonStreamWriter& w, const std::vector<uint64_t>& counts)
+{
+    w.beginObject();
+    for (size_t t = 0; t < counts.size(); t++) {
+        if (!counts[t]) continue;
+        w.key(descLayoutTypes[t]);
+        w.value(counts[t]);
+    }
+    w.endObject();
+}
+
+void ExportPoolPlanJson(const DescriptorPoolPlan& plan, std::string& out)
+{
+    out.clear();
+    JsonStreamWriter w(out, JsonStreamWriter::STYLE_PRETTY);
+    w.beginObject();
+    w.key("frames_in_flight");
+    w.value(plan.framesInFlight);
+    w.key("strategies");
+    w.beginArray();
+    for (auto& s: plan.strategies) {
+        w.beginObject();
+        w.key("name");
+        w.value(s.name);
+        w.key("description");
+        w.value(s.description);
+        w.key("total_sets");
+        w.value(s.totalSets);
+        w.key("total_bytes");
+        w.value(s.totalBytes);
+        w.key("pools");
+        w.beginArray();
+        for (auto& pool: s.pools) {
+            w.beginObject();
+            w.key("name");
+            w.value(pool.name);
+            w.key("copies");
+            w.value(pool.copies);
+            w.key("max_sets");
+            w.value(pool.maxSets);
+            w.key("pool_sizes");
+            WriteTypeCounts(w, pool.poolSizes);
+            w.key("bytes");
+            w.value(pool.bytes);
+            w.endObject();
+        }
+        w.endArray();
+        w.endObject();
+    }
+    w.endArray();
+    w.key("variants");
+    w.beginArray();
+    vector<uint64_t> descriptors;
+    for (auto& v: plan.variants) {
+        w.beginObject();
+        w.key("set");
+        w.value(v.set);
+        w.key("instances");
+        w.value(v.instances);
+        w.key("per_frame");
+        w.value(v.perFrame ? 1 : 0);
+        w.key("descriptors");
+        descriptors.assign(v.descriptors.begin(), v.descriptors.end());
+        WriteTypeCounts(w, descriptors);
+        w.key("layouts");
+        w.beginArray();
+        for (auto& l: v.layouts) w.value(l);
+        w.endArray();
+        w.endObject();
+    }
+    w.endArray();
+    w.endObject();
+    w.finish();
+}
+
+void ExportPoolPlanHeader(const DescriptorPoolPlan& plan, const std::string& source, std::string& out)
+{
+    out.clear();
+    out += "// Generated by vkplc from " + source + ". Do not edit.\n";
+    out += "// Descriptor pool sizes for " + to_string(plan.framesInFlight) + " frames in flight.\n\n";
+    out += "#pragma once\n\n";
+    out += "#include <vulkan/vulkan.h>\n\n";
+    out += "#define VKPLC_FRAMES_IN_FLIGHT " + to_string(plan.framesInFlight) + "\n";
+    for (auto& s: plan.strategies) {
+        string sId = "VKPLC_POOLS_" + ExportIdentifier(s.name);
+        out += "\n// " + s.name + ": " + s.description + ". " + to_string(s.totalSets) + " sets, " +
+               to_string(s.totalBytes) + " bytes of descriptors.\n";
+        out += "#define " + sId + "_NUM_POOLS " + to_string(s.pools.size()) + "\n";
+        for (auto& pool: s.pools) {
+            string pId = sId + "_" + ExportIdentifier(pool.name);
+            if (pool.maxSets > UINT32_MAX) throw std::runtime_error("pool '" + pool.name + "' needs more than 2^32 sets.");
+            size_t numSizes = 0;
+            for (uint64_t n: pool.poolSizes) {
+                if (n > UINT32_MAX) throw std::runtime_error("pool '" + pool.name + "' needs more than 2^32 descriptors of a type.");
+                if (n) numSizes++;
+            }
+            out += "#define " + pId + "_COPIES " + to_string(pool.copies) + "\n";
+            out += "#define " + pId + "_MAX_SETS " + to_string(pool.maxSets) + "u\n";
+            out += "#define " + pId + "_NUM_SIZES " + to_string(numSizes) + "\n";
+            if (!numSizes) continue;
+            out += "static const VkDescriptorPoolSize " + pId + "_SIZES[] = {\n";
+            for (size_t t = 0; t < pool.poolSizes.size(); t++) {
+                if (pool.poolSizes[t]) out += "    { " + descLayoutTypes[t] + ", " + to_string(pool.poolSizes[t]) + "u },\n";
+            }
+            out += "};\n";
+        }
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _DESCRIPTOR_POOLS_
+#define _DESCRIPTOR_POOLS_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "pipelinelayout_model.hpp"
+
+// Descriptor pool sizing. A set variant is one descriptor set layout: the bindings a set has in some
+// pipeline layout, shared by every pipeline layout whose set lists the same ones. Given how many
+// instances of each variant are allocated, PlanDescriptorPools() works out exact VkDescriptorPoolSize
+// counts, maxSets and descriptor memory for a few ways of splitting the sets into pools.
+
+// How many sets get allocated, read from JSON:
+//     {
+//         "frames_in_flight" : 2,
+//         "sets" : { "PSET_PER_OBJECT" : 4096, "PSET_PER_MATERIAL" : { "instances" : 300, "per_frame" : false } },
+//         "layouts" : { "PIPELINE_SKIN" : { "PSET_PER_OBJECT" : 512 } },
+//         "descriptor_bytes" : { "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER" : 64 }
+//     }
+// "sets" gives the instances of each variant of a set; a plain number means per frame in flight, and a
+// set not listed gets one per frame. "layouts" overrides that for the variant a pipeline layout uses;
+// a variant shared by several gets the largest count asked for. "descriptor_bytes" replaces the default
+// size of a descriptor type, rough desktop figures that only the target device can make exact.
+struct PoolSizingInput {
+    struct SetCount {
+        uint32_t instances = 1;
+        bool perFrame = true;           // Allocated again for each frame in flight, rather than once.
+    };
+
+    uint32_t framesInFlight = 2;
+    std::unordered_map<std::string, SetCount> sets;
+    std::unordered_map< std::string, std::unordered_map<std::string, uint32_t> > layouts;
+    std::vector<uint32_t> descriptorBytes;      // By typeIdx.
+
+    PoolSizingInput();
+    // Throws std::runtime_error on malformed input or an unknown descriptor type.
+    void deserialize(const char* begin, const char* end);
+};
+
+struct DescriptorPoolPlan {
+    struct Variant {
+        std::string set;
+        std::vector<std::string> layouts;       // Pipeline layouts using it.
+        std::vector<uint32_t> descriptors;      // Per set, by typeIdx.
+        uint32_t instances = 0;
+        bool perFrame = true;
+    };
+    // copies identical pools, each created with maxSets and poolSizes.
+    struct Pool {
+        std::string name;
+        uint32_t copies = 1;
+        uint64_t maxSets = 0;
+        std::vector<uint64_t> poolSizes;        // By typeIdx.
+        uint64_t bytes = 0;                     // Descriptor memory of one copy.
+    };
+    struct Strategy {
+        std::string name;
+        std::string description;
+        std::vector<Pool> pools;
+        uint64_t totalSets = 0;
+        uint64_t totalBytes = 0;
+    };
+
+    uint32_t framesInFlight = 0;
+    std::vector<Variant> variants;
+    // "global": one pool for everything. "per_frame": one pool per frame in flight with the per-frame sets,
+    // so a frame's pool can be reset on its own, plus one "shared" pool for the sets allocated once.
+    // "per_frequency": one pool per set, one copy per frame in flight for per-frame sets and one in all
+    // for the others. A pool no set would go in is left out.
+    std::vector<Strategy> strategies;
+};
+
+// Throws std::runtime_error if a binding has an invalid type.
+void PlanDescriptorPools(const PipelineLayoutModel& model, const PoolSizingInput& input, DescriptorPoolPlan& out);
+
+void ExportPoolPlanJson(const DescriptorPoolPlan& plan, std::string& out);
+// maxSets and a VkDescriptorPoolSize array per pool; includes <vulkan/vulkan.h>. Throws std::runtime_error
+// if a count does not fit the uint32_t Vulkan takes.
+void ExportPoolPlanHeader(const DescriptorPoolPlan& plan, const std::string& source, std::string& out);
+
+#endif // _DESCRIPTOR_POOLS_
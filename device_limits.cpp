@@ -0,0 +1,388 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "device_limits.hpp"
+#include "build_cache.hpp"
+#include "json_stream.hpp"
+#include <algorithm>
+#include <map>
+#include <math.h>
+#include <stdexcept>
+
+using namespace std;
+
+const char* const deviceLimitNames[NUM_DEVICE_LIMITS] = {
+    "maxPerStageDescriptorSamplers",
+    "maxPerStageDescriptorUniformBuffers",
+    "maxPerStageDescriptorStorageBuffers",
+    "maxPerStageDescriptorSampledImages",
+    "maxPerStageDescriptorStorageImages",
+    "maxPerStageDescriptorInputAttachments",
+    "maxPerStageResources",
+    "maxDescriptorSetSamplers",
+    "maxDescriptorSetUniformBuffers",
+    "maxDescriptorSetUniformBuffersDynamic",
+    "maxDescriptorSetStorageBuffers",
+    "maxDescriptorSetStorageBuffersDynamic",
+    "maxDescriptorSetSampledImages",
+    "maxDescriptorSetStorageImages",
+    "maxDescriptorSetInputAttachments",
+    "maxBoundDescriptorSets"
+};
+
+const char* const shaderStageNames[NUM_SHADER_STAGES] = {
+    "vertex", "tessellation control", "tessellation evaluation", "geometry", "fragment", "compute"
+};
+
+// The descriptor types, as bits by typeIdx, each limit counts.
+static const uint32_t limitTypes[NUM_DEVICE_LIMITS] = {
+    0x003,  // SAMPLER, COMBINED_IMAGE_SAMPLER
+    0x140,  // UNIFORM_BUFFER, UNIFORM_BUFFER_DYNAMIC
+    0x280,  // STORAGE_BUFFER, STORAGE_BUFFER_DYNAMIC
+    0x016,  // COMBINED_IMAGE_SAMPLER, SAMPLED_IMAGE, UNIFORM_TEXEL_BUFFER
+    0x028,  // STORAGE_IMAGE, STORAGE_TEXEL_BUFFER
+    0x400,  // INPUT_ATTACHMENT
+    0x7FE,  // All but SAMPLER
+    0x003,
+    0x140,
+    0x100,
+    0x280,
+    0x200,
+    0x016,
+    0x028,
+    0x400,
+    0x000   // Counts sets, not descriptors.
+};
+
+// Shader stages, as bits by ShaderStage, of the pipeline stage bits in stageFlagBits.
+static uint32_t ShaderStages(uint32_t stageFlagBits)
+{
+    static const struct { int bit; uint32_t stages; } bits[] = {
+        { 3, 1u << SHADER_STAGE_VERTEX },
+        { 4, 1u << SHADER_STAGE_TESSELLATION_CONTROL },
+        { 5, 1u << SHADER_STAGE_TESSELLATION_EVALUATION },
+        { 6, 1u << SHADER_STAGE_GEOMETRY },
+        { 7, 1u << SHADER_STAGE_FRAGMENT },
+        { 11, 1u << SHADER_STAGE_COMPUTE },
+        { 15, (1u << SHADER_STAGE_COMPUTE) - 1 },          // ALL_GRAPHICS
+        { 16, (1u << NUM_SHADER_STAGES) - 1 },             // ALL_COMMANDS
+    };
+    uint32_t stages = 0;
+    for (auto& m: bits) {
+        if ((stageFlagBits >> m.bit) & 1) stages |= m.stages;
+    }
+    return stages;
+}
+
+// Each layout's counts in one row: per-stage limits by stage first, then the others.
+static const int NUM_LIMIT_SLOTS = NUM_PER_STAGE_LIMITS * NUM_SHADER_STAGES + NUM_DEVICE_LIMITS - NUM_PER_STAGE_LIMITS;
+
+static int LimitSlot(int limit, int stage)
+{
+    return limit < NUM_PER_STAGE_LIMITS ? limit * NUM_SHADER_STAGES + stage :
+        NUM_PER_STAGE_LIMITS * NUM_SHADER_STAGES + limit - NUM_PER_STAGE_LIMITS;
+}
+
+// How much of what a limit counts one set of a layout holds; stage -1 for all stages.
+static uint32_t CountInSet(const PipelineLayoutModel& model, const DescriptorSet& dset, int limit, int stage)
+{
+    uint32_t count = 0;
+    for (BindingHandle h: dset.dlayouts) {
+        const DescriptorLayout* dl = model.binding(h);
+        if (!dl || dl->typeIdx < 0 || dl->typeIdx >= (int) descLayoutTypes.size()) continue;
+        if (!((limitTypes[limit] >> dl->typeIdx) & 1)) continue;
+        if (stage >= 0 && !((ShaderStages(dl->stageFlagBits) >> stage) & 1)) continue;
+        count++;
+    }
+    return count;
+}
+
+// -------------------------------------------------------- Profiles -----------------------------------------------
+
+DeviceProfile::DeviceProfile()
+{
+    for (auto& l: limits) l = UINT64_MAX;
+}
+
+// Keeps the lower of each limit an object of VkPhysicalDeviceLimits members gives.
+static void ReadLimits(JsonStreamReader& r, uint64_t* limits)
+{
+    string key;
+    r.beginObject();
+    while (r.nextKey(key)) {
+        auto name = find_if(deviceLimitNames, deviceLimitNames + NUM_DEVICE_LIMITS, [&key](const char* n) { return key == n; });
+        if (name == deviceLimitNames + NUM_DEVICE_LIMITS || r.peekType() != JsonStreamReader::TYPE_NUMBER) {
+            r.skipValue();
+            continue;
+        }
+        int64_t v = r.readInt();
+        if (v < 0) r.fail(key + " is negative");
+        uint64_t& limit = limits[name - deviceLimitNames];
+        limit = min(limit, (uint64_t) v);
+    }
+}
+
+// Reads the first "limits" object at any depth in the value and, if name is given, the first
+// "deviceName" string. Returns whether there were limits.
+static bool FindLimits(JsonStreamReader& r, uint64_t* limits, string* name, bool found = false)
+{
+    string key;
+    if (r.peekType() == JsonStreamReader::TYPE_ARRAY) {
+        r.beginArray();
+        while (r.nextElement()) found = FindLimits(r, limits, name, found);
+    } else if (r.peekType() == JsonStreamReader::TYPE_OBJECT) {
+        r.beginObject();
+        while (r.nextKey(key)) {
+            JsonStreamReader::Type type = r.peekType();
+            if (key == "limits" && type == JsonStreamReader::TYPE_OBJECT && !found) {
+                ReadLimits(r, limits);
+                found = true;
+            } else if (key == "deviceName" && type == JsonStreamReader::TYPE_STRING && name && name->empty()) {
+                r.readString(*name);
+            } else if (type == JsonStreamReader::TYPE_ARRAY || type == JsonStreamReader::TYPE_OBJECT) {
+                found = FindLimits(r, limits, name, found);
+            } else {
+                r.skipValue();
+            }
+        }
+    } else {
+        r.skipValue();
+    }
+    return found;
+}
+
+void ParseDeviceProfiles(const char* begin, const char* end, const std::string& fileName, std::vector<DeviceProfile>& out)
+{
+    JsonStreamReader r(begin, end);
+    DeviceProfile device;
+    device.file = fileName;
+    bool deviceFound = false;
+    map<string, DeviceProfile> capabilities;
+    vector< pair<string, vector<string>> > profiles;
+    string key, name;
+    r.beginObject();
+    while (r.nextKey(key)) {
+        if (key == "capabilities" && r.peekType() == JsonStreamReader::TYPE_OBJECT) {
+            r.beginObject();
+            while (r.nextKey(name)) FindLimits(r, capabilities[name].limits, nullptr);
+        } else if (key == "profiles" && r.peekType() == JsonStreamReader::TYPE_OBJECT) {
+            r.beginObject();
+            while (r.nextKey(name)) {
+                profiles.push_back(make_pair(name, vector<string>()));
+                auto& uses = profiles.back().second;
+                r.beginObject();
+                while (r.nextKey(key)) {
+                    if (key != "capabilities") {
+                        r.skipValue();
+                        continue;
+                    }
+                    r.beginArray();
+                    while (r.nextElement()) {
+                        if (r.peekType() != JsonStreamReader::TYPE_ARRAY) {
+                            uses.push_back(string());
+                            r.readString(uses.back());
+                            continue;
+                        }
+                        // Alternatives: any one of them will do; the first stands for all.
+                        r.beginArray();
+                        for (bool first = true; r.nextElement(); first = false) {
+                            if (first) {
+                                uses.push_back(string());
+                                r.readString(uses.back());
+                            } else {
+                                r.skipValue();
+                            }
+                        }
+                    }
+                }
+            }
+        } else if (!deviceFound || device.name.empty()) {
+            deviceFound = FindLimits(r, device.limits, &device.name, deviceFound);
+        } else {
+            r.skipValue();
+        }
+    }
+    r.finish();
+
+    if (profiles.empty()) {
+        if (!deviceFound) throw std::runtime_error(fileName + ": no device limits.");
+        if (device.name.empty()) {
+            size_t slash = fileName.find_last_of("/\\");
+            device.name = fileName.substr(slash == string::npos ? 0 : slash + 1);
+        }
+        out.push_back(device);
+        return;
+    }
+    for (auto& p: profiles) {
+        DeviceProfile profile;
+        profile.name = p.first;
+        profile.file = fileName;
+        for (auto& use: p.second) {
+            auto c = capabilities.find(use);
+            if (c == capabilities.end()) {
+                throw std::runtime_error(fileName + ": profile " + p.first + " uses unknown capability " + use + ".");
+            }
+            for (int l = 0; l < NUM_DEVICE_LIMITS; l++) profile.limits[l] = min(profile.limits[l], c->second.limits[l]);
+        }
+        out.push_back(profile);
+    }
+}
+
+void LoadDeviceProfiles(const std::string& fileName, std::vector<DeviceProfile>& out)
+{
+    string text;
+    if (!ReadFile(fileName, text)) throw std::runtime_error("Could not open " + fileName + ".");
+    try {
+        ParseDeviceProfiles(text.data(), text.data() + text.size(), fileName, out);
+    } catch (const std::runtime_error& e) {
+        // The reader's messages carry a position but no file.
+        string what = e.what();
+        if (what.compare(0, fileName.size(), fileName)) what = fileName + ": " + what;
+        throw std::runtime_error(what);
+    }
+}
+
+// -------------------------------------------------------- Check -----------------------------------------------
+
+static double UseRatio(const DeviceLimitUse& use)
+{
+    return use.max ? (double) use.used / use.max : use.used ? HUGE_VAL : 0.0;
+}
+
+// Nearer the limit, or further over it: by used / max, given as ra and rb, then by headroom; then in
+// layout, limit and stage order.
+static bool Tighter(double ra, const DeviceLimitUse& a, double rb, const DeviceLimitUse& b)
+{
+    if (ra != rb) return ra > rb;
+    if (a.headroom() != b.headroom()) return a.headroom() < b.headroom();
+    if (a.layout != b.layout) return a.layout < b.layout;
+    return a.limit != b.limit ? a.limit < b.limit : a.stage < b.stage;
+}
+
+void CheckDeviceLimits(const PipelineLayoutModel& model, const std::vector<DeviceProfile>& profiles, size_t numWorst,
+                       DeviceLimitsReport& out)
+{
+    out = DeviceLimitsReport();
+    size_t numProfiles = profiles.size();
+    out.violations.assign(numProfiles, 0);
+    out.layoutsOver.assign(numProfiles, 0);
+    out.tightest.assign(numProfiles, DeviceLimitUse());
+
+    // Which limits each descriptor type counts toward.
+    uint32_t typeLimits[32] = {};
+    for (int l = 0; l < NUM_DEVICE_LIMITS; l++) {
+        for (size_t t = 0; t < descLayoutTypes.size() && t < 32; t++) {
+            if ((limitTypes[l] >> t) & 1) typeLimits[t] |= 1u << l;
+        }
+    }
+    // The profiles' limits in slot order.
+    vector<uint64_t> maxima(numProfiles * NUM_LIMIT_SLOTS);
+    for (size_t p = 0; p < numProfiles; p++) {
+        for (int l = 0; l < NUM_DEVICE_LIMITS; l++) {
+            for (int s = 0; s < (l < NUM_PER_STAGE_LIMITS ? NUM_SHADER_STAGES : 1); s++) {
+                maxima[p * NUM_LIMIT_SLOTS + LimitSlot(l, s)] = profiles[p].limits[l];
+            }
+        }
+    }
+
+    uint32_t used[NUM_LIMIT_SLOTS];
+    vector<bool> over(numProfiles);
+    vector<double> tightest(numProfiles, -1.0);
+    vector< pair<double, DeviceLimitUse> > candidates;
+    for (int layout = 0; layout < (int) model.layouts().size(); layout++) {
+        fill(used, used + NUM_LIMIT_SLOTS, 0);
+        used[LimitSlot(LIMIT_BOUND_DESCRIPTOR_SETS, 0)] = (uint32_t) model.dsets().size();
+        for (auto& dset: model.layouts()[layout].descsets) {
+            for (BindingHandle h: dset.dlayouts) {
+                const DescriptorLayout* dl = model.binding(h);
+                if (!dl || dl->typeIdx < 0 || dl->typeIdx >= (int) descLayoutTypes.size()) continue;
+                uint32_t limits = typeLimits[dl->typeIdx], stages = ShaderStages(dl->stageFlagBits);
+                for (int l = 0; l < NUM_DEVICE_LIMITS; l++) {
+                    if (!((limits >> l) & 1)) continue;
+                    if (l >= NUM_PER_STAGE_LIMITS) {
+                        used[LimitSlot(l, 0)]++;
+                        continue;
+                    }
+                    for (int s = 0; s < NUM_SHADER_STAGES; s++) {
+                        if ((stages >> s) & 1) used[LimitSlot(l, s)]++;
+                    }
+                }
+            }
+        }
+
+        fill(over.begin(), over.end(), false);
+        for (int l = 0; l < NUM_DEVICE_LIMITS; l++) {
+            for (int s = 0; s < (l < NUM_PER_STAGE_LIMITS ? NUM_SHADER_STAGES : 1); s++) {
+                int slot = LimitSlot(l, s);
+                if (!used[slot]) continue;
+                DeviceLimitUse use, worst;
+                use.layout = layout;
+                use.limit = (DeviceLimit) l;
+                use.stage = l < NUM_PER_STAGE_LIMITS ? s : -1;
+                use.used = used[slot];
+                double worstRatio = -1.0;
+                for (size_t p = 0; p < numProfiles; p++) {
+                    use.max = maxima[p * NUM_LIMIT_SLOTS + slot];
+                    if (use.max == UINT64_MAX) continue;
+                    use.profile = (int) p;
+                    if (use.used > use.max) {
+                        out.violations[p]++;
+                        over[p] = true;
+                    }
+                    double ratio = UseRatio(use);
+                    if (ratio >= tightest[p] && (out.tightest[p].layout < 0 || Tighter(ratio, use, tightest[p], out.tightest[p]))) {
+                        out.tightest[p] = use;
+                        tightest[p] = ratio;
+                    }
+                    if (ratio >= worstRatio && (worst.profile < 0 || Tighter(ratio, use, worstRatio, worst))) {
+                        worst = use;
+                        worstRatio = ratio;
+                    }
+                }
+                if (worst.profile >= 0) candidates.push_back(make_pair(worstRatio, worst));
+            }
+        }
+        for (size_t p = 0; p < numProfiles; p++) out.layoutsOver[p] += over[p];
+    }
+
+    numWorst = min(numWorst, candidates.size());
+    partial_sort(candidates.begin(), candidates.begin() + numWorst, candidates.end(),
+        [](const pair<double, DeviceLimitUse>& a, const pair<double, DeviceLimitUse>& b) {
+            return Tighter(a.first, a.second, b.first, b.second);
+        });
+    for (size_t i = 0; i < numWorst; i++) out.worst.push_back(candidates[i].second);
+
+    // The set behind each reported use.
+    auto attribute = [&model](DeviceLimitUse& use) {
+        if (use.layout < 0 || use.limit == LIMIT_BOUND_DESCRIPTOR_SETS) return;
+        for (auto& dset: model.layouts()[use.layout].descsets) {
+            uint32_t count = CountInSet(model, dset, use.limit, use.stage);
+            if (count > use.setCount) {
+                use.set = (int) dset.index;
+                use.setCount = count;
+            }
+        }
+    };
+    for (auto& use: out.tightest) attribute(use);
+    for (auto& use: out.worst) attribute(use);
+}
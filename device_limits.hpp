@@ -0,0 +1,112 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _DEVICE_LIMITS_
+#define _DEVICE_LIMITS_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "pipelinelayout_model.hpp"
+
+// The VkPhysicalDeviceLimits a pipeline layout's descriptors count against. The per-stage ones apply to
+// each shader stage on its own, the others to the whole layout, all its sets and stages together.
+enum DeviceLimit {
+    LIMIT_PER_STAGE_SAMPLERS,
+    LIMIT_PER_STAGE_UNIFORM_BUFFERS,
+    LIMIT_PER_STAGE_STORAGE_BUFFERS,
+    LIMIT_PER_STAGE_SAMPLED_IMAGES,
+    LIMIT_PER_STAGE_STORAGE_IMAGES,
+    LIMIT_PER_STAGE_INPUT_ATTACHMENTS,
+    LIMIT_PER_STAGE_RESOURCES,
+    LIMIT_SET_SAMPLERS,
+    LIMIT_SET_UNIFORM_BUFFERS,
+    LIMIT_SET_UNIFORM_BUFFERS_DYNAMIC,
+    LIMIT_SET_STORAGE_BUFFERS,
+    LIMIT_SET_STORAGE_BUFFERS_DYNAMIC,
+    LIMIT_SET_SAMPLED_IMAGES,
+    LIMIT_SET_STORAGE_IMAGES,
+    LIMIT_SET_INPUT_ATTACHMENTS,
+    LIMIT_BOUND_DESCRIPTOR_SETS,
+    NUM_DEVICE_LIMITS,
+    NUM_PER_STAGE_LIMITS = LIMIT_SET_SAMPLERS
+};
+
+// Shader stages, from the pipeline stage bits of stageFlagBits; ALL_GRAPHICS and ALL_COMMANDS stand for
+// the stages they cover.
+enum ShaderStage {
+    SHADER_STAGE_VERTEX,
+    SHADER_STAGE_TESSELLATION_CONTROL,
+    SHADER_STAGE_TESSELLATION_EVALUATION,
+    SHADER_STAGE_GEOMETRY,
+    SHADER_STAGE_FRAGMENT,
+    SHADER_STAGE_COMPUTE,
+    NUM_SHADER_STAGES
+};
+
+extern const char* const deviceLimitNames[NUM_DEVICE_LIMITS];   // As VkPhysicalDeviceLimits has them.
+extern const char* const shaderStageNames[NUM_SHADER_STAGES];
+
+struct DeviceProfile {
+    std::string name;
+    std::string file;
+    uint64_t limits[NUM_DEVICE_LIMITS];     // UINT64_MAX where the file gives none: not checked.
+
+    DeviceProfile();
+};
+
+// Appends the device profiles in a JSON file: one per entry of "profiles" in the Vulkan Profiles format,
+// with the lowest of each limit among its capabilities (the first of alternatives); otherwise one for a
+// device report as gpuinfo.org or vulkaninfo write it, named by its deviceName, with the first "limits"
+// object found anywhere in it. Throws std::runtime_error on malformed input or a file with no limits.
+void LoadDeviceProfiles(const std::string& fileName, std::vector<DeviceProfile>& out);
+void ParseDeviceProfiles(const char* begin, const char* end, const std::string& fileName, std::vector<DeviceProfile>& out);
+
+// One pipeline layout's use of one limit on one profile.
+struct DeviceLimitUse {
+    int layout = -1;
+    int profile = -1;
+    DeviceLimit limit = NUM_DEVICE_LIMITS;
+    int stage = -1;             // ShaderStage for the per-stage limits, -1 for the others.
+    int set = -1;               // The set that contributes most; -1 for LIMIT_BOUND_DESCRIPTOR_SETS.
+    uint32_t setCount = 0;      // Its contribution.
+    uint32_t used = 0;
+    uint64_t max = 0;
+    int64_t headroom(void) const { return (int64_t) max - (int64_t) used; }
+};
+
+struct DeviceLimitsReport {
+    std::vector<size_t> violations;             // Per profile: uses over the limit.
+    std::vector<size_t> layoutsOver;            // Per profile: pipeline layouts with any.
+    std::vector<DeviceLimitUse> tightest;       // Per profile: the use nearest its limit, or over it most.
+    // The uses nearest their limits or furthest over them, by used / max, one per layout, limit and stage,
+    // on the profile where it is tightest.
+    std::vector<DeviceLimitUse> worst;
+};
+
+// Counts each layout's descriptors once, then compares them with every profile. Bindings of an invalid
+// type count toward nothing.
+void CheckDeviceLimits(const PipelineLayoutModel& model, const std::vector<DeviceProfile>& profiles, size_t numWorst,
+                       DeviceLimitsReport& out);
+
+#endif // _DEVICE_LIMITS_
@@ -0,0 +1,694 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "edit_journal.hpp"
+#include "pipelinelayout_binary.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+using namespace std;
+
+#define VKPIPELINE_JOURNAL_VERSION 1
+
+static const char JOURNAL_MAGIC[8] = { 'V', 'K', 'P', 'L', 'J', 'N', 'L', '\0' };
+
+enum JournalOp : uint8_t {
+    JOURNAL_CHECKPOINT = 0xF0,
+    JOURNAL_REBASE = 0xF1
+};
+
+struct JournalHeader {
+    char magic[8];          // "VKPLJNL\0"
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t baseSize;      // Project file the journal was started on; ~0 if there was none.
+    uint32_t baseCrc;
+    uint32_t reserved;
+    uint64_t resumePos;     // Logical position of the record at resumeOffset. Records before it (the
+    uint64_t resumeOffset;  // checkpoint and carried-over rebases) come from before compaction.
+};
+
+static_assert(sizeof(JournalHeader) == 48, "JournalHeader layout is part of the file format");
+
+static const uint64_t NO_FILE = ~0ull;
+static const size_t RECORD_HEADER = 8;
+
+// -------------------------------------------------------- Encoding -----------------------------------------------
+
+static uint32_t Crc32(const void* data, size_t size, uint32_t crc = 0)
+{
+    static const vector<uint32_t> table = []() {
+        vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    auto* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void PutVarint(string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out += (char) (v | 0x80);
+        v >>= 7;
+    }
+    out += (char) v;
+}
+
+static bool GetVarint(const char*& p, const char* end, uint64_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p == end) return false;
+        uint8_t b = (uint8_t) *p++;
+        v |= uint64_t(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+static uint32_t ZigZag(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+static int32_t UnZigZag(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+static void EncodeEdit(string& out, const ModelEdit& edit)
+{
+    out += (char) edit.op;
+    int numArgs = ModelEditNumArgs(edit.op);
+    for (int i = 0; i < numArgs; i++) PutVarint(out, ZigZag(edit.args[i]));
+    if (ModelEditHasText(edit.op)) {
+        size_t len = edit.text ? strlen(edit.text) : 0;
+        PutVarint(out, len);
+        out.append(edit.text ? edit.text : "", len);
+    }
+}
+
+static bool DecodeEdit(const char* p, const char* end, ModelEdit& edit, string& text)
+{
+    if (p == end) return false;
+    edit.op = (ModelEditOp) (uint8_t) *p++;
+    int numArgs = ModelEditNumArgs(edit.op);
+    if (numArgs < 0) return false;
+    uint64_t v;
+    for (int i = 0; i < 4; i++) {
+        edit.args[i] = 0;
+        if (i >= numArgs) continue;
+        if (!GetVarint(p, end, v) || v > 0xffffffffu) return false;
+        edit.args[i] = UnZigZag((uint32_t) v);
+    }
+    edit.text = nullptr;
+    if (ModelEditHasText(edit.op)) {
+        if (!GetVarint(p, end, v) || v > uint64_t(end - p)) return false;
+        text.assign(p, (size_t) v);
+        p += v;
+        edit.text = text.c_str();
+    }
+    return p == end;
+}
+
+static void AppendRecord(string& out, const string& payload)
+{
+    uint32_t head[2] = { (uint32_t) payload.size(), Crc32(payload.data(), payload.size()) };
+    out.append(reinterpret_cast<const char*>(head), sizeof(head));
+    out += payload;
+}
+
+static string RebasePayload(uint64_t mark, uint64_t size, uint32_t crc)
+{
+    string payload(1, (char) JOURNAL_REBASE);
+    PutVarint(payload, mark);
+    PutVarint(payload, size);
+    PutVarint(payload, crc);
+    return payload;
+}
+
+static bool ReadWholeFile(const string& fileName, string& out)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) return false;
+    char buf[65536];
+    size_t n;
+    out.clear();
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) out.append(buf, n);
+    fclose(file);
+    return true;
+}
+
+static void WriteWholeFile(const string& fileName, const string& data)
+{
+    string tmp = fileName + ".tmp";
+    FILE* file = fopen(tmp.c_str(), "wb");
+    if (!file) throw runtime_error("Could not open " + tmp + " for writing.");
+    bool ok = fwrite(data.data(), 1, data.size(), file) == data.size() && SyncFile(file);
+    if (fclose(file) != 0 || !ok || !RenameOver(tmp, fileName)) {
+        remove(tmp.c_str());
+        throw runtime_error("Could not write " + fileName + ".");
+    }
+}
+
+// -------------------------------------------------------- EditJournal -----------------------------------------------
+
+EditJournal::~EditJournal()
+{
+    close();
+}
+
+std::string EditJournal::journalFileName(const std::string& projectFile)
+{
+    return projectFile + ".journal";
+}
+
+EditJournal::Fingerprint EditJournal::fingerprint(const std::string& fileName)
+{
+    Fingerprint fp = { NO_FILE, 0 };
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (!file) return fp;
+    vector<char> buf(1 << 20);
+    size_t n;
+    fp.size = 0;
+    while ((n = fread(buf.data(), 1, buf.size(), file)) > 0) {
+        fp.crc = Crc32(buf.data(), n, fp.crc);
+        fp.size += n;
+    }
+    fclose(file);
+    return fp;
+}
+
+// Header, then an optional checkpoint and the rebases that let it be matched against the project file.
+static string JournalPrefix(uint64_t baseSize, uint32_t baseCrc, uint64_t resumePos,
+                            const string* checkpoint, const string& rebases)
+{
+    JournalHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = VKPIPELINE_JOURNAL_VERSION;
+    header.headerSize = sizeof(JournalHeader);
+    header.baseSize = baseSize;
+    header.baseCrc = baseCrc;
+    header.resumePos = resumePos;
+
+    string out(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (checkpoint) AppendRecord(out, *checkpoint);
+    out += rebases;
+    reinterpret_cast<JournalHeader*>(&out[0])->resumeOffset = out.size();
+    return out;
+}
+
+void EditJournal::create(const Fingerprint& base, const std::string* checkpoint)
+{
+    string prefix = JournalPrefix(base.size, base.crc, 0, checkpoint, "");
+    WriteWholeFile(m_path, prefix);
+    m_file = fopen(m_path.c_str(), "r+b");
+    if (!m_file) throw runtime_error("Could not open " + m_path + ".");
+    fseek(m_file, 0, SEEK_END);
+
+    m_resumePos = 0;
+    m_resumeOffset = prefix.size();
+    m_writtenPos = m_pos = m_durablePos = 0;
+    m_base = base;
+    m_rebases.clear();
+    m_compactFrom = 0;
+    m_checkpointBytes = checkpoint ? checkpoint->size() : 0;
+}
+
+// If the journal on disk applies to the project, replays it and leaves m_file open for appending.
+size_t EditJournal::replay(PipelineLayoutModel& model, const Fingerprint& project)
+{
+    string text;
+    if (!ReadWholeFile(m_path, text)) return 0;
+
+    auto moveAside = [&]() {
+        RenameOver(m_path, m_path + ".stale");
+        return 0;
+    };
+
+    if (text.size() < sizeof(JournalHeader)) return moveAside();
+    JournalHeader header;
+    memcpy(&header, text.data(), sizeof(header));
+    if (memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version > VKPIPELINE_JOURNAL_VERSION || header.headerSize < sizeof(JournalHeader) ||
+        header.resumeOffset < header.headerSize || header.resumeOffset > text.size()) {
+        return moveAside();
+    }
+
+    struct Record {
+        size_t offset;
+        const char* payload;
+        uint32_t size;
+    };
+    vector<Record> records;
+    size_t end = header.headerSize;
+    while (text.size() - end >= RECORD_HEADER) {
+        uint32_t head[2];
+        memcpy(head, text.data() + end, sizeof(head));
+        if (head[0] == 0 || head[0] > text.size() - end - RECORD_HEADER) break;
+        const char* payload = text.data() + end + RECORD_HEADER;
+        if (Crc32(payload, head[0]) != head[1]) break;
+        records.push_back({ end, payload, head[0] });
+        end += RECORD_HEADER + head[0];
+    }
+    // The prefix is only ever written whole, by a rename; damage there is not a torn append.
+    if (end < header.resumeOffset) return moveAside();
+
+    auto posOf = [&](size_t offset) {
+        return offset < header.resumeOffset ? header.resumePos : header.resumePos + (offset - header.resumeOffset);
+    };
+
+    Fingerprint base = { header.baseSize, header.baseCrc };
+    int checkpoint = -1;
+    bool matched = base == project;
+    bool rebased = false;
+    uint64_t rebaseMark = 0;
+    vector<Rebase> rebases;
+    for (int i = 0; i < (int) records.size(); i++) {
+        auto& r = records[i];
+        uint8_t op = (uint8_t) r.payload[0];
+        if (op == JOURNAL_CHECKPOINT) {
+            checkpoint = i;
+        } else if (op == JOURNAL_REBASE) {
+            const char* p = r.payload + 1;
+            uint64_t mark, size, crc;
+            if (!GetVarint(p, r.payload + r.size, mark) || !GetVarint(p, r.payload + r.size, size) ||
+                !GetVarint(p, r.payload + r.size, crc)) {
+                continue;
+            }
+            Rebase rebase = { mark, { size, (uint32_t) crc } };
+            rebases.push_back(rebase);
+            if (rebase.file == project) {
+                rebased = true;
+                rebaseMark = mark;
+            }
+        }
+    }
+
+    // Where the model starts from: the project file as loaded, if the journal says which edits
+    // it already contains, otherwise the checkpoint, as long as the project is one this journal knows.
+    uint64_t from;
+    if (rebased && (checkpoint < 0 || rebaseMark >= header.resumePos)) {
+        from = rebaseMark;
+    } else if (checkpoint >= 0 && (matched || rebased)) {
+        auto& r = records[checkpoint];
+        string image(r.payload + 1, r.size - 1);    // Copied for the alignment the binary view needs.
+        try {
+            model.deserializeBinary(PipelineLayoutBinary(image.data(), image.size()));
+        } catch (const runtime_error& e) {
+            throw runtime_error(m_path + ": " + e.what());
+        }
+        from = posOf(r.offset + RECORD_HEADER + r.size);
+    } else if (checkpoint < 0 && matched) {
+        from = header.resumePos;
+    } else {
+        return moveAside();
+    }
+
+    size_t replayed = 0;
+    ModelEdit edit;
+    string editText;
+    for (auto& r: records) {
+        uint8_t op = (uint8_t) r.payload[0];
+        if (op == JOURNAL_CHECKPOINT || op == JOURNAL_REBASE || r.offset < header.resumeOffset) continue;
+        if (!DecodeEdit(r.payload, r.payload + r.size, edit, editText)) {
+            end = r.offset;     // Written by a newer editor, or damaged: cut it off with the tail.
+            break;
+        }
+        if (posOf(r.offset) < from) continue;
+        model.applyEdit(edit);
+        replayed++;
+    }
+
+    m_file = fopen(m_path.c_str(), "r+b");
+    if (!m_file) throw runtime_error("Could not open " + m_path + ".");
+    if (end < text.size() && !TruncateFile(m_file, end)) {
+        fclose(m_file);
+        m_file = nullptr;
+        throw runtime_error("Could not truncate " + m_path + ".");
+    }
+    fseek(m_file, 0, SEEK_END);
+
+    m_resumePos = header.resumePos;
+    m_resumeOffset = header.resumeOffset;
+    m_writtenPos = m_pos = m_durablePos = posOf(end);
+    m_base = base;
+    m_rebases = rebases;
+    m_compactFrom = header.resumePos;
+    m_checkpointBytes = checkpoint >= 0 ? records[checkpoint].size : 0;
+    return replayed;
+}
+
+size_t EditJournal::open(PipelineLayoutModel& model, const std::string& projectFile)
+{
+    close();
+    m_project = projectFile;
+    m_path = journalFileName(projectFile);
+    m_generation++;
+    m_error.clear();
+    m_stats = Stats();
+
+    Fingerprint project = fingerprint(projectFile);
+    size_t replayed = replay(model, project);
+    if (!m_file) create(project, nullptr);
+    start(model);
+    return replayed;
+}
+
+void EditJournal::restart(PipelineLayoutModel& model, const std::string& projectFile)
+{
+    close();
+    string previous = m_path;
+    m_project = projectFile;
+    m_path = journalFileName(projectFile);
+    m_generation++;
+    m_error.clear();
+    m_stats = Stats();
+
+    string checkpoint(1, (char) JOURNAL_CHECKPOINT);
+    string image;
+    model.serializeBinary(image);
+    checkpoint += image;
+    create(fingerprint(projectFile), &checkpoint);
+    if (!previous.empty() && previous != m_path) remove(previous.c_str());
+    start(model);
+}
+
+void EditJournal::start(PipelineLayoutModel& model)
+{
+    m_buffer.clear();
+    m_lastRecord = string::npos;
+    m_compactJob.reset();
+    m_compacting = false;
+    m_syncRequested = false;
+    m_quit = false;
+    {
+        lock_guard<mutex> lock(m_lock);
+        m_model = &model;
+    }
+    model.addEditListener(this);
+    m_thread = thread(&EditJournal::writerMain, this);
+}
+
+void EditJournal::close(void)
+{
+    if (!m_model) return;
+    m_model->removeEditListener(this);
+    {
+        lock_guard<mutex> lock(m_lock);
+        m_quit = true;
+        m_model = nullptr;
+    }
+    m_wake.notify_all();
+    if (m_thread.joinable()) m_thread.join();
+    if (m_file) fclose(m_file);
+    m_file = nullptr;
+}
+
+void EditJournal::sync(void)
+{
+    unique_lock<mutex> lock(m_lock);
+    if (m_quit || !m_model) return;
+    uint64_t target = m_pos;
+    m_lastRecord = string::npos;
+    m_syncRequested = true;
+    m_wake.notify_all();
+    m_synced.wait(lock, [&]() { return m_durablePos >= target || !m_error.empty() || m_quit; });
+}
+
+EditJournal::Mark EditJournal::mark(void)
+{
+    lock_guard<mutex> lock(m_lock);
+    m_lastRecord = string::npos;
+    return { m_generation, m_pos };
+}
+
+void EditJournal::rebase(const std::string& tmpFile, const Mark& mark)
+{
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (mark.generation != m_generation || !m_model || m_quit) return;
+    }
+    Fingerprint file = fingerprint(tmpFile);
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (mark.generation != m_generation || !m_model || m_quit || !m_error.empty()) return;
+        append(RebasePayload(mark.pos, file.size, file.crc));
+        m_lastRecord = string::npos;
+        m_rebases.push_back({ mark.pos, file });
+    }
+    sync();
+}
+
+// Called with m_lock held.
+void EditJournal::append(const std::string& payload)
+{
+    size_t at = m_buffer.size();
+    if (at == 0) {
+        m_commitDeadline = chrono::steady_clock::now() + chrono::milliseconds(m_groupCommitMs);
+        m_wake.notify_all();
+    }
+    AppendRecord(m_buffer, payload);
+    m_pos += m_buffer.size() - at;
+    m_stats.records++;
+    m_stats.bytes += m_buffer.size() - at;
+}
+
+// Called with m_lock held.
+void EditJournal::record(const ModelEdit& edit)
+{
+    m_payload.clear();
+    EncodeEdit(m_payload, edit);
+    int key = ModelEditTargetArgs(edit.op);
+    if (key && m_lastRecord != string::npos && m_lastEdit.op == edit.op &&
+        equal(edit.args, edit.args + key, m_lastEdit.args)) {
+        m_pos -= m_buffer.size() - m_lastRecord;
+        m_buffer.resize(m_lastRecord);
+    }
+    size_t at = m_buffer.size();
+    append(m_payload);
+    m_lastRecord = key ? at : string::npos;
+    m_lastEdit = edit;
+    m_lastEdit.text = nullptr;
+}
+
+// Called with m_lock held. True if the caller is to start a compaction.
+bool EditJournal::compactionDue(void)
+{
+    if (m_compacting || m_pos - m_compactFrom <= max(m_compactBytes, m_checkpointBytes)) return false;
+    m_compacting = true;
+    m_lastRecord = string::npos;
+    return true;
+}
+
+void EditJournal::startCompaction(void)
+{
+    // The snapshot has to be taken here, on the thread that edits the model; the rest is the writer's.
+    unique_ptr<CompactJob> job(new CompactJob);
+    job->snapshot.reset(new PipelineLayoutSnapshot);
+    m_model->snapshot(*job->snapshot);
+    lock_guard<mutex> lock(m_lock);
+    job->mark = m_pos;
+    m_compactJob = move(job);
+    m_wake.notify_all();
+}
+
+void EditJournal::onEdit(const ModelEdit& edit)
+{
+    bool compact;
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (!m_error.empty() || !m_model) return;
+        record(edit);
+        compact = compactionDue();
+    }
+    if (compact) startCompaction();
+}
+
+void EditJournal::onChangeSet(const ModelChangeSet& changes)
+{
+    // The whole transaction under one lock, so the writer never picks up part of it.
+    bool compact;
+    {
+        lock_guard<mutex> lock(m_lock);
+        if (!m_error.empty() || !m_model) return;
+        for (auto& edit: changes.edits) record(edit);
+        compact = compactionDue();
+    }
+    if (compact) startCompaction();
+}
+
+void EditJournal::setGroupCommitMs(int ms)
+{
+    lock_guard<mutex> lock(m_lock);
+    m_groupCommitMs = ms;
+}
+
+void EditJournal::setCompactBytes(uint64_t bytes)
+{
+    lock_guard<mutex> lock(m_lock);
+    m_compactBytes = bytes;
+}
+
+std::string EditJournal::error(void) const
+{
+    lock_guard<mutex> lock(m_lock);
+    return m_error;
+}
+
+EditJournal::Stats EditJournal::stats(void) const
+{
+    lock_guard<mutex> lock(m_lock);
+    return m_stats;
+}
+
+// Rewrites the journal as: the checkpoint, the known project file versions, and the records from the
+// snapshot's position on. Replaces the file by a rename, so a crash leaves either journal whole.
+void EditJournal::compact(CompactJob& job)
+{
+    auto t0 = chrono::steady_clock::now();
+    string tmp = m_path + ".tmp";
+    FILE* out = nullptr;
+    try {
+        string checkpoint(1, (char) JOURNAL_CHECKPOINT);
+        {
+            PipelineLayoutModel model;
+            model.restore(*job.snapshot);
+            job.snapshot.reset();
+            string image;
+            model.serializeBinary(image);
+            checkpoint += image;
+        }
+
+        Fingerprint base;
+        string rebases;
+        {
+            lock_guard<mutex> lock(m_lock);
+            base = m_base;
+            // Only the newest mark per file version matters.
+            vector<Rebase> kept;
+            for (int i = (int) m_rebases.size() - 1; i >= 0; i--) {
+                bool seen = false;
+                for (auto& k: kept) seen = seen || k.file == m_rebases[i].file;
+                if (!seen) kept.push_back(m_rebases[i]);
+            }
+            reverse(kept.begin(), kept.end());
+            m_rebases = kept;
+            for (auto& r: kept) AppendRecord(rebases, RebasePayload(r.mark, r.file.size, r.file.crc));
+        }
+        string prefix = JournalPrefix(base.size, base.crc, job.mark, &checkpoint, rebases);
+
+        out = fopen(tmp.c_str(), "wb");
+        if (!out) throw runtime_error("Could not open " + tmp + " for writing.");
+        if (fwrite(prefix.data(), 1, prefix.size(), out) != prefix.size()) throw runtime_error("Write failed.");
+
+        uint64_t from = m_resumeOffset + (job.mark - m_resumePos);
+        uint64_t to = m_resumeOffset + (m_writtenPos - m_resumePos);
+        if (fseek(m_file, (long) from, SEEK_SET) != 0) throw runtime_error("Seek failed.");
+        vector<char> buf(1 << 16);
+        while (from < to) {
+            size_t n = (size_t) min<uint64_t>(buf.size(), to - from);
+            if (fread(buf.data(), 1, n, m_file) != n || fwrite(buf.data(), 1, n, out) != n) {
+                throw runtime_error("Copy failed.");
+            }
+            from += n;
+        }
+        bool ok = SyncFile(out);
+        ok = fclose(out) == 0 && ok;
+        out = nullptr;
+        if (!ok || !RenameOver(tmp, m_path)) throw runtime_error("Could not write " + m_path + ".");
+
+        fclose(m_file);
+        m_file = fopen(m_path.c_str(), "r+b");
+        if (!m_file) throw runtime_error("Could not open " + m_path + ".");
+        fseek(m_file, 0, SEEK_END);
+        m_resumePos = job.mark;
+        m_resumeOffset = prefix.size();
+
+        lock_guard<mutex> lock(m_lock);
+        m_compactFrom = job.mark;
+        m_checkpointBytes = checkpoint.size();
+        m_stats.compactions++;
+        m_stats.compactMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    } catch (const exception& e) {
+        if (out) fclose(out);
+        remove(tmp.c_str());
+        lock_guard<mutex> lock(m_lock);
+        if (m_error.empty()) m_error = m_path + ": " + e.what();
+        m_synced.notify_all();
+    }
+}
+
+void EditJournal::writerMain(void)
+{
+    unique_lock<mutex> lock(m_lock);
+    string pending;
+    while (true) {
+        if (!m_error.empty()) {
+            m_buffer.clear();
+            m_compactJob.reset();
+        }
+        if (m_buffer.empty() && !m_compactJob) {
+            if (m_quit) break;
+            m_wake.wait(lock);
+            continue;
+        }
+        // Let appends gather until the deadline, unless someone is waiting on them.
+        if (!m_buffer.empty() && !m_syncRequested && !m_quit &&
+            chrono::steady_clock::now() < m_commitDeadline) {
+            m_wake.wait_until(lock, m_commitDeadline);
+            continue;
+        }
+
+        if (!m_buffer.empty()) {
+            pending.swap(m_buffer);
+            m_buffer.clear();
+            m_lastRecord = string::npos;
+            m_syncRequested = false;
+            uint64_t end = m_pos;
+            lock.unlock();
+            bool ok = fwrite(pending.data(), 1, pending.size(), m_file) == pending.size() && SyncFile(m_file);
+            pending.clear();
+            lock.lock();
+            if (ok) {
+                m_writtenPos = m_durablePos = end;
+                m_stats.syncs++;
+            } else if (m_error.empty()) {
+                m_error = "Could not write " + m_path + ".";
+            }
+            m_synced.notify_all();
+            continue;
+        }
+
+        if (m_quit) break;      // A compaction still queued is not needed to close.
+        unique_ptr<CompactJob> job = move(m_compactJob);
+        lock.unlock();
+        compact(*job);
+        lock.lock();
+        m_compacting = false;
+    }
+    m_compactJob.reset();
+    m_synced.notify_all();
+}
@@ -0,0 +1,173 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _EDIT_JOURNAL_
+#define _EDIT_JOURNAL_
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <cstdio>
+#include "pipelinelayout_model.hpp"
+
+// <project>.journal: every edit made since the project file was written, appended as it happens, so a
+// crash loses at most the last group commit. All integers are little-endian.
+//
+//     JournalHeader       Which project file the journal applies to, and where its logical positions start.
+//     record*             uint32_t size, uint32_t crc32 of the payload, payload[size]
+//
+// A payload is a ModelEditOp byte, the op's args as zigzag varints and, if the op has text, a varint
+// length and the bytes. Two more ops belong to the journal itself:
+//     JOURNAL_CHECKPOINT  The whole model as a .vkpipeline.bin image. Written by compaction; replay starts there.
+//     JOURNAL_REBASE      The project file was rewritten with the state at logical position `mark`, and now
+//                         has the given size and crc32. Written before the rename that makes it true.
+// Logical positions count record bytes since the journal was started and survive compaction.
+// Replay stops at the first torn or corrupt record and cuts the file there.
+class EditJournal : public ModelEditListener
+{
+public:
+    struct Stats {
+        uint64_t records = 0;       // Appended since open().
+        uint64_t bytes = 0;
+        uint64_t syncs = 0;         // fsyncs, each covering every record appended before it.
+        uint64_t compactions = 0;
+        double compactMs = 0.0;     // Last compaction, on the writer thread.
+    };
+
+    // A point in the edit stream, taken together with a save's snapshot.
+    struct Mark {
+        uint64_t generation;
+        uint64_t pos;
+    };
+
+    EditJournal() {}
+    ~EditJournal();                 // close()
+    EditJournal(const EditJournal&) = delete;
+    EditJournal& operator=(const EditJournal&) = delete;
+
+    static std::string journalFileName(const std::string& projectFile);
+
+    // Replays <projectFile>.journal onto model, which must hold what load(projectFile) produced (or
+    // initDefault() if there is no such file), then journals every further edit of it. A journal written
+    // against some other version of the project file is moved aside to .journal.stale. Returns the
+    // number of edits replayed. Throws std::runtime_error.
+    size_t open(PipelineLayoutModel& model, const std::string& projectFile);
+
+    // Drops the current journal and starts one for projectFile, checkpointed with the model as it is
+    // now. For Save As, once projectFile has been written.
+    void restart(PipelineLayoutModel& model, const std::string& projectFile);
+
+    // Writes out what is pending, stops listening and closes the file. The journal stays on disk.
+    void close(void);
+
+    // Blocks until every edit made so far is on disk.
+    void sync(void);
+
+    Mark mark(void);
+
+    // Pass as writeFile()'s beforeReplace: durably notes that tmpFile, once renamed over the project
+    // file, holds the model as of `mark`. Runs on any thread; a mark from an earlier open() is ignored.
+    void rebase(const std::string& tmpFile, const Mark& mark);
+
+    void onEdit(const ModelEdit& edit) override;
+    void onChangeSet(const ModelChangeSet& changes) override;
+
+    // The writer waits this long after an append for more to share its fsync.
+    void setGroupCommitMs(int ms);
+    // Compaction starts once this many record bytes follow the checkpoint, or the size of the
+    // checkpoint if that is bigger.
+    void setCompactBytes(uint64_t bytes);
+
+    bool isOpen(void) const { return m_model != nullptr; }
+    const std::string& fileName(void) const { return m_path; }
+    std::string error(void) const;  // First write error; nothing is journaled after one.
+    Stats stats(void) const;
+
+private:
+    struct Fingerprint {
+        uint64_t size;
+        uint32_t crc;
+        bool operator==(const Fingerprint& o) const { return size == o.size && crc == o.crc; }
+    };
+    struct Rebase {
+        uint64_t mark;
+        Fingerprint file;
+    };
+    struct CompactJob {
+        std::unique_ptr<PipelineLayoutSnapshot> snapshot;
+        uint64_t mark;
+    };
+
+    static Fingerprint fingerprint(const std::string& fileName);
+    void create(const Fingerprint& base, const std::string* checkpoint);
+    size_t replay(PipelineLayoutModel& model, const Fingerprint& project);
+    void start(PipelineLayoutModel& model);
+    void append(const std::string& payload);
+    void record(const ModelEdit& edit);
+    bool compactionDue(void);
+    void startCompaction(void);
+    void compact(CompactJob& job);
+    void writerMain(void);
+
+    PipelineLayoutModel* m_model = nullptr;
+    std::string m_project;
+    std::string m_path;
+    uint64_t m_generation = 0;
+
+    // Owned by the writer thread while it runs.
+    FILE* m_file = nullptr;
+    uint64_t m_resumePos = 0;       // Logical position of the record at m_resumeOffset.
+    uint64_t m_resumeOffset = 0;
+    uint64_t m_writtenPos = 0;      // Logical end of what is in the file.
+
+    std::thread m_thread;
+    mutable std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_synced;
+    std::string m_buffer;           // Encoded, not yet written.
+    std::string m_payload;          // Scratch for record().
+    uint64_t m_pos = 0;             // Logical end, including m_buffer.
+    uint64_t m_durablePos = 0;
+    std::chrono::steady_clock::time_point m_commitDeadline;
+    size_t m_lastRecord = std::string::npos;   // Offset in m_buffer of the last record, while it may be coalesced.
+    ModelEdit m_lastEdit;
+    Fingerprint m_base = { 0, 0 };
+    std::vector<Rebase> m_rebases;
+    std::unique_ptr<CompactJob> m_compactJob;
+    bool m_compacting = false;
+    uint64_t m_compactFrom = 0;     // Logical position of the last checkpoint.
+    uint64_t m_checkpointBytes = 0;
+    bool m_syncRequested = false;
+    bool m_quit = false;
+    std::string m_error;
+    Stats m_stats;
+
+    int m_groupCommitMs = 20;
+    uint64_t m_compactBytes = 4 << 20;
+};
+
+#endif // _EDIT_JOURNAL_
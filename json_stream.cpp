@@ -0,0 +1,580 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "json_stream.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdexcept>
+
+using namespace std;
+
+JsonStreamReader::JsonStreamReader(const char* begin, const char* end)
+    : m_begin(begin), m_p(begin), m_end(end)
+{
+    // Tolerate a UTF-8 BOM, as files saved from Windows editors often carry one.
+    if (m_end - m_p >= 3 && !memcmp(m_p, "\xEF\xBB\xBF", 3)) m_p += 3;
+}
+
+void JsonStreamReader::fail(const std::string& msg) const
+{
+    int line = 1, col = 1;
+    for (const char* c = m_begin; c < m_p && c < m_end; c++) {
+        if (*c == '\n') { line++; col = 1; } else { col++; }
+    }
+    throw std::runtime_error("Line " + to_string(line) + ", Column " + to_string(col) + ": " + msg);
+}
+
+void JsonStreamReader::skipSpace(void)
+{
+    while (m_p < m_end) {
+        char c = *m_p;
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            m_p++;
+        } else if (c == '/' && m_p + 1 < m_end && m_p[1] == '/') {
+            while (m_p < m_end && *m_p != '\n') m_p++;
+        } else if (c == '/' && m_p + 1 < m_end && m_p[1] == '*') {
+            const char* close = m_p + 2;
+            while (close + 1 < m_end && !(close[0] == '*' && close[1] == '/')) close++;
+            if (close + 1 >= m_end) fail("Unterminated comment");
+            m_p = close + 2;
+        } else {
+            break;
+        }
+    }
+}
+
+void JsonStreamReader::expect(char c)
+{
+    skipSpace();
+    if (m_p >= m_end || *m_p != c) fail(string("Expected '") + c + "'");
+    m_p++;
+}
+
+static void AppendUtf8(std::string& out, uint32_t cp)
+{
+    if (cp < 0x80) {
+        out.push_back((char) cp);
+    } else if (cp < 0x800) {
+        out.push_back((char) (0xC0 | (cp >> 6)));
+        out.push_back((char) (0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back((char) (0xE0 | (cp >> 12)));
+        out.push_back((char) (0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char) (0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back((char) (0xF0 | (cp >> 18)));
+        out.push_back((char) (0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back((char) (0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back((char) (0x80 | (cp & 0x3F)));
+    }
+}
+
+// Parses a string token; out == nullptr skips it.
+void JsonStreamReader::parseString(std::string* out)
+{
+    expect('"');
+    if (out) out->clear();
+    while (true) {
+        // Copy runs of plain characters in one go.
+        const char* run = m_p;
+        while (m_p < m_end && *m_p != '"' && *m_p != '\\') m_p++;
+        if (out) out->append(run, m_p - run);
+        if (m_p >= m_end) fail("Missing '\"' to close string");
+        if (*m_p++ == '"') return;
+
+        if (m_p >= m_end) fail("Bad escape sequence in string");
+        char e = *m_p++;
+        uint32_t cp = 0;
+        switch (e) {
+            case '"': cp = '"'; break;
+            case '\\': cp = '\\'; break;
+            case '/': cp = '/'; break;
+            case 'b': cp = '\b'; break;
+            case 'f': cp = '\f'; break;
+            case 'n': cp = '\n'; break;
+            case 'r': cp = '\r'; break;
+            case 't': cp = '\t'; break;
+            case 'u': {
+                auto hex4 = [this]() {
+                    if (m_end - m_p < 4) fail("Bad unicode escape sequence in string");
+                    uint32_t v = 0;
+                    for (int i = 0; i < 4; i++) {
+                        char h = *m_p++;
+                        v <<= 4;
+                        if (h >= '0' && h <= '9') v |= h - '0';
+                        else if (h >= 'a' && h <= 'f') v |= h - 'a' + 10;
+                        else if (h >= 'A' && h <= 'F') v |= h - 'A' + 10;
+                        else fail("Bad unicode escape sequence in string");
+                    }
+                    return v;
+                };
+                cp = hex4();
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    if (m_end - m_p < 2 || m_p[0] != '\\' || m_p[1] != 'u') {
+                        fail("Expecting another \\u token to begin the second half of a unicode surrogate pair");
+                    }
+                    m_p += 2;
+                    uint32_t lo = hex4();
+                    cp = 0x10000 + ((cp & 0x3FF) << 10) + (lo & 0x3FF);
+                }
+                break;
+            }
+            default:
+                fail("Bad escape sequence in string");
+        }
+        if (out) AppendUtf8(*out, cp);
+    }
+}
+
+double JsonStreamReader::parseNumber(void)
+{
+    skipSpace();
+    const char* start = m_p;
+    if (m_p < m_end && *m_p == '-') m_p++;
+    bool integral = true;
+    uint64_t mag = 0;
+    while (m_p < m_end && *m_p >= '0' && *m_p <= '9') {
+        mag = mag * 10 + (*m_p++ - '0');
+    }
+    while (m_p < m_end && (*m_p == '.' || *m_p == 'e' || *m_p == 'E' || *m_p == '+' || *m_p == '-' ||
+                           (*m_p >= '0' && *m_p <= '9'))) {
+        integral = false;
+        m_p++;
+    }
+    if (m_p == start || (m_p == start + 1 && *start == '-')) fail("Syntax error: value, object or array expected.");
+    if (integral && m_p - start < 19) {
+        return *start == '-' ? -(double) mag : (double) mag;
+    }
+    string tok(start, m_p);
+    char* endp = nullptr;
+    double v = strtod(tok.c_str(), &endp);
+    if (!endp || *endp) fail("'" + tok + "' is not a number.");
+    return v;
+}
+
+JsonStreamReader::Type JsonStreamReader::peekType(void)
+{
+    skipSpace();
+    if (m_p >= m_end) fail("Syntax error: value, object or array expected.");
+    switch (*m_p) {
+        case '{': return TYPE_OBJECT;
+        case '[': return TYPE_ARRAY;
+        case '"': return TYPE_STRING;
+        case 't': case 'f': return TYPE_BOOL;
+        case 'n': return TYPE_NULL;
+        default: return TYPE_NUMBER;
+    }
+}
+
+void JsonStreamReader::beginObject(void)
+{
+    expect('{');
+    m_first.push_back(true);
+}
+
+bool JsonStreamReader::nextKey(std::string& key)
+{
+    skipSpace();
+    if (m_p < m_end && *m_p == '}') {
+        m_p++;
+        m_first.pop_back();
+        return false;
+    }
+    if (!m_first.back()) {
+        if (m_p >= m_end || *m_p != ',') fail("Missing ',' or '}' in object declaration");
+        m_p++;
+        skipSpace();
+    }
+    m_first.back() = false;
+    if (m_p >= m_end || *m_p != '"') fail("Missing '}' or object member name");
+    parseString(&key);
+    skipSpace();
+    if (m_p >= m_end || *m_p != ':') fail("Missing ':' after object member name");
+    m_p++;
+    return true;
+}
+
+void JsonStreamReader::beginArray(void)
+{
+    expect('[');
+    m_first.push_back(true);
+}
+
+bool JsonStreamReader::nextElement(void)
+{
+    skipSpace();
+    if (m_p < m_end && *m_p == ']') {
+        m_p++;
+        m_first.pop_back();
+        return false;
+    }
+    if (!m_first.back()) {
+        if (m_p >= m_end || *m_p != ',') fail("Missing ',' or ']' in array declaration");
+        m_p++;
+    }
+    m_first.back() = false;
+    return true;
+}
+
+static bool MatchWord(const char*& p, const char* end, const char* word)
+{
+    size_t n = strlen(word);
+    if ((size_t) (end - p) < n || memcmp(p, word, n)) return false;
+    p += n;
+    return true;
+}
+
+void JsonStreamReader::readString(std::string& out)
+{
+    switch (peekType()) {
+        case TYPE_STRING: parseString(&out); return;
+        case TYPE_NULL: skipValue(); out.clear(); return;
+        default: fail("Type is not convertible to string");
+    }
+}
+
+double JsonStreamReader::readDouble(void)
+{
+    switch (peekType()) {
+        case TYPE_NUMBER: return parseNumber();
+        case TYPE_NULL: skipValue(); return 0.0;
+        case TYPE_BOOL: {
+            bool t = *m_p == 't';
+            skipValue();
+            return t ? 1.0 : 0.0;
+        }
+        default: fail("Value is not convertible to a number");
+    }
+}
+
+int64_t JsonStreamReader::readInt(void)
+{
+    double v = readDouble();
+    if (!(v >= -9223372036854775808.0 && v < 9223372036854775808.0)) fail("Integer out of range");
+    return (int64_t) v;
+}
+
+void JsonStreamReader::skipValue(void)
+{
+    switch (peekType()) {
+        case TYPE_OBJECT: {
+            string key;
+            beginObject();
+            while (nextKey(key)) skipValue();
+            return;
+        }
+        case TYPE_ARRAY:
+            beginArray();
+            while (nextElement()) skipValue();
+            return;
+        case TYPE_STRING:
+            parseString(nullptr);
+            return;
+        case TYPE_BOOL:
+            if (!MatchWord(m_p, m_end, "true") && !MatchWord(m_p, m_end, "false")) fail("Syntax error: value, object or array expected.");
+            return;
+        case TYPE_NULL:
+            if (!MatchWord(m_p, m_end, "null")) fail("Syntax error: value, object or array expected.");
+            return;
+        case TYPE_NUMBER:
+            parseNumber();
+            return;
+    }
+}
+
+void JsonStreamReader::finish(void)
+{
+    skipSpace();
+    if (m_p < m_end && *m_p != '\0') fail("Extra non-whitespace after JSON value.");
+}
+
+// -------------------------------------------------------- JsonStreamWriter -----------------------------------------------
+
+static const size_t WRITER_BUFFER_SIZE = 64 * 1024;
+static const unsigned PRETTY_RIGHT_MARGIN = 74;    // StyledStreamWriter's rightMargin_.
+
+// Decodes one UTF-8 sequence the way jsoncpp does, so malformed input is escaped identically.
+static uint32_t Utf8ToCodepoint(const char*& s, const char* e)
+{
+    const uint32_t REPLACEMENT_CHARACTER = 0xFFFD;
+    uint32_t first = (unsigned char) *s;
+    if (first < 0x80) return first;
+    if (first < 0xE0) {
+        if (e - s < 2) return REPLACEMENT_CHARACTER;
+        uint32_t cp = ((first & 0x1F) << 6) | ((unsigned char) s[1] & 0x3F);
+        s += 1;
+        return cp < 0x80 ? REPLACEMENT_CHARACTER : cp;
+    }
+    if (first < 0xF0) {
+        if (e - s < 3) return REPLACEMENT_CHARACTER;
+        uint32_t cp = ((first & 0x0F) << 12) | (((unsigned char) s[1] & 0x3F) << 6) | ((unsigned char) s[2] & 0x3F);
+        s += 2;
+        if (cp >= 0xD800 && cp <= 0xDFFF) return REPLACEMENT_CHARACTER;
+        return cp < 0x800 ? REPLACEMENT_CHARACTER : cp;
+    }
+    if (first < 0xF8) {
+        if (e - s < 4) return REPLACEMENT_CHARACTER;
+        uint32_t cp = ((first & 0x07) << 18) | (((unsigned char) s[1] & 0x3F) << 12) |
+                      (((unsigned char) s[2] & 0x3F) << 6) | ((unsigned char) s[3] & 0x3F);
+        s += 3;
+        return cp < 0x10000 ? REPLACEMENT_CHARACTER : cp;
+    }
+    return REPLACEMENT_CHARACTER;
+}
+
+static void AppendHex16(std::string& out, uint32_t v)
+{
+    static const char hex[] = "0123456789abcdef";
+    char buf[6] = { '\\', 'u', hex[(v >> 12) & 0xF], hex[(v >> 8) & 0xF], hex[(v >> 4) & 0xF], hex[v & 0xF] };
+    out.append(buf, 6);
+}
+
+void AppendJsonQuoted(std::string& out, const char* str, size_t len)
+{
+    const char* end = str + len;
+    out.push_back('"');
+    for (const char* c = str; c != end; ++c) {
+        // Copy runs that need no escaping in one go.
+        const char* run = c;
+        while (c != end && *c != '"' && *c != '\\' && (unsigned char) *c >= 0x20 && (unsigned char) *c < 0x80) c++;
+        out.append(run, c - run);
+        if (c == end) break;
+        switch (*c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: {
+                uint32_t cp = Utf8ToCodepoint(c, end);
+                if (cp < 0x10000) {
+                    AppendHex16(out, cp);
+                } else {
+                    cp -= 0x10000;
+                    AppendHex16(out, 0xD800 + ((cp >> 10) & 0x3FF));
+                    AppendHex16(out, 0xDC00 + (cp & 0x3FF));
+                }
+            }
+        }
+    }
+    out.push_back('"');
+}
+
+JsonStreamWriter::JsonStreamWriter(std::string& out, Style style)
+    : m_out(&out), m_style(style)
+{
+}
+
+JsonStreamWriter::JsonStreamWriter(FILE* file, Style style)
+    : m_out(&m_buf), m_file(file), m_style(style)
+{
+    m_buf.reserve(WRITER_BUFFER_SIZE + 4096);
+}
+
+void JsonStreamWriter::flush(void)
+{
+    if (!m_file || m_buf.empty()) return;
+    if (fwrite(m_buf.data(), 1, m_buf.size(), m_file) != m_buf.size()) {
+        throw std::runtime_error("Write failed.");
+    }
+    m_buf.clear();
+}
+
+void JsonStreamWriter::flushIfFull(void)
+{
+    if (m_file && m_buf.size() >= WRITER_BUFFER_SIZE) flush();
+}
+
+void JsonStreamWriter::writeIndent(void)
+{
+    m_out->push_back('\n');
+    m_out->append(m_indent);
+}
+
+void JsonStreamWriter::writeWithIndent(const std::string& s)
+{
+    if (!m_indented) writeIndent();
+    m_out->append(s);
+    m_indented = false;
+}
+
+// Writes the deferred opening bracket of a pretty container, plus any scalars held back
+// while it was still possible for the array to fit on one line.
+void JsonStreamWriter::openPretty(Frame& f)
+{
+    writeWithIndent(f.object ? "{" : "[");
+    m_indent.push_back('\t');
+    f.open = true;
+    for (size_t i = 0; i < f.pending.size(); i++) {
+        if (i > 0) m_out->push_back(',');
+        writeWithIndent(f.pending[i]);
+    }
+    f.count = (int) f.pending.size();
+    f.pending.clear();
+}
+
+void JsonStreamWriter::beforeValue(void)
+{
+    if (m_stack.empty() || m_stack.back().object) return;
+    Frame& f = m_stack.back();
+    if (m_style == STYLE_COMPACT) {
+        if (f.count++ > 0) m_out->push_back(',');
+        return;
+    }
+    // A container element always puts the array on multiple lines.
+    if (!f.open) openPretty(f);
+    if (f.count++ > 0) m_out->push_back(',');
+    if (!m_indented) writeIndent();
+    m_indented = true;
+}
+
+void JsonStreamWriter::afterValue(void)
+{
+    m_indented = false;
+    flushIfFull();
+}
+
+void JsonStreamWriter::scalar(const std::string& text)
+{
+    if (m_style == STYLE_PRETTY && !m_stack.empty() && !m_stack.back().object && !m_stack.back().open) {
+        Frame& f = m_stack.back();
+        f.pending.push_back(text);
+        if (f.pending.size() * 3 >= PRETTY_RIGHT_MARGIN) openPretty(f);
+        return;
+    }
+    beforeValue();
+    m_out->append(text);
+    afterValue();
+}
+
+void JsonStreamWriter::beginObject(void)
+{
+    beforeValue();
+    m_stack.push_back(Frame());
+    m_stack.back().object = true;
+    if (m_style == STYLE_COMPACT) {
+        m_out->push_back('{');
+        m_stack.back().open = true;
+    }
+}
+
+void JsonStreamWriter::key(const char* name, size_t len)
+{
+    Frame& f = m_stack.back();
+    m_scratch.clear();
+    AppendJsonQuoted(m_scratch, name, len);
+    if (m_style == STYLE_COMPACT) {
+        if (f.count++ > 0) m_out->push_back(',');
+        m_out->append(m_scratch);
+        m_out->push_back(':');
+        return;
+    }
+    if (!f.open) openPretty(f);
+    if (f.count++ > 0) {
+        m_out->push_back(',');
+        m_indented = false;
+    }
+    writeWithIndent(m_scratch);
+    m_out->append(" : ");
+}
+
+void JsonStreamWriter::endObject(void)
+{
+    Frame& f = m_stack.back();
+    if (m_style == STYLE_COMPACT) {
+        m_out->push_back('}');
+    } else if (!f.open) {
+        m_out->append("{}");
+    } else {
+        m_indent.pop_back();
+        writeWithIndent("}");
+    }
+    m_stack.pop_back();
+    afterValue();
+}
+
+void JsonStreamWriter::beginArray(void)
+{
+    beforeValue();
+    m_stack.push_back(Frame());
+    m_stack.back().object = false;
+    if (m_style == STYLE_COMPACT) {
+        m_out->push_back('[');
+        m_stack.back().open = true;
+    }
+}
+
+void JsonStreamWriter::endArray(void)
+{
+    Frame& f = m_stack.back();
+    if (m_style == STYLE_COMPACT) {
+        m_out->push_back(']');
+    } else if (f.pending.empty() && !f.open) {
+        m_out->append("[]");
+    } else if (!f.open) {
+        size_t lineLength = 4 + (f.pending.size() - 1) * 2;    // "[ " + ", " * (n - 1) + " ]"
+        for (auto& s: f.pending) lineLength += s.size();
+        if (lineLength >= PRETTY_RIGHT_MARGIN) {
+            openPretty(f);
+        } else {
+            m_out->append("[ ");
+            for (size_t i = 0; i < f.pending.size(); i++) {
+                if (i > 0) m_out->append(", ");
+                m_out->append(f.pending[i]);
+            }
+            m_out->append(" ]");
+        }
+    }
+    if (m_style == STYLE_PRETTY && f.open) {
+        m_indent.pop_back();
+        writeWithIndent("]");
+    }
+    m_stack.pop_back();
+    afterValue();
+}
+
+void JsonStreamWriter::value(const char* str, size_t len)
+{
+    m_scratch.clear();
+    AppendJsonQuoted(m_scratch, str, len);
+    scalar(m_scratch);
+}
+
+void JsonStreamWriter::value(int64_t v)
+{
+    scalar(to_string(v));
+}
+
+void JsonStreamWriter::value(uint64_t v)
+{
+    scalar(to_string(v));
+}
+
+void JsonStreamWriter::finish(void)
+{
+    m_out->push_back('\n');
+    flush();
+}
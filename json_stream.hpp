@@ -0,0 +1,137 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _JSON_STREAM_
+#define _JSON_STREAM_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+// Streaming JSON reader. Walks the input once and hands values to the caller as it reaches them,
+// without building a document tree. Accepts what Json::Reader accepts with default features,
+// including // and /* */ comments. Throws std::runtime_error with line / column on malformed input.
+//
+//     r.beginObject();
+//     while (r.nextKey(key)) {
+//         if (key == "name") r.readString(name);
+//         else r.skipValue();
+//     }
+class JsonStreamReader
+{
+    const char* m_begin;
+    const char* m_p;
+    const char* m_end;
+    std::vector<bool> m_first;  // One entry per open object / array: no element read yet.
+
+    void skipSpace(void);
+    void expect(char c);
+    void parseString(std::string* out);
+    double parseNumber(void);
+
+public:
+    enum Type { TYPE_NULL, TYPE_BOOL, TYPE_NUMBER, TYPE_STRING, TYPE_ARRAY, TYPE_OBJECT };
+
+    JsonStreamReader(const char* begin, const char* end);
+
+    [[noreturn]] void fail(const std::string& msg) const;
+
+    Type peekType(void);
+
+    void beginObject(void);
+    bool nextKey(std::string& key);     // False, and the object is closed, once '}' is reached.
+    void beginArray(void);
+    bool nextElement(void);             // False, and the array is closed, once ']' is reached.
+
+    // Scalars follow Json::Value conversion rules: null reads as 0 / "", bools as 0 / 1.
+    void readString(std::string& out);
+    int64_t readInt(void);
+    double readDouble(void);
+
+    void skipValue(void);
+    void finish(void);                  // Only whitespace and comments may follow the root value.
+};
+
+// Streaming JSON writer. Appends to a string or to a FILE* through a 64 KB buffer, never holding
+// more than one array's worth of pending scalars. STYLE_PRETTY reproduces Json::StyledStreamWriter
+// byte for byte (tab indent, "key" : value, short scalar arrays on one line, \uXXXX for non-ASCII);
+// keys are written in the order given, so callers emit them sorted to match. STYLE_COMPACT has no
+// whitespace at all. Both end with a newline. Throws std::runtime_error if the file cannot be written.
+class JsonStreamWriter
+{
+public:
+    enum Style { STYLE_COMPACT, STYLE_PRETTY };
+
+    JsonStreamWriter(std::string& out, Style style);
+    JsonStreamWriter(FILE* file, Style style);
+
+    void beginObject(void);
+    void key(const char* name) { key(name, strlen(name)); }
+    void key(const std::string& name) { key(name.data(), name.size()); }
+    void key(const char* name, size_t len);
+    void endObject(void);
+    void beginArray(void);
+    void endArray(void);
+
+    void value(const std::string& str) { value(str.data(), str.size()); }
+    void value(const char* str, size_t len);
+    void value(int64_t v);
+    void value(uint64_t v);
+    void value(int v) { value((int64_t) v); }
+    void value(uint32_t v) { value((uint64_t) v); }
+
+    void finish(void);                  // Terminating newline, then flushes to the file.
+
+private:
+    struct Frame {
+        bool object;
+        bool open = false;              // Opening bracket written; false while still deferred.
+        int count = 0;
+        std::vector<std::string> pending;   // Pretty arrays: scalars held until the layout is known.
+    };
+
+    std::string m_buf;
+    std::string* m_out;
+    FILE* m_file = nullptr;
+    Style m_style;
+    std::vector<Frame> m_stack;
+    std::string m_indent;
+    bool m_indented = true;             // Same role as StyledStreamWriter::indented_.
+    std::string m_scratch;
+
+    void flushIfFull(void);
+    void flush(void);
+    void writeIndent(void);
+    void writeWithIndent(const std::string& s);
+    void openPretty(Frame& f);
+    void beforeValue(void);
+    void afterValue(void);
+    void scalar(const std::string& text);
+};
+
+// Quotes str the way Json::valueToQuotedString does, appending to out.
+void AppendJsonQuoted(std::string& out, const char* str, size_t len);
+
+#endif // _JSON_STREAM_
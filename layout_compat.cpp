@@ -0,0 +1,142 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "layout_compat.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+void LayoutCompatibility::build(const PipelineLayoutModel& model, SetIdentity identity)
+{
+    m_numLayouts = model.layouts().size();
+    m_numSets = (uint32_t) model.dsets().size();
+    if (m_numSets > 255) throw std::runtime_error("More than 255 sets.");
+
+    // Set layout ids: 0 for the empty set, then in order of first use.
+    map< pair<uint32_t, vector<BindingHandle>>, uint32_t > ids;
+    vector<BindingHandle> bindings;
+    m_setLayouts.assign(m_numLayouts * m_numSets, 0);
+    for (size_t l = 0; l < m_numLayouts; l++) {
+        for (auto& dset: model.layouts()[l].descsets) {
+            if (dset.index >= m_numSets) continue;
+            bindings.assign(dset.dlayouts.begin(), dset.dlayouts.end());
+            if (identity == SETS_UNORDERED) sort(bindings.begin(), bindings.end());
+            auto id = ids.emplace(make_pair(dset.index, bindings), (uint32_t) ids.size() + 1).first->second;
+            m_setLayouts[l * m_numSets + dset.index] = id;
+        }
+    }
+    m_numSetLayouts = ids.size() + 1;
+
+    m_sorted.resize(m_numLayouts);
+    for (size_t l = 0; l < m_numLayouts; l++) m_sorted[l] = (uint32_t) l;
+    const uint32_t* setLayouts = m_setLayouts.data();
+    uint32_t numSets = m_numSets;
+    stable_sort(m_sorted.begin(), m_sorted.end(), [setLayouts, numSets](uint32_t a, uint32_t b) {
+        return lexicographical_compare(setLayouts + a * numSets, setLayouts + (a + 1) * numSets,
+                                       setLayouts + b * numSets, setLayouts + (b + 1) * numSets);
+    });
+    m_common.assign(m_numLayouts, 0);
+    m_place.resize(m_numLayouts);
+    for (size_t i = 0; i < m_numLayouts; i++) {
+        m_place[m_sorted[i]] = (uint32_t) i;
+        if (i) m_common[i] = (uint8_t) prefix(m_sorted[i - 1], m_sorted[i]);
+    }
+}
+
+size_t LayoutCompatibility::numGroups(uint32_t length) const
+{
+    if (!m_numLayouts) return 0;
+    size_t groups = 1;
+    for (size_t i = 1; i < m_numLayouts; i++) {
+        if (m_common[i] < length) groups++;
+    }
+    return groups;
+}
+
+uint32_t LayoutCompatibility::prefix(int a, int b) const
+{
+    const uint32_t* x = &m_setLayouts[a * m_numSets];
+    const uint32_t* y = &m_setLayouts[b * m_numSets];
+    uint32_t n = 0;
+    while (n < m_numSets && x[n] == y[n]) n++;
+    return n;
+}
+
+void LayoutCompatibility::matrix(ThreadPool& pool, std::vector<uint8_t>& out) const
+{
+    size_t n = m_numLayouts;
+    out.assign(n * n, 0);
+    const size_t ROWS_PER_TASK = 64;
+    uint8_t* cells = out.data();
+    for (size_t first = 0; first < n; first += ROWS_PER_TASK) {
+        size_t last = min(n, first + ROWS_PER_TASK);
+        pool.submit([this, cells, n, first, last]() {
+            for (size_t a = first; a < last; a++) {
+                uint8_t* row = cells + a * n;
+                size_t i = m_place[a];
+                row[a] = (uint8_t) m_numSets;
+                // The running minimum of neighbour prefixes, outwards in sorted order.
+                uint8_t common = (uint8_t) m_numSets;
+                for (size_t j = i + 1; j < n && common; j++) {
+                    common = min(common, m_common[j]);
+                    row[m_sorted[j]] = common;
+                }
+                common = (uint8_t) m_numSets;
+                for (size_t j = i; j > 0 && common; j--) {
+                    common = min(common, m_common[j]);
+                    row[m_sorted[j - 1]] = common;
+                }
+            }
+        });
+    }
+    pool.wait();
+}
+
+// Calls to bind the used sets of layout from set index from on, one per run; adds the sets to sets.
+size_t LayoutCompatibility::bindCalls(int layout, uint32_t from, size_t& sets) const
+{
+    const uint32_t* s = &m_setLayouts[layout * m_numSets];
+    size_t calls = 0;
+    for (uint32_t k = from; k < m_numSets; k++) {
+        if (!s[k]) continue;
+        sets++;
+        if (k == from || !s[k - 1]) calls++;
+    }
+    return calls;
+}
+
+LayoutCompatibility::RebindCost LayoutCompatibility::rebindCost(const std::vector<int>& order) const
+{
+    RebindCost cost;
+    for (size_t i = 0; i < order.size(); i++) {
+        int b = order[i];
+        if (i && order[i - 1] == b) continue;
+        cost.bindCallsAll += bindCalls(b, 0, cost.setsBoundAll);
+        if (i) cost.switches++;
+        cost.bindCalls += bindCalls(b, i ? prefix(order[i - 1], b) : 0, cost.setsBound);
+    }
+    return cost;
+}
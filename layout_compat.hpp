@@ -0,0 +1,90 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _LAYOUT_COMPAT_
+#define _LAYOUT_COMPAT_
+
+#include <vector>
+#include <cstdint>
+#include "pipelinelayout_model.hpp"
+
+class ThreadPool;
+
+// Descriptor set compatibility between pipeline layouts. Vulkan keeps sets 0..n-1 bound across a
+// pipeline switch when both layouts have identical set layouts for all of them; n is the compatible
+// prefix. Every layout has all the model's sets, the unused ones as empty set layouts.
+//
+// The layouts are sorted by their sequence of set layouts, so that two layouts' prefix is the smallest
+// common prefix of the neighbours between them in that order: a matrix row costs one pass outwards
+// from the layout's place, whatever the number of sets.
+class LayoutCompatibility
+{
+public:
+    // When two sets' layouts are identical. SETS_ORDERED: same bindings in the same order, numbered by
+    // position as exported headers have them without BindingNumbers. SETS_UNORDERED: same bindings, as
+    // when they are numbered by BindingNumbers.
+    enum SetIdentity { SETS_ORDERED, SETS_UNORDERED };
+
+    // Rebinding along a sequence of pipeline layouts. A call binds one run of consecutive used sets.
+    struct RebindCost {
+        size_t switches = 0;
+        size_t setsBound = 0;
+        size_t bindCalls = 0;
+        size_t setsBoundAll = 0;    // Rebinding every used set at each switch.
+        size_t bindCallsAll = 0;
+    };
+
+    // Throws std::runtime_error past 255 sets, the most a matrix entry holds.
+    void build(const PipelineLayoutModel& model, SetIdentity identity = SETS_ORDERED);
+
+    size_t numLayouts(void) const { return m_numLayouts; }
+    uint32_t numSets(void) const { return m_numSets; }
+    // Distinct set layouts, the empty one included.
+    size_t numSetLayouts(void) const { return m_numSetLayouts; }
+    // Groups of layouts that are compatible through the first length sets, 1 <= length <= numSets().
+    size_t numGroups(uint32_t length) const;
+
+    // Distinct set layout id of one of layout's sets, 0 when it is empty.
+    uint32_t setLayout(int layout, uint32_t set) const { return m_setLayouts[layout * m_numSets + set]; }
+    uint32_t prefix(int a, int b) const;
+    // Position of layout in an order of all layouts where compatible ones are adjacent: drawing in
+    // that order keeps the most sets bound.
+    uint32_t rank(int layout) const { return m_place[layout]; }
+    // numLayouts() rows of numLayouts() prefixes, the rows split across pool's threads.
+    void matrix(ThreadPool& pool, std::vector<uint8_t>& out) const;
+    // The first layout binds all its used sets; after that each switch keeps the compatible prefix.
+    RebindCost rebindCost(const std::vector<int>& order) const;
+
+private:
+    size_t m_numLayouts = 0;
+    uint32_t m_numSets = 0;
+    size_t m_numSetLayouts = 0;
+    std::vector<uint32_t> m_setLayouts;     // [layout * m_numSets + set]: distinct set layout id, 0 when empty.
+    std::vector<uint32_t> m_sorted;         // Layouts by their sequence of set layout ids.
+    std::vector<uint8_t> m_common;          // [i]: prefix of m_sorted[i - 1] and m_sorted[i]; [0] unused.
+    std::vector<uint32_t> m_place;          // Inverse of m_sorted.
+
+    size_t bindCalls(int layout, uint32_t from, size_t& sets) const;
+};
+
+#endif // _LAYOUT_COMPAT_
@@ -0,0 +1,110 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "layout_export.hpp"
+#include "binding_numbers.hpp"
+#include "build_cache.hpp"
+#include <stdio.h>
+#include <ctype.h>
+
+using namespace std;
+
+std::string ExportIdentifier(const char* name, size_t size)
+{
+    string id;
+    id.reserve(size + 1);
+    for (size_t i = 0; i < size; i++) {
+        char c = name[i];
+        id.push_back(isalnum((unsigned char) c) ? (char) toupper((unsigned char) c) : '_');
+    }
+    if (id.empty() || isdigit((unsigned char) id[0])) id.insert(id.begin(), '_');
+    return id;
+}
+
+std::string ExportHeaderName(const PipelineLayoutModel& model, int layout)
+{
+    NameId name = model.layouts()[layout].name;
+    return ExportIdentifier(model.names().c_str(name), model.names().size(name)) + ".h";
+}
+
+uint64_t ExportDigest(const PipelineLayoutModel& model, int layout, const BindingNumbers* numbers)
+{
+    auto& pl = model.layouts()[layout];
+    auto& names = model.names();
+    string key;
+    names.appendTo(pl.name, key);
+    key.push_back('\0');
+    for (int s = 0; s < (int) model.dsets().size(); s++) {
+        string set = names.str(model.dsets()[s]);
+        key += set;
+        key.push_back('\0');
+        for (BindingHandle h: pl.descsets[s].dlayouts) {
+            const DescriptorLayout* dl = model.binding(h);
+            char buf[48];
+            snprintf(buf, sizeof(buf), "%d:%x:%d", dl->typeIdx, dl->stageFlagBits,
+                     numbers ? numbers->number(set, names.str(dl->name)) : -1);
+            names.appendTo(dl->name, key);
+            key.push_back('\0');
+            key += buf;
+            key.push_back('\0');
+        }
+        key.push_back('\1');
+    }
+    return HashBytes(key.data(), key.size(), 0xE4);
+}
+
+void ExportPipelineLayoutHeader(const PipelineLayoutModel& model, int layout, const std::string& source, std::string& out,
+                                const BindingNumbers* numbers)
+{
+    auto& pl = model.layouts()[layout];
+    auto& names = model.names();
+    auto identifier = [&names](NameId id) { return ExportIdentifier(names.c_str(id), names.size(id)); };
+    string plId = identifier(pl.name);
+    char hex[16];
+
+    out.clear();
+    out += "// Generated by vkplc from " + source + ". Do not edit.\n";
+    out += "// Pipeline layout ";
+    names.appendTo(pl.name, out);
+    out += "\n\n";
+    out += "#pragma once\n\n";
+    out += "#define " + plId + "_NUM_SETS " + to_string(model.dsets().size()) + "\n";
+
+    for (int s = 0; s < (int) model.dsets().size(); s++) {
+        string set = names.str(model.dsets()[s]);
+        string setId = plId + "_" + identifier(model.dsets()[s]);
+        auto& dlayouts = pl.descsets[s].dlayouts;
+        out += "\n#define " + setId + "_SET " + to_string(s) + "\n";
+        out += "#define " + setId + "_NUM_BINDINGS " + to_string(dlayouts.size()) + "\n";
+        for (int b = 0; b < (int) dlayouts.size(); b++) {
+            const DescriptorLayout* dl = model.binding(dlayouts[b]);
+            string bId = setId + "_" + identifier(dl->name);
+            bool validType = dl->typeIdx >= 0 && dl->typeIdx < (int) descLayoutTypes.size();
+            snprintf(hex, sizeof(hex), "0x%08x", dl->stageFlagBits);
+            int number = numbers ? numbers->number(set, names.str(dl->name)) : b;
+            out += "#define " + bId + "_BINDING " + to_string(number) + "\n";
+            out += "#define " + bId + "_TYPE " + (validType ? descLayoutTypes[dl->typeIdx] : string("VK_DESCRIPTOR_TYPE_MAX_ENUM")) + "\n";
+            out += "#define " + bId + "_STAGES " + hex + "\n";
+        }
+    }
+}
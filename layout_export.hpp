@@ -0,0 +1,51 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _LAYOUT_EXPORT_
+#define _LAYOUT_EXPORT_
+
+#include <string>
+#include <cstdint>
+#include "pipelinelayout_model.hpp"
+
+class BindingNumbers;
+
+// Per pipeline layout C header: set indices, binding numbers, descriptor types and stage flags as #defines.
+// Binding numbers come from numbers when given, and are positions within the set otherwise.
+
+// Upper-cased identifier form of a layout / set / binding name.
+std::string ExportIdentifier(const char* name, size_t size);
+inline std::string ExportIdentifier(const std::string& name) { return ExportIdentifier(name.data(), name.size()); }
+
+// File name (without directory) of the header generated for pipeline layout 'layout'.
+std::string ExportHeaderName(const PipelineLayoutModel& model, int layout);
+
+// Hash of everything the header for 'layout' is generated from: the pipeline name, the names of the
+// global sets and the name / type / stage flags / number of every binding it references. Unchanged digest
+// means an unchanged header, so callers can skip regenerating it.
+uint64_t ExportDigest(const PipelineLayoutModel& model, int layout, const BindingNumbers* numbers = nullptr);
+
+void ExportPipelineLayoutHeader(const PipelineLayoutModel& model, int layout, const std::string& source, std::string& out,
+                                const BindingNumbers* numbers = nullptr);
+
+#endif // _LAYOUT_EXPORT_
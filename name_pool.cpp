@@ -0,0 +1,162 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "name_pool.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+// Names bigger than a quarter of this get a chunk of their own. Chunks start at NAME_CHUNK_MIN and
+// double up to it, so that a pool that only adds a few names after being copied stays small.
+static const size_t NAME_CHUNK_SIZE = 64 * 1024;
+static const size_t NAME_CHUNK_MIN = 1024;
+
+// FNV-1a.
+static uint32_t HashName(const char* s, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t) s[i]) * 16777619u;
+    return h;
+}
+
+NamePool& NamePool::operator=(const NamePool& o)
+{
+    if (this == &o) return *this;
+    m_entries = o.m_entries;
+    m_table = o.m_table;
+    m_chunks = o.m_chunks;
+    m_chunkBytes = o.m_chunkBytes;
+    // What follows o's last name in its chunk is o's to fill.
+    m_free = nullptr;
+    m_freeSize = 0;
+    m_nextChunk = NAME_CHUNK_MIN;
+    return *this;
+}
+
+NamePool& NamePool::operator=(NamePool&& o)
+{
+    if (this == &o) return *this;
+    swap(m_entries, o.m_entries);
+    swap(m_table, o.m_table);
+    swap(m_chunks, o.m_chunks);
+    swap(m_free, o.m_free);
+    swap(m_freeSize, o.m_freeSize);
+    swap(m_chunkBytes, o.m_chunkBytes);
+    swap(m_nextChunk, o.m_nextChunk);
+    o.clear();
+    return *this;
+}
+
+void NamePool::clear(void)
+{
+    m_entries.clear();
+    m_table.clear();
+    m_table.resize(64, NAME_NONE);
+    m_chunks.clear();
+    m_free = nullptr;
+    m_freeSize = 0;
+    m_chunkBytes = 0;
+    m_nextChunk = NAME_CHUNK_MIN;
+    intern("", 0);
+}
+
+char* NamePool::store(const char* s, size_t len)
+{
+    if (len + 1 > NAME_CHUNK_SIZE / 4) {
+        m_chunks.push_back(shared_ptr<char>(new char[len + 1], default_delete<char[]>()));
+        m_chunkBytes += len + 1;
+        char* p = m_chunks.back().get();
+        memcpy(p, s, len);
+        p[len] = '\0';
+        return p;
+    }
+    if (m_freeSize < len + 1) {
+        size_t size = max(m_nextChunk, len + 1);
+        m_nextChunk = min(m_nextChunk * 2, NAME_CHUNK_SIZE);
+        m_chunks.push_back(shared_ptr<char>(new char[size], default_delete<char[]>()));
+        m_chunkBytes += size;
+        m_free = m_chunks.back().get();
+        m_freeSize = size;
+    }
+    char* p = m_free;
+    if (len) memcpy(p, s, len);
+    p[len] = '\0';
+    m_free += len + 1;
+    m_freeSize -= len + 1;
+    return p;
+}
+
+void NamePool::grow(void)
+{
+    vector<uint32_t> table(m_table.size() * 2, NAME_NONE);
+    size_t mask = table.size() - 1;
+    for (uint32_t id = 0; id < m_entries.size(); id++) {
+        size_t i = m_entries[id].hash & mask;
+        while (table[i] != NAME_NONE) i = (i + 1) & mask;
+        table[i] = id;
+    }
+    m_table.assign(table.begin(), table.end());
+}
+
+NameId NamePool::find(const char* s, size_t len) const
+{
+    uint32_t h = HashName(s, len);
+    size_t mask = m_table.size() - 1;
+    for (size_t i = h & mask; m_table[i] != NAME_NONE; i = (i + 1) & mask) {
+        const Entry& e = m_entries[m_table[i]];
+        if (e.hash == h && e.size == len && (len == 0 || memcmp(e.data, s, len) == 0)) return m_table[i];
+    }
+    return NAME_NONE;
+}
+
+NameId NamePool::intern(const char* s, size_t len)
+{
+    uint32_t h = HashName(s, len);
+    size_t mask = m_table.size() - 1;
+    size_t i = h & mask;
+    for (; m_table[i] != NAME_NONE; i = (i + 1) & mask) {
+        const Entry& e = m_entries[m_table[i]];
+        if (e.hash == h && e.size == len && (len == 0 || memcmp(e.data, s, len) == 0)) return m_table[i];
+    }
+    if (len > UINT32_MAX || m_entries.size() >= NAME_NONE) throw std::length_error("Too many names.");
+    NameId id = (NameId) m_entries.size();
+    m_entries.push_back(Entry{ store(s, len), (uint32_t) len, h });
+    m_table.edit(i) = id;
+    if (m_entries.size() * 2 > m_table.size()) grow();
+    return id;
+}
+
+bool NamePool::less(NameId a, NameId b) const
+{
+    const Entry& x = m_entries[a];
+    const Entry& y = m_entries[b];
+    int c = memcmp(x.data, y.data, min(x.size, y.size));
+    return c < 0 || (c == 0 && x.size < y.size);
+}
+
+size_t NamePool::heapBytes(void) const
+{
+    return m_chunkBytes + m_entries.size() * sizeof(Entry) + m_table.size() * sizeof(uint32_t) +
+        m_chunks.size() * sizeof(m_chunks[0]);
+}
@@ -0,0 +1,90 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _NAME_POOL_
+#define _NAME_POOL_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include "cow_vector.hpp"
+
+// A string interned in a NamePool. Within one pool, equal ids mean equal strings.
+typedef uint32_t NameId;
+
+#define NAME_EMPTY 0u               // "", present in every pool.
+#define NAME_NONE 0xffffffffu       // find(): not in the pool.
+
+// Every distinct name stored once, NUL-terminated, in chunks that never move: c_str() stays valid
+// until clear(), however many names are added meanwhile. Nothing is removed, so a name that is
+// renamed away stays until the pool is rebuilt. Names may contain NULs; size() is authoritative.
+// Copies are O(1): they share the text and, until either side adds a name, the tables.
+class NamePool
+{
+public:
+    NamePool() { clear(); }
+    NamePool(const NamePool& o) { *this = o; }
+    NamePool(NamePool&& o) { *this = std::move(o); }
+    NamePool& operator=(const NamePool& o);     // Same ids; shares o's storage.
+    NamePool& operator=(NamePool&& o);          // Leaves o empty but usable.
+
+    NameId intern(const char* s, size_t len);   // Throws std::length_error past 4G names.
+    NameId intern(const char* s) { return intern(s, strlen(s)); }
+    NameId intern(const std::string& s) { return intern(s.data(), s.size()); }
+    NameId find(const char* s, size_t len) const;
+    NameId find(const std::string& s) const { return find(s.data(), s.size()); }
+
+    const char* c_str(NameId id) const { return m_entries[id].data; }
+    size_t size(NameId id) const { return m_entries[id].size; }
+    bool empty(NameId id) const { return m_entries[id].size == 0; }
+    std::string str(NameId id) const { return std::string(m_entries[id].data, m_entries[id].size); }
+    void appendTo(NameId id, std::string& out) const { out.append(m_entries[id].data, m_entries[id].size); }
+
+    // Byte order, as std::string::compare() has it.
+    bool less(NameId a, NameId b) const;
+
+    size_t count(void) const { return m_entries.size(); }
+    size_t heapBytes(void) const;               // Chunks, entries and hash table.
+    void clear(void);
+
+private:
+    struct Entry {
+        const char* data;
+        uint32_t size;
+        uint32_t hash;
+    };
+    CowVector<Entry> m_entries;
+    CowVector<uint32_t, 1024> m_table;          // Ids by hash, open addressing; NAME_NONE where free.
+    CowVector< std::shared_ptr<char> > m_chunks;
+    char* m_free = nullptr;                     // Unused tail of the current chunk; copies start their own.
+    size_t m_freeSize = 0;
+    size_t m_chunkBytes = 0;
+    size_t m_nextChunk = 0;
+
+    char* store(const char* s, size_t len);
+    void grow(void);
+};
+
+#endif // _NAME_POOL_
@@ -0,0 +1,231 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "packed_text.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+// -------------------------------------------------------- LZ codec -----------------------------------------------
+
+// Byte-aligned LZ77 in the style of an LZ4 block. A sequence is
+//     token           high nibble: literal count, low nibble: match length - 4 (15 = more bytes follow)
+//     [255...]        literal count continued, each byte added, the first one below 255 ending it
+//     literals
+//     offset          uint16_t, little-endian, 1..65535 back from the current output position
+//     [255...]        match length continued
+// The last sequence is literals only and ends the input. Only this file writes the format, but the
+// decoder still checks every length against both buffers.
+
+static const int LZ_MIN_MATCH = 4;
+static const int LZ_HASH_BITS = 12;
+
+static inline uint32_t Read32(const uint8_t* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void PutLength(vector<uint8_t>& out, size_t len)
+{
+    while (len >= 255) {
+        out.push_back(255);
+        len -= 255;
+    }
+    out.push_back((uint8_t) len);
+}
+
+static void EmitSequence(vector<uint8_t>& out, const uint8_t* literals, size_t numLiterals, size_t offset, size_t matchLen)
+{
+    size_t m = matchLen ? matchLen - LZ_MIN_MATCH : 0;
+    out.push_back((uint8_t) ((min<size_t>(numLiterals, 15) << 4) | min<size_t>(m, 15)));
+    if (numLiterals >= 15) PutLength(out, numLiterals - 15);
+    out.insert(out.end(), literals, literals + numLiterals);
+    if (!matchLen) return;
+    out.push_back((uint8_t) offset);
+    out.push_back((uint8_t) (offset >> 8));
+    if (m >= 15) PutLength(out, m - 15);
+}
+
+// table holds positions from earlier inputs too; every candidate is checked before use, so stale
+// entries only cost a missed match, and the table never needs clearing.
+static void LzCompress(const uint8_t* src, size_t size, vector<uint8_t>& out, uint32_t* table)
+{
+    out.clear();
+    out.reserve(size / 2 + 16);
+    size_t anchor = 0, pos = 0;
+    while (pos + LZ_MIN_MATCH <= size) {
+        uint32_t seq = Read32(src + pos);
+        uint32_t h = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+        size_t from = table[h];
+        table[h] = (uint32_t) pos;
+        if (from >= pos || pos - from > 65535 || Read32(src + from) != seq) {
+            pos++;
+            continue;
+        }
+        size_t len = LZ_MIN_MATCH;
+        while (pos + len < size && src[from + len] == src[pos + len]) len++;
+        EmitSequence(out, src + anchor, pos - anchor, pos - from, len);
+        pos += len;
+        anchor = pos;
+    }
+    EmitSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+static bool LzDecompress(const uint8_t* src, size_t srcSize, char* dst, size_t dstSize)
+{
+    const uint8_t* end = src + srcSize;
+    size_t op = 0;
+    auto readLength = [&](size_t& len) {
+        uint8_t b;
+        do {
+            if (src == end) return false;
+            b = *src++;
+            len += b;
+        } while (b == 255);
+        return true;
+    };
+    while (src < end) {
+        uint8_t token = *src++;
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15 && !readLength(numLiterals)) return false;
+        if (numLiterals > size_t(end - src) || numLiterals > dstSize - op) return false;
+        memcpy(dst + op, src, numLiterals);
+        src += numLiterals;
+        op += numLiterals;
+        if (src == end) break;
+
+        if (end - src < 2) return false;
+        size_t offset = src[0] | (src[1] << 8);
+        src += 2;
+        size_t len = token & 15;
+        if (len == 15 && !readLength(len)) return false;
+        len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || len > dstSize - op) return false;
+        const char* from = dst + op - offset;
+        if (offset >= len) {
+            memcpy(dst + op, from, len);
+        } else {
+            // The match overlaps what it produces: copy forward, byte by byte.
+            for (size_t i = 0; i < len; i++) dst[op + i] = from[i];
+        }
+        op += len;
+    }
+    return op == dstSize;
+}
+
+// -------------------------------------------------------- PackedText -----------------------------------------------
+
+void PackedText::release(void)
+{
+    if (m_size & ARENA_BIT) SlabArena::release(m_bytes);
+    else delete[] m_bytes;
+    m_bytes = nullptr;
+    m_size = 0;
+    m_stored = 0;
+}
+
+PackedText& PackedText::operator=(const PackedText& o)
+{
+    if (this == &o) return *this;
+    size_t n = o.storedSize();
+    char* bytes = n ? new char[n] : nullptr;
+    if (n) memcpy(bytes, o.m_bytes, n);
+    release();
+    m_bytes = bytes;
+    m_size = o.decodedSize();
+    m_stored = o.m_stored;
+    return *this;
+}
+
+PackedText& PackedText::operator=(PackedText&& o)
+{
+    if (this == &o) return *this;
+    release();
+    m_bytes = o.m_bytes;
+    m_size = o.m_size;
+    m_stored = o.m_stored;
+    o.m_bytes = nullptr;
+    o.m_size = 0;
+    o.m_stored = 0;
+    return *this;
+}
+
+void PackedText::assign(const char* data, size_t size, SlabArena* arena)
+{
+    if (size >= PACKED_BIT) throw std::length_error("Text too long.");
+    const char* from = data;
+    uint32_t stored = (uint32_t) size;
+    if (size >= PACKED_TEXT_MIN_SIZE) {
+        // Loading packs every binding; reuse the scratch space across calls.
+        static thread_local vector<uint8_t> packed;
+        static thread_local vector<uint32_t> table(1 << LZ_HASH_BITS);
+        LzCompress(reinterpret_cast<const uint8_t*>(data), size, packed, table.data());
+        if (packed.size() < size) {
+            from = reinterpret_cast<const char*>(packed.data());
+            stored = (uint32_t) packed.size() | PACKED_BIT;
+        }
+    }
+    size_t n = stored & ~PACKED_BIT;
+    char* bytes = nullptr;
+    if (n) {
+        bytes = arena ? static_cast<char*>(arena->allocate(n, 1)) : new char[n];
+        memcpy(bytes, from, n);
+    }
+    release();
+    m_bytes = bytes;
+    m_size = (uint32_t) size | (arena && n ? ARENA_BIT : 0);
+    m_stored = stored;
+}
+
+std::string PackedText::str(void) const
+{
+    string out;
+    appendTo(out);
+    return out;
+}
+
+void PackedText::appendTo(std::string& out) const
+{
+    size_t size = decodedSize();
+    if (!packed()) {
+        if (size) out.append(m_bytes, size);
+        return;
+    }
+    size_t at = out.size();
+    out.resize(at + size);
+    if (!LzDecompress(reinterpret_cast<const uint8_t*>(m_bytes), storedSize(), &out[at], size)) {
+        out.resize(at);
+        throw std::runtime_error("Corrupt packed text.");
+    }
+}
+
+bool PackedText::equals(const char* data, size_t size) const
+{
+    if (size != decodedSize()) return false;
+    if (!packed()) return size == 0 || memcmp(m_bytes, data, size) == 0;
+    return str().compare(0, string::npos, data, size) == 0;
+}
@@ -0,0 +1,85 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _PACKED_TEXT_
+#define _PACKED_TEXT_
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include "slab_arena.hpp"
+
+// Text that is only read now and then, such as binding data and comments. Anything of
+// PACKED_TEXT_MIN_SIZE bytes or more is held LZ-compressed when that makes it smaller, and is
+// decoded again on every read; shorter text is stored as is. 16 bytes plus one exactly-sized
+// allocation, none when empty, which assign() can take from a SlabArena when many are made at once.
+// Copies always go to the heap. Sizes are limited to 2 GB.
+#define PACKED_TEXT_MIN_SIZE 64
+
+class PackedText
+{
+    char* m_bytes = nullptr;
+    uint32_t m_size = 0;        // Decoded; the top bit marks m_bytes as SlabArena memory.
+    uint32_t m_stored = 0;      // Bytes in m_bytes; the top bit marks them as compressed.
+
+    static const uint32_t PACKED_BIT = 0x80000000u;
+    static const uint32_t ARENA_BIT = 0x80000000u;
+    uint32_t storedSize(void) const { return m_stored & ~PACKED_BIT; }
+    bool packed(void) const { return (m_stored & PACKED_BIT) != 0; }
+    uint32_t decodedSize(void) const { return m_size & ~ARENA_BIT; }
+    void release(void);
+
+public:
+    PackedText() {}
+    PackedText(const char* s) { assign(s, strlen(s)); }
+    PackedText(const std::string& s) { assign(s.data(), s.size()); }
+    PackedText(const PackedText& o) { *this = o; }
+    PackedText(PackedText&& o) { *this = std::move(o); }
+    ~PackedText() { release(); }
+    PackedText& operator=(const PackedText& o);
+    PackedText& operator=(PackedText&& o);
+    PackedText& operator=(const char* s) { assign(s, strlen(s)); return *this; }
+    PackedText& operator=(const std::string& s) { assign(s.data(), s.size()); return *this; }
+
+    // Throws std::length_error past 2 GB. With an arena, the bytes are allocated there.
+    void assign(const char* data, size_t size, SlabArena* arena = nullptr);
+
+    // Decoding. appendTo() adds to what out already holds.
+    std::string str(void) const;
+    void decode(std::string& out) const { out.clear(); appendTo(out); }
+    void appendTo(std::string& out) const;
+
+    size_t size(void) const { return decodedSize(); }
+    bool empty(void) const { return decodedSize() == 0; }
+    bool isPacked(void) const { return packed(); }
+    size_t storedBytes(void) const { return storedSize(); }
+
+    bool equals(const char* data, size_t size) const;
+    bool operator==(const char* s) const { return equals(s, strlen(s)); }
+    bool operator==(const std::string& s) const { return equals(s.data(), s.size()); }
+    bool operator!=(const char* s) const { return !(*this == s); }
+    bool operator!=(const std::string& s) const { return !(*this == s); }
+};
+
+#endif // _PACKED_TEXT_
@@ -0,0 +1,407 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "pipelinelayout_binary.hpp"
+#include "pipelinelayout_model.hpp"
+#include <string.h>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+static const char BIN_MAGIC[8] = { 'V', 'K', 'P', 'L', 'B', 'I', 'N', '\0' };
+
+static_assert(sizeof(BinHeader) == 72, "BinHeader layout is part of the file format");
+static_assert(sizeof(BinBinding) == 32, "BinBinding layout is part of the file format");
+static_assert(sizeof(BinLayout) == 16, "BinLayout layout is part of the file format");
+
+// -------------------------------------------------------- File helpers -----------------------------------------------
+
+bool SyncFile(FILE* file)
+{
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool RenameOver(const std::string& from, const std::string& to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+bool TruncateFile(FILE* file, uint64_t size)
+{
+    if (fflush(file) != 0) return false;
+#ifdef _WIN32
+    return _chsize_s(_fileno(file), (__int64) size) == 0;
+#else
+    return ftruncate(fileno(file), (off_t) size) == 0;
+#endif
+}
+
+// -------------------------------------------------------- MappedFile -----------------------------------------------
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& fileName)
+{
+    HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Could not open " + fileName + ".");
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        CloseHandle(file);
+        throw std::runtime_error("Could not map " + fileName + ".");
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Could not map " + fileName + ".");
+    }
+    m_file = file;
+    m_mapping = mapping;
+    m_data = (const char*) view;
+    m_size = (size_t) size.QuadPart;
+}
+
+MappedFile::~MappedFile()
+{
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& fileName)
+{
+    int fd = open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + fileName + ".");
+    }
+    struct stat sb;
+    void* view = MAP_FAILED;
+    if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+        view = mmap(nullptr, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + fileName + ".");
+    }
+    m_data = (const char*) view;
+    m_size = (size_t) sb.st_size;
+}
+
+MappedFile::~MappedFile()
+{
+    munmap((void*) m_data, m_size);
+}
+
+#endif
+
+// -------------------------------------------------------- PipelineLayoutBinary -----------------------------------------------
+
+PipelineLayoutBinary::PipelineLayoutBinary(const std::string& fileName)
+    : m_file(new MappedFile(fileName)), m_data(m_file->data()), m_size(m_file->size())
+{
+    checkHeader();
+}
+
+PipelineLayoutBinary::PipelineLayoutBinary(const char* data, size_t size)
+    : m_data(data), m_size(size)
+{
+    checkHeader();
+}
+
+static bool TableFits(uint32_t offset, uint32_t count, size_t recordSize, size_t fileSize)
+{
+    return offset % 4 == 0 && offset <= fileSize && (uint64_t) count * recordSize <= fileSize - offset;
+}
+
+void PipelineLayoutBinary::checkHeader(void)
+{
+    m_header = reinterpret_cast<const BinHeader*>(m_data);
+    if (m_size < sizeof(BinHeader) || memcmp(m_header->magic, BIN_MAGIC, sizeof(BIN_MAGIC))) {
+        throw std::runtime_error("Not a .vkpipeline.bin file.");
+    }
+    if (m_header->version > VKPIPELINE_BIN_VERSION) {
+        throw std::runtime_error("Written by a newer version (format " + to_string(m_header->version) + ").");
+    }
+    const BinHeader& h = *m_header;
+    if (h.headerSize < sizeof(BinHeader) || h.fileSize != m_size ||
+        !TableFits(h.bindingsOffset, h.numBindings, sizeof(BinBinding), m_size) ||
+        !TableFits(h.setsOffset, h.numSets, sizeof(BinString), m_size) ||
+        !TableFits(h.layoutsOffset, h.numLayouts, sizeof(BinLayout), m_size) ||
+        !TableFits(h.setRangesOffset, h.numSetRanges, sizeof(BinSetRange), m_size) ||
+        !TableFits(h.refsOffset, h.numRefs, sizeof(uint32_t), m_size) ||
+        !TableFits(h.stringsOffset, h.stringsSize, 1, m_size)) {
+        throw std::runtime_error("Truncated or corrupt .vkpipeline.bin file.");
+    }
+}
+
+template <typename T>
+const T& PipelineLayoutBinary::record(uint32_t offset, uint32_t count, uint32_t idx) const
+{
+    if (idx >= count) throw std::runtime_error("Record index out of range.");
+    return reinterpret_cast<const T*>(m_data + offset)[idx];
+}
+
+bool PipelineLayoutBinary::Name::equals(const char* s, size_t len) const
+{
+    return size == len && !memcmp(data, s, len);
+}
+
+const BinBinding& PipelineLayoutBinary::binding(uint32_t idx) const
+{
+    return record<BinBinding>(m_header->bindingsOffset, m_header->numBindings, idx);
+}
+
+const BinLayout& PipelineLayoutBinary::layout(uint32_t idx) const
+{
+    const BinLayout& l = record<BinLayout>(m_header->layoutsOffset, m_header->numLayouts, idx);
+    if ((uint64_t) l.firstSetRange + l.numSetRanges > m_header->numSetRanges) {
+        throw std::runtime_error("Set range out of range.");
+    }
+    return l;
+}
+
+PipelineLayoutBinary::Name PipelineLayoutBinary::text(const BinString& s) const
+{
+    // The NUL after each string is part of its extent, so callers may rely on data being terminated.
+    if (s.offset >= m_header->stringsSize || s.size >= m_header->stringsSize - s.offset ||
+        m_data[m_header->stringsOffset + s.offset + s.size] != '\0') {
+        throw std::runtime_error("String reference out of range.");
+    }
+    return Name{ m_data + m_header->stringsOffset + s.offset, s.size };
+}
+
+PipelineLayoutBinary::Name PipelineLayoutBinary::setName(uint32_t idx) const
+{
+    return text(record<BinString>(m_header->setsOffset, m_header->numSets, idx));
+}
+
+uint32_t PipelineLayoutBinary::setBindings(uint32_t layoutIdx, uint32_t set, const uint32_t*& refs) const
+{
+    const BinLayout& l = layout(layoutIdx);
+    if (set >= l.numSetRanges) {
+        throw std::runtime_error("Set index out of range.");
+    }
+    const BinSetRange& r = record<BinSetRange>(m_header->setRangesOffset, m_header->numSetRanges, l.firstSetRange + set);
+    if (r.firstRef > m_header->numRefs || r.numRefs > m_header->numRefs - r.firstRef) {
+        throw std::runtime_error("Binding reference out of range.");
+    }
+    refs = reinterpret_cast<const uint32_t*>(m_data + m_header->refsOffset) + r.firstRef;
+    for (uint32_t i = 0; i < r.numRefs; i++) {
+        if (refs[i] >= m_header->numBindings) throw std::runtime_error("Invalid DL index.");
+    }
+    return r.numRefs;
+}
+
+int PipelineLayoutBinary::findLayout(const std::string& name) const
+{
+    for (uint32_t i = 0; i < numLayouts(); i++) {
+        if (text(layout(i).name).equals(name.data(), name.size())) return (int) i;
+    }
+    return -1;
+}
+
+int PipelineLayoutBinary::findBinding(const std::string& name) const
+{
+    for (uint32_t i = 0; i < numBindings(); i++) {
+        if (text(binding(i).name).equals(name.data(), name.size())) return (int) i;
+    }
+    return -1;
+}
+
+// -------------------------------------------------------- PipelineLayoutModel -----------------------------------------------
+
+namespace {
+
+// Builds the string section. Identical strings, typically empty comments and repeated data blocks,
+// are stored once.
+class StringTable
+{
+    std::unordered_map<std::string, uint32_t> m_offsets;
+    const NamePool& m_names;
+    std::vector<BinString> m_nameRefs;      // By NameId; size UINT32_MAX until first added.
+
+public:
+    std::string bytes;
+
+    explicit StringTable(const NamePool& names) : m_names(names), m_nameRefs(names.count(), BinString{ 0, UINT32_MAX }) {}
+
+    BinString add(NameId id)
+    {
+        BinString& ref = m_nameRefs[id];
+        if (ref.size == UINT32_MAX) ref = add(m_names.str(id));
+        return ref;
+    }
+
+    BinString add(const std::string& s)
+    {
+        if (bytes.size() + s.size() + 1 > UINT32_MAX) throw std::runtime_error("Project too large for .vkpipeline.bin.");
+        auto it = m_offsets.emplace(s, (uint32_t) bytes.size());
+        if (it.second) {
+            bytes.append(s);
+            bytes.push_back('\0');
+        }
+        return BinString{ it.first->second, (uint32_t) s.size() };
+    }
+};
+
+template <typename T>
+uint32_t AppendTable(std::string& out, const std::vector<T>& table)
+{
+    uint32_t offset = (uint32_t) out.size();
+    out.append(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(T));
+    return offset;
+}
+
+}
+
+void PipelineLayoutModel::serializeBinary(std::string& out) const
+{
+    StringTable strings(m_names);
+    vector<BinBinding> bindings;
+    bindings.reserve(m_dlayouts.size());
+    string data, comment;
+    for (auto& dl: m_dlayouts) {
+        dl->data.decode(data);
+        dl->comment.decode(comment);
+        bindings.push_back(BinBinding{ strings.add(dl->name), strings.add(data), strings.add(comment),
+                                       dl->typeIdx, dl->stageFlagBits });
+    }
+    vector<BinString> sets;
+    sets.reserve(m_dsets.size());
+    for (NameId s: m_dsets) sets.push_back(strings.add(s));
+
+    vector<BinLayout> layouts;
+    vector<BinSetRange> ranges;
+    vector<uint32_t> refs;
+    layouts.reserve(m_layouts.size());
+    for (auto& pl: m_layouts) {
+        // Every set gets a range, the ones the layout does not use an empty one.
+        layouts.push_back(BinLayout{ strings.add(pl.name), (uint32_t) ranges.size(), (uint32_t) m_dsets.size() });
+        for (uint32_t s = 0; s < m_dsets.size(); s++) {
+            auto& dset = pl.descsets[s];
+            ranges.push_back(BinSetRange{ (uint32_t) refs.size(), (uint32_t) dset.dlayouts.size() });
+            for (BindingHandle dl: dset.dlayouts) refs.push_back((uint32_t) resolveBinding(dl));
+        }
+    }
+
+    BinHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, BIN_MAGIC, sizeof(BIN_MAGIC));
+    h.version = VKPIPELINE_BIN_VERSION;
+    h.headerSize = sizeof(BinHeader);
+    h.numBindings = (uint32_t) bindings.size();
+    h.numSets = (uint32_t) sets.size();
+    h.numLayouts = (uint32_t) layouts.size();
+    h.numSetRanges = (uint32_t) ranges.size();
+    h.numRefs = (uint32_t) refs.size();
+    h.stringsSize = (uint32_t) strings.bytes.size();
+
+    out.clear();
+    out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    h.bindingsOffset = AppendTable(out, bindings);
+    h.setsOffset = AppendTable(out, sets);
+    h.layoutsOffset = AppendTable(out, layouts);
+    h.setRangesOffset = AppendTable(out, ranges);
+    h.refsOffset = AppendTable(out, refs);
+    h.stringsOffset = (uint32_t) out.size();
+    out.append(strings.bytes);
+    out.resize((out.size() + 3) & ~(size_t) 3, '\0');
+    if (out.size() > UINT32_MAX) throw std::runtime_error("Project too large for .vkpipeline.bin.");
+    h.fileSize = (uint32_t) out.size();
+    memcpy(&out[0], &h, sizeof(h));
+}
+
+void PipelineLayoutModel::deserializeBinary(const PipelineLayoutBinary& bin)
+{
+    NamePool names;
+    auto intern = [&names](const PipelineLayoutBinary::Name& t) { return names.intern(t.data, t.size); };
+    vector<NameId> dsets(bin.numSets());
+    vector< shared_ptr<DescriptorLayout> > dlayouts;
+    vector<PipelineLayout> layouts(bin.numLayouts());
+
+    for (uint32_t i = 0; i < bin.numSets(); i++) {
+        dsets[i] = intern(bin.setName(i));
+    }
+    dlayouts.reserve(bin.numBindings());
+    for (uint32_t i = 0; i < bin.numBindings(); i++) {
+        const BinBinding& b = bin.binding(i);
+        dlayouts.push_back(makeBinding(intern(bin.text(b.name))));
+        dlayouts.back()->typeIdx = b.typeIdx;
+        auto data = bin.text(b.data);
+        auto comment = bin.text(b.comment);
+        dlayouts.back()->data.assign(data.data, data.size, &m_arena);
+        dlayouts.back()->comment.assign(comment.data, comment.size, &m_arena);
+        dlayouts.back()->stageFlagBits = b.stageFlagBits;
+    }
+    BindingSlotTable slots;
+    assignHandles(dlayouts, slots);
+    for (uint32_t l = 0; l < bin.numLayouts(); l++) {
+        const BinLayout& bl = bin.layout(l);
+        auto& pl = layouts[l];
+        pl.name = intern(bin.text(bl.name));
+        for (uint32_t s = 0; s < bl.numSetRanges; s++) {
+            const uint32_t* refs;
+            uint32_t n = bin.setBindings(l, s, refs);
+            if (!n) continue;
+            if (s >= bin.numSets()) throw std::runtime_error("Invalid set index.");
+            auto& dst = pl.descsets.edit(s).dlayouts;
+            dst.reserve(n);
+            for (uint32_t k = 0; k < n; k++) dst.push_back(dlayouts[refs[k]]->handle);
+        }
+    }
+
+    m_names = std::move(names);
+    m_dsets.assign(dsets.begin(), dsets.end());
+    m_dlayouts.assign(dlayouts.begin(), dlayouts.end());
+    swap(m_slots, slots);
+    m_layouts.assign(make_move_iterator(layouts.begin()), make_move_iterator(layouts.end()));
+    invalidateIndexes();
+}
@@ -0,0 +1,160 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _PIPELINE_LAYOUT_BINARY_
+#define _PIPELINE_LAYOUT_BINARY_
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+
+// .vkpipeline.bin: the project as flat, offset-addressed tables, meant to be mapped and queried in place.
+// All integers are little-endian and the tables are read in place, so like the editor this assumes a
+// little-endian host. Every table starts on a 4-byte boundary.
+//
+//     BinHeader
+//     BinBinding   bindings[numBindings]
+//     BinString    sets[numSets]
+//     BinLayout    layouts[numLayouts]
+//     BinSetRange  setRanges[numSetRanges]     Per pipeline layout, one range per descriptor set.
+//     uint32_t     refs[numRefs]               Binding indices, in set order.
+//     char         strings[stringsSize]        Interned, each followed by a NUL.
+//
+// Readers reject a newer version. The format holds exactly what the model holds, so
+// .json -> .bin -> .json reproduces the file that save() writes.
+#define VKPIPELINE_BIN_VERSION 1
+
+struct BinString {
+    uint32_t offset;    // Into the string section.
+    uint32_t size;      // Without the trailing NUL.
+};
+
+struct BinBinding {
+    BinString name;
+    BinString data;
+    BinString comment;
+    int32_t typeIdx;
+    uint32_t stageFlagBits;
+};
+
+struct BinLayout {
+    BinString name;
+    uint32_t firstSetRange;
+    uint32_t numSetRanges;
+};
+
+struct BinSetRange {
+    uint32_t firstRef;
+    uint32_t numRefs;
+};
+
+struct BinHeader {
+    char magic[8];      // "VKPLBIN\0"
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t numBindings;
+    uint32_t numSets;
+    uint32_t numLayouts;
+    uint32_t numSetRanges;
+    uint32_t numRefs;
+    uint32_t stringsSize;
+    uint32_t bindingsOffset;
+    uint32_t setsOffset;
+    uint32_t layoutsOffset;
+    uint32_t setRangesOffset;
+    uint32_t refsOffset;
+    uint32_t stringsOffset;
+    uint32_t fileSize;
+    uint32_t reserved;
+};
+
+// Read-only mapping of a whole file; mmap on POSIX, a file mapping on Windows.
+class MappedFile
+{
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+
+public:
+    explicit MappedFile(const std::string& fileName);   // Throws std::runtime_error.
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data(void) const { return m_data; }
+    size_t size(void) const { return m_size; }
+};
+
+// Small portable file helpers shared by the writers. All return false on failure.
+bool SyncFile(FILE* file);                                          // fflush, then fsync / _commit.
+bool RenameOver(const std::string& from, const std::string& to);   // Replaces `to` if it exists.
+bool TruncateFile(FILE* file, uint64_t size);
+
+// Zero-copy view of a .vkpipeline.bin image. Opening checks the header and table extents only;
+// records are bounds-checked as they are read, so the cost of a query does not depend on project size.
+// Names point into the image and stay valid as long as the view does. Throws std::runtime_error on
+// a malformed image.
+class PipelineLayoutBinary
+{
+    std::unique_ptr<MappedFile> m_file;
+    const char* m_data;
+    size_t m_size;
+    const BinHeader* m_header;
+
+    void checkHeader(void);
+    template <typename T> const T& record(uint32_t offset, uint32_t count, uint32_t idx) const;
+
+public:
+    explicit PipelineLayoutBinary(const std::string& fileName);     // Maps the file.
+    PipelineLayoutBinary(const char* data, size_t size);            // Views caller-owned memory.
+
+    // A string in the image: NUL-terminated, but may also contain NULs, so size is authoritative.
+    struct Name {
+        const char* data;
+        uint32_t size;
+        std::string str(void) const { return std::string(data, size); }
+        bool equals(const char* s, size_t len) const;
+    };
+
+    uint32_t numBindings(void) const { return m_header->numBindings; }
+    uint32_t numSets(void) const { return m_header->numSets; }
+    uint32_t numLayouts(void) const { return m_header->numLayouts; }
+
+    const BinBinding& binding(uint32_t idx) const;
+    const BinLayout& layout(uint32_t idx) const;       // Its set range is known to lie within the table.
+    Name text(const BinString& s) const;
+    Name setName(uint32_t idx) const;
+
+    // Binding indices referenced by set `set` of pipeline layout `layoutIdx`; every index is < numBindings().
+    uint32_t setBindings(uint32_t layoutIdx, uint32_t set, const uint32_t*& refs) const;
+
+    // Linear scans over the name tables, without materializing anything. -1 if absent.
+    int findLayout(const std::string& name) const;
+    int findBinding(const std::string& name) const;
+};
+
+#endif // _PIPELINE_LAYOUT_BINARY_
@@ -0,0 +1,2568 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "pipelinelayout_model.hpp"
+#include "pipelinelayout_binary.hpp"
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+#include <cassert>
+#include <cstring>
+#include <thread>
+#include <atomic>
+#include <json/json.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <process.h>
+#include <intrin.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+vector<string> descLayoutTypes = {
+    "VK_DESCRIPTOR_TYPE_SAMPLER",
+    "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER",
+    "VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE",
+    "VK_DESCRIPTOR_TYPE_STORAGE_IMAGE",
+    "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER",
+    "VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER",
+    "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER",
+    "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER",
+    "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC",
+    "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC",
+    "VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT"
+};
+vector<string> stageBits = {
+        "VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT",
+        "VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT",
+        "VK_PIPELINE_STAGE_VERTEX_INPUT_BIT",
+        "VK_PIPELINE_STAGE_VERTEX_SHADER_BIT",
+        "VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT",
+        "VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT",
+        "VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT",
+        "VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT",
+        "VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT",
+        "VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT",
+        "VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT",
+        "VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT",
+        "VK_PIPELINE_STAGE_TRANSFER_BIT",
+        "VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT",
+        "VK_PIPELINE_STAGE_HOST_BIT",
+        "VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT",
+        "VK_PIPELINE_STAGE_ALL_COMMANDS_BIT"
+};
+
+// -------------------------------------------------------- Helpers -----------------------------------------------
+
+// src: http://stackoverflow.com/questions/874134/find-if-string-ends-with-another-string-in-c
+inline bool EndsWith(std::string const & value, std::string const & ending)
+{
+    if (ending.size() > value.size()) return false;
+    return std::equal(ending.rbegin(), ending.rend(), value.rbegin());
+}
+
+// The typeName written for a binding; one of an invalid type gets VK_DESCRIPTOR_TYPE_MAX_ENUM, as in
+// exported headers, and validate() reports it.
+static const std::string& TypeName(int typeIdx)
+{
+    static const std::string invalid = "VK_DESCRIPTOR_TYPE_MAX_ENUM";
+    return typeIdx >= 0 && typeIdx < (int) descLayoutTypes.size() ? descLayoutTypes[typeIdx] : invalid;
+}
+
+// ModelNameIndex upkeep. nameAt(i) is the name of the i-th of count entries in the indexed list;
+// numNames the size of the model's NamePool.
+template <typename NameAt>
+static void IndexRebuild(ModelNameIndex& index, size_t numNames, size_t count, NameAt nameAt)
+{
+    index.positions.assign(numNames, -1);
+    index.repeats = false;
+    for (size_t i = 0; i < count; i++) {
+        int& pos = index.positions[nameAt(i)];
+        if (pos < 0) pos = (int) i;
+        else index.repeats = true;
+    }
+    index.size = count;
+    index.valid = true;
+}
+
+static int IndexLookup(const ModelNameIndex& index, NameId name)
+{
+    return name < index.positions.size() ? index.positions[name] : -1;
+}
+
+template <typename NameAt>
+static int IndexFind(ModelNameIndex& index, size_t numNames, size_t count, NameAt nameAt, NameId name)
+{
+    if (!index.valid || index.size != count) IndexRebuild(index, numNames, count, nameAt);
+    int pos = IndexLookup(index, name);
+    if (pos < 0) return -1;
+    if (pos < (int) count && nameAt(pos) == name) return pos;
+    IndexRebuild(index, numNames, count, nameAt);
+    return IndexLookup(index, name);
+}
+
+static void IndexSet(ModelNameIndex& index, NameId name, int pos)
+{
+    if (name >= index.positions.size()) index.positions.resize(name + 1, -1);
+    index.positions[name] = pos;
+}
+
+// An entry was appended at pos.
+static void IndexAdded(ModelNameIndex& index, NameId name, int pos)
+{
+    if (!index.valid) return;
+    if (index.size != (size_t) pos) {
+        index.valid = false;
+        return;
+    }
+    if (IndexLookup(index, name) >= 0) index.repeats = true;
+    else IndexSet(index, name, pos);
+    index.size++;
+}
+
+static void IndexRenamed(ModelNameIndex& index, NameId from, NameId to, int pos)
+{
+    if (!index.valid) return;
+    if (index.repeats) {
+        index.valid = false;
+        return;
+    }
+    IndexSet(index, from, -1);
+    int other = IndexLookup(index, to);
+    if (other >= 0) {
+        index.repeats = true;
+        IndexSet(index, to, min(other, pos));
+    } else {
+        IndexSet(index, to, pos);
+    }
+}
+
+// The entries at a and b, now named nameA and nameB, traded places.
+static void IndexSwapped(ModelNameIndex& index, NameId nameA, int a, NameId nameB, int b)
+{
+    if (!index.valid) return;
+    if (index.repeats) {
+        index.valid = false;
+        return;
+    }
+    IndexSet(index, nameA, a);
+    IndexSet(index, nameB, b);
+}
+
+static inline int CountTrailingZeros(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return (int) idx;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// BindingUsage upkeep, on one binding's sorted list.
+static bool UsageLess(const BindingUsage& a, const BindingUsage& b)
+{
+    return a.layout < b.layout || (a.layout == b.layout && a.word < b.word);
+}
+
+template <typename V>
+static auto UsageFind(V& usages, uint32_t layout, uint32_t word) -> decltype(usages.begin())
+{
+    auto it = lower_bound(usages.begin(), usages.end(), BindingUsage{ layout, word, 0 }, UsageLess);
+    return (it != usages.end() && it->layout == layout && it->word == word) ? it : usages.end();
+}
+
+static bool UsageTest(const vector<BindingUsage>& usages, int layout, int set)
+{
+    auto it = UsageFind(usages, layout, set / 64);
+    return it != usages.end() && (it->sets >> (set % 64) & 1);
+}
+
+static void UsageSet(vector<BindingUsage>& usages, int layout, int set)
+{
+    BindingUsage key{ (uint32_t) layout, (uint32_t) set / 64, 0 };
+    auto it = lower_bound(usages.begin(), usages.end(), key, UsageLess);
+    if (it == usages.end() || it->layout != key.layout || it->word != key.word) it = usages.insert(it, key);
+    it->sets |= 1ull << (set % 64);
+}
+
+static void UsageClear(vector<BindingUsage>& usages, int layout, int set)
+{
+    auto it = UsageFind(usages, layout, set / 64);
+    if (it == usages.end()) return;
+    it->sets &= ~(1ull << (set % 64));
+    if (!it->sets) usages.erase(it);
+}
+
+// Names straight from the pool, without a std::string in between.
+static void WriteName(JsonStreamWriter& writer, const NamePool& names, NameId id)
+{
+    writer.value(names.c_str(id), names.size(id));
+}
+
+static void WriteKey(JsonStreamWriter& writer, const NamePool& names, NameId id)
+{
+    writer.key(names.c_str(id), names.size(id));
+}
+
+// -------------------------------------------------------- BindingSlotTable -----------------------------------------------
+
+BindingHandle BindingSlotTable::allocate(uint32_t index)
+{
+    uint32_t s;
+    if (!m_free.empty()) {
+        s = m_free.back();
+        m_free.pop_back();
+        m_slots.edit(s).generation++;
+    } else {
+        if (m_slots.size() == MAX_SLOTS) throw std::length_error("Too many bindings.");
+        s = (uint32_t) m_slots.size();
+        m_slots.push_back(Slot{ FREE, 1 });
+    }
+    m_slots.edit(s).index = index;
+    return m_slots[s].generation << SLOT_BITS | s;
+}
+
+void BindingSlotTable::release(BindingHandle h)
+{
+    uint32_t s = h & SLOT_MASK;
+    if (find(h) < 0) return;
+    m_slots.edit(s).index = FREE;
+    if (m_slots[s].generation < 255) m_free.push_back(s);
+}
+
+// -------------------------------------------------------- DescriptorLayout & PipelineLayout -----------------------------------------------
+
+DescriptorLayout::DescriptorLayout(NameId name_)
+    : name(name_)
+{}
+
+void DescriptorLayout::stageFlagBitsToBools(std::vector<bool>& out) const
+{
+    out[0] = !!(stageFlagBits & VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    out[1] = !!(stageFlagBits & VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+    out[2] = !!(stageFlagBits & VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+    out[3] = !!(stageFlagBits & VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+    out[4] = !!(stageFlagBits & VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT);
+    out[5] = !!(stageFlagBits & VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT);
+    out[6] = !!(stageFlagBits & VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT);
+    out[7] = !!(stageFlagBits & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    out[8] = !!(stageFlagBits & VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT);
+    out[9] = !!(stageFlagBits & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+    out[10] = !!(stageFlagBits & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    out[11] = !!(stageFlagBits & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    out[12] = !!(stageFlagBits & VK_PIPELINE_STAGE_TRANSFER_BIT);
+    out[13] = !!(stageFlagBits & VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+    out[14] = !!(stageFlagBits & VK_PIPELINE_STAGE_HOST_BIT);
+    out[15] = !!(stageFlagBits & VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
+    out[16] = !!(stageFlagBits & VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+}
+
+void DescriptorLayout::stageFlagBitsFromBools(std::vector<bool>& out)
+{
+    stageFlagBits = 0;
+    if (out[0]) stageFlagBits |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    if (out[1]) stageFlagBits |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    if (out[2]) stageFlagBits |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+    if (out[3]) stageFlagBits |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+    if (out[4]) stageFlagBits |= VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT;
+    if (out[5]) stageFlagBits |= VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT;
+    if (out[6]) stageFlagBits |= VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+    if (out[7]) stageFlagBits |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    if (out[8]) stageFlagBits |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    if (out[9]) stageFlagBits |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    if (out[10]) stageFlagBits |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    if (out[11]) stageFlagBits |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (out[12]) stageFlagBits |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+    if (out[13]) stageFlagBits |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    if (out[14]) stageFlagBits |= VK_PIPELINE_STAGE_HOST_BIT;
+    if (out[15]) stageFlagBits |= VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+    if (out[16]) stageFlagBits |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+}
+
+size_t DescriptorSetList::position(uint32_t set) const
+{
+    return lower_bound(m_sets.begin(), m_sets.end(), set,
+                       [](const DescriptorSet& s, uint32_t index) { return s.index < index; }) - m_sets.begin();
+}
+
+const DescriptorSet* DescriptorSetList::find(uint32_t set) const
+{
+    size_t i = position(set);
+    return (i < m_sets.size() && m_sets[i].index == set) ? &m_sets[i] : nullptr;
+}
+
+const DescriptorSet& DescriptorSetList::operator[](uint32_t set) const
+{
+    static const DescriptorSet empty;
+    const DescriptorSet* found = find(set);
+    return found ? *found : empty;
+}
+
+DescriptorSet& DescriptorSetList::edit(uint32_t set)
+{
+    size_t i = position(set);
+    if (i == m_sets.size() || m_sets[i].index != set) {
+        DescriptorSet added;
+        added.index = set;
+        m_sets.insert(i, move(added));
+    }
+    return m_sets.edit(i);
+}
+
+void DescriptorSetList::prune(uint32_t set)
+{
+    const DescriptorSet* found = find(set);
+    if (found && found->dlayouts.empty()) erase(set);
+}
+
+void DescriptorSetList::erase(uint32_t set)
+{
+    size_t i = position(set);
+    if (i < m_sets.size() && m_sets[i].index == set) m_sets.erase(i);
+}
+
+void DescriptorSetList::swapSets(uint32_t a, uint32_t b)
+{
+    if (a == b) return;
+    const DescriptorSet* x = find(a);
+    const DescriptorSet* y = find(b);
+    if (!x && !y) return;
+    CowVector<BindingHandle> from = x ? x->dlayouts : CowVector<BindingHandle>();
+    CowVector<BindingHandle> to = y ? y->dlayouts : CowVector<BindingHandle>();
+    erase(a);
+    erase(b);
+    if (!to.empty()) edit(a).dlayouts = move(to);
+    if (!from.empty()) edit(b).dlayouts = move(from);
+}
+
+PipelineLayout::PipelineLayout(NameId name_)
+    : name(name_)
+{}
+
+// -------------------------------------------------------- PipelineLayoutModel -----------------------------------------------
+
+void PipelineLayoutModel::initDefault(void)
+{
+    clear();
+    m_layouts.push_back(PipelineLayout(m_names.intern("LAYOUT_DEFAULT")));
+
+    m_dsets.push_back(m_names.intern("PSET_PER_FRAME"));
+    m_dsets.push_back(m_names.intern("PSET_PER_SCENE"));
+    m_dsets.push_back(m_names.intern("PSET_PER_CAMERA"));
+    m_dsets.push_back(m_names.intern("PSET_PER_MATERIAL"));
+    m_dsets.push_back(m_names.intern("PSET_PER_OBJECT"));
+
+    appendBinding(makeBinding(m_names.intern("UBO_FRAME_GLOBAL_INFO")));
+    appendBinding(makeBinding(m_names.intern("UBO_CAMERA_INFO")));
+    appendBinding(makeBinding(m_names.intern("UBO_WORLD_MATRIX")));
+    appendBinding(makeBinding(m_names.intern("UBO_SCENE_PARAMS_GENERIC")));
+    appendBinding(makeBinding(m_names.intern("UBO_MATERIAL_PARAMS_GENERIC")));
+    appendBinding(makeBinding(m_names.intern("UBO_OBJECT_PARAMS_GENERIC")));
+    appendBinding(makeBinding(m_names.intern("SSBO_LIGHT_GRID_DATA")));
+    appendBinding(makeBinding(m_names.intern("SSBO_BATCHED_DRAWCALL_DATA")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_ARRAY")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_DIFFUSE_MAP")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_NORMAL_MAP")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_SHININESS_MAP")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_METALLIC_MAP")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_IRRADIANCE")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_RADIANCE")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_POSTROCESS0")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_POSTROCESS1")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_POSTROCESS2")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_POSTROCESS3")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_SHADOW0")));
+    appendBinding(makeBinding(m_names.intern("SAMPLER_SHADOW1")));
+
+    findDLV(0, "PSET_PER_FRAME").push_back(findDescLayoutByName("UBO_FRAME_GLOBAL_INFO")->handle);
+    findDLV(0, "PSET_PER_CAMERA").push_back(findDescLayoutByName("UBO_CAMERA_INFO")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("UBO_WORLD_MATRIX")->handle);
+    findDLV(0, "PSET_PER_SCENE").push_back(findDescLayoutByName("UBO_SCENE_PARAMS_GENERIC")->handle);
+    findDLV(0, "PSET_PER_MATERIAL").push_back(findDescLayoutByName("UBO_MATERIAL_PARAMS_GENERIC")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("UBO_OBJECT_PARAMS_GENERIC")->handle);
+    findDLV(0, "PSET_PER_CAMERA").push_back(findDescLayoutByName("SSBO_LIGHT_GRID_DATA")->handle);
+    findDLV(0, "PSET_PER_MATERIAL").push_back(findDescLayoutByName("SSBO_BATCHED_DRAWCALL_DATA")->handle);
+    findDLV(0, "PSET_PER_MATERIAL").push_back(findDescLayoutByName("SAMPLER_ARRAY")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_DIFFUSE_MAP")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_NORMAL_MAP")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_SHININESS_MAP")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_METALLIC_MAP")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_IRRADIANCE")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_RADIANCE")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_POSTROCESS0")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_POSTROCESS1")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_POSTROCESS2")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_POSTROCESS3")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_SHADOW0")->handle);
+    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_SHADOW1")->handle);
+}
+
+void PipelineLayoutModel::clear(void)
+{
+    m_layouts.clear();
+    m_dsets.clear();
+    m_dlayouts.clear();
+    m_slots.clear();
+    m_names.clear();
+    invalidateIndexes();
+}
+
+void PipelineLayoutModel::invalidateIndexes(void)
+{
+    m_layoutIndex.valid = false;
+    m_setIndex.valid = false;
+    m_bindingIndex.valid = false;
+    m_usageIndex.valid = false;
+    m_usageIndex.renumber.clear();
+    m_columns.valid = false;
+    m_transaction = Transaction();
+    if (m_undo) m_undo->reset();
+    m_generation++;
+}
+
+std::vector<BindingUsage>& PipelineLayoutModel::usages(BindingHandle h) const
+{
+    settleUsages();
+    return unsettledUsages(h);
+}
+
+// Entries made or looked up here go through usageNumber() / usageLayout().
+std::vector<BindingUsage>& PipelineLayoutModel::unsettledUsages(BindingHandle h) const
+{
+    auto& usages = m_usageIndex.usages;
+    if (!m_usageIndex.valid) {
+        m_usageIndex.renumber.clear();
+        usages.clear();
+        usages.resize(m_slots.numSlots());
+        // Layouts and sets are visited in order, so each list comes out sorted.
+        for (uint32_t l = 0; l < m_layouts.size(); l++) {
+            for (auto& dset: m_layouts[l].descsets) {
+                uint32_t s = dset.index;
+                for (BindingHandle dl: dset.dlayouts) {
+                    auto& u = usages[BindingSlotTable::slotOf(dl)];
+                    if (u.empty() || u.back().layout != l || u.back().word != s / 64) u.push_back(BindingUsage{ l, s / 64, 0 });
+                    u.back().sets |= 1ull << (s % 64);
+                }
+            }
+        }
+        m_usageIndex.valid = true;
+    }
+    uint32_t slot = BindingSlotTable::slotOf(h);
+    if (slot >= usages.size()) usages.resize(m_slots.numSlots());
+    return usages[slot];
+}
+
+// Applies the renumbering delLayout() left for later, in one pass.
+void PipelineLayoutModel::settleUsages(void) const
+{
+    auto& renumber = m_usageIndex.renumber;
+    if (renumber.empty()) return;
+    // Entries of deleted layouts are gone already; every number left is in renumber, which is sorted.
+    vector<uint32_t> to(renumber.back() + 1);
+    for (uint32_t l = 0; l < renumber.size(); l++) to[renumber[l]] = l;
+    for (auto& list: m_usageIndex.usages) {
+        for (auto& u: list) u.layout = to[u.layout];
+    }
+    renumber.clear();
+}
+
+uint32_t PipelineLayoutModel::usageNumber(int layout) const
+{
+    auto& renumber = m_usageIndex.renumber;
+    return renumber.empty() ? (uint32_t) layout : renumber[layout];
+}
+
+// A layout added at the end while renumbering is pending: its entries take the next number.
+void PipelineLayoutModel::usageLayoutAdded(void)
+{
+    auto& renumber = m_usageIndex.renumber;
+    if (!renumber.empty()) renumber.push_back(renumber.back() + 1);
+}
+
+int PipelineLayoutModel::usageLayout(uint32_t number) const
+{
+    auto& renumber = m_usageIndex.renumber;
+    if (renumber.empty()) return (int) number;
+    return (int) (lower_bound(renumber.begin(), renumber.end(), number) - renumber.begin());
+}
+
+ModelBindingColumns& PipelineLayoutModel::columns(void) const
+{
+    if (!m_columns.valid) {
+        m_columns.types.resize(m_dlayouts.size());
+        m_columns.stages.resize(m_dlayouts.size());
+        for (size_t i = 0; i < m_dlayouts.size(); i++) {
+            m_columns.types[i] = m_dlayouts[i]->typeIdx;
+            m_columns.stages[i] = m_dlayouts[i]->stageFlagBits;
+        }
+        m_columns.valid = true;
+    }
+    return m_columns;
+}
+
+// Takes the idx-th entry out of a set, and the set out of the binding's usages unless it is listed twice.
+// A set left empty is no longer stored.
+void PipelineLayoutModel::removeFromSet(int layout, int set, int idx)
+{
+    auto& dlayouts = editSet(layout, set);
+    BindingHandle dl = dlayouts[idx];
+    dlayouts.erase(idx);
+    if (m_usageIndex.valid && find(dlayouts.begin(), dlayouts.end(), dl) == dlayouts.end()) {
+        UsageClear(unsettledUsages(dl), usageNumber(layout), set);
+    }
+    if (dlayouts.empty()) pruneSet(layout, set);
+}
+
+// For loaders: a fresh table, bindings[i] holding the handle for slot i.
+void PipelineLayoutModel::assignHandles(std::vector< std::shared_ptr<DescriptorLayout> >& dlayouts, BindingSlotTable& slots)
+{
+    slots.clear();
+    slots.reserve(dlayouts.size());
+    for (size_t i = 0; i < dlayouts.size(); i++) {
+        if (dlayouts[i]) dlayouts[i]->handle = slots.allocate((uint32_t) i);
+    }
+}
+
+void PipelineLayoutModel::appendBinding(std::shared_ptr<DescriptorLayout> dl)
+{
+    dl->handle = m_slots.allocate((uint32_t) m_dlayouts.size());
+    if (m_columns.valid) {
+        m_columns.types.push_back(dl->typeIdx);
+        m_columns.stages.push_back(dl->stageFlagBits);
+    }
+    m_dlayouts.push_back(move(dl));
+}
+
+DescriptorLayout& PipelineLayoutModel::editBinding(int idx)
+{
+    DescriptorLayoutPtr& dl = m_dlayouts.edit(idx);
+    // Once edit() has unshared the chunk, the count tells whether a snapshot holds the binding too. The
+    // binding was made non-const, so the cast is fine.
+    if (dl.use_count() != 1) dl = m_arena.makeShared<DescriptorLayout>(*dl);
+    else atomic_thread_fence(memory_order_acquire);
+    return const_cast<DescriptorLayout&>(*dl);
+}
+
+void PipelineLayoutModel::addLayout(const char* name)
+{
+    if (!strlen(name)) return;
+    NameId id = m_names.intern(name);
+    if (findLayout(id) >= 0) return;
+    setInverse(EDIT_DEL_LAYOUT, (int32_t) m_layouts.size());
+    m_layouts.push_back(PipelineLayout(id));
+    usageLayoutAdded();
+    IndexAdded(m_layoutIndex, m_layouts.back().name, (int) m_layouts.size() - 1);
+    notify(EDIT_ADD_LAYOUT, 0, 0, 0, 0, name);
+}
+
+void PipelineLayoutModel::delLayout(int idx)
+{
+    if (idx < 0 || idx >= (int) m_layouts.size()) return;
+    if (wantInverse()) {
+        layoutPayload(idx, m_inverseText);
+        setInverse(EDIT_RESTORE_LAYOUT, idx, 0, 0, 0, m_inverseText.c_str());
+    }
+    if (m_usageIndex.valid) {
+        // Drop the layout's entries, then renumber the ones after it. In a transaction the renumbering
+        // waits for the next use of the index, and is done once for all the deletes before it.
+        auto& renumber = m_usageIndex.renumber;
+        if (m_transaction.depth && renumber.empty()) {
+            renumber.resize(m_layouts.size());
+            for (uint32_t l = 0; l < renumber.size(); l++) renumber[l] = l;
+        }
+        uint32_t numbered = renumber.empty() ? (uint32_t) idx : renumber[idx];
+        for (auto& dset: m_layouts[idx].descsets) {
+            for (BindingHandle dl: dset.dlayouts) {
+                auto& u = m_usageIndex.usages[BindingSlotTable::slotOf(dl)];
+                auto first = lower_bound(u.begin(), u.end(), BindingUsage{ numbered, 0, 0 }, UsageLess);
+                auto last = first;
+                while (last != u.end() && last->layout == numbered) ++last;
+                u.erase(first, last);
+            }
+        }
+        if (!renumber.empty()) {
+            renumber.erase(renumber.begin() + idx);
+        } else {
+            for (auto& list: m_usageIndex.usages) {
+                for (auto& u: list) {
+                    if ((int) u.layout > idx) u.layout--;
+                }
+            }
+        }
+    }
+    m_layouts.erase(idx);
+    m_layoutIndex.valid = false;
+    notify(EDIT_DEL_LAYOUT, idx);
+}
+
+void PipelineLayoutModel::renameLayout(int idx, const char* name)
+{
+    if (!strlen(name)) return;
+    if (idx < 0 || idx >= (int) m_layouts.size()) return;
+    NameId id = m_names.intern(name);
+    if (m_layouts[idx].name == id) return;
+    setInverse(EDIT_RENAME_LAYOUT, idx, 0, 0, 0, m_names.c_str(m_layouts[idx].name));
+    IndexRenamed(m_layoutIndex, m_layouts[idx].name, id, idx);
+    m_layouts.edit(idx).name = id;
+    notify(EDIT_RENAME_LAYOUT, idx, 0, 0, 0, name);
+}
+
+void PipelineLayoutModel::reorderLayout(int& idx, bool up)
+{
+    if (idx < 0 || idx >= (int) m_layouts.size()) return;
+    int newidx = idx + (up ? -1 : 1);
+    if (newidx < 0 || newidx >= (int) m_layouts.size()) return;
+    setInverse(EDIT_REORDER_LAYOUT, newidx, !up);
+    m_layouts.swapAt(idx, newidx);
+    IndexSwapped(m_layoutIndex, m_layouts[idx].name, idx, m_layouts[newidx].name, newidx);
+    if (m_usageIndex.valid) {
+        // Only the bindings of the two layouts are affected, and in each of their lists the two
+        // layouts' entries sit next to each other.
+        uint32_t lo = min(idx, newidx), hi = max(idx, newidx);
+        unordered_set<BindingHandle> touched;
+        for (auto& dset: m_layouts[idx].descsets) touched.insert(dset.dlayouts.begin(), dset.dlayouts.end());
+        for (auto& dset: m_layouts[newidx].descsets) touched.insert(dset.dlayouts.begin(), dset.dlayouts.end());
+        for (BindingHandle dl: touched) {
+            auto& u = usages(dl);
+            auto first = lower_bound(u.begin(), u.end(), BindingUsage{ lo, 0, 0 }, UsageLess);
+            auto last = lower_bound(first, u.end(), BindingUsage{ hi + 1, 0, 0 }, UsageLess);
+            for (auto it = first; it != last; ++it) it->layout = (it->layout == lo) ? hi : lo;
+            sort(first, last, UsageLess);
+        }
+    }
+    notify(EDIT_REORDER_LAYOUT, idx, up);
+    idx = newidx;
+}
+
+void PipelineLayoutModel::cloneLayout(int idx, const char* name)
+{
+    if (!strlen(name)) return;
+    if (idx < 0 || idx >= (int) m_layouts.size()) return;
+    NameId id = m_names.intern(name);
+    if (findLayout(id) >= 0) return;
+    setInverse(EDIT_DEL_LAYOUT, (int32_t) m_layouts.size());
+    PipelineLayout copy = m_layouts[idx];
+    copy.name = id;
+    m_layouts.push_back(move(copy));
+    usageLayoutAdded();
+    uint32_t l = (uint32_t) m_layouts.size() - 1;
+    IndexAdded(m_layoutIndex, id, (int) l);
+    if (m_usageIndex.valid) {
+        // The copy comes last, so its entries go at the end of each list.
+        for (auto& dset: m_layouts[l].descsets) {
+            for (BindingHandle dl: dset.dlayouts) UsageSet(usages(dl), l, dset.index);
+        }
+    }
+    notify(EDIT_CLONE_LAYOUT, idx, 0, 0, 0, name);
+}
+
+void PipelineLayoutModel::addDescset(int layout, const char* name)
+{
+    if (!strlen(name)) return;
+    NameId id = m_names.intern(name);
+    if (findDescset(id) >= 0) return;
+    setInverse(EDIT_DEL_DESCSET, layout, (int32_t) m_dsets.size());
+    m_dsets.push_back(id);
+    IndexAdded(m_setIndex, m_dsets.back(), (int) m_dsets.size() - 1);
+    notify(EDIT_ADD_DESCSET, layout, 0, 0, 0, name);
+}
+
+void PipelineLayoutModel::delDescset(int layout, int idx)
+{
+    if (idx < 0 || idx >= (int) m_dsets.size()) return;
+    if (wantInverse()) {
+        lastSetPayload(idx, m_inverseText);
+        setInverse(EDIT_RESTORE_DESCSET, layout, idx, 0, 0, m_inverseText.c_str());
+    }
+    m_dsets.erase(idx);
+    m_setIndex.valid = false;
+    // The last set index goes away; only the layouts that use it are written to.
+    uint32_t last = (uint32_t) m_dsets.size();
+    for (int l = 0; l < (int) m_layouts.size(); l++) {
+        const DescriptorSet* dset = m_layouts[l].descsets.find(last);
+        if (!dset) continue;
+        if (m_usageIndex.valid) {
+            for (BindingHandle dl: dset->dlayouts) UsageClear(usages(dl), l, last);
+        }
+        m_layouts.edit(l).descsets.erase(last);
+    }
+    notify(EDIT_DEL_DESCSET, layout, idx);
+}
+
+void PipelineLayoutModel::renameDescset(int layout, int idx, const char * name)
+{
+    if (!strlen(name)) return;
+    if (idx < 0 || idx >= (int) m_dsets.size()) return;
+    NameId id = m_names.intern(name);
+    if (m_dsets[idx] == id) return;
+    setInverse(EDIT_RENAME_DESCSET, layout, idx, 0, 0, m_names.c_str(m_dsets[idx]));
+    IndexRenamed(m_setIndex, m_dsets[idx], id, idx);
+    m_dsets.edit(idx) = id;
+    notify(EDIT_RENAME_DESCSET, layout, idx, 0, 0, name);
+}
+
+void PipelineLayoutModel::reorderDescset(int layout, int& idx, bool up)
+{
+    if (idx < 0 || idx >= (int) m_dsets.size()) return;
+    int newidx = idx + (up ? -1 : 1);
+    if (newidx < 0 || newidx >= (int) m_dsets.size()) return;
+    setInverse(EDIT_REORDER_DESCSET, layout, newidx, !up);
+
+    m_dsets.swapAt(idx, newidx);
+    IndexSwapped(m_setIndex, m_dsets[idx], idx, m_dsets[newidx], newidx);
+
+    for (int l = 0; l < (int) m_layouts.size(); l++) {
+        if (!m_layouts[l].descsets.find(idx) && !m_layouts[l].descsets.find(newidx)) continue;
+        auto& pl = m_layouts.edit(l);
+        pl.descsets.swapSets(idx, newidx);
+        if (!m_usageIndex.valid) continue;
+        // The two sets traded contents: clear both bits of everything in them, then set them again.
+        auto& a = pl.descsets[idx].dlayouts;
+        auto& b = pl.descsets[newidx].dlayouts;
+        for (BindingHandle dl: a) UsageClear(usages(dl), l, newidx);
+        for (BindingHandle dl: b) UsageClear(usages(dl), l, idx);
+        for (BindingHandle dl: a) UsageSet(usages(dl), l, idx);
+        for (BindingHandle dl: b) UsageSet(usages(dl), l, newidx);
+    }
+
+    notify(EDIT_REORDER_DESCSET, layout, idx, up);
+    idx = newidx;
+}
+
+void PipelineLayoutModel::reorderDescsetlayout(int layout, int set, int& idx, bool up)
+{
+    if (layout < 0 || layout >= (int) m_layouts.size()) return;
+    auto& descsets = m_layouts[layout].descsets;
+    if (set < 0 || set >= (int) m_dsets.size()) return;
+    auto& dslayouts = descsets[set].dlayouts;
+    if (idx < 0 || idx >= (int) dslayouts.size()) return;
+    int newidx = idx + (up ? -1 : 1);
+    if (newidx < 0 || newidx >= (int) dslayouts.size()) return;
+    setInverse(EDIT_REORDER_DESCSETLAYOUT, layout, set, newidx, !up);
+    editSet(layout, set).swapAt(idx, newidx);
+    notify(EDIT_REORDER_DESCSETLAYOUT, layout, set, idx, up);
+    idx = newidx;
+}
+
+void PipelineLayoutModel::delDescsetlayout(int layout, int set, int idx)
+{
+    if (layout < 0 || layout >= (int) m_layouts.size()) return;
+    auto& descsets = m_layouts[layout].descsets;
+    if (set < 0 || set >= (int) m_dsets.size()) return;
+    auto& dslayouts = descsets[set].dlayouts;
+    if (idx < 0 || idx >= (int) dslayouts.size()) return;
+    setInverse(EDIT_INSERT_DESCSETLAYOUT, layout, set, idx, resolveBinding(dslayouts[idx]));
+    removeFromSet(layout, set, idx);
+    notify(EDIT_DEL_DESCSETLAYOUT, layout, set, idx);
+}
+
+void PipelineLayoutModel::addDescsetlayout(int layout, int set, int bindingIdx)
+{
+    if (layout < 0 || layout >= (int) m_layouts.size()) return;
+    auto& descsets = m_layouts[layout].descsets;
+    if (set < 0 || set >= (int) m_dsets.size()) return;
+    if (bindingIdx < 0 || bindingIdx >= (int) m_dlayouts.size()) return;
+    BindingHandle dl = m_dlayouts[bindingIdx]->handle;
+    auto& u = unsettledUsages(dl);
+    if (UsageTest(u, usageNumber(layout), set)) {
+        // No duplicates allowed.
+        return;
+    }
+    setInverse(EDIT_DEL_DESCSETLAYOUT, layout, set, (int32_t) descsets[set].dlayouts.size());
+    editSet(layout, set).push_back(dl);
+    UsageSet(u, usageNumber(layout), set);
+    notify(EDIT_ADD_DESCSETLAYOUT, layout, set, bindingIdx);
+}
+
+void PipelineLayoutModel::insertDescsetlayout(int layout, int set, int idx, int bindingIdx)
+{
+    if (layout < 0 || layout >= (int) m_layouts.size()) return;
+    auto& descsets = m_layouts[layout].descsets;
+    if (set < 0 || set >= (int) m_dsets.size()) return;
+    if (idx < 0 || idx > (int) descsets[set].dlayouts.size()) return;
+    if (bindingIdx < 0 || bindingIdx >= (int) m_dlayouts.size()) return;
+    BindingHandle dl = m_dlayouts[bindingIdx]->handle;
+    setInverse(EDIT_DEL_DESCSETLAYOUT, layout, set, idx);
+    editSet(layout, set).insert(idx, dl);
+    if (m_usageIndex.valid) UsageSet(unsettledUsages(dl), usageNumber(layout), set);
+    notify(EDIT_INSERT_DESCSETLAYOUT, layout, set, idx, bindingIdx);
+}
+
+void PipelineLayoutModel::addDesclayout(const char* name)
+{
+    if (!strlen(name)) return;
+    setInverse(EDIT_DEL_DESCLAYOUT, (int32_t) m_dlayouts.size());
+    appendBinding(makeBinding(m_names.intern(name)));
+    IndexAdded(m_bindingIndex, m_dlayouts.back()->name, (int) m_dlayouts.size() - 1);
+    notify(EDIT_ADD_DESCLAYOUT, 0, 0, 0, 0, name);
+}
+
+void PipelineLayoutModel::delDesclayout(int idx)
+{
+    if (idx < 0 || idx >= (int) m_dlayouts.size()) return;
+    if (wantInverse()) {
+        bindingPayload(idx, m_inverseText);
+        setInverse(EDIT_RESTORE_DESCLAYOUT, idx, 0, 0, 0, m_inverseText.c_str());
+    }
+
+    // Only the sets that list the binding are visited. Its slot is freed, which is what makes any
+    // handle to it held elsewhere stale, and the bindings after it move up a place.
+    BindingHandle dl = m_dlayouts[idx]->handle;
+    auto& u = unsettledUsages(dl);
+    for (auto& entry: u) {
+        int layout = usageLayout(entry.layout);
+        for (uint64_t bits = entry.sets; bits; bits &= bits - 1) {
+            int set = entry.word * 64 + CountTrailingZeros(bits);
+            editSet(layout, set).eraseIf([dl](BindingHandle h) { return h == dl; });
+            pruneSet(layout, set);
+        }
+    }
+    u.clear();
+    m_slots.release(dl);
+
+    m_dlayouts.erase(idx);
+    for (int i = idx; i < (int) m_dlayouts.size(); i++) m_slots.moved(m_dlayouts[i]->handle, i);
+    // Like the usage index in delLayout(): in a transaction, rebuilt once rather than shifted every time.
+    if (m_transaction.depth) m_columns.valid = false;
+    if (m_columns.valid) {
+        m_columns.types.erase(m_columns.types.begin() + idx);
+        m_columns.stages.erase(m_columns.stages.begin() + idx);
+    }
+    m_bindingIndex.valid = false;
+    notify(EDIT_DEL_DESCLAYOUT, idx);
+}
+
+void PipelineLayoutModel::renameDesclayout(int idx, const char* name)
+{
+    if (!strlen(name)) return;
+    if (idx < 0 || idx >= (int) m_dlayouts.size()) return;
+    NameId id = m_names.intern(name);
+    if (m_dlayouts[idx]->name == id) return;
+    setInverse(EDIT_RENAME_DESCLAYOUT, idx, 0, 0, 0, m_names.c_str(m_dlayouts[idx]->name));
+    IndexRenamed(m_bindingIndex, m_dlayouts[idx]->name, id, idx);
+    editBinding(idx).name = id;
+    notify(EDIT_RENAME_DESCLAYOUT, idx, 0, 0, 0, name);
+}
+
+void PipelineLayoutModel::reorderDesclayout(int& idx, bool up)
+{
+    if (idx < 0 || idx >= (int) m_dlayouts.size()) return;
+    int newidx = idx + (up ? -1 : 1);
+    if (newidx < 0 || newidx >= (int) m_dlayouts.size()) return;
+    setInverse(EDIT_REORDER_DESCLAYOUT, newidx, !up);
+    m_dlayouts.swapAt(idx, newidx);
+    m_slots.moved(m_dlayouts[idx]->handle, idx);
+    m_slots.moved(m_dlayouts[newidx]->handle, newidx);
+    if (m_columns.valid) {
+        swap(m_columns.types[idx], m_columns.types[newidx]);
+        swap(m_columns.stages[idx], m_columns.stages[newidx]);
+    }
+    IndexSwapped(m_bindingIndex, m_dlayouts[idx]->name, idx, m_dlayouts[newidx]->name, newidx);
+    notify(EDIT_REORDER_DESCLAYOUT, idx, up);
+    idx = newidx;
+}
+
+void PipelineLayoutModel::setDesclayoutType(int idx, int typeIdx)
+{
+    if (idx < 0 || idx >= (int) m_dlayouts.size()) return;
+    if (m_dlayouts[idx]->typeIdx == typeIdx) return;
+    setInverse(EDIT_SET_DESCLAYOUT_TYPE, idx, m_dlayouts[idx]->typeIdx);
+    editBinding(idx).typeIdx = typeIdx;
+    if (m_columns.valid) m_columns.types[idx] = typeIdx;
+    notify(EDIT_SET_DESCLAYOUT_TYPE, idx, typeIdx);
+}
+
+void PipelineLayoutModel::setDesclayoutStages(int idx, uint32_t stageFlagBits)
+{
+    if (idx < 0 || idx >= (int) m_dlayouts.size()) return;
+    if (m_dlayouts[idx]->stageFlagBits == stageFlagBits) return;
+    setInverse(EDIT_SET_DESCLAYOUT_STAGES, idx, (int32_t) m_dlayouts[idx]->stageFlagBits);
+    editBinding(idx).stageFlagBits = stageFlagBits;
+    if (m_columns.valid) m_columns.stages[idx] = stageFlagBits;
+    notify(EDIT_SET_DESCLAYOUT_STAGES, idx, (int32_t) stageFlagBits);
+}
+
+int PipelineLayoutModel::updateBindingStages(uint32_t typeMask, uint32_t stageMask, uint32_t setBits, uint32_t clearBits)
+{
+    auto& cols = columns();
+    vector<int> changed;
+    UpdateBindingStages(cols.types.data(), cols.stages.data(), cols.stages.size(), typeMask, stageMask, setBits,
+                        clearBits, changed);
+    if (changed.empty()) return 0;
+    // The column has the new stages already; the bindings still hold the old ones for the inverse.
+    if (wantInverse()) {
+        bindingStagesPayload(changed, m_inverseText);
+        setInverse(EDIT_RESTORE_BINDING_STAGES, 0, 0, 0, 0, m_inverseText.c_str());
+    }
+    for (int idx: changed) editBinding(idx).stageFlagBits = cols.stages[idx];
+    notify(EDIT_UPDATE_BINDING_STAGES, (int32_t) typeMask, (int32_t) stageMask, (int32_t) setBits, (int32_t) clearBits);
+    return (int) changed.size();
+}
+
+void PipelineLayoutModel::setDesclayoutData(int idx, const char* data)
+{
+    if (idx < 0 || idx >= (int) m_dlayouts.size()) return;
+    if (m_dlayouts[idx]->data == data) return;
+    if (wantInverse()) {
+        m_dlayouts[idx]->data.decode(m_inverseText);
+        setInverse(EDIT_SET_DESCLAYOUT_DATA, idx, 0, 0, 0, m_inverseText.c_str());
+    }
+    editBinding(idx).data = data;
+    notify(EDIT_SET_DESCLAYOUT_DATA, idx, 0, 0, 0, data);
+}
+
+void PipelineLayoutModel::setDesclayoutComment(int idx, const char* comment)
+{
+    if (idx < 0 || idx >= (int) m_dlayouts.size()) return;
+    if (m_dlayouts[idx]->comment == comment) return;
+    if (wantInverse()) {
+        m_dlayouts[idx]->comment.decode(m_inverseText);
+        setInverse(EDIT_SET_DESCLAYOUT_COMMENT, idx, 0, 0, 0, m_inverseText.c_str());
+    }
+    editBinding(idx).comment = comment;
+    notify(EDIT_SET_DESCLAYOUT_COMMENT, idx, 0, 0, 0, comment);
+}
+
+// -------------------------------------------------------- Edit notification & replay -----------------------------------------------
+
+int ModelEditNumArgs(ModelEditOp op)
+{
+    switch (op) {
+    case EDIT_ADD_LAYOUT: return 0;
+    case EDIT_DEL_LAYOUT: return 1;
+    case EDIT_RENAME_LAYOUT: return 1;
+    case EDIT_REORDER_LAYOUT: return 2;
+    case EDIT_ADD_DESCSET: return 1;
+    case EDIT_DEL_DESCSET: return 2;
+    case EDIT_RENAME_DESCSET: return 2;
+    case EDIT_REORDER_DESCSET: return 3;
+    case EDIT_REORDER_DESCSETLAYOUT: return 4;
+    case EDIT_DEL_DESCSETLAYOUT: return 3;
+    case EDIT_ADD_DESCSETLAYOUT: return 3;
+    case EDIT_ADD_DESCLAYOUT: return 0;
+    case EDIT_DEL_DESCLAYOUT: return 1;
+    case EDIT_RENAME_DESCLAYOUT: return 1;
+    case EDIT_REORDER_DESCLAYOUT: return 2;
+    case EDIT_SET_DESCLAYOUT_TYPE: return 2;
+    case EDIT_SET_DESCLAYOUT_STAGES: return 2;
+    case EDIT_SET_DESCLAYOUT_DATA: return 1;
+    case EDIT_SET_DESCLAYOUT_COMMENT: return 1;
+    case EDIT_CLONE_LAYOUT: return 1;
+    case EDIT_RESTORE_LAYOUT: return 1;
+    case EDIT_RESTORE_DESCSET: return 2;
+    case EDIT_RESTORE_DESCLAYOUT: return 1;
+    case EDIT_INSERT_DESCSETLAYOUT: return 4;
+    case EDIT_UPDATE_BINDING_STAGES: return 4;
+    case EDIT_RESTORE_BINDING_STAGES: return 0;
+    default: return -1;
+    }
+}
+
+bool ModelEditHasText(ModelEditOp op)
+{
+    switch (op) {
+    case EDIT_ADD_LAYOUT:
+    case EDIT_RENAME_LAYOUT:
+    case EDIT_ADD_DESCSET:
+    case EDIT_RENAME_DESCSET:
+    case EDIT_ADD_DESCLAYOUT:
+    case EDIT_RENAME_DESCLAYOUT:
+    case EDIT_SET_DESCLAYOUT_DATA:
+    case EDIT_SET_DESCLAYOUT_COMMENT:
+    case EDIT_CLONE_LAYOUT:
+    case EDIT_RESTORE_LAYOUT:
+    case EDIT_RESTORE_DESCSET:
+    case EDIT_RESTORE_DESCLAYOUT:
+    case EDIT_RESTORE_BINDING_STAGES:
+        return true;
+    default:
+        return false;
+    }
+}
+
+int ModelEditTargetArgs(ModelEditOp op)
+{
+    switch (op) {
+    case EDIT_RENAME_LAYOUT:
+    case EDIT_RENAME_DESCLAYOUT:
+    case EDIT_SET_DESCLAYOUT_TYPE:
+    case EDIT_SET_DESCLAYOUT_STAGES:
+    case EDIT_SET_DESCLAYOUT_DATA:
+    case EDIT_SET_DESCLAYOUT_COMMENT:
+        return 1;
+    case EDIT_RENAME_DESCSET:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+void PipelineLayoutModel::notify(ModelEditOp op, int32_t a, int32_t b, int32_t c, int32_t d, const char* text)
+{
+    ModelEdit edit = { op, { a, b, c, d }, text };
+    ModelEdit inverse = m_inverse;
+    m_inverse.op = (ModelEditOp) 0;
+    if (m_transaction.aborting) return;
+    if (m_undo && inverse.op) m_undo->onEdit(edit, inverse);
+    if (m_transaction.depth) {
+        holdEdit(edit, inverse);
+        return;
+    }
+    for (auto* listener: m_listeners) {
+        listener->onEdit(edit);
+    }
+}
+
+static bool SameTarget(const ModelEdit& x, const ModelEdit& y, int numArgs)
+{
+    if (x.op != y.op) return false;
+    for (int i = 0; i < numArgs; i++) {
+        if (x.args[i] != y.args[i]) return false;
+    }
+    return true;
+}
+
+void PipelineLayoutModel::holdEdit(const ModelEdit& edit, const ModelEdit& inverse)
+{
+    auto& t = m_transaction;
+    auto hold = [](vector<HeldEdit>& list, const ModelEdit& e) { list.push_back({ e, e.text ? e.text : "" }); };
+    if (inverse.op) hold(t.inverses, inverse);
+    if (m_listeners.empty()) return;
+    // A set / rename edit supersedes the last one of its target, unless something that moves things
+    // came in between. Keys may collide; the edits themselves decide.
+    int numArgs = ModelEditTargetArgs(edit.op);
+    if (!numArgs) {
+        t.targets.clear();
+    } else {
+        uint64_t key = ((uint64_t) edit.op << 56) ^ ((uint64_t) (uint32_t) edit.args[0] << 24) ^
+                       (numArgs > 1 ? (uint32_t) edit.args[1] : 0);
+        auto it = t.targets.find(key);
+        if (it != t.targets.end() && SameTarget(t.edits[it->second].edit, edit, numArgs)) {
+            t.edits[it->second].edit.op = (ModelEditOp) 0;
+        }
+        t.targets[key] = t.edits.size();
+    }
+    hold(t.edits, edit);
+}
+
+void PipelineLayoutModel::beginTransaction(void)
+{
+    if (m_transaction.depth++) return;
+    if (m_undo) m_undo->beginGroup();
+}
+
+void PipelineLayoutModel::commitTransaction(void)
+{
+    if (!m_transaction.depth || --m_transaction.depth) return;
+    if (m_undo) m_undo->endGroup();
+    vector<HeldEdit> held;
+    held.swap(m_transaction.edits);
+    m_transaction = Transaction();
+
+    ModelChangeSet changes;
+    changes.edits.reserve(held.size());
+    for (auto& h: held) {
+        if (!h.edit.op) continue;
+        if (h.edit.text) h.edit.text = h.text.c_str();
+        changes.edits.push_back(h.edit);
+    }
+    if (changes.edits.empty()) return;
+    for (auto* listener: m_listeners) {
+        listener->onChangeSet(changes);
+    }
+}
+
+void PipelineLayoutModel::abortTransaction(void)
+{
+    if (!m_transaction.depth) return;
+    vector<HeldEdit> inverses;
+    inverses.swap(m_transaction.inverses);
+    m_transaction.aborting = true;
+    try {
+        for (size_t i = inverses.size(); i-- > 0;) {
+            auto& e = inverses[i].edit;
+            if (e.text) e.text = inverses[i].text.c_str();
+            applyEdit(e);
+        }
+    } catch (...) {
+        // Half rolled back: nothing known about the model holds any more.
+        invalidateIndexes();
+        throw;
+    }
+    m_transaction = Transaction();
+    if (m_undo) m_undo->discardGroup();
+}
+
+void PipelineLayoutModel::applyEdit(const ModelEdit& e)
+{
+    int idx;
+    const char* text = e.text ? e.text : "";
+    switch (e.op) {
+    case EDIT_ADD_LAYOUT: addLayout(text); break;
+    case EDIT_DEL_LAYOUT: delLayout(e.args[0]); break;
+    case EDIT_RENAME_LAYOUT: renameLayout(e.args[0], text); break;
+    case EDIT_REORDER_LAYOUT: idx = e.args[0]; reorderLayout(idx, e.args[1] != 0); break;
+    case EDIT_ADD_DESCSET: addDescset(e.args[0], text); break;
+    case EDIT_DEL_DESCSET: delDescset(e.args[0], e.args[1]); break;
+    case EDIT_RENAME_DESCSET: renameDescset(e.args[0], e.args[1], text); break;
+    case EDIT_REORDER_DESCSET: idx = e.args[1]; reorderDescset(e.args[0], idx, e.args[2] != 0); break;
+    case EDIT_REORDER_DESCSETLAYOUT: idx = e.args[2]; reorderDescsetlayout(e.args[0], e.args[1], idx, e.args[3] != 0); break;
+    case EDIT_DEL_DESCSETLAYOUT: delDescsetlayout(e.args[0], e.args[1], e.args[2]); break;
+    case EDIT_ADD_DESCSETLAYOUT: addDescsetlayout(e.args[0], e.args[1], e.args[2]); break;
+    case EDIT_ADD_DESCLAYOUT: addDesclayout(text); break;
+    case EDIT_DEL_DESCLAYOUT: delDesclayout(e.args[0]); break;
+    case EDIT_RENAME_DESCLAYOUT: renameDesclayout(e.args[0], text); break;
+    case EDIT_REORDER_DESCLAYOUT: idx = e.args[0]; reorderDesclayout(idx, e.args[1] != 0); break;
+    case EDIT_SET_DESCLAYOUT_TYPE: setDesclayoutType(e.args[0], e.args[1]); break;
+    case EDIT_SET_DESCLAYOUT_STAGES: setDesclayoutStages(e.args[0], (uint32_t) e.args[1]); break;
+    case EDIT_SET_DESCLAYOUT_DATA: setDesclayoutData(e.args[0], text); break;
+    case EDIT_SET_DESCLAYOUT_COMMENT: setDesclayoutComment(e.args[0], text); break;
+    case EDIT_CLONE_LAYOUT: cloneLayout(e.args[0], text); break;
+    case EDIT_RESTORE_LAYOUT: restoreLayout(e.args[0], text); break;
+    case EDIT_RESTORE_DESCSET: restoreDescset(e.args[0], e.args[1], text); break;
+    case EDIT_RESTORE_DESCLAYOUT: restoreDesclayout(e.args[0], text); break;
+    case EDIT_INSERT_DESCSETLAYOUT: insertDescsetlayout(e.args[0], e.args[1], e.args[2], e.args[3]); break;
+    case EDIT_UPDATE_BINDING_STAGES:
+        updateBindingStages((uint32_t) e.args[0], (uint32_t) e.args[1], (uint32_t) e.args[2], (uint32_t) e.args[3]);
+        break;
+    case EDIT_RESTORE_BINDING_STAGES: restoreBindingStages(text); break;
+    default: throw std::runtime_error("Unknown edit.");
+    }
+}
+
+void PipelineLayoutModel::setInverse(ModelEditOp op, int32_t a, int32_t b, int32_t c, int32_t d, const char* text)
+{
+    if (!wantInverse()) return;
+    // text may already be m_inverseText.
+    if (text != m_inverseText.c_str()) m_inverseText = text ? text : "";
+    m_inverse = { op, { a, b, c, d }, text ? m_inverseText.c_str() : nullptr };
+}
+
+void PipelineLayoutModel::addEditListener(ModelEditListener* listener)
+{
+    if (find(m_listeners.begin(), m_listeners.end(), listener) == m_listeners.end()) {
+        m_listeners.push_back(listener);
+    }
+}
+
+void PipelineLayoutModel::removeEditListener(ModelEditListener* listener)
+{
+    m_listeners.erase(remove(m_listeners.begin(), m_listeners.end(), listener), m_listeners.end());
+}
+
+int PipelineLayoutModel::findLayout(NameId name) const
+{
+    return IndexFind(m_layoutIndex, m_names.count(), m_layouts.size(), [this](size_t i) { return m_layouts[i].name; }, name);
+}
+
+int PipelineLayoutModel::findDescset(NameId name) const
+{
+    return IndexFind(m_setIndex, m_names.count(), m_dsets.size(), [this](size_t i) { return m_dsets[i]; }, name);
+}
+
+int PipelineLayoutModel::findDesclayout(NameId name) const
+{
+    return IndexFind(m_bindingIndex, m_names.count(), m_dlayouts.size(), [this](size_t i) { return m_dlayouts[i]->name; }, name);
+}
+
+// Names that were never interned cannot be in any list.
+int PipelineLayoutModel::findLayout(const std::string& name) const
+{
+    NameId id = m_names.find(name);
+    return id == NAME_NONE ? -1 : findLayout(id);
+}
+
+int PipelineLayoutModel::findDescset(const std::string& name) const
+{
+    NameId id = m_names.find(name);
+    return id == NAME_NONE ? -1 : findDescset(id);
+}
+
+int PipelineLayoutModel::findDesclayout(const std::string& name) const
+{
+    NameId id = m_names.find(name);
+    return id == NAME_NONE ? -1 : findDesclayout(id);
+}
+
+const DescriptorLayout* PipelineLayoutModel::findDescLayoutByName(const std::string name)
+{
+    int idx = findDesclayout(name);
+    if (idx < 0) {
+        throw std::runtime_error("Could not find layout by name.");
+    }
+    return m_dlayouts[idx].get();
+}
+
+int PipelineLayoutModel::findDescLayoutByPtr(const DescriptorLayout* dlayout) const
+{
+    // By handle, not address: editing a binding a snapshot shares swaps in a copy, which keeps it.
+    int idx = dlayout ? m_slots.find(dlayout->handle) : -1;
+    if (idx < 0) {
+        throw std::runtime_error("Could not find layout by ptr.");
+    }
+    return idx;
+}
+
+int PipelineLayoutModel::resolveBinding(BindingHandle h) const
+{
+    int idx = m_slots.find(h);
+    if (idx < 0) {
+        throw std::runtime_error("Dangling binding handle.");
+    }
+    return idx;
+}
+
+CowVector<BindingHandle>& PipelineLayoutModel::findDLV(int layout, const std::string name)
+{
+    if (layout < 0 || layout >= (int) m_layouts.size()) {
+        throw std::runtime_error("invalid layout.");
+    }
+
+    int idx = findDescset(name);
+    if (idx == -1) {
+        throw std::runtime_error("invalid name.");
+    }
+
+    assert(m_layouts[layout].descsets.extent() <= m_dsets.size());
+    return editSet(layout, idx);
+}
+
+void PipelineLayoutModel::getDLGetSetList(int layout, const DescriptorLayout* dl, vector<bool>& out)
+{
+    assert(dl);
+    if (layout < 0 || layout >= (int) m_layouts.size()) {
+        throw std::runtime_error("invalid layout.");
+    }
+    assert(m_layouts[layout].descsets.extent() <= m_dsets.size());
+    assert(out.size() == m_dsets.size());
+    fill(out.begin(), out.end(), false);
+    if (m_slots.find(dl->handle) < 0) return;
+    auto& u = usages(dl->handle);
+    for (auto e = lower_bound(u.begin(), u.end(), BindingUsage{ (uint32_t) layout, 0, 0 }, UsageLess);
+         e != u.end() && e->layout == (uint32_t) layout; ++e) {
+        for (uint64_t bits = e->sets; bits; bits &= bits - 1) {
+            size_t set = e->word * 64 + CountTrailingZeros(bits);
+            if (set < out.size()) out[set] = true;
+        }
+    }
+}
+
+void PipelineLayoutModel::getDLSetSetList(int layout, const DescriptorLayout* dl, vector<bool>& in)
+{
+    assert(dl);
+    if (layout < 0 || layout >= (int) m_layouts.size()) {
+        throw std::runtime_error("invalid layout.");
+    }
+    assert(m_layouts[layout].descsets.extent() <= m_dsets.size());
+    assert(in.size() == m_dsets.size());
+    for (int i = 0; i < (int) m_dsets.size(); i++) {
+        bool found = isInSet(dl, layout, i);
+        auto& dlayouts = m_layouts[layout].descsets[i].dlayouts;
+        if (found && !in[i]) {
+            // Removed.
+            int foundIdx = (int) dlayouts.size() - 1;
+            while (dlayouts[foundIdx] != dl->handle) foundIdx--;
+            if (wantInverse()) setInverse(EDIT_INSERT_DESCSETLAYOUT, layout, i, foundIdx, resolveBinding(dl->handle));
+            removeFromSet(layout, i, foundIdx);
+            notify(EDIT_DEL_DESCSETLAYOUT, layout, i, foundIdx);
+        }
+        if (!found && in[i]) {
+            // Added.
+            setInverse(EDIT_DEL_DESCSETLAYOUT, layout, i, (int32_t) dlayouts.size());
+            editSet(layout, i).push_back(dl->handle);
+            UsageSet(usages(dl->handle), layout, i);
+            if (!m_listeners.empty() || wantInverse()) notify(EDIT_ADD_DESCSETLAYOUT, layout, i, findDescLayoutByPtr(dl));
+        }
+    }
+}
+
+void PipelineLayoutModel::findUsages(const DescriptorLayout* dl, std::vector< std::pair<int, int> >& out) const
+{
+    out.clear();
+    if (m_slots.find(dl->handle) < 0) return;
+    for (auto& u: usages(dl->handle)) {
+        for (uint64_t bits = u.sets; bits; bits &= bits - 1) {
+            out.push_back(make_pair((int) u.layout, (int) (u.word * 64 + CountTrailingZeros(bits))));
+        }
+    }
+}
+
+bool PipelineLayoutModel::isInSet(const DescriptorLayout* dl, int layout, int set) const
+{
+    if (layout < 0 || set < 0 || m_slots.find(dl->handle) < 0) return false;
+    return UsageTest(usages(dl->handle), layout, set);
+}
+
+void PipelineLayoutModel::filterBindings(uint32_t typeMask, uint32_t stageMask, std::vector<int>& out) const
+{
+    auto& cols = columns();
+    FilterBindings(cols.types.data(), cols.stages.data(), cols.stages.size(), typeMask, stageMask, out);
+}
+
+void PipelineLayoutModel::blobUsage(size_t& decodedBytes, size_t& storedBytes) const
+{
+    decodedBytes = storedBytes = 0;
+    for (auto& dl: m_dlayouts) {
+        decodedBytes += dl->data.size() + dl->comment.size();
+        storedBytes += dl->data.storedBytes() + dl->comment.storedBytes();
+    }
+}
+
+bool PipelineLayoutModel::validate(std::vector<std::string>& errors) const
+{
+    size_t numErrors = errors.size();
+    auto name = [this](NameId id) { return m_names.str(id); };
+
+    vector<bool> seen(m_names.count(), false);
+    for (int i = 0; i < (int) m_dlayouts.size(); i++) {
+        auto* dl = m_dlayouts[i].get();
+        if (!dl) {
+            errors.push_back("binding " + to_string(i) + " is null.");
+            continue;
+        }
+        if (m_slots.find(dl->handle) != i) {
+            errors.push_back("binding " + to_string(i) + " has a stale handle.");
+        }
+        if (m_names.empty(dl->name)) {
+            errors.push_back("binding " + to_string(i) + " has an empty name.");
+        }
+        if (seen[dl->name]) {
+            errors.push_back("binding '" + name(dl->name) + "' is defined more than once.");
+        }
+        seen[dl->name] = true;
+        if (dl->typeIdx < 0 || dl->typeIdx >= (int) descLayoutTypes.size()) {
+            errors.push_back("binding '" + name(dl->name) + "' has invalid type " + to_string(dl->typeIdx) + ".");
+        }
+        if (dl->stageFlagBits & ~((1u << stageBits.size()) - 1)) {
+            errors.push_back("binding '" + name(dl->name) + "' has unknown stage flag bits.");
+        }
+    }
+
+    seen.assign(m_names.count(), false);
+    for (NameId dset: m_dsets) {
+        if (m_names.empty(dset)) {
+            errors.push_back("descriptor set with an empty name.");
+        }
+        if (seen[dset]) {
+            errors.push_back("descriptor set '" + name(dset) + "' is defined more than once.");
+        }
+        seen[dset] = true;
+    }
+
+    seen.assign(m_names.count(), false);
+    for (auto& pl: m_layouts) {
+        if (seen[pl.name]) {
+            errors.push_back("pipeline layout '" + name(pl.name) + "' is defined more than once.");
+        }
+        seen[pl.name] = true;
+        if (pl.descsets.extent() > m_dsets.size()) {
+            errors.push_back("pipeline layout '" + name(pl.name) + "' uses set " + to_string(pl.descsets.extent() - 1) +
+                             ", only " + to_string(m_dsets.size()) + " are defined.");
+        }
+        for (auto& dset: pl.descsets) {
+            int s = (int) dset.index;
+            if (dset.dlayouts.empty()) {
+                errors.push_back("pipeline layout '" + name(pl.name) + "' stores set " + to_string(s) + " empty.");
+            }
+            unordered_set<BindingHandle> listed;
+            for (BindingHandle dl: dset.dlayouts) {
+                int idx = m_slots.find(dl);
+                if (idx < 0 || !m_dlayouts[idx]) {
+                    errors.push_back("pipeline layout '" + name(pl.name) + "' set " + to_string(s) + " references a dangling binding.");
+                } else if (!listed.insert(dl).second) {
+                    errors.push_back("pipeline layout '" + name(pl.name) + "' set " + to_string(s) +
+                                     " references binding '" + name(m_dlayouts[idx]->name) + "' more than once.");
+                }
+            }
+        }
+    }
+
+    return errors.size() == numErrors;
+}
+
+bool PipelineLayoutModel::isBinaryFileName(const std::string& fileName)
+{
+    return EndsWith(fileName, ".vkpipeline.bin");
+}
+
+std::string PipelineLayoutModel::normalizeFileName(std::string fileName)
+{
+    if (!EndsWith(fileName, ".vkpipeline.json") && !isBinaryFileName(fileName)) {
+        if (EndsWith(fileName, ".vkpipeline")) {
+            fileName += ".json";
+        } else {
+            fileName += ".vkpipeline.json";
+        }
+    }
+    return fileName;
+}
+
+void PipelineLayoutModel::serializeDom(std::string& out) const
+{
+    Json::Value value;
+    value["num_layouts"] = m_layouts.size();
+    for (auto& playout: m_layouts) {
+        Json::Value vplayout;
+        vplayout["name"] = m_names.str(playout.name);
+        // Every set is written, the ones the layout does not use as empty.
+        for (uint32_t setIdx = 0; setIdx < m_dsets.size(); setIdx++) {
+            Json::Value vdset;
+            vdset["set_index"] = setIdx;
+            for (auto& dl : playout.descsets[setIdx].dlayouts) {
+                Json::Value vdl = resolveBinding(dl);
+                vdset["desc_layouts"].append(vdl);
+            }
+            vplayout["desc_sets"].append(vdset);
+        }
+        value["layouts"].append(vplayout);
+    }
+    value["num_sets"] = m_dsets.size();
+    for (NameId dset: m_dsets) {
+        Json::Value vdset;
+        vdset = m_names.str(dset);
+        value["sets"].append(vdset);
+    }
+    value["num_bindings"] = m_dlayouts.size();
+    for (auto& binding: m_dlayouts) {
+        Json::Value vbinding;
+        vbinding["name"] = m_names.str(binding->name);
+        vbinding["type"] = binding->typeIdx;
+        vbinding["typeName"] = TypeName(binding->typeIdx);
+        vbinding["data"] = binding->data.str();
+        vbinding["comment"] = binding->comment.str();
+        vbinding["stageFlagBits"] = binding->stageFlagBits;
+        value["bindings"].append(vbinding);
+    }
+
+    ostringstream oss;
+    Json::StyledStreamWriter writer;
+    writer.write(oss, value);
+    out = oss.str();
+}
+
+void PipelineLayoutModel::setFileFormat(int format)
+{
+    if (format != PROJECT_FORMAT_INDEXED && format != PROJECT_FORMAT_NAMED) {
+        throw std::runtime_error("Unsupported project format " + to_string(format) + ".");
+    }
+    m_fileFormat = format;
+}
+
+void PipelineLayoutModel::serialize(JsonStreamWriter& writer) const
+{
+    if (m_fileFormat == PROJECT_FORMAT_NAMED && hasUniqueNames()) {
+        serializeNamed(writer);
+    } else {
+        serializeIndexed(writer);
+    }
+}
+
+// Keys are emitted in the sorted order Json::Value uses, so the pretty form matches serializeDom().
+void PipelineLayoutModel::serializeIndexed(JsonStreamWriter& writer) const
+{
+    string text;
+    writer.beginObject();
+    if (!m_dlayouts.empty()) {
+        writer.key("bindings");
+        writer.beginArray();
+        for (auto& binding: m_dlayouts) {
+            writer.beginObject();
+            writer.key("comment");
+            binding->comment.decode(text);
+            writer.value(text);
+            writer.key("data");
+            binding->data.decode(text);
+            writer.value(text);
+            writer.key("name");
+            WriteName(writer, m_names, binding->name);
+            writer.key("stageFlagBits");
+            writer.value(binding->stageFlagBits);
+            writer.key("type");
+            writer.value(binding->typeIdx);
+            writer.key("typeName");
+            writer.value(TypeName(binding->typeIdx));
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+    if (!m_layouts.empty()) {
+        writer.key("layouts");
+        writer.beginArray();
+        for (auto& playout: m_layouts) {
+            writer.beginObject();
+            if (!m_dsets.empty()) {
+                writer.key("desc_sets");
+                writer.beginArray();
+                for (uint32_t setIdx = 0; setIdx < m_dsets.size(); setIdx++) {
+                    auto& dset = playout.descsets[setIdx];
+                    writer.beginObject();
+                    if (!dset.dlayouts.empty()) {
+                        writer.key("desc_layouts");
+                        writer.beginArray();
+                        for (BindingHandle dl: dset.dlayouts) writer.value(resolveBinding(dl));
+                        writer.endArray();
+                    }
+                    writer.key("set_index");
+                    writer.value(setIdx);
+                    writer.endObject();
+                }
+                writer.endArray();
+            }
+            writer.key("name");
+            WriteName(writer, m_names, playout.name);
+            writer.endObject();
+        }
+        writer.endArray();
+    }
+    writer.key("num_bindings");
+    writer.value((uint64_t) m_dlayouts.size());
+    writer.key("num_layouts");
+    writer.value((uint64_t) m_layouts.size());
+    writer.key("num_sets");
+    writer.value((uint64_t) m_dsets.size());
+    if (!m_dsets.empty()) {
+        writer.key("sets");
+        writer.beginArray();
+        for (NameId dset: m_dsets) WriteName(writer, m_names, dset);
+        writer.endArray();
+    }
+    writer.endObject();
+    writer.finish();
+}
+
+// Whether names can stand in for positions: PROJECT_FORMAT_NAMED has no way to tell apart two
+// bindings, sets or layouts of the same name, nor to write a set that is not in m_dsets.
+bool PipelineLayoutModel::hasUniqueNames(void) const
+{
+    vector<bool> seen(m_names.count(), false);
+    for (auto& dl: m_dlayouts) {
+        if (seen[dl->name]) return false;
+        seen[dl->name] = true;
+    }
+    seen.assign(m_names.count(), false);
+    for (NameId s: m_dsets) {
+        if (seen[s]) return false;
+        seen[s] = true;
+    }
+    seen.assign(m_names.count(), false);
+    for (auto& pl: m_layouts) {
+        if (seen[pl.name] || pl.descsets.extent() > m_dsets.size()) return false;
+        seen[pl.name] = true;
+    }
+    return true;
+}
+
+template <typename T, typename Name>
+static vector<const T*> SortedByName(const CowVector<T>& items, const NamePool& names, Name name)
+{
+    vector<const T*> sorted;
+    sorted.reserve(items.size());
+    for (auto& item: items) sorted.push_back(&item);
+    sort(sorted.begin(), sorted.end(), [&](const T* a, const T* b) { return names.less(name(*a), name(*b)); });
+    return sorted;
+}
+
+void PipelineLayoutModel::serializeNamed(JsonStreamWriter& writer) const
+{
+    auto bindingName = [](const DescriptorLayoutPtr& dl) { return dl->name; };
+
+    writer.beginObject();
+    writer.key("format");
+    writer.value(PROJECT_FORMAT_NAMED);
+
+    writer.key("order");
+    writer.beginObject();
+    writer.key("bindings");
+    writer.beginArray();
+    for (auto& dl: m_dlayouts) WriteName(writer, m_names, dl->name);
+    writer.endArray();
+    writer.key("layouts");
+    writer.beginArray();
+    for (auto& pl: m_layouts) WriteName(writer, m_names, pl.name);
+    writer.endArray();
+    writer.key("sets");
+    writer.beginArray();
+    for (NameId s: m_dsets) WriteName(writer, m_names, s);
+    writer.endArray();
+    writer.endObject();
+
+    // Sets in name order within each layout, so that reordering them leaves this section alone.
+    vector<int> setOrder(m_dsets.size());
+    for (int i = 0; i < (int) setOrder.size(); i++) setOrder[i] = i;
+    sort(setOrder.begin(), setOrder.end(), [this](int a, int b) { return m_names.less(m_dsets[a], m_dsets[b]); });
+
+    writer.key("layouts");
+    writer.beginObject();
+    for (auto* pl: SortedByName(m_layouts, m_names, [](const PipelineLayout& l) { return l.name; })) {
+        WriteKey(writer, m_names, pl->name);
+        writer.beginObject();
+        for (int s: setOrder) {
+            if (pl->descsets[s].dlayouts.empty()) continue;
+            WriteKey(writer, m_names, m_dsets[s]);
+            writer.beginArray();
+            for (BindingHandle dl: pl->descsets[s].dlayouts) WriteName(writer, m_names, m_dlayouts[resolveBinding(dl)]->name);
+            writer.endArray();
+        }
+        writer.endObject();
+    }
+    writer.endObject();
+
+    string text;
+    writer.key("bindings");
+    writer.beginObject();
+    for (auto* binding: SortedByName(m_dlayouts, m_names, bindingName)) {
+        auto& dl = **binding;
+        WriteKey(writer, m_names, dl.name);
+        writer.beginObject();
+        writer.key("comment");
+        dl.comment.decode(text);
+        writer.value(text);
+        writer.key("data");
+        dl.data.decode(text);
+        writer.value(text);
+        writer.key("stageFlagBits");
+        writer.value(dl.stageFlagBits);
+        writer.key("type");
+        writer.value(dl.typeIdx);
+        writer.key("typeName");
+        writer.value(TypeName(dl.typeIdx));
+        writer.endObject();
+    }
+    writer.endObject();
+
+    writer.endObject();
+    writer.finish();
+}
+
+void PipelineLayoutModel::serialize(std::string& out, JsonStreamWriter::Style style) const
+{
+    out.clear();
+    JsonStreamWriter writer(out, style);
+    serialize(writer);
+}
+
+void PipelineLayoutModel::snapshot(PipelineLayoutSnapshot& out) const
+{
+    out.layouts = m_layouts;
+    out.dlayouts = m_dlayouts;
+    out.dsets = m_dsets;
+    out.names = m_names;
+    out.slots = m_slots;
+    out.filename = m_filename;
+    out.fileFormat = m_fileFormat;
+}
+
+void PipelineLayoutModel::restore(const PipelineLayoutSnapshot& snap)
+{
+    m_layouts = snap.layouts;
+    m_dlayouts = snap.dlayouts;
+    m_dsets = snap.dsets;
+    m_names = snap.names;
+    m_slots = snap.slots;
+    invalidateIndexes();
+    m_filename = snap.filename;
+    m_fileFormat = snap.fileFormat;
+}
+
+void PipelineLayoutModel::writeFile(std::string fileName, JsonStreamWriter::Style style,
+                                    const std::function<void(const std::string&)>& beforeReplace) const
+{
+    if (fileName.length() <= 0) return;
+    fileName = normalizeFileName(fileName);
+    bool binary = isBinaryFileName(fileName);
+
+    // Unique per process and thread, so concurrent saves of the same file never share a temp file.
+#ifdef _WIN32
+    string tmp = fileName + ".tmp" + to_string(_getpid()) + "." + to_string(GetCurrentThreadId());
+#else
+    string tmp = fileName + ".tmp" + to_string(getpid()) + "." + to_string(hash<thread::id>()(this_thread::get_id()));
+#endif
+    FILE* file = fopen(tmp.c_str(), binary ? "wb" : "w");
+    if (!file) {
+        throw std::runtime_error("Could not open " + fileName + " for writing.");
+    }
+    try {
+        if (binary) {
+            string image;
+            serializeBinary(image);
+            if (fwrite(image.data(), 1, image.size(), file) != image.size()) {
+                throw std::runtime_error("Write failed.");
+            }
+        } else {
+            JsonStreamWriter writer(file, style);
+            serialize(writer);
+        }
+        if (!SyncFile(file)) {
+            throw std::runtime_error("Write failed.");
+        }
+    } catch (const std::runtime_error& e) {
+        fclose(file);
+        remove(tmp.c_str());
+        throw std::runtime_error(fileName + ": " + e.what());
+    }
+    if (fclose(file) != 0) {
+        remove(tmp.c_str());
+        throw std::runtime_error("Could not write " + fileName + ".");
+    }
+    if (beforeReplace) {
+        try {
+            beforeReplace(tmp);
+        } catch (...) {
+            remove(tmp.c_str());
+            throw;
+        }
+    }
+    if (!RenameOver(tmp, fileName)) {
+        remove(tmp.c_str());
+        throw std::runtime_error("Could not write " + fileName + ".");
+    }
+}
+
+void PipelineLayoutModel::save(std::string fileName, JsonStreamWriter::Style style)
+{
+    if (fileName.length() <= 0) return;
+    fileName = normalizeFileName(fileName);
+    writeFile(fileName, style);
+    m_filename = fileName;
+}
+
+void PipelineLayoutModel::load(std::string fileName)
+{
+    if (fileName.length() <= 0) return;
+    fileName = normalizeFileName(fileName);
+
+    if (isBinaryFileName(fileName)) {
+        try {
+            deserializeBinary(PipelineLayoutBinary(fileName));
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(fileName + ": " + e.what());
+        }
+        m_filename = fileName;
+        return;
+    }
+
+    ifstream ifs;
+    ifs.open(fileName.c_str(), std::ifstream::in | std::ifstream::binary);
+    if (!ifs.is_open()) {
+        throw std::runtime_error("Could not open " + fileName + ".");
+    }
+    string text((istreambuf_iterator<char>(ifs)), istreambuf_iterator<char>());
+    ifs.close();
+
+    try {
+        deserialize(text.data(), text.data() + text.size());
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(fileName + ": " + e.what());
+    }
+    m_filename = fileName;
+}
+
+// Handles in DescriptorSet::dlayouts hold binding indices until the whole file has been read,
+// since nothing orders "bindings" before "layouts" in the file. Out of range ones all become
+// UINT32_MAX, which no binding list gets to.
+static BindingHandle SwizzleIndex(int64_t idx)
+{
+    return (idx < 0 || idx >= UINT32_MAX) ? UINT32_MAX : (BindingHandle) idx;
+}
+
+// Without names, as in PROJECT_FORMAT_NAMED where the key is the name, a "name" member is skipped.
+static void ReadBinding(JsonStreamReader& r, DescriptorLayout& dl, std::string& key, NamePool* names, SlabArena& arena)
+{
+    r.beginObject();
+    while (r.nextKey(key)) {
+        if (key == "name" && names) { r.readString(key); dl.name = names->intern(key); }
+        else if (key == "type") dl.typeIdx = (int) r.readInt();
+        else if (key == "data") { r.readString(key); dl.data.assign(key.data(), key.size(), &arena); }
+        else if (key == "comment") { r.readString(key); dl.comment.assign(key.data(), key.size(), &arena); }
+        else if (key == "stageFlagBits") dl.stageFlagBits = (uint32_t) r.readInt();
+        else r.skipValue();
+    }
+}
+
+// descsets is scratch kept across calls, so that its vectors are grown once per load rather than once
+// per set; each set that lists bindings is then copied out at its exact size. Returns the number of
+// sets in the file, empty ones included.
+static size_t ReadPipelineLayout(JsonStreamReader& r, PipelineLayout& pl, std::string& key, NamePool& names,
+                               vector< pair<int64_t, vector<BindingHandle>> >& descsets)
+{
+    pl.name = NAME_EMPTY;
+    size_t numSets = 0;
+    r.beginObject();
+    while (r.nextKey(key)) {
+        if (key == "name") {
+            r.readString(key);
+            pl.name = names.intern(key);
+        } else if (key == "desc_sets") {
+            numSets = 0;
+            r.beginArray();
+            while (r.nextElement()) {
+                if (numSets == descsets.size()) descsets.emplace_back();
+                auto& dset = descsets[numSets++];
+                dset.first = 0;
+                dset.second.clear();
+                r.beginObject();
+                while (r.nextKey(key)) {
+                    if (key == "set_index") {
+                        dset.first = r.readInt();
+                    } else if (key == "desc_layouts") {
+                        dset.second.clear();
+                        r.beginArray();
+                        while (r.nextElement()) {
+                            dset.second.push_back(SwizzleIndex(r.readInt()));
+                        }
+                    } else {
+                        r.skipValue();
+                    }
+                }
+            }
+        } else {
+            r.skipValue();
+        }
+    }
+
+    pl.descsets.clear();
+    for (size_t i = 0; i < numSets; i++) {
+        auto& dset = descsets[i];
+        if (dset.first < 0 || dset.first >= (int64_t) numSets) {
+            throw std::runtime_error("Invalid set index.");
+        }
+        if (dset.second.empty()) {
+            pl.descsets.erase((uint32_t) dset.first);
+        } else {
+            pl.descsets.edit((uint32_t) dset.first).dlayouts.assign(dset.second.begin(), dset.second.end());
+        }
+    }
+    return numSets;
+}
+
+// Opens the root object and reads "format", if that is the first key. Leaves the next key in key,
+// with more false if there is none.
+static int64_t ReadProjectFormat(JsonStreamReader& r, std::string& key, bool& more)
+{
+    int64_t format = PROJECT_FORMAT_INDEXED;
+    try {
+        r.beginObject();
+        more = r.nextKey(key);
+        if (more && key == "format") {
+            format = r.readInt();
+            more = r.nextKey(key);
+        }
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(string("Could not parse: ") + e.what());
+    }
+    if (format != PROJECT_FORMAT_INDEXED && format != PROJECT_FORMAT_NAMED) {
+        throw std::runtime_error("Unsupported project format " + to_string(format) + ".");
+    }
+    return format;
+}
+
+void PipelineLayoutModel::deserialize(const char* begin, const char* end)
+{
+    JsonStreamReader r(begin, end);
+    string key;
+    bool more = false;
+    if (ReadProjectFormat(r, key, more) == PROJECT_FORMAT_NAMED) {
+        deserializeNamed(r, key, more, nullptr);
+        return;
+    }
+
+    int64_t numSets = 0, numBindings = 0, numLayouts = 0;
+    NamePool names;
+    vector<NameId> dsets;
+    vector< shared_ptr<DescriptorLayout> > dlayouts;
+    vector<PipelineLayout> layouts;
+    vector<size_t> layoutSets;
+    vector< pair<int64_t, vector<BindingHandle>> > descsetsScratch;
+
+    try {
+        for (; more; more = r.nextKey(key)) {
+            if (key == "num_sets") {
+                numSets = r.readInt();
+            } else if (key == "num_bindings") {
+                numBindings = r.readInt();
+            } else if (key == "num_layouts") {
+                numLayouts = r.readInt();
+            } else if (key == "sets") {
+                dsets.clear();
+                r.beginArray();
+                while (r.nextElement()) {
+                    r.readString(key);
+                    dsets.push_back(names.intern(key));
+                }
+            } else if (key == "bindings") {
+                dlayouts.clear();
+                r.beginArray();
+                while (r.nextElement()) {
+                    dlayouts.push_back(makeBinding(NAME_EMPTY));
+                    dlayouts.back()->stageFlagBits = 0;
+                    ReadBinding(r, *dlayouts.back(), key, &names, m_arena);
+                }
+            } else if (key == "layouts") {
+                layouts.clear();
+                layoutSets.clear();
+                r.beginArray();
+                while (r.nextElement()) {
+                    layouts.push_back(PipelineLayout());
+                    layoutSets.push_back(ReadPipelineLayout(r, layouts.back(), key, names, descsetsScratch));
+                }
+            } else {
+                r.skipValue();
+            }
+        }
+        r.finish();
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(string("Could not parse: ") + e.what());
+    }
+
+    // The counts may pad the lists, but only as far as what the file lists can use: sets up to the ones
+    // the layouts give, bindings up to the highest one a set refers to. Anything past that would be
+    // allocated on the file's word alone.
+    int64_t usedSets = (int64_t) dsets.size(), usedBindings = (int64_t) dlayouts.size();
+    for (size_t l = 0; l < layouts.size(); l++) {
+        usedSets = max(usedSets, (int64_t) layoutSets[l]);
+        for (auto& stored: layouts[l].descsets) {
+            for (BindingHandle b: stored.dlayouts) usedBindings = max(usedBindings, (int64_t) b + 1);
+        }
+    }
+    if (numSets < (int64_t) dsets.size() || numSets > usedSets) {
+        throw std::runtime_error("Mismatch between sets and num_sets");
+    }
+    if (numBindings < (int64_t) dlayouts.size() || numBindings > usedBindings) {
+        throw std::runtime_error("Mismatch between bindings and num_bindings");
+    }
+    if (numLayouts != (int64_t) layouts.size()) {
+        throw std::runtime_error("Mismatch between layouts and num_layouts");
+    }
+    dsets.resize(numSets, NAME_EMPTY);
+    if ((int64_t) dlayouts.size() < numBindings) {
+        NameId unknown = names.intern("UNKNOWN");
+        while ((int64_t) dlayouts.size() < numBindings) dlayouts.push_back(makeBinding(unknown));
+    }
+
+    BindingSlotTable slots;
+    assignHandles(dlayouts, slots);
+    for (size_t l = 0; l < layouts.size(); l++) {
+        auto& pl = layouts[l];
+        if (layoutSets[l] != (size_t) numSets) {
+            throw std::runtime_error("Mismatch between desc_set and num_sets");
+        }
+        for (auto& stored: pl.descsets) {
+            auto& dset = pl.descsets.edit(stored.index).dlayouts;
+            for (size_t k = 0; k < dset.size(); k++) {
+                if (dset[k] >= dlayouts.size()) {
+                    throw std::runtime_error("Invalid DL index.");
+                }
+                dset.edit(k) = dlayouts[dset[k]]->handle;
+            }
+        }
+    }
+
+    m_names = std::move(names);
+    m_dsets.assign(dsets.begin(), dsets.end());
+    m_dlayouts.assign(dlayouts.begin(), dlayouts.end());
+    swap(m_slots, slots);
+    m_layouts.assign(make_move_iterator(layouts.begin()), make_move_iterator(layouts.end()));
+    invalidateIndexes();
+    m_fileFormat = PROJECT_FORMAT_INDEXED;
+}
+
+static void ReadNameList(JsonStreamReader& r, vector<string>& out)
+{
+    out.clear();
+    r.beginArray();
+    while (r.nextElement()) {
+        out.push_back(string());
+        r.readString(out.back());
+    }
+}
+
+// PROJECT_FORMAT_NAMED, from the key after "format" on. Names are only resolved once everything has
+// been read, so the sections may come in any order; partial reads are only quick in the written one.
+void PipelineLayoutModel::deserializeNamed(JsonStreamReader& r, std::string& key, bool more, const std::string* onlyLayout)
+{
+    typedef vector< pair<string, vector<string>> > NamedSets;
+    vector<string> setOrder, layoutOrder, bindingOrder;
+    vector< pair<string, NamedSets> > layoutDefs;
+    unordered_map<string, shared_ptr<DescriptorLayout>> bindingDefs;
+    unordered_set<string> used;     // With onlyLayout: the bindings it refers to, once it has been read.
+    bool layoutsRead = false;
+    string name, duplicate;
+    NamePool names;
+
+    try {
+        for (; more; more = r.nextKey(key)) {
+            if (key == "order") {
+                r.beginObject();
+                while (r.nextKey(key)) {
+                    if (key == "bindings") ReadNameList(r, bindingOrder);
+                    else if (key == "layouts") ReadNameList(r, layoutOrder);
+                    else if (key == "sets") ReadNameList(r, setOrder);
+                    else r.skipValue();
+                }
+            } else if (key == "layouts") {
+                r.beginObject();
+                while (r.nextKey(name)) {
+                    if (onlyLayout && name != *onlyLayout) {
+                        r.skipValue();
+                        continue;
+                    }
+                    layoutDefs.push_back(make_pair(name, NamedSets()));
+                    auto& sets = layoutDefs.back().second;
+                    r.beginObject();
+                    while (r.nextKey(key)) {
+                        sets.push_back(make_pair(key, vector<string>()));
+                        ReadNameList(r, sets.back().second);
+                        if (onlyLayout) used.insert(sets.back().second.begin(), sets.back().second.end());
+                    }
+                }
+                layoutsRead = true;
+            } else if (key == "bindings") {
+                r.beginObject();
+                while (r.nextKey(name)) {
+                    if (onlyLayout && layoutsRead && !used.count(name)) {
+                        r.skipValue();
+                        continue;
+                    }
+                    auto dl = makeBinding(NAME_EMPTY);
+                    dl->stageFlagBits = 0;
+                    ReadBinding(r, *dl, key, nullptr, m_arena);
+                    if (!bindingDefs.insert(make_pair(name, move(dl))).second && duplicate.empty()) {
+                        duplicate = name;
+                    }
+                }
+            } else {
+                r.skipValue();
+            }
+        }
+        r.finish();
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(string("Could not parse: ") + e.what());
+    }
+
+    if (!duplicate.empty()) {
+        throw std::runtime_error("binding '" + duplicate + "' is defined more than once.");
+    }
+    if (onlyLayout && layoutDefs.empty()) {
+        throw std::runtime_error("No pipeline layout named '" + *onlyLayout + "'.");
+    }
+    if (onlyLayout && !layoutsRead) {
+        // Bindings came first: drop the ones the layout does not use now.
+        for (auto& set: layoutDefs[0].second) used.insert(set.second.begin(), set.second.end());
+    }
+
+    unordered_map<string, int> setIdx;
+    vector<NameId> dsets;
+    dsets.reserve(setOrder.size());
+    for (int i = 0; i < (int) setOrder.size(); i++) {
+        if (!setIdx.insert(make_pair(setOrder[i], i)).second) {
+            throw std::runtime_error("descriptor set '" + setOrder[i] + "' is listed more than once.");
+        }
+        dsets.push_back(names.intern(setOrder[i]));
+    }
+
+    // Bindings in "order" first, then any it leaves out, by name.
+    vector< shared_ptr<DescriptorLayout> > dlayouts;
+    unordered_map<string, DescriptorLayout*> bindingByName;
+    dlayouts.reserve(bindingDefs.size());
+    bindingByName.reserve(bindingDefs.size());
+    for (auto& n: bindingOrder) {
+        if (onlyLayout && !used.count(n)) continue;
+        auto it = bindingDefs.find(n);
+        if (it == bindingDefs.end()) {
+            if (bindingByName.count(n)) throw std::runtime_error("binding '" + n + "' is listed more than once.");
+            throw std::runtime_error("binding '" + n + "' is listed but not defined.");
+        }
+        it->second->name = names.intern(n);
+        bindingByName[n] = it->second.get();
+        dlayouts.push_back(move(it->second));
+        bindingDefs.erase(it);
+    }
+    vector<string> unlisted;
+    for (auto& def: bindingDefs) {
+        if (!onlyLayout || used.count(def.first)) unlisted.push_back(def.first);
+    }
+    sort(unlisted.begin(), unlisted.end());
+    for (auto& n: unlisted) {
+        bindingDefs[n]->name = names.intern(n);
+        bindingByName[n] = bindingDefs[n].get();
+        dlayouts.push_back(move(bindingDefs[n]));
+    }
+    BindingSlotTable slots;
+    assignHandles(dlayouts, slots);
+
+    // Layouts likewise, though ones missing from "order" keep their place in the file.
+    unordered_map<string, size_t> layoutDefIdx;
+    for (size_t i = 0; i < layoutDefs.size(); i++) {
+        if (!layoutDefIdx.insert(make_pair(layoutDefs[i].first, i)).second) {
+            throw std::runtime_error("pipeline layout '" + layoutDefs[i].first + "' is defined more than once.");
+        }
+    }
+    vector<size_t> layoutSeq;
+    vector<bool> placed(layoutDefs.size(), false);
+    for (auto& n: layoutOrder) {
+        if (onlyLayout && n != *onlyLayout) continue;
+        auto it = layoutDefIdx.find(n);
+        if (it == layoutDefIdx.end()) throw std::runtime_error("pipeline layout '" + n + "' is listed but not defined.");
+        if (placed[it->second]) throw std::runtime_error("pipeline layout '" + n + "' is listed more than once.");
+        placed[it->second] = true;
+        layoutSeq.push_back(it->second);
+    }
+    for (size_t i = 0; i < layoutDefs.size(); i++) {
+        if (!placed[i]) layoutSeq.push_back(i);
+    }
+
+    vector<PipelineLayout> layouts(layoutSeq.size());
+    for (size_t l = 0; l < layoutSeq.size(); l++) {
+        auto& def = layoutDefs[layoutSeq[l]];
+        auto& pl = layouts[l];
+        pl.name = names.intern(def.first);
+        vector<bool> seen(setOrder.size(), false);
+        for (auto& set: def.second) {
+            auto s = setIdx.find(set.first);
+            if (s == setIdx.end()) {
+                throw std::runtime_error("pipeline layout '" + def.first + "' uses unknown set '" + set.first + "'.");
+            }
+            if (seen[s->second]) {
+                throw std::runtime_error("pipeline layout '" + def.first + "' lists set '" + set.first + "' more than once.");
+            }
+            seen[s->second] = true;
+            if (set.second.empty()) continue;
+            auto& dst = pl.descsets.edit(s->second).dlayouts;
+            dst.reserve(set.second.size());
+            for (auto& n: set.second) {
+                auto b = bindingByName.find(n);
+                if (b == bindingByName.end()) {
+                    throw std::runtime_error("pipeline layout '" + def.first + "' set '" + set.first +
+                                             "' references unknown binding '" + n + "'.");
+                }
+                dst.push_back(b->second->handle);
+            }
+        }
+    }
+
+    m_names = std::move(names);
+    m_dsets.assign(dsets.begin(), dsets.end());
+    m_dlayouts.assign(dlayouts.begin(), dlayouts.end());
+    swap(m_slots, slots);
+    m_layouts.assign(make_move_iterator(layouts.begin()), make_move_iterator(layouts.end()));
+    invalidateIndexes();
+    m_fileFormat = PROJECT_FORMAT_NAMED;
+}
+
+void PipelineLayoutModel::compactNames(void)
+{
+    NamePool names;
+    auto keep = [&](NameId& id) { id = names.intern(m_names.c_str(id), m_names.size(id)); };
+    for (size_t i = 0; i < m_dsets.size(); i++) keep(m_dsets.edit(i));
+    for (size_t i = 0; i < m_dlayouts.size(); i++) keep(editBinding((int) i).name);
+    for (size_t i = 0; i < m_layouts.size(); i++) keep(m_layouts.edit(i).name);
+    m_names = std::move(names);
+}
+
+void PipelineLayoutModel::deserializeLayout(const char* begin, const char* end, const std::string& layoutName)
+{
+    {
+        JsonStreamReader r(begin, end);
+        string key;
+        bool more = false;
+        if (ReadProjectFormat(r, key, more) == PROJECT_FORMAT_NAMED) {
+            deserializeNamed(r, key, more, &layoutName);
+            return;
+        }
+    }
+
+    deserialize(begin, end);
+    NameId id = m_names.find(layoutName);
+    auto it = find_if(m_layouts.begin(), m_layouts.end(), [id](const PipelineLayout& pl) { return pl.name == id; });
+    if (it == m_layouts.end()) {
+        throw std::runtime_error("No pipeline layout named '" + layoutName + "'.");
+    }
+    PipelineLayout layout = move(*it);
+    vector<bool> used(m_dlayouts.size(), false);
+    for (auto& dset: layout.descsets) {
+        for (BindingHandle dl: dset.dlayouts) used[m_slots.find(dl)] = true;
+    }
+    vector<DescriptorLayoutPtr> dlayouts;
+    for (size_t i = 0; i < m_dlayouts.size(); i++) {
+        if (!used[i]) {
+            m_slots.release(m_dlayouts[i]->handle);
+            continue;
+        }
+        m_slots.moved(m_dlayouts[i]->handle, (uint32_t) dlayouts.size());
+        dlayouts.push_back(m_dlayouts[i]);
+    }
+    m_dlayouts.assign(dlayouts.begin(), dlayouts.end());
+    m_layouts.clear();
+    m_layouts.push_back(move(layout));
+    compactNames();
+    invalidateIndexes();
+}
+
+void PipelineLayoutModel::deserializeDom(const char* begin, const char* end)
+{
+    Json::Value value;
+    Json::Features features;
+    Json::Reader reader(features);
+    if (!reader.parse(begin, end, value)) {
+        throw std::runtime_error("Could not parse: " + reader.getFormattedErrorMessages());
+    }
+    invalidateIndexes();
+
+    m_dsets.resize(value["num_sets"].asInt());
+    for (int i = 0; i < (int) value["sets"].size(); i++) {
+        m_dsets.edit(i) = m_names.intern(value["sets"][i].asString());
+    }
+
+    vector< shared_ptr<DescriptorLayout> > dlayouts(value["num_bindings"].asInt());
+    for (size_t i = 0; i < dlayouts.size() && i < m_dlayouts.size(); i++) {
+        if (m_dlayouts[i]) dlayouts[i] = m_arena.makeShared<DescriptorLayout>(*m_dlayouts[i]);
+    }
+    for (int i = 0; i < (int) value["bindings"].size(); i++) {
+        if (!dlayouts[i].get()) {
+            dlayouts[i] = makeBinding(m_names.intern("UNKNOWN"));
+        }
+        dlayouts[i]->name = m_names.intern(value["bindings"][i]["name"].asString());
+        dlayouts[i]->typeIdx = value["bindings"][i]["type"].asInt();
+        dlayouts[i]->data = value["bindings"][i]["data"].asString();
+        dlayouts[i]->comment = value["bindings"][i]["comment"].asString();
+        dlayouts[i]->stageFlagBits = value["bindings"][i]["stageFlagBits"].asUInt();
+    }
+    assignHandles(dlayouts, m_slots);
+    m_dlayouts.assign(dlayouts.begin(), dlayouts.end());
+
+    m_layouts.resize(value["num_layouts"].asInt());
+    for (int i = 0; i < (int) value["layouts"].size(); i++) {
+        auto& vplayout = value["layouts"][i];
+        PipelineLayout& pl = m_layouts.edit(i);
+        pl.name = m_names.intern(vplayout["name"].asString());
+        pl.descsets.clear();
+        if ((int) vplayout["desc_sets"].size() != value["num_sets"].asInt()) {
+            throw std::runtime_error("Mismatch between desc_set and num_sets");
+        }
+        for (int j = 0; j < (int) vplayout["desc_sets"].size(); j++) {
+            int setIdx = vplayout["desc_sets"][j]["set_index"].asInt();
+            if (setIdx < 0 || setIdx >= (int) vplayout["desc_sets"].size()) {
+                throw std::runtime_error("Invalid set index.");
+            }
+            if (vplayout["desc_sets"][j]["desc_layouts"].empty()) {
+                pl.descsets.erase(setIdx);
+                continue;
+            }
+            auto& dst = pl.descsets.edit(setIdx).dlayouts;
+            dst.resize(vplayout["desc_sets"][j]["desc_layouts"].size());
+            for (int k = 0; k < (int) vplayout["desc_sets"][j]["desc_layouts"].size(); k++) {
+                int dlIdx = vplayout["desc_sets"][j]["desc_layouts"][k].asInt();
+                if (dlIdx < 0 || dlIdx >= (int) m_dlayouts.size()) {
+                    throw std::runtime_error("Invalid DL index.");
+                }
+                dst.edit(k) = m_dlayouts[dlIdx] ? m_dlayouts[dlIdx]->handle : BINDING_HANDLE_NONE;
+            }
+        }
+    }
+}
+
+// -------------------------------------------------------- Undo payloads -----------------------------------------------
+
+// What a delete is about to drop, for the EDIT_RESTORE_* edit that undoes it. Bindings go by position:
+//     layout      { "name", "sets" : [ [ binding ] per set ] }
+//     set         { "name", "layouts" : [ [ binding ] per layout ] }    The contents of the last set, which
+//                                                                       is the one delDescset() truncates.
+//     binding     { "binding" : { as in "bindings" }, "refs" : [ [ layout, set, position ] ] }
+//     stages      [ binding, stageFlagBits, binding, stageFlagBits, ... ]     What a bulk stage update is
+//                                                                          about to change, in order.
+
+static void ReadIndexLists(JsonStreamReader& r, vector< vector<int> >& out)
+{
+    out.clear();
+    r.beginArray();
+    while (r.nextElement()) {
+        out.emplace_back();
+        r.beginArray();
+        while (r.nextElement()) out.back().push_back((int) r.readInt());
+    }
+}
+
+void PipelineLayoutModel::layoutPayload(int idx, std::string& out) const
+{
+    out.clear();
+    JsonStreamWriter w(out, JsonStreamWriter::STYLE_COMPACT);
+    w.beginObject();
+    w.key("name");
+    WriteName(w, m_names, m_layouts[idx].name);
+    // By set index, up to the last set the layout uses; restoreLayout() reads the rest as empty.
+    w.key("sets");
+    w.beginArray();
+    auto& descsets = m_layouts[idx].descsets;
+    for (uint32_t s = 0; s < descsets.extent(); s++) {
+        w.beginArray();
+        for (BindingHandle dl: descsets[s].dlayouts) w.value(resolveBinding(dl));
+        w.endArray();
+    }
+    w.endArray();
+    w.endObject();
+}
+
+// Only the layouts that use the last set are listed, each as [layout, binding...].
+void PipelineLayoutModel::lastSetPayload(int idx, std::string& out) const
+{
+    out.clear();
+    uint32_t last = (uint32_t) m_dsets.size() - 1;
+    JsonStreamWriter w(out, JsonStreamWriter::STYLE_COMPACT);
+    w.beginObject();
+    w.key("name");
+    WriteName(w, m_names, m_dsets[idx]);
+    w.key("users");
+    w.beginArray();
+    for (int l = 0; l < (int) m_layouts.size(); l++) {
+        const DescriptorSet* dset = m_layouts[l].descsets.find(last);
+        if (!dset) continue;
+        w.beginArray();
+        w.value(l);
+        for (BindingHandle dl: dset->dlayouts) w.value(resolveBinding(dl));
+        w.endArray();
+    }
+    w.endArray();
+    w.endObject();
+}
+
+void PipelineLayoutModel::bindingPayload(int idx, std::string& out) const
+{
+    out.clear();
+    auto& binding = *m_dlayouts[idx];
+    string text;
+    JsonStreamWriter w(out, JsonStreamWriter::STYLE_COMPACT);
+    w.beginObject();
+    w.key("binding");
+    w.beginObject();
+    w.key("comment");
+    binding.comment.decode(text);
+    w.value(text);
+    w.key("data");
+    binding.data.decode(text);
+    w.value(text);
+    w.key("name");
+    WriteName(w, m_names, binding.name);
+    w.key("stageFlagBits");
+    w.value(binding.stageFlagBits);
+    w.key("type");
+    w.value(binding.typeIdx);
+    w.endObject();
+    // Every place the binding is listed, in the order restoreDesclayout() puts them back.
+    w.key("refs");
+    w.beginArray();
+    for (auto& entry: unsettledUsages(binding.handle)) {
+        int layout = usageLayout(entry.layout);
+        for (uint64_t bits = entry.sets; bits; bits &= bits - 1) {
+            int set = entry.word * 64 + CountTrailingZeros(bits);
+            auto& dlayouts = m_layouts[layout].descsets[set].dlayouts;
+            for (auto it = dlayouts.begin(); it != dlayouts.end(); ++it) {
+                if (*it != binding.handle) continue;
+                w.beginArray();
+                w.value(layout);
+                w.value(set);
+                w.value((int) it.index());
+                w.endArray();
+            }
+        }
+    }
+    w.endArray();
+    w.endObject();
+}
+
+void PipelineLayoutModel::bindingStagesPayload(const std::vector<int>& changed, std::string& out) const
+{
+    out.clear();
+    JsonStreamWriter w(out, JsonStreamWriter::STYLE_COMPACT);
+    w.beginArray();
+    for (int idx: changed) {
+        w.value(idx);
+        w.value(m_dlayouts[idx]->stageFlagBits);
+    }
+    w.endArray();
+}
+
+void PipelineLayoutModel::restoreLayout(int idx, const char* json)
+{
+    if (idx < 0 || idx > (int) m_layouts.size()) return;
+    JsonStreamReader r(json, json + strlen(json));
+    string key, name;
+    vector< vector<int> > sets;
+    r.beginObject();
+    while (r.nextKey(key)) {
+        if (key == "name") r.readString(name);
+        else if (key == "sets") ReadIndexLists(r, sets);
+        else r.skipValue();
+    }
+    for (auto& list: sets) {
+        for (int b: list) {
+            if (b < 0 || b >= (int) m_dlayouts.size()) throw std::runtime_error("Invalid DL index.");
+        }
+    }
+
+    PipelineLayout pl(m_names.intern(name));
+    for (uint32_t s = 0; s < sets.size() && s < m_dsets.size(); s++) {
+        if (sets[s].empty()) continue;
+        auto& dlayouts = pl.descsets.edit(s).dlayouts;
+        for (int b: sets[s]) dlayouts.push_back(m_dlayouts[b]->handle);
+    }
+    setInverse(EDIT_DEL_LAYOUT, idx);
+    // In a transaction (an abort undoing deletes, say) one rebuild on first use beats renumbering each time.
+    if (m_transaction.depth) {
+        m_usageIndex.valid = false;
+        m_usageIndex.renumber.clear();
+    }
+    if (m_usageIndex.valid) {
+        settleUsages();
+        // The reverse of delLayout(): renumber the entries from idx on, then add the layout's.
+        for (auto& list: m_usageIndex.usages) {
+            for (auto& u: list) {
+                if ((int) u.layout >= idx) u.layout++;
+            }
+        }
+        for (auto& dset: pl.descsets) {
+            for (BindingHandle dl: dset.dlayouts) UsageSet(usages(dl), idx, dset.index);
+        }
+    }
+    m_layouts.insert(idx, move(pl));
+    m_layoutIndex.valid = false;
+    notify(EDIT_RESTORE_LAYOUT, idx, 0, 0, 0, json);
+}
+
+void PipelineLayoutModel::restoreDescset(int layout, int idx, const char* json)
+{
+    if (idx < 0 || idx > (int) m_dsets.size()) return;
+    JsonStreamReader r(json, json + strlen(json));
+    string key, name;
+    vector< vector<int> > users, lists;
+    r.beginObject();
+    while (r.nextKey(key)) {
+        if (key == "name") r.readString(name);
+        else if (key == "users") ReadIndexLists(r, users);
+        else if (key == "layouts") ReadIndexLists(r, lists);
+        else r.skipValue();
+    }
+    // Older payloads list every layout's set, "layouts" rather than "users".
+    for (size_t l = 0; l < lists.size(); l++) {
+        if (lists[l].empty()) continue;
+        users.emplace_back(1, (int) l);
+        users.back().insert(users.back().end(), lists[l].begin(), lists[l].end());
+    }
+    for (auto& user: users) {
+        if (user.size() < 2 || user[0] < 0 || user[0] >= (int) m_layouts.size()) {
+            throw std::runtime_error("Invalid layout index.");
+        }
+        for (size_t i = 1; i < user.size(); i++) {
+            if (user[i] < 0 || user[i] >= (int) m_dlayouts.size()) throw std::runtime_error("Invalid DL index.");
+        }
+    }
+
+    setInverse(EDIT_DEL_DESCSET, layout, idx);
+    m_dsets.insert(idx, m_names.intern(name));
+    m_setIndex.valid = false;
+    int last = (int) m_dsets.size() - 1;
+    for (auto& user: users) {
+        int l = user[0];
+        auto& dlayouts = editSet(l, last);
+        for (size_t i = 1; i < user.size(); i++) {
+            BindingHandle dl = m_dlayouts[user[i]]->handle;
+            dlayouts.push_back(dl);
+            if (m_usageIndex.valid) UsageSet(usages(dl), l, last);
+        }
+    }
+    notify(EDIT_RESTORE_DESCSET, layout, idx, 0, 0, json);
+}
+
+void PipelineLayoutModel::restoreDesclayout(int idx, const char* json)
+{
+    if (idx < 0 || idx > (int) m_dlayouts.size()) return;
+    JsonStreamReader r(json, json + strlen(json));
+    string key;
+    auto dl = makeBinding(NAME_EMPTY);
+    vector< vector<int> > refs;
+    r.beginObject();
+    while (r.nextKey(key)) {
+        if (key == "binding") ReadBinding(r, *dl, key, &m_names, m_arena);
+        else if (key == "refs") ReadIndexLists(r, refs);
+        else r.skipValue();
+    }
+    for (auto& ref: refs) {
+        if (ref.size() != 3 || ref[0] < 0 || ref[0] >= (int) m_layouts.size() || ref[1] < 0 ||
+            ref[1] >= (int) m_dsets.size() || ref[2] < 0) {
+            throw std::runtime_error("Invalid binding reference.");
+        }
+    }
+
+    setInverse(EDIT_DEL_DESCLAYOUT, idx);
+    // A new handle: the old one went stale with the delete, and stays so.
+    BindingHandle h = m_slots.allocate((uint32_t) idx);
+    dl->handle = h;
+    if (m_transaction.depth) m_columns.valid = false;
+    if (m_columns.valid) {
+        m_columns.types.insert(m_columns.types.begin() + idx, dl->typeIdx);
+        m_columns.stages.insert(m_columns.stages.begin() + idx, dl->stageFlagBits);
+    }
+    m_dlayouts.insert(idx, move(dl));
+    for (int i = idx + 1; i < (int) m_dlayouts.size(); i++) m_slots.moved(m_dlayouts[i]->handle, i);
+    m_bindingIndex.valid = false;
+    for (auto& ref: refs) {
+        auto& dlayouts = editSet(ref[0], ref[1]);
+        dlayouts.insert(min((size_t) ref[2], dlayouts.size()), h);
+        if (m_usageIndex.valid) UsageSet(usages(h), ref[0], ref[1]);
+    }
+    notify(EDIT_RESTORE_DESCLAYOUT, idx, 0, 0, 0, json);
+}
+
+void PipelineLayoutModel::restoreBindingStages(const char* json)
+{
+    JsonStreamReader r(json, json + strlen(json));
+    vector<int> changed;
+    vector<uint32_t> stages;
+    r.beginArray();
+    while (r.nextElement()) {
+        int64_t idx = r.readInt();
+        if (idx < 0 || idx >= (int64_t) m_dlayouts.size() || !r.nextElement()) throw std::runtime_error("Invalid DL index.");
+        changed.push_back((int) idx);
+        stages.push_back((uint32_t) r.readInt());
+    }
+    if (changed.empty()) return;
+
+    if (wantInverse()) {
+        bindingStagesPayload(changed, m_inverseText);
+        setInverse(EDIT_RESTORE_BINDING_STAGES, 0, 0, 0, 0, m_inverseText.c_str());
+    }
+    for (size_t i = 0; i < changed.size(); i++) {
+        editBinding(changed[i]).stageFlagBits = stages[i];
+        if (m_columns.valid) m_columns.stages[changed[i]] = stages[i];
+    }
+    notify(EDIT_RESTORE_BINDING_STAGES, 0, 0, 0, 0, json);
+}
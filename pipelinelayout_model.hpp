@@ -0,0 +1,593 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _PIPELINE_LAYOUT_MODEL_
+#define _PIPELINE_LAYOUT_MODEL_
+
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include "json_stream.hpp"
+#include "pipelinelayout_binary.hpp"
+#include "packed_text.hpp"
+#include "name_pool.hpp"
+#include "binding_filter.hpp"
+#include "cow_vector.hpp"
+
+// Bump whenever load() / save() change what they accept or emit; keys the vkplc build cache.
+#define PIPELINE_LAYOUT_TOOL_VERSION "1.2"
+
+typedef enum Vk__PipelineStageFlagBits {
+    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT = 0x00000001,
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT = 0x00000002,
+    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT = 0x00000004,
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT = 0x00000008,
+    VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT = 0x00000010,
+    VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT = 0x00000020,
+    VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT = 0x00000040,
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT = 0x00000080,
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT = 0x00000100,
+    VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT = 0x00000200,
+    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT = 0x00000400,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT = 0x00000800,
+    VK_PIPELINE_STAGE_TRANSFER_BIT = 0x00001000,
+    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT = 0x00002000,
+    VK_PIPELINE_STAGE_HOST_BIT = 0x00004000,
+    VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT = 0x00008000,
+    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT = 0x00010000,
+} Vk__PipelineStageFlagBits;
+
+// Display names, indexed by DescriptorLayout::typeIdx and by stage bit position.
+extern std::vector<std::string> descLayoutTypes;
+extern std::vector<std::string> stageBits;
+
+// -------------------------------------------------------- BindingHandle -----------------------------------------------
+
+// How sets refer to bindings: a slot in the model's BindingSlotTable in the low 24 bits, and in the
+// high 8 the generation of that slot when the handle was made. Deleting a binding bumps its slot's
+// generation, so handles to it stop resolving rather than reach whatever takes the slot next.
+// 0 is never a valid handle.
+typedef uint32_t BindingHandle;
+
+#define BINDING_HANDLE_NONE 0u
+
+// Slot -> position in the binding list. Freed slots are reused, newest first; a slot whose
+// generation would wrap around is retired instead, so a stale handle can never come back to life.
+class BindingSlotTable
+{
+public:
+    static const uint32_t SLOT_BITS = 24;
+    static const uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+    static const uint32_t MAX_SLOTS = SLOT_MASK + 1;
+
+    static uint32_t slotOf(BindingHandle h) { return h & SLOT_MASK; }
+
+    // Position h stands for, -1 if its binding was deleted or it never was a handle of this table.
+    int find(BindingHandle h) const
+    {
+        uint32_t s = h & SLOT_MASK;
+        if (s >= m_slots.size() || m_slots[s].generation != h >> SLOT_BITS || m_slots[s].index == FREE) return -1;
+        return (int) m_slots[s].index;
+    }
+
+    BindingHandle allocate(uint32_t index);     // Throws std::length_error once every slot is taken.
+    void release(BindingHandle h);
+    void moved(BindingHandle h, uint32_t index) { m_slots.edit(h & SLOT_MASK).index = index; }
+    void clear(void) { m_slots.clear(); m_free.clear(); }
+    void reserve(size_t n) { m_slots.reserve(n); }
+    size_t numSlots(void) const { return m_slots.size(); }
+
+private:
+    static const uint32_t FREE = 0xffffffffu;
+    struct Slot {
+        uint32_t index;         // FREE while no binding holds the slot.
+        uint32_t generation;    // 1..255, of the latest handle made for the slot.
+    };
+    CowVector<Slot> m_slots;
+    CowVector<uint32_t> m_free;
+};
+
+// -------------------------------------------------------- DescriptorLayout & PipelineLayout -----------------------------------------------
+
+// Names are ids in the owning model's NamePool (PipelineLayoutModel::names()). A model's bindings may
+// be shared with its snapshots, so the model only hands them out const and copies one before editing it.
+struct DescriptorLayout {
+    NameId name = NAME_EMPTY;
+    int typeIdx = 0;
+    PackedText data;        // Free-form, can be large; decoded on demand.
+    PackedText comment;
+    uint32_t stageFlagBits = 0x00010000; // VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+    BindingHandle handle = BINDING_HANDLE_NONE;  // Assigned by the model that holds the binding.
+
+public:
+    DescriptorLayout(NameId name_);
+    void stageFlagBitsToBools(std::vector<bool>& out) const;
+    void stageFlagBitsFromBools(std::vector<bool>& out);
+};
+
+// Bindings are made in their model's SlabArena, with their reference counts; the last reference hands
+// the memory back to it, on whichever thread that is.
+typedef std::shared_ptr<const DescriptorLayout> DescriptorLayoutPtr;
+
+// Copying any of these costs O(1): the lists are CowVectors, shared until written to.
+struct DescriptorSet {
+    uint32_t index = 0;     // Set number within the pipeline layout, an index into the model's dsets().
+    CowVector<BindingHandle> dlayouts;
+};
+
+// The sets of one pipeline layout. Only sets that list bindings are stored, in index order; any other
+// index below the model's dsets().size() reads as an empty set, so that a layout costs what it uses and
+// adding or removing a global set leaves the layouts that do not use it alone.
+class DescriptorSetList
+{
+public:
+    typedef CowVector<DescriptorSet>::const_iterator const_iterator;
+
+    // Over the stored sets only.
+    const_iterator begin(void) const { return m_sets.begin(); }
+    const_iterator end(void) const { return m_sets.end(); }
+    size_t numStored(void) const { return m_sets.size(); }
+    bool empty(void) const { return m_sets.empty(); }
+    // One past the highest stored index, 0 if there is none.
+    uint32_t extent(void) const { return m_sets.empty() ? 0 : m_sets.back().index + 1; }
+
+    const DescriptorSet* find(uint32_t set) const;
+    // An empty set if the index is not stored.
+    const DescriptorSet& operator[](uint32_t set) const;
+
+    // Stores the set if it is not already; prune() it again if it may have been left empty.
+    DescriptorSet& edit(uint32_t set);
+    void prune(uint32_t set);
+    void erase(uint32_t set);
+    // The two indexes trade contents.
+    void swapSets(uint32_t a, uint32_t b);
+    void clear(void) { m_sets.clear(); }
+
+private:
+    size_t position(uint32_t set) const;    // Of the first stored set at or after the index.
+
+    CowVector<DescriptorSet> m_sets;
+};
+
+struct PipelineLayout {
+    NameId name = NAME_EMPTY;
+    DescriptorSetList descsets;
+
+public:
+    PipelineLayout() {}
+    PipelineLayout(NameId name_);
+};
+
+// .vkpipeline.json revisions; deserialize() reads both, serialize() writes the model's fileFormat().
+//
+// PROJECT_FORMAT_INDEXED: "num_layouts" / "layouts" / "sets" / "bindings", with set entries giving a
+// binding's position in "bindings" and each set its "set_index". Reordering bindings or sets rewrites
+// references all over the file.
+//
+// PROJECT_FORMAT_NAMED: every name is written once and referred to by that name, so positions only
+// appear in "order". Keys are sorted by name, except at the top, which is laid out for partial reads:
+//     "format" : 2                                            Must be the first key.
+//     "order" : { "bindings" : [ names ], "layouts" : [ names ], "sets" : [ names ] }
+//     "layouts" : { layout : { set : [ binding names ] } }    Empty sets are left out.
+//     "bindings" : { name : { "comment", "data", "stageFlagBits", "type", "typeName" } }
+// Models whose binding, set or layout names are not unique cannot be written this way and are
+// written as PROJECT_FORMAT_INDEXED instead.
+enum ProjectFormat {
+    PROJECT_FORMAT_INDEXED = 1,
+    PROJECT_FORMAT_NAMED = 2
+};
+
+// -------------------------------------------------------- PipelineLayoutSnapshot -----------------------------------------------
+
+// What a model holds, sharing all of it with the model: taking a snapshot or restoring one is O(1)
+// whatever the project's size. Lists, sets and bindings are copied by whichever side writes to them
+// first, so a snapshot only costs memory for what changes while it is kept, and other threads may read
+// it while the model goes on being edited. The slot table comes along, so restore() hands out the same
+// binding handles.
+struct PipelineLayoutSnapshot {
+    CowVector<PipelineLayout> layouts;
+    CowVector<DescriptorLayoutPtr> dlayouts;
+    CowVector<NameId> dsets;
+    NamePool names;
+    BindingSlotTable slots;
+    std::string filename;
+    int fileFormat = PROJECT_FORMAT_INDEXED;
+};
+
+// -------------------------------------------------------- ModelEdit -----------------------------------------------
+
+// One editor action that changed the model, as passed to ModelEditListener and replayed by
+// PipelineLayoutModel::applyEdit(). args holds the action's int parameters in declaration order
+// (reorders record the index before the move; bools are 0 / 1), text its string parameter.
+enum ModelEditOp : uint8_t {
+    EDIT_ADD_LAYOUT = 1,
+    EDIT_DEL_LAYOUT,
+    EDIT_RENAME_LAYOUT,
+    EDIT_REORDER_LAYOUT,
+    EDIT_ADD_DESCSET,
+    EDIT_DEL_DESCSET,
+    EDIT_RENAME_DESCSET,
+    EDIT_REORDER_DESCSET,
+    EDIT_REORDER_DESCSETLAYOUT,
+    EDIT_DEL_DESCSETLAYOUT,
+    EDIT_ADD_DESCSETLAYOUT,
+    EDIT_ADD_DESCLAYOUT,
+    EDIT_DEL_DESCLAYOUT,
+    EDIT_RENAME_DESCLAYOUT,
+    EDIT_REORDER_DESCLAYOUT,
+    EDIT_SET_DESCLAYOUT_TYPE,
+    EDIT_SET_DESCLAYOUT_STAGES,
+    EDIT_SET_DESCLAYOUT_DATA,
+    EDIT_SET_DESCLAYOUT_COMMENT,
+    EDIT_CLONE_LAYOUT,
+    // Only made by undo, to put back what a delete took. The restores' text is JSON describing it, laid
+    // out under "Undo payloads" in pipelinelayout_model.cpp.
+    EDIT_RESTORE_LAYOUT,
+    EDIT_RESTORE_DESCSET,
+    EDIT_RESTORE_DESCLAYOUT,
+    EDIT_INSERT_DESCSETLAYOUT,
+    // updateBindingStages(): typeMask, stageMask, setBits, clearBits.
+    EDIT_UPDATE_BINDING_STAGES,
+    // Only made by undo, to put back the stages an EDIT_UPDATE_BINDING_STAGES changed; JSON as above.
+    EDIT_RESTORE_BINDING_STAGES,
+    EDIT_OP_END
+};
+
+struct ModelEdit {
+    ModelEditOp op;
+    int32_t args[4];
+    const char* text;       // Only valid during the callback; NUL-terminated, nullptr if the op has none.
+};
+
+// Number of args used by an op, and whether it carries text. -1 for an unknown op.
+int ModelEditNumArgs(ModelEditOp op);
+bool ModelEditHasText(ModelEditOp op);
+// Leading args that name what a set / rename op changes, so that a later op on the same target supersedes
+// it. 0 for every other op.
+int ModelEditTargetArgs(ModelEditOp op);
+
+// What one transaction changed (PipelineLayoutModel::commitTransaction()): its edits in the order they
+// were made, less those a later edit of the same target (ModelEditTargetArgs()) superseded with no edit
+// that moves things in between. Texts are only valid during the callback.
+struct ModelChangeSet {
+    std::vector<ModelEdit> edits;
+};
+
+// Called after every editor action that changed something. Actions that turn out to be no-ops
+// (bad index, duplicate name, unchanged value) are not reported. Edits made in a transaction are
+// reported when it commits, all in one onChangeSet(), which by default passes them to onEdit().
+class ModelEditListener
+{
+public:
+    virtual ~ModelEditListener() {}
+    virtual void onEdit(const ModelEdit& edit) = 0;
+    virtual void onChangeSet(const ModelChangeSet& changes)
+    {
+        for (auto& edit: changes.edits) onEdit(edit);
+    }
+};
+
+// Told of every reported edit together with the edit that takes it back, before the listeners are; see
+// undo_history.hpp. Inverses are ordinary edits, or the EDIT_RESTORE_* / EDIT_INSERT_DESCSETLAYOUT ops
+// for what a delete or a bulk stage update took, and applying one reports its own inverse in turn. Edits between beginGroup()
+// and endGroup() make up one action; discardGroup() closes one whose edits have been rolled back.
+// reset() follows every wholesale change: nothing recorded before it applies any more.
+class ModelUndoRecorder
+{
+public:
+    virtual ~ModelUndoRecorder() {}
+    virtual void onEdit(const ModelEdit& edit, const ModelEdit& inverse) = 0;
+    virtual void beginGroup(void) = 0;
+    virtual void endGroup(void) = 0;
+    virtual void discardGroup(void) = 0;
+    virtual void reset(void) = 0;
+};
+
+// -------------------------------------------------------- PipelineLayoutModel -----------------------------------------------
+
+// NameId -> position in one of the model's lists, the first one when a name repeats. Built on first
+// use and kept current by the editor actions; anything else that replaces a list drops it. A lookup
+// still checks what it finds against the list, and rebuilds if the list changed length behind its back.
+struct ModelNameIndex {
+    std::vector<int> positions;     // -1, or past the end, for names no entry has.
+    size_t size = 0;
+    bool valid = false;
+    bool repeats = false;   // Some name occurs twice: renames and reorders rebuild rather than patch.
+};
+
+// Which sets of one pipeline layout list a binding: bit b stands for set word * 64 + b.
+struct BindingUsage {
+    uint32_t layout;
+    uint32_t word;
+    uint64_t sets;
+};
+
+// The reverse of DescriptorSet::dlayouts: per binding slot, its BindingUsages sorted by layout and word,
+// one per pipeline layout that uses it in the common case of at most 64 sets. Built on first use and
+// kept current by the editor actions, in time proportional to the references they touch (deleting a
+// layout renumbers every entry after it; in a transaction, for all the deletes at once, on the next use).
+struct ModelUsageIndex {
+    std::vector< std::vector<BindingUsage> > usages;
+    // When not empty, layouts have been deleted in a transaction and the entries not yet renumbered:
+    // the number the entries still use for each layout there is now.
+    std::vector<uint32_t> renumber;
+    bool valid = false;
+};
+
+// typeIdx and stageFlagBits of every binding, in dlayouts() order, for the passes in binding_filter.hpp.
+// A copy of what the DescriptorLayouts hold: built on first use and kept current by the editor actions.
+struct ModelBindingColumns {
+    std::vector<int32_t> types;
+    std::vector<uint32_t> stages;
+    bool valid = false;
+};
+
+// GUI-free project model. Holds the pipeline layouts, the global set list and the global binding list,
+// plus every editor action and the .vkpipeline.json / .vkpipeline.bin load / save. Used by the editor window and by vkplc.
+class PipelineLayoutModel
+{
+protected:
+    CowVector<PipelineLayout> m_layouts;
+    SlabArena m_arena;              // Bindings and, when loaded, their data and comments.
+    CowVector<DescriptorLayoutPtr> m_dlayouts;
+    BindingSlotTable m_slots;
+    CowVector<NameId> m_dsets;
+    NamePool m_names;
+    std::string m_filename = "default.vkpipeline.json";
+    std::vector<ModelEditListener*> m_listeners;
+    ModelUndoRecorder* m_undo = nullptr;
+    ModelEdit m_inverse = {};       // Of the action under way, set just before it changes anything.
+    std::string m_inverseText;
+
+    // An edit held while a transaction is open. Its text, if any, is kept alongside; edit.text itself
+    // only tells whether there is one until the edit is handed on.
+    struct HeldEdit {
+        ModelEdit edit;
+        std::string text;
+    };
+    struct Transaction {
+        int depth = 0;
+        bool aborting = false;
+        std::vector<HeldEdit> edits;        // For the listeners; superseded ones have op 0.
+        std::vector<HeldEdit> inverses;     // For abortTransaction(), in the order the edits were made.
+        std::unordered_map<uint64_t, size_t> targets;   // Target of a set / rename edit -> its place in edits.
+    };
+    Transaction m_transaction;
+
+    int m_fileFormat = PROJECT_FORMAT_INDEXED;
+    mutable ModelNameIndex m_layoutIndex;
+    mutable ModelNameIndex m_setIndex;
+    mutable ModelNameIndex m_bindingIndex;
+    mutable ModelUsageIndex m_usageIndex;
+    mutable ModelBindingColumns m_columns;
+    uint64_t m_generation = 0;      // Bumped by invalidateIndexes().
+
+    // For code that fills or replaces the lists directly rather than through the editor actions. Also
+    // resets the undo recorder, forgets any open transaction and moves generation() on.
+    void invalidateIndexes(void);
+    std::vector<BindingUsage>& usages(BindingHandle h) const;
+    std::vector<BindingUsage>& unsettledUsages(BindingHandle h) const;
+    void settleUsages(void) const;
+    uint32_t usageNumber(int layout) const;     // The number a layout's entries use.
+    int usageLayout(uint32_t number) const;
+    void usageLayoutAdded(void);
+    ModelBindingColumns& columns(void) const;
+    void removeFromSet(int layout, int set, int idx);
+    CowVector<BindingHandle>& editSet(int layout, int set) { return m_layouts.edit(layout).descsets.edit(set).dlayouts; }
+    void pruneSet(int layout, int set) { m_layouts.edit(layout).descsets.prune(set); }
+    std::shared_ptr<DescriptorLayout> makeBinding(NameId name) { return m_arena.makeShared<DescriptorLayout>(name); }
+    void appendBinding(std::shared_ptr<DescriptorLayout> dl);
+    DescriptorLayout& editBinding(int idx);        // Copies the binding first if a snapshot shares it.
+    static void assignHandles(std::vector< std::shared_ptr<DescriptorLayout> >& dlayouts, BindingSlotTable& slots);
+    int resolveBinding(BindingHandle h) const;     // bindingIndex(), throwing for a dangling handle.
+    void compactNames(void);                       // Drops pool entries nothing refers to, renumbering the rest.
+
+    void serializeIndexed(JsonStreamWriter& writer) const;
+    void serializeNamed(JsonStreamWriter& writer) const;
+    bool hasUniqueNames(void) const;
+    void deserializeNamed(JsonStreamReader& r, std::string& key, bool more, const std::string* onlyLayout);
+    void notify(ModelEditOp op, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0, const char* text = nullptr);
+    void holdEdit(const ModelEdit& edit, const ModelEdit& inverse);
+
+    // Undo and rollback support. Inverses are only worked out when wantInverse(); the *Payload() functions
+    // write the JSON the restore actions take, describing what a delete is about to drop.
+    bool wantInverse(void) const { return m_undo || m_transaction.depth; }
+    void setInverse(ModelEditOp op, int32_t a = 0, int32_t b = 0, int32_t c = 0, int32_t d = 0, const char* text = nullptr);
+    void layoutPayload(int idx, std::string& out) const;
+    void lastSetPayload(int idx, std::string& out) const;
+    void bindingPayload(int idx, std::string& out) const;
+    void bindingStagesPayload(const std::vector<int>& changed, std::string& out) const;
+    void restoreLayout(int idx, const char* json);
+    void restoreDescset(int layout, int idx, const char* json);
+    void restoreDesclayout(int idx, const char* json);
+    void restoreBindingStages(const char* json);
+
+public:
+    // ---------------------- Editor actions ----------------------
+
+    void initDefault(void);
+    void clear(void);
+
+    void addLayout(const char* name);
+    void delLayout(int idx);
+    void renameLayout(int idx, const char* name);
+    void reorderLayout(int& idx, bool up);
+    // Appends a copy of layout idx under a new name. O(1): the copy shares its sets with the original
+    // until either is edited. Keeping the usage index current adds time for each binding the copy lists.
+    void cloneLayout(int idx, const char* name);
+
+    void addDescset(int layout, const char* name);
+    void delDescset(int layout, int idx);
+    void renameDescset(int layout, int idx, const char* name);
+    void reorderDescset(int layout, int& idx, bool up);
+
+    void reorderDescsetlayout(int layout, int set, int& idx, bool up);
+    void delDescsetlayout(int layout, int set, int idx);
+    void addDescsetlayout(int layout, int set, int bindingIdx);
+    // Puts the binding at position idx of the set, even if the set lists it already: how undo brings back
+    // an entry delDescsetlayout() took.
+    void insertDescsetlayout(int layout, int set, int idx, int bindingIdx);
+
+    void addDesclayout(const char* name);
+    void delDesclayout(int idx);
+    void renameDesclayout(int idx, const char* name);
+    void reorderDesclayout(int& idx, bool up);
+
+    void setDesclayoutType(int idx, int typeIdx);
+    void setDesclayoutStages(int idx, uint32_t stageFlagBits);
+    void setDesclayoutData(int idx, const char* data);
+    void setDesclayoutComment(int idx, const char* comment);
+
+    // Sets and clears stage bits on every binding filterBindings() would return, in one pass over the
+    // columns. Reported as a single EDIT_UPDATE_BINDING_STAGES, undone by a single
+    // EDIT_RESTORE_BINDING_STAGES holding the changed bindings' old stages. Returns how many changed.
+    int updateBindingStages(uint32_t typeMask, uint32_t stageMask, uint32_t setBits, uint32_t clearBits);
+
+    // Runs the action an edit describes; listeners see it again. Wholesale changes (initDefault(),
+    // clear(), load(), deserialize*(), restore()) are not edits and are not reported.
+    void applyEdit(const ModelEdit& edit);
+    void addEditListener(ModelEditListener* listener);
+    void removeEditListener(ModelEditListener* listener);
+    // At most one; nullptr detaches. Inverses are only worked out while a recorder is attached.
+    void setUndoRecorder(ModelUndoRecorder* recorder) { m_undo = recorder; }
+    ModelUndoRecorder* undoRecorder(void) const { return m_undo; }
+
+    // ---------------------- Transactions ----------------------
+
+    // Edits in a transaction take effect at once, as always, but listeners hear of them at the commit, as
+    // one ModelChangeSet, and the undo recorder gets them as one group. Index upkeep that would cost more
+    // than the edit itself is put off: the usage index is renumbered for deleted layouts, and the binding
+    // columns rebuilt for deleted bindings, once, on first use after the deletes. Aborting takes
+    // the edits back through their inverses, in time proportional to them, and nobody hears of them.
+    // Transactions nest; only the outermost commit counts, and an abort at any depth ends them all.
+    // Wholesale changes forget an open transaction without reporting it.
+    void beginTransaction(void);
+    void commitTransaction(void);
+    void abortTransaction(void);
+    bool inTransaction(void) const { return m_transaction.depth > 0; }
+
+    // ---------------------- Queries ----------------------
+
+    // Position of the first layout / set / binding with that name, -1 if there is none. O(1).
+    int findLayout(const std::string& name) const;
+    int findDescset(const std::string& name) const;
+    int findDesclayout(const std::string& name) const;
+    int findLayout(NameId name) const;
+    int findDescset(NameId name) const;
+    int findDesclayout(NameId name) const;
+
+    const DescriptorLayout* findDescLayoutByName(const std::string name);
+    int findDescLayoutByPtr(const DescriptorLayout* dlayout) const;
+
+    // Handle <-> position in dlayouts(), both O(1). bindingIndex() is -1 and binding() nullptr
+    // for a handle whose binding has been deleted.
+    int bindingIndex(BindingHandle h) const { return m_slots.find(h); }
+    BindingHandle bindingHandle(int idx) const { return m_dlayouts[idx]->handle; }
+    const DescriptorLayout* binding(BindingHandle h) const
+    {
+        int idx = m_slots.find(h);
+        return idx < 0 ? nullptr : m_dlayouts[idx].get();
+    }
+
+    CowVector<BindingHandle>& findDLV(int layout, const std::string name);
+    void getDLGetSetList(int layout, const DescriptorLayout* dl, std::vector<bool>& out);
+    void getDLSetSetList(int layout, const DescriptorLayout* dl, std::vector<bool>& in);
+
+    // Every (pipeline layout, set) that lists dl, in layout then set order. Time proportional to
+    // the number of layouts using dl.
+    void findUsages(const DescriptorLayout* dl, std::vector< std::pair<int, int> >& out) const;
+    bool isInSet(const DescriptorLayout* dl, int layout, int set) const;
+
+    // Appends the position of every binding of a type in typeMask (bit t for typeIdx t, BINDING_TYPES_ANY
+    // for all) that has any of the stages in stageMask (0 for all), in order. Vectorized over m_columns.
+    void filterBindings(uint32_t typeMask, uint32_t stageMask, std::vector<int>& out) const;
+
+    const CowVector<PipelineLayout>& layouts(void) const { return m_layouts; }
+    const CowVector<DescriptorLayoutPtr>& dlayouts(void) const { return m_dlayouts; }
+    const CowVector<NameId>& dsets(void) const { return m_dsets; }
+
+    // Every layout, set and binding name, interned. Ids are the model's own: they mean nothing to
+    // another model and are reassigned by clear() and every load.
+    const NamePool& names(void) const { return m_names; }
+    const std::string& filename(void) const { return m_filename; }
+    // Changes with every wholesale change, which no edit reports: what is kept current from the edits
+    // has to start over when it does.
+    uint64_t generation(void) const { return m_generation; }
+
+    // ProjectFormat the next save writes .vkpipeline.json files in. load() / deserialize() set it to
+    // what they read; .vkpipeline.bin files leave it alone.
+    int fileFormat(void) const { return m_fileFormat; }
+    void setFileFormat(int format);
+
+    // Appends a message for every structural problem found. Returns true if the model is consistent.
+    bool validate(std::vector<std::string>& errors) const;
+
+    // Binding data and comments: their decoded size and what they take as stored.
+    void blobUsage(size_t& decodedBytes, size_t& storedBytes) const;
+    // Slabs the bindings have been allocated from, over the model's lifetime.
+    const SlabArena::Stats& arenaStats(void) const { return m_arena.stats(); }
+
+    // ---------------------- I/O ----------------------
+
+    static std::string normalizeFileName(std::string fileName);
+
+    // In-memory form of the .vkpipeline.json format. deserialize() throws on malformed input.
+    // serialize() / deserialize() stream straight between the model and the text; serializeDom() and
+    // deserializeDom() are the original Json::Value paths, kept as the reference for vkplc bench. They
+    // only know PROJECT_FORMAT_INDEXED, in which STYLE_PRETTY output is byte-identical to serializeDom().
+    void serialize(std::string& out, JsonStreamWriter::Style style = JsonStreamWriter::STYLE_PRETTY) const;
+    void serialize(JsonStreamWriter& writer) const;
+    void serializeDom(std::string& out) const;
+    void deserialize(const char* begin, const char* end);
+    void deserializeDom(const char* begin, const char* end);
+
+    // Partial read: just the named pipeline layout, every set and the bindings the layout uses, in
+    // their usual order. A PROJECT_FORMAT_NAMED file is only decoded that far; an indexed one is read
+    // whole and pruned. Throws if there is no such layout.
+    void deserializeLayout(const char* begin, const char* end, const std::string& layoutName);
+
+    // .vkpipeline.bin image (pipelinelayout_binary.hpp). deserializeBinary() materializes a mapped view;
+    // cheap queries can use the view directly and skip the model.
+    void serializeBinary(std::string& out) const;
+    void deserializeBinary(const PipelineLayoutBinary& bin);
+    static bool isBinaryFileName(const std::string& fileName);
+
+    // snapshot() fills in a PipelineLayoutSnapshot that shares the model's contents; restore() makes the
+    // model share a snapshot's. Both O(1). Used to save on another thread while editing goes on.
+    void snapshot(PipelineLayoutSnapshot& out) const;
+    void restore(const PipelineLayoutSnapshot& snap);
+
+    // writeFile() replaces fileName atomically: it writes and syncs a temp file next to it, then renames
+    // it over the target, so a failed or interrupted save leaves the previous file intact. beforeReplace,
+    // if set, gets the synced temp file's name just before the rename; it may throw to abort the save.
+    // save() is writeFile() plus remembering the name.
+    void writeFile(std::string fileName, JsonStreamWriter::Style style = JsonStreamWriter::STYLE_PRETTY,
+                   const std::function<void(const std::string&)>& beforeReplace = nullptr) const;
+    void save(std::string fileName, JsonStreamWriter::Style style = JsonStreamWriter::STYLE_PRETTY);
+    void load(std::string fileName);
+};
+
+#endif // _PIPELINE_LAYOUT_MODEL_
@@ -0,0 +1,383 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "set_order.hpp"
+#include "layout_compat.hpp"
+#include "pipelinelayout_binary.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <unordered_map>
+
+using namespace std;
+
+// -------------------------------------------------------- DrawTrace -----------------------------------------------
+
+void DrawTrace::load(const PipelineLayoutModel& model, const std::string& fileName)
+{
+    MappedFile file(fileName);
+    try {
+        parse(model, file.data(), file.size());
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(fileName + ": " + e.what());
+    }
+}
+
+void DrawTrace::parse(const PipelineLayoutModel& model, const char* data, size_t size)
+{
+    m_events.clear();
+    m_numDraws = 0;
+    const char* end = data + size;
+    size_t line = 0;
+    for (const char* p = data; p < end;) {
+        const char* eol = (const char*) memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        const char* e = eol;
+        line++;
+        while (p < e && (*p == ' ' || *p == '\t')) p++;
+        while (e > p && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) e--;
+        const char* s = p;
+        p = eol + 1;
+        if (s == e || *s == '#') continue;
+
+        char tag = *s++;
+        if (s < e && *s != ' ' && *s != '\t') tag = 0;
+        while (s < e && (*s == ' ' || *s == '\t')) s++;
+        if (tag == 'd') {
+            uint64_t count = s == e ? 1 : 0;
+            for (; s < e && *s >= '0' && *s <= '9' && count < (UINT64_MAX - 9) / 10; s++) count = count * 10 + (*s - '0');
+            if (s != e) throw std::runtime_error("Line " + to_string(line) + ": bad draw count.");
+            m_numDraws += count;
+            if (count && (m_events.empty() || kind(m_events.size() - 1) != EVENT_DRAW)) m_events.push_back(EVENT_DRAW << 30);
+        } else if (tag == 'p' || tag == 'u') {
+            NameId name = model.names().find(s, e - s);
+            int idx = name == NAME_NONE ? -1 : tag == 'p' ? model.findLayout(name) : model.findDesclayout(name);
+            if (idx < 0) {
+                throw std::runtime_error("Line " + to_string(line) + ": unknown " +
+                    (tag == 'p' ? "pipeline layout " : "binding ") + string(s, e) + ".");
+            }
+            m_events.push_back(((uint32_t) (tag == 'p' ? EVENT_PIPELINE : EVENT_UPDATE) << 30) | (uint32_t) idx);
+        } else {
+            throw std::runtime_error("Line " + to_string(line) + ": expected p, u or d.");
+        }
+    }
+}
+
+// -------------------------------------------------------- Replay -----------------------------------------------
+
+static inline int CountTrailingZeros(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return (int) idx;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+static inline int CountBits(uint64_t v)
+{
+#ifdef _MSC_VER
+    return (int) __popcnt64(v);
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+namespace {
+
+// The part of a draw the set order decides: sets whose layout differs from the previous draw's, sets
+// the layout uses, and those of them that were written.
+struct DrawKey {
+    uint64_t differ;
+    uint64_t used;
+    uint64_t written;
+    bool operator==(const DrawKey& o) const { return differ == o.differ && used == o.used && written == o.written; }
+};
+
+struct DrawKeyHash {
+    size_t operator()(const DrawKey& k) const
+    {
+        uint64_t h = k.differ * 0x9E3779B97F4A7C15ull;
+        h = (h ^ (h >> 29) ^ k.used) * 0xBF58476D1CE4E5B9ull;
+        h = (h ^ (h >> 32) ^ k.written) * 0x94D049BB133111EBull;
+        return (size_t) (h ^ (h >> 31));
+    }
+};
+
+// What one replay of a trace over a project leaves: the work no order changes, the draws to weigh
+// orders by, and what the binding moves are picked by.
+struct Replay {
+    uint32_t numSets = 0;
+    SetOrderPlan::Work written;
+    unordered_map<DrawKey, uint64_t, DrawKeyHash> draws;
+    vector<uint64_t> bindingSets;       // Per binding: the sets listing it, in any layout.
+    vector<uint64_t> bindingUpdates;    // Per binding: draws with an update of it pending.
+    vector<uint64_t> setWrites;         // Per set: draws that wrote it.
+};
+
+}
+
+static void ReplayTrace(const PipelineLayoutModel& model, const DrawTrace& trace, Replay& out)
+{
+    LayoutCompatibility compat;
+    compat.build(model);
+    uint32_t numSets = compat.numSets();
+    if (numSets > 64) throw std::runtime_error("More than 64 sets.");
+    size_t numLayouts = model.layouts().size(), numBindings = model.dlayouts().size();
+    vector<uint64_t> used(numLayouts, 0);
+    vector<uint32_t> sizes(numLayouts * numSets, 0);
+    out = Replay();
+    out.numSets = numSets;
+    out.bindingSets.assign(numBindings, 0);
+    out.bindingUpdates.assign(numBindings, 0);
+    out.setWrites.assign(numSets, 0);
+    for (size_t l = 0; l < numLayouts; l++) {
+        for (auto& dset: model.layouts()[l].descsets) {
+            if (dset.index >= numSets) continue;
+            used[l] |= 1ull << dset.index;
+            sizes[l * numSets + dset.index] = (uint32_t) dset.dlayouts.size();
+            for (BindingHandle h: dset.dlayouts) {
+                int b = model.bindingIndex(h);
+                if (b >= 0) out.bindingSets[b] |= 1ull << dset.index;
+            }
+        }
+    }
+
+    vector<uint64_t> updatedAt(numBindings, 0);
+    uint64_t draw = 1, dirty = 0;
+    uint64_t all = numSets == 64 ? ~0ull : (1ull << numSets) - 1;
+    int layout = -1, previous = -1;
+    // Runs of the same key are frequent; count them before going to the table.
+    DrawKey run = { 0, 0, 0 };
+    uint64_t runLength = 0;
+    out.written.draws = trace.numDraws();
+    for (size_t i = 0; i < trace.numEvents(); i++) {
+        int idx = trace.index(i);
+        switch (trace.kind(i)) {
+        case DrawTrace::EVENT_PIPELINE:
+            layout = idx;
+            break;
+        case DrawTrace::EVENT_UPDATE:
+            dirty |= out.bindingSets[idx];
+            if (updatedAt[idx] != draw) {
+                updatedAt[idx] = draw;
+                out.bindingUpdates[idx]++;
+            }
+            break;
+        case DrawTrace::EVENT_DRAW: {
+            if (layout < 0) break;
+            draw++;
+            DrawKey key = { all, used[layout], dirty & used[layout] };
+            if (previous == layout) {
+                key.differ = 0;
+            } else if (previous >= 0) {
+                key.differ = 0;
+                for (uint32_t s = 0; s < numSets; s++) {
+                    if (compat.setLayout(previous, s) != compat.setLayout(layout, s)) key.differ |= 1ull << s;
+                }
+            }
+            for (uint64_t m = key.written; m; m &= m - 1) {
+                int s = CountTrailingZeros(m);
+                out.written.setsWritten++;
+                out.written.descriptorsWritten += sizes[layout * numSets + s];
+                out.setWrites[s]++;
+            }
+            dirty &= ~key.used;
+            previous = layout;
+            if (!key.differ && !key.written) break;
+            if (runLength && key == run) {
+                runLength++;
+                continue;
+            }
+            if (runLength) out.draws[run] += runLength;
+            run = key;
+            runLength = 1;
+            break;
+        }
+        }
+    }
+    if (runLength) out.draws[run] += runLength;
+}
+
+// Binding work for the replayed draws with set s at index position[s].
+static void OrderWork(const Replay& r, const vector<int>& position, SetOrderPlan::Work& work)
+{
+    work = r.written;
+    for (auto& d: r.draws) {
+        const DrawKey& key = d.first;
+        int first = (int) r.numSets;
+        for (uint64_t m = key.differ; m; m &= m - 1) first = min(first, position[CountTrailingZeros(m)]);
+        uint64_t positions = 0;
+        for (uint64_t m = key.used; m; m &= m - 1) {
+            int s = CountTrailingZeros(m);
+            if (position[s] >= first || ((key.written >> s) & 1)) positions |= 1ull << position[s];
+        }
+        work.setsBound += CountBits(positions) * d.second;
+        work.bindCalls += CountBits(positions & ~(positions << 1)) * d.second;
+    }
+}
+
+static bool LessWork(const SetOrderPlan::Work& a, const SetOrderPlan::Work& b)
+{
+    return a.total() != b.total() ? a.total() < b.total() : a.bindCalls < b.bindCalls;
+}
+
+// The order of the replay's sets with the least work; order[k] is the set that goes to index k.
+static void BestOrder(const Replay& r, vector<int>& order, SetOrderPlan::Work& work)
+{
+    const uint64_t EXHAUSTIVE_STEPS = 50000000;
+    int n = (int) r.numSets;
+    vector<int> position(n), trial(n);
+    order.resize(n);
+    for (int k = 0; k < n; k++) order[k] = position[k] = k;
+    OrderWork(r, position, work);
+
+    uint64_t steps = max<size_t>(r.draws.size(), 1);
+    for (int k = 2; k <= n && steps <= EXHAUSTIVE_STEPS; k++) steps *= k;
+    SetOrderPlan::Work w;
+    if (steps <= EXHAUSTIVE_STEPS) {
+        trial = order;
+        while (next_permutation(trial.begin(), trial.end())) {
+            for (int k = 0; k < n; k++) position[trial[k]] = k;
+            OrderWork(r, position, w);
+            if (LessWork(w, work)) {
+                work = w;
+                order = trial;
+            }
+        }
+        return;
+    }
+    for (bool improved = true; improved;) {
+        improved = false;
+        for (int i = 0; i < n; i++) {
+            for (int j = i + 1; j < n; j++) {
+                trial = order;
+                swap(trial[i], trial[j]);
+                for (int k = 0; k < n; k++) position[trial[k]] = k;
+                OrderWork(r, position, w);
+                if (LessWork(w, work)) {
+                    work = w;
+                    order = trial;
+                    improved = true;
+                }
+            }
+        }
+    }
+}
+
+static void MoveBinding(PipelineLayoutModel& model, const SetOrderPlan::Move& move)
+{
+    BindingHandle h = model.bindingHandle(move.binding);
+    vector<pair<int, int>> uses;
+    model.findUsages(model.dlayouts()[move.binding].get(), uses);
+    for (auto& u: uses) {
+        if (u.second != move.from) continue;
+        auto& list = model.layouts()[u.first].descsets[move.from].dlayouts;
+        int idx = (int) (find(list.begin(), list.end(), h) - list.begin());
+        model.delDescsetlayout(u.first, move.from, idx);
+        model.addDescsetlayout(u.first, move.to, move.binding);
+    }
+}
+
+void PlanSetOrder(const PipelineLayoutModel& model, const DrawTrace& trace, SetOrderPlan& plan, int maxReplays)
+{
+    plan = SetOrderPlan();
+    Replay best;
+    ReplayTrace(model, trace, best);
+    plan.replays = 1;
+    vector<int> identity(best.numSets);
+    for (size_t k = 0; k < identity.size(); k++) identity[k] = (int) k;
+    OrderWork(best, identity, plan.current);
+    BestOrder(best, plan.order, plan.reordered);
+    plan.planned = plan.reordered;
+    if (best.numSets < 2) return;
+
+    PipelineLayoutSnapshot snap;
+    model.snapshot(snap);
+    PipelineLayoutModel accepted, candidate;
+    accepted.restore(snap);
+    vector<bool> tried(best.bindingSets.size(), false);
+    Replay replay;
+    vector<int> order;
+    SetOrderPlan::Work work;
+    while (plan.replays < maxReplays) {
+        // The binding in one set that set is written most often without: a write of that set
+        // that did not need to include it.
+        SetOrderPlan::Move move = { -1, -1, -1 };
+        uint64_t waste = 0;
+        for (size_t b = 0; b < best.bindingSets.size(); b++) {
+            uint64_t sets = best.bindingSets[b];
+            if (tried[b] || CountBits(sets) != 1) continue;
+            int s = CountTrailingZeros(sets);
+            if (best.setWrites[s] > best.bindingUpdates[b] && best.setWrites[s] - best.bindingUpdates[b] > waste) {
+                waste = best.setWrites[s] - best.bindingUpdates[b];
+                move = { (int) b, s, -1 };
+            }
+        }
+        if (move.binding < 0) break;
+        tried[move.binding] = true;
+        // Into the set written least often that is still written at least as often as the binding
+        // changes; the most written one if none is.
+        uint64_t updates = best.bindingUpdates[move.binding];
+        auto better = [updates](uint64_t a, uint64_t b) {
+            if ((a >= updates) != (b >= updates)) return a >= updates;
+            return a >= updates ? a < b : a > b;
+        };
+        for (int s = 0; s < (int) best.numSets; s++) {
+            if (s != move.from && (move.to < 0 || better(best.setWrites[s], best.setWrites[move.to]))) move.to = s;
+        }
+
+        accepted.snapshot(snap);
+        candidate.restore(snap);
+        MoveBinding(candidate, move);
+        ReplayTrace(candidate, trace, replay);
+        plan.replays++;
+        BestOrder(replay, order, work);
+        if (!LessWork(work, plan.planned)) continue;
+        candidate.snapshot(snap);
+        accepted.restore(snap);
+        swap(best, replay);
+        plan.planned = work;
+        plan.order = order;
+        plan.moves.push_back(move);
+    }
+}
+
+void ApplySetOrderPlan(PipelineLayoutModel& model, const SetOrderPlan& plan)
+{
+    model.beginTransaction();
+    for (auto& move: plan.moves) MoveBinding(model, move);
+    // Where each set currently is, moving plan.order[k] up to k in turn.
+    vector<int> at(plan.order.size());
+    for (size_t k = 0; k < at.size(); k++) at[k] = (int) k;
+    for (int k = 0; k < (int) plan.order.size(); k++) {
+        int idx = (int) (find(at.begin(), at.end(), plan.order[k]) - at.begin());
+        while (idx > k) {
+            swap(at[idx], at[idx - 1]);
+            model.reorderDescset(0, idx, true);
+        }
+    }
+    model.commitTransaction();
+}
@@ -0,0 +1,95 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _SET_ORDER_
+#define _SET_ORDER_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "pipelinelayout_model.hpp"
+
+// A draw trace recorded from an application, one event per line:
+//   p LAYOUT    the following draws use pipeline layout LAYOUT
+//   u BINDING   BINDING now refers to another resource: the sets holding it are stale
+//   d [N]       N draws, 1 if omitted
+//   # ...       a comment; blank lines are skipped too
+// Names are the project's. The file is mapped and read in one pass, into four bytes per event.
+class DrawTrace
+{
+public:
+    enum EventKind { EVENT_DRAW, EVENT_PIPELINE, EVENT_UPDATE };
+
+    // Throw std::runtime_error naming the line of a malformed event or an unknown name.
+    void load(const PipelineLayoutModel& model, const std::string& fileName);
+    void parse(const PipelineLayoutModel& model, const char* data, size_t size);
+
+    // Consecutive draws are one event.
+    size_t numEvents(void) const { return m_events.size(); }
+    uint64_t numDraws(void) const { return m_numDraws; }
+    EventKind kind(size_t i) const { return (EventKind) (m_events[i] >> 30); }
+    // The pipeline layout or binding an event names.
+    int index(size_t i) const { return (int) (m_events[i] & 0x3FFFFFFF); }
+
+private:
+    std::vector<uint32_t> m_events;     // Kind in the top two bits.
+    uint64_t m_numDraws = 0;
+};
+
+// A set order and binding moves for a project, chosen for the least work replaying a DrawTrace. Before
+// a draw, each set the layout uses that holds a binding updated since the set was last written is
+// written again, all of its descriptors; then the used sets that were written, or that the switch from
+// the layout of the previous draw disturbed, are bound, one call per run of consecutive set indices.
+struct SetOrderPlan {
+    struct Work {
+        uint64_t draws = 0;
+        uint64_t setsBound = 0;
+        uint64_t bindCalls = 0;
+        uint64_t setsWritten = 0;
+        uint64_t descriptorsWritten = 0;
+        uint64_t total(void) const { return setsBound + descriptorsWritten; }
+    };
+    // All uses of a binding go from one set to another; indices are the project's, before reordering.
+    struct Move {
+        int binding;
+        int from;
+        int to;
+    };
+
+    Work current;               // The project as it is.
+    Work reordered;             // The best set order, nothing moved.
+    Work planned;               // The moves, and the best set order after them.
+    std::vector<int> order;     // order[k]: the set, by index after the moves, that goes to index k.
+    std::vector<Move> moves;
+    int replays = 0;
+};
+
+// Sets are ordered by exhaustive search when the trace's distinct draws are few enough, by swapping pairs
+// until nothing improves otherwise. Bindings that only ever appear in one set are moved one at a time,
+// those written most often without being updated first, each move kept if a replay of the trace shows
+// less work; at most maxReplays replays. Throws std::runtime_error past 64 sets.
+void PlanSetOrder(const PipelineLayoutModel& model, const DrawTrace& trace, SetOrderPlan& plan, int maxReplays = 32);
+// Through the editor actions, in one transaction.
+void ApplySetOrderPlan(PipelineLayoutModel& model, const SetOrderPlan& plan);
+
+#endif // _SET_ORDER_
@@ -0,0 +1,110 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "slab_arena.hpp"
+#include <new>
+#include <atomic>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+static const size_t SLAB_SIZE = 64 * 1024;      // Also the alignment, which is what lets release() find the slab.
+
+// live counts the allocations not yet released, plus one for the arena while it bumps through the
+// slab; whoever takes it to zero frees the slab.
+struct SlabHeader {
+    std::atomic<size_t> live;
+};
+
+static const size_t SLAB_HEADER = (sizeof(SlabHeader) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+
+static void* AllocSlab(size_t size)
+{
+#ifdef _WIN32
+    void* p = _aligned_malloc(size, SLAB_SIZE);
+#else
+    void* p = aligned_alloc(SLAB_SIZE, size);
+#endif
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+static void FreeSlab(void* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+SlabArena::~SlabArena()
+{
+    if (m_slab) retire(m_slab);
+}
+
+SlabHeader* SlabArena::newSlab(size_t size)
+{
+    size = (size + SLAB_SIZE - 1) & ~(SLAB_SIZE - 1);
+    SlabHeader* slab = new (AllocSlab(size)) SlabHeader();
+    slab->live.store(1, std::memory_order_relaxed);
+    m_stats.slabs++;
+    m_stats.bytes += size;
+    return slab;
+}
+
+void SlabArena::retire(SlabHeader* slab)
+{
+    if (slab->live.fetch_sub(1, std::memory_order_acq_rel) == 1) FreeSlab(slab);
+}
+
+void* SlabArena::allocate(size_t size, size_t align)
+{
+    m_stats.allocations++;
+    if (size > SLAB_SIZE / 4) {
+        // Its own slab, retired from the start: the one count is the allocation's. The header keeps the
+        // pointer inside the first SLAB_SIZE.
+        SlabHeader* slab = newSlab(SLAB_HEADER + size);
+        return reinterpret_cast<char*>(slab) + SLAB_HEADER;
+    }
+    uintptr_t at = (reinterpret_cast<uintptr_t>(m_next) + align - 1) & ~(uintptr_t) (align - 1);
+    if (!m_slab || at + size > reinterpret_cast<uintptr_t>(m_end)) {
+        SlabHeader* slab = newSlab(SLAB_SIZE);
+        if (m_slab) retire(m_slab);
+        m_slab = slab;
+        m_next = reinterpret_cast<char*>(slab) + SLAB_HEADER;
+        m_end = reinterpret_cast<char*>(slab) + SLAB_SIZE;
+        at = (reinterpret_cast<uintptr_t>(m_next) + align - 1) & ~(uintptr_t) (align - 1);
+    }
+    m_next = reinterpret_cast<char*>(at + size);
+    m_slab->live.fetch_add(1, std::memory_order_relaxed);
+    return reinterpret_cast<void*>(at);
+}
+
+void SlabArena::release(void* p)
+{
+    if (!p) return;
+    SlabHeader* slab = reinterpret_cast<SlabHeader*>(reinterpret_cast<uintptr_t>(p) & ~(uintptr_t) (SLAB_SIZE - 1));
+    if (slab->live.fetch_sub(1, std::memory_order_acq_rel) == 1) FreeSlab(slab);
+}
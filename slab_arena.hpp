@@ -0,0 +1,111 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _SLAB_ARENA_
+#define _SLAB_ARENA_
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+struct SlabHeader;
+
+// Bump allocation out of 64 KB slabs, for the many small objects a project load creates. There is no
+// per-object free: each slab counts what is live in it and goes back to the system, in one call, once
+// that count is zero and the arena has moved on to another slab. Memory handed out stays valid however
+// long it outlives the arena. Requests bigger than a quarter slab get a slab of their own.
+//
+// release() finds the slab from the pointer, so anything from any arena may be released anywhere, on
+// any thread; only allocate() needs the arena to itself.
+class SlabArena
+{
+public:
+    struct Stats {
+        uint64_t slabs = 0;         // Taken from the system by this arena.
+        uint64_t bytes = 0;
+        uint64_t allocations = 0;
+    };
+
+    SlabArena() {}
+    ~SlabArena();
+    SlabArena(const SlabArena&) = delete;
+    SlabArena& operator=(const SlabArena&) = delete;
+
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t));   // Throws std::bad_alloc.
+    static void release(void* p);
+
+    // unique_ptr to a T constructed in the arena; resetting it destroys the T and releases its memory.
+    struct Delete {
+        template <typename T>
+        void operator()(T* p) const { p->~T(); SlabArena::release(p); }
+    };
+    template <typename T, typename... Args>
+    std::unique_ptr<T, Delete> make(Args&&... args)
+    {
+        void* p = allocate(sizeof(T), alignof(T));
+        try {
+            return std::unique_ptr<T, Delete>(new (p) T(std::forward<Args>(args)...));
+        } catch (...) {
+            release(p);
+            throw;
+        }
+    }
+
+    // For std::allocate_shared(): the T and its reference counts in one allocation, released wherever
+    // the last reference goes.
+    template <typename T>
+    struct Allocator {
+        typedef T value_type;
+        SlabArena* arena;
+
+        Allocator(SlabArena* arena_) : arena(arena_) {}
+        template <typename U>
+        Allocator(const Allocator<U>& o) : arena(o.arena) {}
+        T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+        void deallocate(T* p, size_t) { SlabArena::release(p); }
+        template <typename U>
+        bool operator==(const Allocator<U>& o) const { return arena == o.arena; }
+        template <typename U>
+        bool operator!=(const Allocator<U>& o) const { return arena != o.arena; }
+    };
+    template <typename T, typename... Args>
+    std::shared_ptr<T> makeShared(Args&&... args)
+    {
+        return std::allocate_shared<T>(Allocator<T>(this), std::forward<Args>(args)...);
+    }
+
+    const Stats& stats(void) const { return m_stats; }
+
+private:
+    SlabHeader* newSlab(size_t size);
+    static void retire(SlabHeader* slab);
+
+    SlabHeader* m_slab = nullptr;         // Being bumped through.
+    char* m_next = nullptr;
+    char* m_end = nullptr;
+    Stats m_stats;
+};
+
+#endif // _SLAB_ARENA_
@@ -0,0 +1,113 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "thread_pool.hpp"
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t numThreads)
+    : m_queued(0), m_next(0)
+{
+    if (numThreads == 0) numThreads = thread::hardware_concurrency();
+    if (numThreads == 0) numThreads = 1;
+    for (size_t i = 0; i < numThreads; i++) {
+        m_workers.push_back(make_unique<Worker>());
+    }
+    for (size_t i = 0; i < numThreads; i++) {
+        m_threads.push_back(thread(&ThreadPool::workerMain, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_quit = true;
+    }
+    m_wake.notify_all();
+    for (auto& t: m_threads) t.join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    size_t w = m_next++ % m_workers.size();
+    // Counted before it is pushed: once in a deque it can be stolen, run and counted off at once.
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_pending++;
+        m_queued++;
+    }
+    {
+        lock_guard<mutex> guard(m_workers[w]->lock);
+        m_workers[w]->tasks.push_back(move(task));
+    }
+    m_wake.notify_one();
+}
+
+void ThreadPool::wait(void)
+{
+    unique_lock<mutex> guard(m_lock);
+    m_idle.wait(guard, [this]() { return m_pending == 0; });
+}
+
+bool ThreadPool::popTask(size_t self, std::function<void()>& task)
+{
+    {
+        auto& own = *m_workers[self];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = move(own.tasks.back());
+            own.tasks.pop_back();
+            m_queued--;
+            return true;
+        }
+    }
+    for (size_t i = 1; i < m_workers.size(); i++) {
+        auto& victim = *m_workers[(self + i) % m_workers.size()];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_queued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerMain(size_t self)
+{
+    function<void()> task;
+    while (true) {
+        if (popTask(self, task)) {
+            task();
+            task = nullptr;
+            lock_guard<mutex> guard(m_lock);
+            if (--m_pending == 0) m_idle.notify_all();
+            continue;
+        }
+        unique_lock<mutex> guard(m_lock);
+        m_wake.wait(guard, [this]() { return m_quit || m_queued > 0; });
+        if (m_quit && m_queued == 0) return;
+    }
+}
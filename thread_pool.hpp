@@ -0,0 +1,68 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _THREAD_POOL_
+#define _THREAD_POOL_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+
+// Work-stealing thread pool. Every worker owns a deque; it pops its own work from the back
+// and, when empty, steals from the front of the other workers' deques.
+class ThreadPool
+{
+    struct Worker {
+        std::mutex lock;
+        std::deque< std::function<void()> > tasks;
+    };
+
+    std::vector< std::unique_ptr<Worker> > m_workers;
+    std::vector<std::thread> m_threads;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::atomic<size_t> m_queued;   // tasks sitting in a deque
+    std::atomic<size_t> m_next;
+    size_t m_pending = 0;           // tasks queued or running, guarded by m_lock
+    bool m_quit = false;
+
+    bool popTask(size_t self, std::function<void()>& task);
+    void workerMain(size_t self);
+
+public:
+    // numThreads == 0 picks std::thread::hardware_concurrency().
+    ThreadPool(size_t numThreads = 0);
+    ~ThreadPool();
+
+    size_t size(void) const { return m_threads.size(); }
+    void submit(std::function<void()> task);
+    void wait(void);
+};
+
+#endif // _THREAD_POOL_
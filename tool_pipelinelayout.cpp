@@ -25,71 +25,18 @@
 #include "tool_pipelinelayout.hpp"
 #include <algorithm>
 #include <string>
-#include <fstream>
-#include <json/json.h>
+#include <cassert>
+#include <cstring>
 
 using namespace std;
 
-static vector<string> descLayoutTypes = {
-    "VK_DESCRIPTOR_TYPE_SAMPLER",
-    "VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER",
-    "VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE",
-    "VK_DESCRIPTOR_TYPE_STORAGE_IMAGE",
-    "VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER",
-    "VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER",
-    "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER",
-    "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER",
-    "VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC",
-    "VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC",
-    "VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT"
-};
-static vector<string> stageBits = {
-        "VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT",
-        "VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT",
-        "VK_PIPELINE_STAGE_VERTEX_INPUT_BIT",
-        "VK_PIPELINE_STAGE_VERTEX_SHADER_BIT",
-        "VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT",
-        "VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT",
-        "VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT",
-        "VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT",
-        "VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT",
-        "VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT",
-        "VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT",
-        "VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT",
-        "VK_PIPELINE_STAGE_TRANSFER_BIT",
-        "VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT",
-        "VK_PIPELINE_STAGE_HOST_BIT",
-        "VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT",
-        "VK_PIPELINE_STAGE_ALL_COMMANDS_BIT"
-};
-
 // -------------------------------------------------------- Helpers -----------------------------------------------
 
-template <typename T>
-static vector<const char*> CStrList(vector<T> & list)
-{
-    vector<const char*> list_;
-    for (auto& item: list) list_.push_back(item.name.c_str());
-    return list_;
-}
-static vector<const char*> CStrList(vector<std::string>& list)
-{
-    vector<const char*> list_;
-    for (auto& item: list) list_.push_back(item.c_str());
-    return list_;
-}
-static vector<const char*> CStrList(std::vector< std::unique_ptr<DescriptorLayout> >& list)
-{
-    vector<const char*> list_;
-    for (auto& item: list) list_.push_back(item->name.c_str());
-    return list_;
-}
-
 static int DisplayConfirmWindow(const char* text)
 {
     if (ImGui::BeginPopupModal(text, NULL, ImGuiWindowFlags_AlwaysAutoResize)) {
         ImGui::TextColored(ImVec4(0.953f, 0.208f, 0.42f, 1.0f), "%s Are you sure?", text);
-        ImGui::Text("This cannot be undone.");
+        ImGui::Text("Edit > Undo (Ctrl+Z) brings it back.");
         ImGui::Spacing(); ImGui::Spacing(); ImGui::Spacing();
         ImGui::Separator();
         ImGui::Spacing(); ImGui::Spacing(); ImGui::Spacing();
@@ -146,147 +93,202 @@ static void DisplayAboutWindow(void)
     }
 }
 
-static void DisplayCombo(const char* title, int *current, vector<const char*>& items, vector<char>& buffer)
+static void DisplayCombo(const char* title, int *current, vector<const char*>& items)
 {
-    size_t totalsz = 0;
-    for (auto str : items) totalsz += (strlen(str) + 1);
-    buffer.resize(totalsz + 1);
-    size_t off = 0;
-    for (auto str : items) {
-        memcpy(&buffer[off], str, (strlen(str) + 1));
-        off += (strlen(str) + 1);
-    }
-    buffer[off] = '\0';
-    ImGui::Combo(title, current, buffer.data());
+    ImGui::Combo(title, current, items.data(), (int) items.size());
 }
 
-// src: http://stackoverflow.com/questions/874134/find-if-string-ends-with-another-string-in-c
-inline bool EndsWith(std::string const & value, std::string const & ending)
+// -------------------------------------------------------- PipelineLayoutTool -----------------------------------------------
+
+const char* PipelineLayoutTool::getWindowTitle()
 {
-    if (ending.size() > value.size()) return false;
-    return std::equal(ending.rbegin(), ending.rend(), value.rbegin());
+    return "VK Pipeline Layout Editor";
 }
 
-// -------------------------------------------------------- DescriptorLayout & PipelineLayout -----------------------------------------------
+void PipelineLayoutTool::init(void)
+{
+    for (auto& type: descLayoutTypes) m_typeNames.push_back(type.c_str());
+    addEditListener(this);
+    m_history.attach(*this);
+    initDefault();
+    openJournal();
+}
 
-DescriptorLayout::DescriptorLayout(std::string name_)
-    : name(name_)
-{}
+// Brings back any edits the last session did not save, then journals from here on.
+void PipelineLayoutTool::openJournal(void)
+{
+    try {
+        size_t replayed = m_journal.open(*this, m_filename);
+        m_journalStatus = replayed ? "Recovered " + to_string(replayed) + " unsaved edits." : "";
+    } catch (const std::exception& e) {
+        m_journalStatus = string("Journal off: ") + e.what();
+    }
+}
 
-void DescriptorLayout::stageFlagBitsToBools(std::vector<bool>& out)
+// -------------------------------------------------------- Name lists -----------------------------------------------
+
+void PipelineLayoutTool::onEdit(const ModelEdit& edit)
+{
+    switch (edit.op) {
+    case EDIT_SET_DESCLAYOUT_DATA:
+    case EDIT_SET_DESCLAYOUT_COMMENT:
+        if (!m_typingText && edit.args[0] < (int) m_dlayouts.size() && m_dlayouts[edit.args[0]]->handle == m_textBinding) {
+            if (edit.op == EDIT_SET_DESCLAYOUT_DATA) m_dataStale = true;
+            else m_commentStale = true;
+        }
+        return;
+    case EDIT_SET_DESCLAYOUT_TYPE:
+    case EDIT_SET_DESCLAYOUT_STAGES:
+    case EDIT_UPDATE_BINDING_STAGES:
+    case EDIT_RESTORE_BINDING_STAGES:
+        return;
+    case EDIT_ADD_LAYOUT:
+    case EDIT_DEL_LAYOUT:
+    case EDIT_RENAME_LAYOUT:
+    case EDIT_REORDER_LAYOUT:
+    case EDIT_CLONE_LAYOUT:
+    case EDIT_RESTORE_LAYOUT:
+        m_layoutNames.valid = false;
+        break;
+    case EDIT_ADD_DESCSET:
+    case EDIT_DEL_DESCSET:
+    case EDIT_RENAME_DESCSET:
+    case EDIT_REORDER_DESCSET:
+    case EDIT_RESTORE_DESCSET:
+        m_setNames.valid = false;
+        break;
+    case EDIT_ADD_DESCLAYOUT:
+    case EDIT_DEL_DESCLAYOUT:
+    case EDIT_RENAME_DESCLAYOUT:
+    case EDIT_REORDER_DESCLAYOUT:
+    case EDIT_RESTORE_DESCLAYOUT:
+        m_bindingNames.valid = false;
+        break;
+    default:
+        break;
+    }
+    // Anything else may move, drop or rename what the selected set lists.
+    m_setBindingNames.valid = false;
+}
+
+void PipelineLayoutTool::checkGeneration(void)
 {
-    out[0] = !!(stageFlagBits & VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
-    out[1] = !!(stageFlagBits & VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
-    out[2] = !!(stageFlagBits & VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
-    out[3] = !!(stageFlagBits & VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
-    out[4] = !!(stageFlagBits & VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT);
-    out[5] = !!(stageFlagBits & VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT);
-    out[6] = !!(stageFlagBits & VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT);
-    out[7] = !!(stageFlagBits & VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-    out[8] = !!(stageFlagBits & VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT);
-    out[9] = !!(stageFlagBits & VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
-    out[10] = !!(stageFlagBits & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
-    out[11] = !!(stageFlagBits & VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-    out[12] = !!(stageFlagBits & VK_PIPELINE_STAGE_TRANSFER_BIT);
-    out[13] = !!(stageFlagBits & VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
-    out[14] = !!(stageFlagBits & VK_PIPELINE_STAGE_HOST_BIT);
-    out[15] = !!(stageFlagBits & VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT);
-    out[16] = !!(stageFlagBits & VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    if (generation() == m_namesGeneration) return;
+    m_namesGeneration = generation();
+    m_layoutNames.valid = m_setNames.valid = m_bindingNames.valid = m_setBindingNames.valid = false;
 }
 
-void DescriptorLayout::stageFlagBitsFromBools(std::vector<bool>& out)
+vector<const char*>& PipelineLayoutTool::layoutNames(void)
 {
-    stageFlagBits = 0;
-    if (out[0]) stageFlagBits |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    if (out[1]) stageFlagBits |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
-    if (out[2]) stageFlagBits |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
-    if (out[3]) stageFlagBits |= VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
-    if (out[4]) stageFlagBits |= VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT;
-    if (out[5]) stageFlagBits |= VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT;
-    if (out[6]) stageFlagBits |= VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
-    if (out[7]) stageFlagBits |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    if (out[8]) stageFlagBits |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    if (out[9]) stageFlagBits |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-    if (out[10]) stageFlagBits |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    if (out[11]) stageFlagBits |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-    if (out[12]) stageFlagBits |= VK_PIPELINE_STAGE_TRANSFER_BIT;
-    if (out[13]) stageFlagBits |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    if (out[14]) stageFlagBits |= VK_PIPELINE_STAGE_HOST_BIT;
-    if (out[15]) stageFlagBits |= VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
-    if (out[16]) stageFlagBits |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    checkGeneration();
+    if (!m_layoutNames.valid) {
+        m_layoutNames.items.clear();
+        for (auto& layout: m_layouts) m_layoutNames.items.push_back(m_names.c_str(layout.name));
+        m_layoutNames.valid = true;
+    }
+    return m_layoutNames.items;
 }
 
-PipelineLayout::PipelineLayout(std::string name_)
-    : name(name_)
-{}
+vector<const char*>& PipelineLayoutTool::setNames(void)
+{
+    checkGeneration();
+    if (!m_setNames.valid) {
+        m_setNames.items.clear();
+        for (NameId set: m_dsets) m_setNames.items.push_back(m_names.c_str(set));
+        m_setNames.valid = true;
+    }
+    return m_setNames.items;
+}
 
-// -------------------------------------------------------- PipelineLayoutTool -----------------------------------------------
+vector<const char*>& PipelineLayoutTool::bindingNames(void)
+{
+    checkGeneration();
+    if (!m_bindingNames.valid) {
+        m_bindingNames.items.clear();
+        for (auto& dl: m_dlayouts) m_bindingNames.items.push_back(m_names.c_str(dl->name));
+        m_bindingNames.valid = true;
+    }
+    return m_bindingNames.items;
+}
 
-const char* PipelineLayoutTool::getWindowTitle()
+// Empty when there is no such layout or set.
+vector<const char*>& PipelineLayoutTool::setBindingNames(int layout, int set)
 {
-    return "VK Pipeline Layout Editor";
+    checkGeneration();
+    if (!m_setBindingNames.valid || m_setBindingsOf != make_pair(layout, set)) {
+        m_setBindingNames.items.clear();
+        if (layout < (int) m_layouts.size() && set < (int) m_dsets.size()) {
+            for (BindingHandle dl: m_layouts[layout].descsets[set].dlayouts) {
+                assert(binding(dl));
+                m_setBindingNames.items.push_back(m_names.c_str(binding(dl)->name));
+            }
+        }
+        m_setBindingsOf = make_pair(layout, set);
+        m_setBindingNames.valid = true;
+    }
+    return m_setBindingNames.items;
 }
 
-void PipelineLayoutTool::init(void)
+// -------------------------------------------------------- Saving -----------------------------------------------
+
+// Snapshots the project and hands it to the saver; the frame carries on while it is written.
+void PipelineLayoutTool::startSave(const std::string& fileName)
+{
+    try {
+        string target = normalizeFileName(fileName);
+        if (m_journal.isOpen() && m_journal.fileName() == EditJournal::journalFileName(target)) {
+            // The journal learns which edits the file holds before the file replaces the old one.
+            EditJournal::Mark mark = m_journal.mark();
+            m_saver.save(*this, target, JsonStreamWriter::STYLE_PRETTY,
+                         [this, mark](const string& tmpFile) { m_journal.rebase(tmpFile, mark); });
+        } else {
+            m_saver.save(*this, target);
+        }
+        m_saveStatus = "Saving...";
+    } catch (const std::exception& e) {
+        m_errorTitle = "Save failed";
+        m_error = e.what();
+    }
+}
+
+void PipelineLayoutTool::pollSave(void)
 {
-    m_layouts.push_back(PipelineLayout("LAYOUT_DEFAULT"));
-
-    m_dsets.push_back(("PSET_PER_FRAME"));
-    m_dsets.push_back(("PSET_PER_SCENE"));
-    m_dsets.push_back(("PSET_PER_CAMERA"));
-    m_dsets.push_back(("PSET_PER_MATERIAL"));
-    m_dsets.push_back(("PSET_PER_OBJECT"));
-
-    auto& descset = m_layouts[m_layouts.size() - 1].descsets;
-    descset.push_back(DescriptorSet());
-    descset.push_back(DescriptorSet());
-    descset.push_back(DescriptorSet());
-    descset.push_back(DescriptorSet());
-    descset.push_back(DescriptorSet());
-
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("UBO_FRAME_GLOBAL_INFO"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("UBO_CAMERA_INFO"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("UBO_WORLD_MATRIX"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("UBO_SCENE_PARAMS_GENERIC"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("UBO_MATERIAL_PARAMS_GENERIC"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("UBO_OBJECT_PARAMS_GENERIC"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SSBO_LIGHT_GRID_DATA"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SSBO_BATCHED_DRAWCALL_DATA"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_ARRAY"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_DIFFUSE_MAP"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_NORMAL_MAP"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_SHININESS_MAP"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_METALLIC_MAP"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_IRRADIANCE"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_RADIANCE"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_POSTROCESS0"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_POSTROCESS1"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_POSTROCESS2"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_POSTROCESS3"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_SHADOW0"));
-    m_dlayouts.push_back(make_unique<DescriptorLayout>("SAMPLER_SHADOW1"));
-
-    findDLV(0, "PSET_PER_FRAME").push_back(findDescLayoutByName("UBO_FRAME_GLOBAL_INFO"));
-    findDLV(0, "PSET_PER_CAMERA").push_back(findDescLayoutByName("UBO_CAMERA_INFO"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("UBO_WORLD_MATRIX"));
-    findDLV(0, "PSET_PER_SCENE").push_back(findDescLayoutByName("UBO_SCENE_PARAMS_GENERIC"));
-    findDLV(0, "PSET_PER_MATERIAL").push_back(findDescLayoutByName("UBO_MATERIAL_PARAMS_GENERIC"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("UBO_OBJECT_PARAMS_GENERIC"));
-    findDLV(0, "PSET_PER_CAMERA").push_back(findDescLayoutByName("SSBO_LIGHT_GRID_DATA"));
-    findDLV(0, "PSET_PER_MATERIAL").push_back(findDescLayoutByName("SSBO_BATCHED_DRAWCALL_DATA"));
-    findDLV(0, "PSET_PER_MATERIAL").push_back(findDescLayoutByName("SAMPLER_ARRAY"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_DIFFUSE_MAP"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_NORMAL_MAP"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_SHININESS_MAP"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_METALLIC_MAP"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_IRRADIANCE"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_RADIANCE"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_POSTROCESS0"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_POSTROCESS1"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_POSTROCESS2"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_POSTROCESS3"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_SHADOW0"));
-    findDLV(0, "PSET_PER_OBJECT").push_back(findDescLayoutByName("SAMPLER_SHADOW1"));
+    BackgroundSaver::Result result;
+    while (m_saver.poll(result)) {
+        if (result.ok && m_journal.fileName() != EditJournal::journalFileName(result.fileName)) {
+            // Saved under a new name: the journal moves along with the project.
+            try {
+                m_journal.restart(*this, result.fileName);
+                m_journalStatus.clear();
+            } catch (const std::exception& e) {
+                m_journalStatus = string("Journal off: ") + e.what();
+            }
+        }
+        if (result.ok) {
+            // Only a save that made it takes the project's name; a failed Save As leaves it as it was.
+            m_filename = result.fileName;
+            char buf[64];
+            snprintf(buf, sizeof(buf), "Saved (%.0f ms).", result.snapshotMs + result.writeMs);
+            m_saveStatus = buf;
+        } else {
+            m_saveStatus = "Save failed.";
+            m_errorTitle = "Save failed";
+            m_error = result.error;
+        }
+    }
+    if (m_saver.busy()) m_saveStatus = "Saving...";
+
+    if (!m_error.empty()) {
+        ImGui::OpenPopup(m_errorTitle.c_str());
+    }
+    if (ImGui::BeginPopupModal(m_errorTitle.c_str(), NULL, ImGuiWindowFlags_AlwaysAutoResize)) {
+        ImGui::Text("%s", m_error.c_str());
+        if (ImGui::Button("OK", ImVec2(120, 0))) {
+            m_error.clear();
+            ImGui::CloseCurrentPopup();
+        }
+        ImGui::EndPopup();
+    }
 }
 
 void PipelineLayoutTool::render(int screenWidth, int screenHeight)
@@ -315,26 +317,49 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
                 }
                 if (ImGui::MenuItem("Open..", NULL, nullptr)) {
                     string p;
-                    if (openDialog(p, "vkpipeline.json")) {
-                        this->load(p);
+                    if (openDialog(p, "vkpipeline.json;vkpipeline.bin")) {
+                        // A file that fails to load leaves the open project as it was.
+                        try {
+                            this->load(p);
+                            openJournal();
+                        } catch (const std::exception& e) {
+                            m_errorTitle = "Open failed";
+                            m_error = e.what();
+                        }
                     }
                 }
                 ImGui::Separator();
                 if (ImGui::MenuItem("Save", NULL, nullptr)) {
-                    this->save(m_filename.c_str());
+                    startSave(m_filename);
                 }
                 if (ImGui::MenuItem("Save As..", NULL, nullptr)) {
                     string p = m_filename;
-                    if (saveDialog(p, "vkpipeline.json")) {
-                        this->save(p);
+                    if (saveDialog(p, "vkpipeline.json;vkpipeline.bin")) {
+                        startSave(p);
                     }
                 }
+                bool named = fileFormat() == PROJECT_FORMAT_NAMED;
+                if (ImGui::MenuItem("Refer to bindings by name", NULL, &named)) {
+                    setFileFormat(named ? PROJECT_FORMAT_NAMED : PROJECT_FORMAT_INDEXED);
+                }
                 ImGui::Separator();
                 if (ImGui::MenuItem("Exit", NULL, nullptr)) {
+                    m_saver.wait();
+                    m_journal.close();
                     exit(0);
                 }
                 ImGui::EndMenu();
             }
+            if (ImGui::BeginMenu("Edit"))
+            {
+                if (ImGui::MenuItem("Undo", "Ctrl+Z", false, m_history.canUndo())) {
+                    m_history.undo();
+                }
+                if (ImGui::MenuItem("Redo", "Ctrl+Y", false, m_history.canRedo())) {
+                    m_history.redo();
+                }
+                ImGui::EndMenu();
+            }
             if (ImGui::BeginMenu("Help"))
             {
                 if (ImGui::MenuItem("About", NULL, nullptr)) {
@@ -348,6 +373,18 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
             ImGui::OpenPopup("About VK Pipeline Layout Editor");
             DisplayAboutWindow();
         }
+        pollSave();
+
+        // Text fields keep Ctrl+Z for themselves while they have the focus.
+        ImGuiIO& io = ImGui::GetIO();
+        if (io.KeyCtrl && !io.WantTextInput) {
+            if (ImGui::IsKeyPressed('Z', false)) m_history.undo();
+            if (ImGui::IsKeyPressed('Y', false)) m_history.redo();
+        }
+        // An undo may have taken away what was selected.
+        activeLayoutItem = max(0, min(activeLayoutItem, (int) m_layouts.size() - 1));
+        activeDescsetItem = max(0, min(activeDescsetItem, (int) m_dsets.size() - 1));
+        activeDescBindingItem = max(0, min(activeDescBindingItem, (int) m_dlayouts.size() - 1));
 
         // --------------------------- First column : info and pipeline layouts ---------------------------------
 
@@ -358,6 +395,15 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
                 ImGui::TextColored(ImVec4(0.75f, 0.75f, 0.75f, 1.0f), "(c) Copyright 2016 UAA Software");
                 ImGui::Spacing(); ImGui::Spacing();
                 ImGui::TextWrapped("%s", m_filename.c_str());
+                if (!m_saveStatus.empty()) {
+                    ImGui::TextColored(ImVec4(0.75f, 0.75f, 0.75f, 1.0f), "%s", m_saveStatus.c_str());
+                }
+                if (m_journalStatus.empty() && !m_journal.error().empty()) {
+                    m_journalStatus = "Journal off: " + m_journal.error();
+                }
+                if (!m_journalStatus.empty()) {
+                    ImGui::TextColored(ImVec4(0.75f, 0.75f, 0.75f, 1.0f), "%s", m_journalStatus.c_str());
+                }
                 ImGui::Spacing(); ImGui::Spacing();
             }
             ImGui::Separator();
@@ -365,7 +411,7 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
                 static char newPipelineName[256] = "new_pipeline_name_here";
                 static char renamePipeline[256];
                 auto action = this->displayNamedList("Pipeline Layout", "Pipeline", "pipeline", "PL",
-                    CStrList(m_layouts), activeLayoutItem, 15, newPipelineName, renamePipeline);
+                    layoutNames(), activeLayoutItem, 15, newPipelineName, renamePipeline);
                 switch (action) {
                     case 1: this->reorderLayout(activeLayoutItem, true); break;
                     case 2: this->reorderLayout(activeLayoutItem, false); break;
@@ -375,6 +421,10 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
                     case 0: break;
                     default: assert(!"unknown action.");
                 }
+                if (ImGui::Button("CLONE THIS PIPELINE AS NEW NAME")) {
+                    this->cloneLayout(activeLayoutItem, newPipelineName);
+                }
+                ImGui::Spacing(); ImGui::Spacing(); ImGui::Spacing();
             }
         }
         ImGui::EndChild();
@@ -388,7 +438,7 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
                 static char newDescsetName[256] = "new_descriptor_set_name";
                 static char renameDescset[256];
                 auto action = this->displayNamedList("Global Descriptor Set Layout", "DescSet", "set", "DSET",
-                    CStrList(m_dsets), activeDescsetItem, 8, newDescsetName, renameDescset);
+                    setNames(), activeDescsetItem, 8, newDescsetName, renameDescset);
                 switch (action) {
                     case 1: this->reorderDescset(activeLayoutItem, activeDescsetItem, true); break;
                     case 2: this->reorderDescset(activeLayoutItem, activeDescsetItem, false); break;
@@ -403,18 +453,11 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
             ImGui::Separator();
             {
                 bool bindingLayoutChanged = false;
-                auto& descset = (activeLayoutItem < m_layouts.size()) ?
-                    m_layouts[activeLayoutItem].descsets : std::vector<DescriptorSet>();
-                std::vector<std::string> desclayout;
-                if (activeDescsetItem < descset.size()) {
-                    for (auto& dlayout : descset[activeDescsetItem].dlayouts) {
-                        assert(dlayout);
-                        desclayout.push_back(dlayout->name);
-                    }
-                }
+                auto dlayouts = (activeLayoutItem < m_layouts.size() && activeDescsetItem < m_dsets.size()) ?
+                    m_layouts[activeLayoutItem].descsets[activeDescsetItem].dlayouts : CowVector<BindingHandle>();
 
                 auto action = this->displayNamedList("Descriptor Binding Layout", "DescLayout", "descriptor layout", "DL",
-                    CStrList(desclayout), activeDesclayoutItem, 12, nullptr, nullptr, &bindingLayoutChanged);
+                    setBindingNames(activeLayoutItem, activeDescsetItem), activeDesclayoutItem, 12, nullptr, nullptr, &bindingLayoutChanged);
                 switch (action) {
                     case 1: this->reorderDescsetlayout(activeLayoutItem, activeDescsetItem, activeDesclayoutItem, true); break;
                     case 2: this->reorderDescsetlayout(activeLayoutItem, activeDescsetItem, activeDesclayoutItem, false); break;
@@ -422,9 +465,8 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
                     default: break;
                 }
                 if (bindingLayoutChanged) {
-                    if (activeDescsetItem < descset.size() && activeDesclayoutItem < descset[activeDescsetItem].dlayouts.size()) {
-                        auto* dlayout = descset[activeDescsetItem].dlayouts[activeDesclayoutItem];
-                        activeDescBindingItem = findDescLayoutByPtr(dlayout);
+                    if (activeDesclayoutItem < dlayouts.size()) {
+                        activeDescBindingItem = bindingIndex(dlayouts[activeDesclayoutItem]);
                     }
                 }
             }
@@ -439,11 +481,10 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
             {
                 static char newDescbindingsName[256] = "new_desc_binding_name";
                 static char renameDescbinding[256];
-                
-                auto& desclayout = m_dlayouts;
+
 
                 auto action = this->displayNamedList("Global Descriptor Binding List", "BList", "binding", "DB",
-                    CStrList(desclayout), activeDescBindingItem, 17, newDescbindingsName, renameDescbinding);
+                    bindingNames(), activeDescBindingItem, 17, newDescbindingsName, renameDescbinding);
                 switch (action) {
                     case 1: this->reorderDesclayout(activeDescBindingItem, true); break;
                     case 2: this->reorderDesclayout(activeDescBindingItem, false); break;
@@ -475,19 +516,31 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
 
         ImGui::BeginChild("Column4", ImVec2(0, 0), true);
         {
-            static vector<char> layoutTypesBuffer;
             static vector<bool> dsetsBuffer;
             static vector<bool> stageBitsBuffer;
 
-            DescriptorLayout defaultLayout("");
-            auto& dlayout = activeDescBindingItem < m_dlayouts.size() ? *m_dlayouts[activeDescBindingItem].get() : defaultLayout;
+            DescriptorLayout defaultLayout(NAME_EMPTY);
+            // Held for the frame: an edit below may replace the model's copy while a snapshot frees this one.
+            DescriptorLayoutPtr held = activeDescBindingItem < m_dlayouts.size() ? m_dlayouts[activeDescBindingItem] : nullptr;
+            const DescriptorLayout& dlayout = held ? *held : defaultLayout;
             ImGui::TextColored(ImVec4(0.067f, 0.765f, 0.941f, 1.0f), "Descriptor Binding Edit:");
 
             if (activeDescBindingItem < m_dlayouts.size()) {
 
                 ImGui::Spacing(); ImGui::Spacing();
-                ImGui::Text("Name: %s", dlayout.name.c_str());
-                DisplayCombo("Binding Type", &dlayout.typeIdx, CStrList(descLayoutTypes), layoutTypesBuffer);
+                ImGui::Text("Name: %s", m_names.c_str(dlayout.name));
+                {
+                    static vector< pair<int, int> > usages;
+                    this->findUsages(&dlayout, usages);
+                    int numLayouts = 0;
+                    for (size_t u = 0; u < usages.size(); u++) {
+                        if (u == 0 || usages[u].first != usages[u - 1].first) numLayouts++;
+                    }
+                    ImGui::Text("Used by %d sets in %d pipeline layouts", (int) usages.size(), numLayouts);
+                }
+                int typeIdx = dlayout.typeIdx;
+                DisplayCombo("Binding Type", &typeIdx, m_typeNames);
+                this->setDesclayoutType(activeDescBindingItem, typeIdx);
 
                 ImGui::Spacing(); ImGui::Spacing(); ImGui::Spacing(); ImGui::Spacing();
                 if (ImGui::CollapsingHeader("Belonged Sets & Stages", ImGuiTreeNodeFlags_DefaultOpen)) {
@@ -497,7 +550,7 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
                         this->getDLGetSetList(activeLayoutItem, &dlayout, dsetsBuffer);
                         for (int s = 0; s < m_dsets.size(); s++) {
                             bool sel = dsetsBuffer[s];
-                            ImGui::Selectable(m_dsets[s].c_str(), &sel);
+                            ImGui::Selectable(m_names.c_str(m_dsets[s]), &sel);
                             dsetsBuffer[s] = sel;
                         }
                         this->getDLSetSetList(activeLayoutItem, &dlayout, dsetsBuffer);
@@ -512,32 +565,53 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
                             ImGui::Selectable(stageBits[stage].c_str(), &sel);
                             stageBitsBuffer[stage] = sel;
                         }
-                        dlayout.stageFlagBitsFromBools(stageBitsBuffer);
+                        DescriptorLayout stages(NAME_EMPTY);
+                        stages.stageFlagBitsFromBools(stageBitsBuffer);
+                        this->setDesclayoutStages(activeDescBindingItem, stages.stageFlagBits);
                         ImGui::TreePop();
                     }
                     ImGui::Spacing(); ImGui::Spacing();
                 }
                 if (ImGui::CollapsingHeader("Custom Data & Comment", ImGuiTreeNodeFlags_DefaultOpen)) {
                     ImGui::Spacing(); ImGui::Spacing();
-                    ImGui::Text("Custom binding data:");
                     static char data_[40960];
-                    strcpy_s(data_, 40960, dlayout.data.c_str());
+                    static char data2_[40960];
+                    static string text;
+                    if (dlayout.handle != m_textBinding || generation() != m_textGeneration) {
+                        m_textBinding = dlayout.handle;
+                        m_textGeneration = generation();
+                        m_dataStale = m_commentStale = true;
+                    }
+                    if (m_dataStale) {
+                        dlayout.data.decode(text);
+                        strcpy_s(data_, 40960, text.c_str());
+                        m_dataStale = false;
+                    }
+                    if (m_commentStale) {
+                        dlayout.comment.decode(text);
+                        strcpy_s(data2_, 40960, text.c_str());
+                        m_commentStale = false;
+                    }
+
+                    ImGui::Text("Custom binding data:");
                     auto dataChanged = ImGui::InputTextMultiline("##source", data_, 40960,
                         ImVec2(-1.0f, ImGui::GetTextLineHeight() * 18),
                         ImGuiInputTextFlags_AllowTabInput);
                     if (dataChanged) {
-                        dlayout.data = data_;
+                        m_typingText = true;
+                        this->setDesclayoutData(activeDescBindingItem, data_);
+                        m_typingText = false;
                     }
 
                     ImGui::Spacing(); ImGui::Spacing();
                     ImGui::Text("Binding comment:");
-                    static char data2_[40960];
-                    strcpy_s(data2_, 40960, dlayout.comment.c_str());
                     auto dataChanged2 = ImGui::InputTextMultiline("##source2", data2_, 40960,
                         ImVec2(-1.0f, ImGui::GetTextLineHeight() * 10),
                         ImGuiInputTextFlags_AllowTabInput);
                     if (dataChanged2) {
-                        dlayout.comment = data2_;
+                        m_typingText = true;
+                        this->setDesclayoutComment(activeDescBindingItem, data2_);
+                        m_typingText = false;
                     }
                     ImGui::Spacing(); ImGui::Spacing();
                 }
@@ -549,167 +623,8 @@ void PipelineLayoutTool::render(int screenWidth, int screenHeight)
     ImGui::End();
 }
 
-void PipelineLayoutTool::addLayout(const char* name)
-{
-    if (!strlen(name)) return;
-    for (auto layout: m_layouts) {
-        if (layout.name == name) {
-            return;
-        }
-    }
-    m_layouts.push_back(PipelineLayout(name));
-    m_layouts[m_layouts.size() - 1].descsets.resize(m_dsets.size());
-}
-
-void PipelineLayoutTool::delLayout(int idx)
-{
-    if (idx < 0 || idx >= m_layouts.size()) return;
-    m_layouts.erase(m_layouts.begin() + idx);
-}
-
-void PipelineLayoutTool::renameLayout(int idx, const char* name)
-{
-    if (!strlen(name)) return;
-    if (idx < 0 || idx >= m_layouts.size()) return;
-    m_layouts[idx].name = name;
-}
-
-void PipelineLayoutTool::reorderLayout(int& idx, bool up)
-{
-    if (idx < 0 || idx >= m_layouts.size()) return;
-    int newidx = idx + (up ? -1 : 1);
-    if (newidx < 0 || newidx >= m_layouts.size()) return;
-    iter_swap(m_layouts.begin() + idx, m_layouts.begin() + newidx);
-    idx = newidx;
-}
-
-void PipelineLayoutTool::addDescset(int layout, const char* name)
-{
-    if (!strlen(name)) return;
-    for (auto descset: m_dsets) {
-        if (descset == name) {
-            return;
-        }
-    }
-    m_dsets.push_back((name));
-    for (auto& pl: m_layouts) {
-        pl.descsets.resize(m_dsets.size());
-    }
-}
-
-void PipelineLayoutTool::delDescset(int layout, int idx)
-{
-    if (idx < 0 || idx >= m_dsets.size()) return;
-    m_dsets.erase(m_dsets.begin() + idx);
-    for (auto& pl: m_layouts) {
-        pl.descsets.resize(m_dsets.size());
-    }
-}
-
-void PipelineLayoutTool::renameDescset(int layout, int idx, const char * name)
-{
-    if (!strlen(name)) return;
-    if (idx < 0 || idx >= m_dsets.size()) return;
-    m_dsets[idx] = name;
-}
-
-void PipelineLayoutTool::reorderDescset(int layout, int& idx, bool up)
-{
-    if (idx < 0 || idx >= m_dsets.size()) return;
-    int newidx = idx + (up ? -1 : 1);
-    if (newidx < 0 || newidx >= m_dsets.size()) return;
- 
-    iter_swap(m_dsets.begin() + idx, m_dsets.begin() + newidx);
-
-    for (auto& pl: m_layouts) {
-        pl.descsets.resize(m_dsets.size());
-        iter_swap(pl.descsets.begin() + idx, pl.descsets.begin() + newidx);
-    }
-
-    idx = newidx;
-}
-
-void PipelineLayoutTool::reorderDescsetlayout(int layout, int set, int& idx, bool up)
-{
-    if (layout < 0 || layout >= m_layouts.size()) return;
-    auto& descsets = m_layouts[layout].descsets;
-    if (set < 0 || set >= descsets.size()) return;
-    auto& dslayouts = descsets[set].dlayouts;
-    if (idx < 0 || idx >= dslayouts.size()) return;
-    int newidx = idx + (up ? -1 : 1);
-    if (newidx < 0 || newidx >= dslayouts.size()) return;
-    iter_swap(dslayouts.begin() + idx, dslayouts.begin() + newidx);
-    idx = newidx;
-}
-
-void PipelineLayoutTool::delDescsetlayout(int layout, int set, int idx)
-{
-    if (layout < 0 || layout >= m_layouts.size()) return;
-    auto& descsets = m_layouts[layout].descsets;
-    if (set < 0 || set >= descsets.size()) return;
-    auto& dslayouts = descsets[set].dlayouts;
-    if (idx < 0 || idx >= dslayouts.size()) return;
-    dslayouts.erase(dslayouts.begin() + idx);
-}
-
-void PipelineLayoutTool::addDescsetlayout(int layout, int set, int bindingIdx)
-{
-    if (layout < 0 || layout >= m_layouts.size()) return;
-    auto& descsets = m_layouts[layout].descsets;
-    if (set < 0 || set >= descsets.size()) return;
-    auto& dslayouts = descsets[set].dlayouts;
-    if (bindingIdx < 0 || bindingIdx > m_dlayouts.size()) return;
-    for (auto& dsl : dslayouts) {
-        if (dsl == m_dlayouts[bindingIdx].get()) {
-            // No duplicates allowed.
-            return;
-        }
-    }
-    dslayouts.push_back(m_dlayouts[bindingIdx].get());
-}
-
-void PipelineLayoutTool::addDesclayout(const char* name)
-{
-    if (!strlen(name)) return;
-    m_dlayouts.push_back(make_unique<DescriptorLayout>(name));
-}
-
-void PipelineLayoutTool::delDesclayout(int idx)
-{
-    if (idx < 0 || idx >= m_dlayouts.size()) return;
-
-    for (auto& pipeline: m_layouts) {
-        for (auto& dset: pipeline.descsets) {
-            for (int i = 0; i < dset.dlayouts.size(); i++) {
-                if (dset.dlayouts[i] == m_dlayouts[idx].get()) {
-                    dset.dlayouts.erase(dset.dlayouts.begin() + i);
-                    i--;
-                }
-            }
-        }
-    }
-
-    m_dlayouts.erase(m_dlayouts.begin() + idx);
-}
-
-void PipelineLayoutTool::renameDesclayout(int idx, const char* name)
-{
-    if (!strlen(name)) return;
-    if (idx < 0 || idx >= m_dlayouts.size()) return;
-    m_dlayouts[idx]->name = name;
-}
-
-void PipelineLayoutTool::reorderDesclayout(int& idx, bool up)
-{
-    if (idx < 0 || idx >= m_dlayouts.size()) return;
-    int newidx = idx + (up ? -1 : 1);
-    if (newidx < 0 || newidx >= m_dlayouts.size()) return;
-    iter_swap(m_dlayouts.begin() + idx, m_dlayouts.begin() + newidx);
-    idx = newidx;
-}
-
 int PipelineLayoutTool::displayNamedList(const char* title, const char* listboxName, const char* objname, const char* abbrev,
-                            vector<const char*> listItems, int& activeItem, int listSize,
+                            vector<const char*>& listItems, int& activeItem, int listSize,
                             char *newNameBuffer, char *renameBuffer, bool *listChanged)
 {
     int retval = 0;
@@ -776,210 +691,3 @@ int PipelineLayoutTool::displayNamedList(const char* title, const char* listboxN
 
     return retval;
 }
-
-DescriptorLayout* PipelineLayoutTool::findDescLayoutByName(const std::string name)
-{
-    for (auto& dlayout: m_dlayouts) {
-        if (dlayout->name == name) return dlayout.get();
-    }
-    throw std::runtime_error("Could not find layout by name.");
-    return 0;
-}
-
-int PipelineLayoutTool::findDescLayoutByPtr(DescriptorLayout* dlayout)
-{
-    for (int i = 0; i < m_dlayouts.size(); i++) {
-        auto& dlayout_ = m_dlayouts[i];
-        if (dlayout_.get() == dlayout) return i;
-    }
-    throw std::runtime_error("Could not find layout by ptr.");
-    return 0;
-}
-
-std::vector<DescriptorLayout*>& PipelineLayoutTool::findDLV(int layout, const std::string name)
-{
-    if (layout < 0 || layout >= m_layouts.size()) {
-        throw std::runtime_error("invalid layout.");
-    }
-
-    int idx = -1;
-    for (int i = 0; i < m_dsets.size(); i++) {
-        if (m_dsets[i] == name) {
-            idx = i;
-            break;
-        }
-    }
-    if (idx == -1) {
-        throw std::runtime_error("invalid name.");
-    }
-
-    assert(m_layouts[layout].descsets.size() == m_dsets.size());
-    return m_layouts[layout].descsets[idx].dlayouts;
-}
-
-void PipelineLayoutTool::getDLGetSetList(int layout, DescriptorLayout* dl, vector<bool>& out)
-{
-    assert(dl);
-    if (layout < 0 || layout >= m_layouts.size()) {
-        throw std::runtime_error("invalid layout.");
-    }
-    assert(m_layouts[layout].descsets.size() == m_dsets.size());
-    assert(out.size() == m_dsets.size());
-    for (int i = 0; i < m_layouts[layout].descsets.size(); i++) {
-        bool found = false;
-        for (int j = 0; j < m_layouts[layout].descsets[i].dlayouts.size(); j++) {
-            if (m_layouts[layout].descsets[i].dlayouts[j] == dl) {
-                found = true;
-            }
-        }
-        out[i] = found;
-    }
-}
-
-void PipelineLayoutTool::getDLSetSetList(int layout, DescriptorLayout* dl, vector<bool>& in)
-{
-    assert(dl);
-    if (layout < 0 || layout >= m_layouts.size()) {
-        throw std::runtime_error("invalid layout.");
-    }
-    assert(m_layouts[layout].descsets.size() == m_dsets.size());
-    assert(in.size() == m_dsets.size());
-    for (int i = 0; i < m_layouts[layout].descsets.size(); i++) {
-        bool found = false;
-        int foundIdx = -1;
-        auto& dlayouts = m_layouts[layout].descsets[i].dlayouts;
-        for (int j = 0; j < dlayouts.size(); j++) {
-            if (dlayouts[j] == dl) {
-                foundIdx = j;
-                found = true;
-            }
-        }
-        if (found && !in[i]) {
-            // Removed.
-            dlayouts.erase(dlayouts.begin() + foundIdx);
-        }
-        if (!found && in[i]) {
-            // Added.
-            dlayouts.push_back(dl);
-        }
-    }
-}
-
-void PipelineLayoutTool::save(std::string fileName)
-{
-    if (fileName.length() <= 0) return;
-    if (!EndsWith(fileName, ".vkpipeline.json")) {
-        if (EndsWith(fileName, ".vkpipeline")) {
-            fileName += ".json";
-        } else {
-            fileName += ".vkpipeline.json";
-        }
-    }
-
-    Json::Value value;
-    value["num_layouts"] = m_layouts.size();  
-    for (auto& playout: m_layouts) {
-        Json::Value vplayout;
-        vplayout["name"] = playout.name;
-        auto setIdx = 0;
-        for (auto& dset : playout.descsets) {
-            Json::Value vdset;
-            vdset["set_index"] = setIdx++;
-            for (auto& dl : dset.dlayouts) {
-                Json::Value vdl = this->findDescLayoutByPtr(dl);
-                vdset["desc_layouts"].append(vdl);
-            }
-            vplayout["desc_sets"].append(vdset);
-        }
-        value["layouts"].append(vplayout);
-    }
-    value["num_sets"] = m_dsets.size();  
-    for (auto& dset: m_dsets) {
-        Json::Value vdset;
-        vdset = dset;
-        value["sets"].append(vdset);
-    }
-    value["num_bindings"] = m_dlayouts.size();  
-    for (auto& binding: m_dlayouts) {
-        Json::Value vbinding;
-        vbinding["name"] = binding->name;
-        vbinding["type"] = binding->typeIdx;
-        vbinding["typeName"] = descLayoutTypes[binding->typeIdx];
-        vbinding["data"] = binding->data;
-        vbinding["comment"] = binding->comment;
-        vbinding["stageFlagBits"] = binding->stageFlagBits;
-        value["bindings"].append(vbinding);
-    }
-
-    ofstream ofs;
-    ofs.open(fileName.c_str(), std::ofstream::out);
-    Json::StyledStreamWriter writer;
-    writer.write(ofs, value);
-    ofs.close();
-
-    m_filename = fileName;
-}
-
-void PipelineLayoutTool::load(std::string fileName)
-{
-    if (fileName.length() <= 0) return;
-    if (!EndsWith(fileName, ".vkpipeline.json")) {
-        if (EndsWith(fileName, ".vkpipeline")) {
-            fileName += ".json";
-        } else {
-            fileName += ".vkpipeline.json";
-        }
-    }
-
-    ifstream ifs;
-    ifs.open(fileName.c_str(), std::ofstream::in);
-
-    Json::Value value;
-    Json::Features features;
-    Json::Reader reader(features);
-    reader.parse(ifs, value);
-    ifs.close();
-
-    m_dsets.resize(value["num_sets"].asInt());
-    for (int i = 0; i < value["sets"].size(); i++) {
-        m_dsets[i] = value["sets"][i].asString();
-    }
-
-    m_dlayouts.resize(value["num_bindings"].asInt());
-    for (int i = 0; i < value["bindings"].size(); i++) {
-        if (!m_dlayouts[i].get()) {
-            m_dlayouts[i] = make_unique<DescriptorLayout>("UNKNOWN");
-        }
-        m_dlayouts[i]->name = value["bindings"][i]["name"].asString();
-        m_dlayouts[i]->typeIdx = value["bindings"][i]["type"].asInt();
-        m_dlayouts[i]->data = value["bindings"][i]["data"].asString();
-        m_dlayouts[i]->comment = value["bindings"][i]["comment"].asString();
-        m_dlayouts[i]->stageFlagBits = value["bindings"][i]["stageFlagBits"].asUInt();
-    }
-
-    m_layouts.resize(value["num_layouts"].asInt());
-    for (int i = 0; i < value["layouts"].size(); i++) {
-        auto& vplayout = value["layouts"][i];
-        m_layouts[i].name = vplayout["name"].asString();
-        m_layouts[i].descsets.resize(vplayout["desc_sets"].size());
-        if (vplayout["desc_sets"].size() != value["num_sets"].asInt()) {
-            throw std::runtime_error("Mismatch between desc_set and num_sets");
-        }
-        for (int j = 0; j < vplayout["desc_sets"].size(); j++) {
-            int setIdx = vplayout["desc_sets"][j]["set_index"].asInt();
-            if (setIdx < 0 || setIdx >= vplayout["desc_sets"].size()) {
-                throw std::runtime_error("Invalid set index.");
-            }
-            m_layouts[i].descsets[setIdx].dlayouts.resize(vplayout["desc_sets"][j]["desc_layouts"].size());
-            for (int k = 0; k < vplayout["desc_sets"][j]["desc_layouts"].size(); k++) {
-                int dlIdx = vplayout["desc_sets"][j]["desc_layouts"][k].asInt();
-                if (dlIdx < 0 || dlIdx >= m_dlayouts.size()) {
-                    throw std::runtime_error("Invalid DL index.");
-                }
-                m_layouts[i].descsets[setIdx].dlayouts[k] = m_dlayouts[dlIdx].get();
-            }
-        }
-    }
-
-    m_filename = fileName;
-}
\ No newline at end of file
@@ -25,106 +25,71 @@
 #define _TOOL_PIPELINE_LAYOUT_
 
 #include <vector>
-#include <unordered_map>
 #include <string>
-#include <memory>
 #include "tool_framework.hpp"
-
-typedef enum Vk__PipelineStageFlagBits {
-    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT = 0x00000001,
-    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT = 0x00000002,
-    VK_PIPELINE_STAGE_VERTEX_INPUT_BIT = 0x00000004,
-    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT = 0x00000008,
-    VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT = 0x00000010,
-    VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT = 0x00000020,
-    VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT = 0x00000040,
-    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT = 0x00000080,
-    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT = 0x00000100,
-    VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT = 0x00000200,
-    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT = 0x00000400,
-    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT = 0x00000800,
-    VK_PIPELINE_STAGE_TRANSFER_BIT = 0x00001000,
-    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT = 0x00002000,
-    VK_PIPELINE_STAGE_HOST_BIT = 0x00004000,
-    VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT = 0x00008000,
-    VK_PIPELINE_STAGE_ALL_COMMANDS_BIT = 0x00010000,
-} Vk__PipelineStageFlagBits;
-
-// -------------------------------------------------------- DescriptorLayout & PipelineLayout -----------------------------------------------
-
-struct DescriptorLayout {
-    std::string name = "UNNAMED_LAYOUT";
-    int typeIdx = 0;
-    std::string data = "";
-    std::string comment = "";
-    uint32_t stageFlagBits = 0x00010000; // VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
-
-public:
-    DescriptorLayout(std::string name_);
-    void stageFlagBitsToBools(std::vector<bool>& out);
-    void stageFlagBitsFromBools(std::vector<bool>& out);
-};
-
-struct DescriptorSet {
-    std::vector<DescriptorLayout*> dlayouts;
-};
-
-struct PipelineLayout {
-    std::string name = "UNNAMED_PIPELINE_LAYOUT";
-    std::vector<DescriptorSet> descsets;
-
-public:
-    PipelineLayout() {}
-    PipelineLayout(std::string name_);
-};
+#include "pipelinelayout_model.hpp"
+#include "background_save.hpp"
+#include "edit_journal.hpp"
+#include "undo_history.hpp"
 
 // -------------------------------------------------------- PipelineLayoutTool -----------------------------------------------
 
-class PipelineLayoutTool : public ToolFramework
+class PipelineLayoutTool : public ToolFramework, public PipelineLayoutModel, public ModelEditListener
 {
-    std::vector<PipelineLayout> m_layouts;
-    std::vector< std::unique_ptr<DescriptorLayout> > m_dlayouts;
-    std::vector<std::string> m_dsets;
-    std::string m_filename = "default.vkpipeline.json";
-
     // ---------------------- Names list UI helper ----------------------
 
     int displayNamedList(const char* title, const char* listboxName, const char* objname, const char* abbrev,
-                         std::vector<const char*> listItems, int& activeItem, int listSize,
+                         std::vector<const char*>& listItems, int& activeItem, int listSize,
                          char *newNameBuffer, char *renameBuffer, bool *listChanged = nullptr);
 
-    // ---------------------- Editor actions ----------------------
-
-    void addLayout(const char* name);
-    void delLayout(int idx);
-    void renameLayout(int idx, const char* name);
-    void reorderLayout(int& idx, bool up);
-
-    void addDescset(int layout, const char* name);
-    void delDescset(int layout, int idx);
-    void renameDescset(int layout, int idx, const char* name);
-    void reorderDescset(int layout, int& idx, bool up);
-
-    void reorderDescsetlayout(int layout, int set, int& idx, bool up);
-    void delDescsetlayout(int layout, int set, int idx);
-    void addDescsetlayout(int layout, int set, int bindingIdx);
-
-    void addDesclayout(const char* name);
-    void delDesclayout(int idx);
-    void renameDesclayout(int idx, const char* name);
-    void reorderDesclayout(int& idx, bool up);
-
-    DescriptorLayout* findDescLayoutByName(const std::string name);
-    int findDescLayoutByPtr(DescriptorLayout* dlayout);
-
-    std::vector<DescriptorLayout*>& findDLV(int layout, const std::string name);
-    void getDLGetSetList(int layout, DescriptorLayout* dl, std::vector<bool>& out);
-    void getDLSetSetList(int layout, DescriptorLayout* dl, std::vector<bool>& in);
-
-    void save(std::string fileName);
-    void load(std::string fileName);
+    // What the list boxes show, kept between frames: NamePool text does not move, so a list is only
+    // made again after an edit that changes its names or order (onEdit()) or a wholesale change.
+    struct NameList {
+        std::vector<const char*> items;
+        bool valid = false;
+    };
+    NameList m_layoutNames;
+    NameList m_setNames;
+    NameList m_bindingNames;
+    NameList m_setBindingNames;         // Of m_setBindingsOf, a layout and set.
+    std::pair<int, int> m_setBindingsOf;
+    std::vector<const char*> m_typeNames;
+    uint64_t m_namesGeneration = 0;
+
+    // The selected binding's data and comment are decoded into the editor's text buffers when it or
+    // they change, not every frame. Edits typed into the buffers leave them be.
+    BindingHandle m_textBinding = BINDING_HANDLE_NONE;
+    uint64_t m_textGeneration = 0;
+    bool m_dataStale = true;
+    bool m_commentStale = true;
+    bool m_typingText = false;
+
+    void checkGeneration(void);
+    std::vector<const char*>& layoutNames(void);
+    std::vector<const char*>& setNames(void);
+    std::vector<const char*>& bindingNames(void);
+    std::vector<const char*>& setBindingNames(int layout, int set);
+
+    // ---------------------- Saving ----------------------
+
+    EditJournal m_journal;          // Outlives m_saver, whose saves call back into it.
+    std::string m_journalStatus;
+    BackgroundSaver m_saver;
+    std::string m_saveStatus;
+    std::string m_errorTitle;   // "Save failed" or "Open failed".
+    std::string m_error;        // Non-empty while the error popup is up.
+
+    void openJournal(void);
+    void startSave(const std::string& fileName);
+    void pollSave(void);
+
+    // ---------------------- Undo ----------------------
+
+    UndoHistory m_history;
 
 public:
+    void onEdit(const ModelEdit& edit) override;
+
     const char* getWindowTitle(void) override;
     void init(void) override;
     void render(int screenWidth, int screenHeight) override;
@@ -0,0 +1,225 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include "undo_history.hpp"
+#include <algorithm>
+
+using namespace std;
+
+UndoHistory::~UndoHistory()
+{
+    detach();
+}
+
+void UndoHistory::attach(PipelineLayoutModel& model)
+{
+    detach();
+    m_model = &model;
+    model.setUndoRecorder(this);
+}
+
+void UndoHistory::detach(void)
+{
+    if (m_model && m_model->undoRecorder() == this) m_model->setUndoRecorder(nullptr);
+    m_model = nullptr;
+    clear();
+}
+
+void UndoHistory::clear(void)
+{
+    m_undo.clear();
+    m_redo.clear();
+    m_building = Step();
+    m_bytes = 0;
+    m_sealed = true;
+}
+
+void UndoHistory::add(Step& step, const ModelEdit& inverse)
+{
+    step.inverses.push_back(Inverse{ inverse.op, { inverse.args[0], inverse.args[1], inverse.args[2], inverse.args[3] },
+                                     inverse.text != nullptr, PackedText() });
+    Inverse& added = step.inverses.back();
+    if (inverse.text) added.text = inverse.text;
+    step.bytes += sizeof(Inverse) + added.text.storedBytes();
+}
+
+void UndoHistory::push(std::deque<Step>& stack, Step&& step)
+{
+    step.bytes += sizeof(Step);
+    m_bytes += step.bytes;
+    stack.push_back(move(step));
+}
+
+void UndoHistory::trim(const std::deque<Step>& keepNewest)
+{
+    while (m_bytes > m_memoryLimit) {
+        deque<Step>* stack;
+        if (m_undo.size() > (&keepNewest == &m_undo ? 1u : 0u)) stack = &m_undo;
+        else if (m_redo.size() > (&keepNewest == &m_redo ? 1u : 0u)) stack = &m_redo;
+        else break;
+        m_bytes -= stack->front().bytes;
+        stack->pop_front();
+        m_dropped++;
+    }
+}
+
+void UndoHistory::onEdit(const ModelEdit& edit, const ModelEdit& inverse)
+{
+    if (m_mode != RECORDING) {
+        add(m_building, inverse);
+        return;
+    }
+    if (m_groupDepth) {
+        add(m_building, inverse);
+        return;
+    }
+    dropRedo();
+
+    auto now = chrono::steady_clock::now();
+    int key = ModelEditTargetArgs(edit.op);
+    if (key && !m_sealed && m_coalesceMs > 0 && !m_undo.empty()) {
+        // The step's inverse already puts the target back as it was before either edit.
+        Step& prev = m_undo.back();
+        if (prev.op == edit.op && equal(edit.args, edit.args + key, prev.target) &&
+            now - prev.last <= chrono::milliseconds(m_coalesceMs)) {
+            prev.last = now;
+            m_coalesced++;
+            return;
+        }
+    }
+    Step step;
+    add(step, inverse);
+    if (key) {
+        step.op = edit.op;
+        copy(edit.args, edit.args + 4, step.target);
+    }
+    step.last = now;
+    push(m_undo, move(step));
+    m_sealed = false;
+    trim(m_undo);
+}
+
+void UndoHistory::beginGroup(void)
+{
+    if (m_groupDepth++ == 0 && m_mode == RECORDING) m_building = Step();
+}
+
+void UndoHistory::endGroup(void)
+{
+    if (!m_groupDepth || --m_groupDepth || m_mode != RECORDING) return;
+    if (m_building.inverses.empty()) return;
+    // Not before: a group may yet be discarded.
+    dropRedo();
+    push(m_undo, move(m_building));
+    m_building = Step();
+    m_sealed = true;
+    trim(m_undo);
+}
+
+void UndoHistory::discardGroup(void)
+{
+    if (!m_groupDepth || --m_groupDepth || m_mode != RECORDING) return;
+    m_building = Step();
+}
+
+void UndoHistory::reset(void)
+{
+    clear();
+    m_groupDepth = 0;
+}
+
+// A new edit: what was undone cannot be redone any more.
+void UndoHistory::dropRedo(void)
+{
+    for (auto& step: m_redo) m_bytes -= step.bytes;
+    m_redo.clear();
+}
+
+// Runs step's inverses newest first; the edits they make collect in m_building.
+void UndoHistory::apply(Step& step, Mode mode)
+{
+    m_mode = mode;
+    m_building = Step();
+    string text;
+    try {
+        for (auto it = step.inverses.rbegin(); it != step.inverses.rend(); ++it) {
+            ModelEdit e = { it->op, { it->args[0], it->args[1], it->args[2], it->args[3] }, nullptr };
+            if (it->hasText) {
+                it->text.decode(text);
+                e.text = text.c_str();
+            }
+            m_model->applyEdit(e);
+        }
+    } catch (...) {
+        m_mode = RECORDING;
+        clear();
+        throw;
+    }
+    m_mode = RECORDING;
+}
+
+bool UndoHistory::undo(void)
+{
+    if (!canUndo() || m_mode != RECORDING || !m_model) return false;
+    Step step = move(m_undo.back());
+    m_undo.pop_back();
+    m_bytes -= step.bytes;
+    apply(step, UNDOING);
+    if (!m_building.inverses.empty()) push(m_redo, move(m_building));
+    m_building = Step();
+    m_sealed = true;
+    trim(m_redo);
+    return true;
+}
+
+bool UndoHistory::redo(void)
+{
+    if (!canRedo() || m_mode != RECORDING || !m_model) return false;
+    Step step = move(m_redo.back());
+    m_redo.pop_back();
+    m_bytes -= step.bytes;
+    apply(step, REDOING);
+    if (!m_building.inverses.empty()) push(m_undo, move(m_building));
+    m_building = Step();
+    m_sealed = true;
+    trim(m_undo);
+    return true;
+}
+
+void UndoHistory::setMemoryLimit(size_t bytes)
+{
+    m_memoryLimit = bytes;
+    trim(m_undo);
+}
+
+UndoHistory::Stats UndoHistory::stats(void) const
+{
+    Stats s;
+    s.undoSteps = m_undo.size();
+    s.redoSteps = m_redo.size();
+    s.bytes = m_bytes;
+    s.coalesced = m_coalesced;
+    s.dropped = m_dropped;
+    return s;
+}
@@ -0,0 +1,121 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef _UNDO_HISTORY_
+#define _UNDO_HISTORY_
+
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include "pipelinelayout_model.hpp"
+
+// Undo / redo for a PipelineLayoutModel, kept as the edits that take each action back rather than as
+// copies of the project: a step costs memory, and undoing or redoing it time, in proportion to what the
+// action changed. Undo runs a step's inverses through applyEdit(), so edit listeners such as EditJournal
+// see ordinary edits, and the inverses those edits report make up the redo step.
+//
+// An edit to the same target as the step before it (ModelEditTargetArgs()) within coalesceMs joins that
+// step: typing into a data or comment field, or toggling stage bits one by one, undoes as a whole. Once the
+// steps take more than the memory limit, the oldest are dropped, redo steps after undo steps; the step
+// just recorded is kept whatever its size. A model transaction is one step; an aborted one leaves none.
+class UndoHistory : public ModelUndoRecorder
+{
+public:
+    struct Stats {
+        size_t undoSteps = 0;
+        size_t redoSteps = 0;
+        size_t bytes = 0;           // Held by all steps.
+        uint64_t coalesced = 0;     // Edits merged into the step before them.
+        uint64_t dropped = 0;       // Steps given up to stay under the memory limit.
+    };
+
+    UndoHistory() {}
+    ~UndoHistory();                 // detach()
+    UndoHistory(const UndoHistory&) = delete;
+    UndoHistory& operator=(const UndoHistory&) = delete;
+
+    // Records model's edits from now on, replacing any recorder it had. The history starts out empty.
+    void attach(PipelineLayoutModel& model);
+    void detach(void);
+
+    // Both return false, and do nothing, if there is no step to take or a group is open. Should the model
+    // throw while applying a step, the history is cleared and the exception passed on.
+    bool undo(void);
+    bool redo(void);
+    bool canUndo(void) const { return !m_undo.empty() && !m_groupDepth; }
+    bool canRedo(void) const { return !m_redo.empty() && !m_groupDepth; }
+
+    void clear(void);
+    // The next edit starts a step of its own, whatever it follows.
+    void seal(void) { m_sealed = true; }
+
+    void setMemoryLimit(size_t bytes);
+    // 0 turns coalescing off.
+    void setCoalesceMs(int ms) { m_coalesceMs = ms; }
+    Stats stats(void) const;
+
+    void onEdit(const ModelEdit& edit, const ModelEdit& inverse) override;
+    void beginGroup(void) override;
+    void endGroup(void) override;
+    void discardGroup(void) override;
+    void reset(void) override;
+
+private:
+    struct Inverse {
+        ModelEditOp op;
+        int32_t args[4];
+        bool hasText;
+        PackedText text;
+    };
+    struct Step {
+        std::vector<Inverse> inverses;  // In the order the edits were made; applied last to first.
+        ModelEditOp op = (ModelEditOp) 0;   // Of the edit, when the step is a single one that may coalesce.
+        int32_t target[4] = {};
+        std::chrono::steady_clock::time_point last;
+        size_t bytes = 0;
+    };
+    enum Mode { RECORDING, UNDOING, REDOING };
+
+    static void add(Step& step, const ModelEdit& inverse);
+    void apply(Step& step, Mode mode);
+    void push(std::deque<Step>& stack, Step&& step);
+    void trim(const std::deque<Step>& keepNewest);
+    void dropRedo(void);
+
+    PipelineLayoutModel* m_model = nullptr;
+    std::deque<Step> m_undo;        // Newest at the back.
+    std::deque<Step> m_redo;        // Next to redo at the back.
+    Step m_building;                // The open group, or the step undo() / redo() is making.
+    int m_groupDepth = 0;
+    Mode m_mode = RECORDING;
+    bool m_sealed = true;
+    size_t m_bytes = 0;
+    size_t m_memoryLimit = 32 << 20;
+    int m_coalesceMs = 1000;
+    uint64_t m_coalesced = 0;
+    uint64_t m_dropped = 0;
+};
+
+#endif // _UNDO_HISTORY_
@@ -0,0 +1,751 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+// vkplc: headless batch compiler for .vkpipeline.json projects.
+// Loads, validates and re-emits many files in parallel on a work-stealing thread pool.
+
+#include "pipelinelayout_model.hpp"
+#include "thread_pool.hpp"
+#include "build_cache.hpp"
+#include "watch_mode.hpp"
+#include "binding_numbers.hpp"
+#include "descriptor_pools.hpp"
+#include "layout_compat.hpp"
+#include "set_order.hpp"
+#include "device_limits.hpp"
+#include "vkplc_bench.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <errno.h>
+
+using namespace std;
+
+struct CompileJob {
+    string input;
+    string output;      // Empty : validate only.
+    double latencyMs = 0.0;
+    bool ok = false;
+    bool cacheHit = false;
+    bool written = false;
+    double savedMs = 0.0;   // Cached cost of the work a hit skipped.
+    vector<string> errors;
+};
+
+struct Options {
+    size_t numThreads = 0;
+    string outDir;
+    string cacheDir;
+    string watchDir;
+    bool inPlace = false;
+    bool quiet = false;
+    JsonStreamWriter::Style style = JsonStreamWriter::STYLE_PRETTY;
+    int format = 0;         // ProjectFormat to re-emit in; 0 : whatever each input uses.
+    vector<string> inputs;
+};
+
+// -------------------------------------------------------- Helpers -----------------------------------------------
+
+static bool EndsWith(const string& value, const string& ending)
+{
+    if (ending.size() > value.size()) return false;
+    return equal(ending.rbegin(), ending.rend(), value.rbegin());
+}
+
+static bool MakeDirs(const string& path)
+{
+    for (size_t pos = 1; pos <= path.size(); pos++) {
+        if (pos == path.size() || path[pos] == '/') {
+            string sub = path.substr(0, pos);
+            if (mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        }
+    }
+    return true;
+}
+
+static string DirName(const string& path)
+{
+    auto slash = path.find_last_of('/');
+    return slash == string::npos ? string(".") : path.substr(0, slash);
+}
+
+static string BaseName(const string& path)
+{
+    auto slash = path.find_last_of('/');
+    return slash == string::npos ? path : path.substr(slash + 1);
+}
+
+static vector<string>* g_scanResult = nullptr;
+static const char* g_scanSuffix = ".vkpipeline.json";
+static int ScanCallback(const char* fpath, const struct stat* sb, int typeflag, struct FTW* ftwbuf)
+{
+    if (typeflag == FTW_F && EndsWith(fpath, g_scanSuffix)) {
+        g_scanResult->push_back(fpath);
+    }
+    return 0;
+}
+
+// Expands directories into the .vkpipeline.json files below them. Paths are relative to the scanned root.
+static void CollectInputs(const string& input, vector<pair<string, string>>& out)
+{
+    struct stat sb;
+    if (stat(input.c_str(), &sb) == 0 && S_ISDIR(sb.st_mode)) {
+        vector<string> files;
+        g_scanResult = &files;
+        nftw(input.c_str(), ScanCallback, 32, FTW_PHYS);
+        g_scanResult = nullptr;
+        sort(files.begin(), files.end());
+        string root = input;
+        while (root.size() > 1 && root.back() == '/') root.pop_back();
+        for (auto& f: files) {
+            out.push_back(make_pair(f, f.substr(root.size() + 1)));
+        }
+    } else {
+        string path = PipelineLayoutModel::normalizeFileName(input);
+        out.push_back(make_pair(path, BaseName(path)));
+    }
+}
+
+static double Percentile(const vector<double>& sorted, double p)
+{
+    if (sorted.empty()) return 0.0;
+    size_t idx = (size_t) (p * (sorted.size() - 1) + 0.5);
+    return sorted[min(idx, sorted.size() - 1)];
+}
+
+// -------------------------------------------------------- Compile -----------------------------------------------
+
+static void Compile(const string& text, const Options& opts, BuildCacheEntry& result)
+{
+    auto t0 = chrono::steady_clock::now();
+    try {
+        PipelineLayoutModel model;
+        model.deserialize(text.data(), text.data() + text.size());
+        if (opts.format) model.setFileFormat(opts.format);
+        result.ok = model.validate(result.errors);
+        model.serialize(result.output, opts.style);
+    } catch (const exception& e) {
+        result.ok = false;
+        result.errors.push_back(e.what());
+    }
+    auto t1 = chrono::steady_clock::now();
+    result.costMs = chrono::duration<double, milli>(t1 - t0).count();
+}
+
+static void RunJob(CompileJob& job, const Options& opts, const BuildCache* cache)
+{
+    auto t0 = chrono::steady_clock::now();
+    try {
+        string text;
+        if (!ReadFile(job.input, text)) {
+            throw runtime_error("Could not open " + job.input + ".");
+        }
+
+        BuildCacheEntry result;
+        string key;
+        if (cache) {
+            key = cache->key(text);
+            job.cacheHit = cache->lookup(key, result);
+        }
+        if (!job.cacheHit) {
+            Compile(text, opts, result);
+            if (cache) cache->store(key, result);
+        }
+
+        job.ok = result.ok;
+        job.errors = move(result.errors);
+        if (job.ok && !job.output.empty()) {
+            job.written = WriteFileIfChanged(job.output, result.output);
+        }
+        if (job.cacheHit) job.savedMs = result.costMs;
+    } catch (const exception& e) {
+        job.ok = false;
+        job.errors.push_back(e.what());
+    }
+    auto t1 = chrono::steady_clock::now();
+    job.latencyMs = chrono::duration<double, milli>(t1 - t0).count();
+}
+
+static void PrintUsage(void)
+{
+    fprintf(stderr,
+        "usage: vkplc [options] <file.vkpipeline.json | directory>...\n"
+        "       vkplc -w DIR -o OUTDIR [-q]\n"
+        "       vkplc convert [-z] [-f N] [-l LAYOUT] IN OUT   (.vkpipeline.json <-> .vkpipeline.bin, by extension)\n"
+        "       vkplc numbers IN NUMBERS.json   (assign binding numbers, keeping the ones in NUMBERS.json if it exists)\n"
+        "       vkplc pools IN [COUNTS.json] OUT   (descriptor pool sizes; OUT .json or .h)\n"
+        "       vkplc compat [-j N] [-u] [-m MATRIX.csv] IN [ORDER.txt]   (set compatibility; rebinds along ORDER)\n"
+        "       vkplc setorder [-n N] [-o OUT] IN TRACE   (set order and binding moves for the least rebinding)\n"
+        "       vkplc limits [-n N] IN PROFILE...   (check against device limits; PROFILE .json files or directories)\n"
+        "       vkplc bench <name> [args]\n"
+        "  -j N        worker threads (default: hardware concurrency)\n"
+        "  -o DIR      re-emit every input below DIR, mirroring the input tree\n"
+        "  -i          re-emit every input in place\n"
+        "  -z          re-emit compact JSON instead of the editor's indented layout\n"
+        "  -f N        re-emit in project format N: 1 indexed, 2 name-addressed (default: as read)\n"
+        "  -l LAYOUT   convert: keep only that pipeline layout and the bindings it uses\n"
+        "  -c DIR      reuse results from the content-hash build cache in DIR\n"
+        "  -w DIR      watch DIR and keep one header per pipeline layout in OUTDIR up to date\n"
+        "  -q          only print errors and the summary\n"
+        "  -u          compat: sets with the same bindings in any order are identical (shared binding numbers)\n"
+        "  -m FILE     compat: write the prefix of every pair of pipeline layouts as CSV\n"
+        "  -n N        setorder: replay TRACE at most N times looking for binding moves (default 32)\n"
+        "  -o FILE     setorder: save IN with the plan applied\n"
+        "  -n N        limits: list the N uses nearest their limits (default 20)\n");
+}
+
+// vkplc convert [-z] [-f N] [-l LAYOUT] IN OUT: the format of each side follows its extension
+// (.vkpipeline.json / .vkpipeline.bin). Refuses a project validate() rejects rather than writing it out.
+static int Convert(int argc, char** argv)
+{
+    JsonStreamWriter::Style style = JsonStreamWriter::STYLE_PRETTY;
+    int format = 0;
+    const char* layout = nullptr;
+    for (; argc > 2; argc--, argv++) {
+        if (!strcmp(argv[0], "-z")) {
+            style = JsonStreamWriter::STYLE_COMPACT;
+        } else if (!strcmp(argv[0], "-f") && argc > 3) {
+            format = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (!strcmp(argv[0], "-l") && argc > 3) {
+            layout = argv[1];
+            argc--;
+            argv++;
+        } else {
+            break;
+        }
+    }
+    if (argc != 2) {
+        PrintUsage();
+        return 2;
+    }
+    try {
+        PipelineLayoutModel model;
+        if (layout) {
+            string text;
+            if (!ReadFile(PipelineLayoutModel::normalizeFileName(argv[0]), text)) {
+                throw runtime_error(string("Could not open ") + argv[0] + ".");
+            }
+            model.deserializeLayout(text.data(), text.data() + text.size(), layout);
+        } else {
+            model.load(argv[0]);
+        }
+        if (format) model.setFileFormat(format);
+        vector<string> errors;
+        if (!model.validate(errors)) {
+            fprintf(stderr, "vkplc: %s is not valid, not converted:\n", argv[0]);
+            for (auto& err: errors) fprintf(stderr, "    %s\n", err.c_str());
+            return 1;
+        }
+        model.save(argv[1], style);
+    } catch (const exception& e) {
+        fprintf(stderr, "vkplc: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+// vkplc numbers IN NUMBERS: numbers the bindings of every set of IN, starting from the numbering in
+// NUMBERS if there is one, and writes the result back there. Lists what had to be renumbered and the
+// pipeline layouts whose shaders that invalidates.
+static int Numbers(int argc, char** argv)
+{
+    if (argc != 2) {
+        PrintUsage();
+        return 2;
+    }
+    try {
+        PipelineLayoutModel model;
+        model.load(argv[0]);
+        BindingNumbers previous, numbers;
+        string text;
+        if (ReadFile(argv[1], text)) previous.deserialize(text.data(), text.data() + text.size());
+        numbers.assign(model, &previous);
+        numbers.serialize(text);
+        WriteFileIfChanged(argv[1], text);
+
+        vector<int> invalidated;
+        numbers.invalidatedLayouts(model, invalidated);
+        printf("%zu bindings numbered, %zu renumbered, %zu dropped\n", numbers.numAdded(),
+            numbers.renumbered().size(), numbers.numDropped());
+        for (auto& r: numbers.renumbered()) printf("    %s %s: %d -> %d\n", r.set.c_str(), r.binding.c_str(), r.from, r.to);
+        if (!invalidated.empty()) {
+            printf("shaders of %zu pipeline layouts invalidated:\n", invalidated.size());
+            for (int l: invalidated) printf("    %s\n", model.names().c_str(model.layouts()[l].name));
+        }
+    } catch (const exception& e) {
+        fprintf(stderr, "vkplc: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+// vkplc pools IN [COUNTS] OUT: descriptor pool sizes for the sets of IN, allocated as COUNTS says
+// (see PoolSizingInput), written as JSON or as a C++ header by the extension of OUT. Prints a summary
+// of each strategy.
+static int Pools(int argc, char** argv)
+{
+    if (argc != 2 && argc != 3) {
+        PrintUsage();
+        return 2;
+    }
+    string out = argv[argc - 1];
+    try {
+        PipelineLayoutModel model;
+        model.load(argv[0]);
+        PoolSizingInput input;
+        string text;
+        if (argc == 3) {
+            if (!ReadFile(argv[1], text)) throw runtime_error(string("Could not open ") + argv[1] + ".");
+            input.deserialize(text.data(), text.data() + text.size());
+        }
+        DescriptorPoolPlan plan;
+        PlanDescriptorPools(model, input, plan);
+        if (EndsWith(out, ".h") || EndsWith(out, ".hpp")) {
+            ExportPoolPlanHeader(plan, BaseName(argv[0]), text);
+        } else {
+            ExportPoolPlanJson(plan, text);
+        }
+        WriteFileIfChanged(out, text);
+
+        printf("%zu set variants, %u frames in flight\n", plan.variants.size(), plan.framesInFlight);
+        for (auto& s: plan.strategies) {
+            printf("  %-14s %3zu pools, %10llu sets, %12.3f MB of descriptors\n", s.name.c_str(), s.pools.size(),
+                (unsigned long long) s.totalSets, s.totalBytes / 1e6);
+        }
+    } catch (const exception& e) {
+        fprintf(stderr, "vkplc: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+static string CsvField(const string& s)
+{
+    if (s.find_first_of(",\"\r\n") == string::npos) return s;
+    string quoted = "\"";
+    for (char c: s) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// vkplc compat [-j N] [-u] [-m MATRIX] IN [ORDER]: how many sets stay bound across a switch between
+// any two pipeline layouts of IN. Writes the whole matrix to MATRIX if asked; ORDER lists pipeline
+// layout names one per line, in the order the application binds them, and gets a rebinding report.
+static int Compat(int argc, char** argv)
+{
+    size_t numThreads = 0;
+    const char* matrixPath = nullptr;
+    LayoutCompatibility::SetIdentity identity = LayoutCompatibility::SETS_ORDERED;
+    for (; argc > 1; argc--, argv++) {
+        if (!strcmp(argv[0], "-u")) {
+            identity = LayoutCompatibility::SETS_UNORDERED;
+        } else if (!strcmp(argv[0], "-j") && argc > 2) {
+            numThreads = (size_t) atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (!strcmp(argv[0], "-m") && argc > 2) {
+            matrixPath = argv[1];
+            argc--;
+            argv++;
+        } else {
+            break;
+        }
+    }
+    if (argc != 1 && argc != 2) {
+        PrintUsage();
+        return 2;
+    }
+    try {
+        PipelineLayoutModel model;
+        model.load(argv[0]);
+        LayoutCompatibility compat;
+        compat.build(model, identity);
+        printf("%zu pipeline layouts, %u sets, %zu distinct set layouts\n", compat.numLayouts(), compat.numSets(),
+            compat.numSetLayouts());
+        for (uint32_t k = 1; k <= compat.numSets(); k++) {
+            printf("  sets 0-%-3u %8zu compatible groups\n", k - 1, compat.numGroups(k));
+        }
+
+        if (matrixPath) {
+            ThreadPool pool(numThreads);
+            vector<uint8_t> matrix;
+            auto t0 = chrono::steady_clock::now();
+            compat.matrix(pool, matrix);
+            auto t1 = chrono::steady_clock::now();
+            size_t n = compat.numLayouts();
+            string text = "layout";
+            for (size_t b = 0; b < n; b++) text += "," + CsvField(model.names().str(model.layouts()[b].name));
+            text += "\n";
+            for (size_t a = 0; a < n; a++) {
+                text += CsvField(model.names().str(model.layouts()[a].name));
+                for (size_t b = 0; b < n; b++) text += "," + to_string(matrix[a * n + b]);
+                text += "\n";
+            }
+            WriteFileIfChanged(matrixPath, text);
+            printf("matrix of %zu x %zu in %.1f ms on %zu threads\n", n, n,
+                chrono::duration<double, milli>(t1 - t0).count(), pool.size());
+        }
+
+        if (argc == 2) {
+            string text;
+            if (!ReadFile(argv[1], text)) throw runtime_error(string("Could not open ") + argv[1] + ".");
+            vector<int> order;
+            size_t pos = 0;
+            while (pos < text.size()) {
+                size_t end = text.find('\n', pos);
+                if (end == string::npos) end = text.size();
+                string name = text.substr(pos, end - pos);
+                pos = end + 1;
+                while (!name.empty() && (name.back() == '\r' || name.back() == ' ')) name.pop_back();
+                if (name.empty()) continue;
+                int layout = model.findLayout(name);
+                if (layout < 0) throw runtime_error("Unknown pipeline layout " + name + " in " + argv[1] + ".");
+                order.push_back(layout);
+            }
+            auto cost = compat.rebindCost(order);
+            printf("%zu pipeline switches: %zu sets bound in %zu vkCmdBindDescriptorSets calls\n", cost.switches,
+                cost.setsBound, cost.bindCalls);
+            printf("  rebinding every set: %zu sets in %zu calls\n", cost.setsBoundAll, cost.bindCallsAll);
+        }
+    } catch (const exception& e) {
+        fprintf(stderr, "vkplc: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+// vkplc setorder [-n N] [-o OUT] IN TRACE: replays the draw trace TRACE (see DrawTrace) over IN and
+// looks for the set order and binding moves with the least binding and descriptor writing work. Prints
+// the work before and after, and saves the project with the plan applied to OUT if given.
+static int SetOrder(int argc, char** argv)
+{
+    int maxReplays = 32;
+    const char* out = nullptr;
+    for (; argc > 2; argc--, argv++) {
+        if (!strcmp(argv[0], "-n") && argc > 3) {
+            maxReplays = atoi(argv[1]);
+            argc--;
+            argv++;
+        } else if (!strcmp(argv[0], "-o") && argc > 3) {
+            out = argv[1];
+            argc--;
+            argv++;
+        } else {
+            break;
+        }
+    }
+    if (argc != 2) {
+        PrintUsage();
+        return 2;
+    }
+    try {
+        PipelineLayoutModel model;
+        model.load(argv[0]);
+        DrawTrace trace;
+        auto t0 = chrono::steady_clock::now();
+        trace.load(model, argv[1]);
+        auto t1 = chrono::steady_clock::now();
+        SetOrderPlan plan;
+        PlanSetOrder(model, trace, plan, maxReplays);
+        auto t2 = chrono::steady_clock::now();
+        printf("%llu draws, %zu events: read in %.0f ms, planned in %.0f ms over %d replays\n",
+            (unsigned long long) trace.numDraws(), trace.numEvents(), chrono::duration<double, milli>(t1 - t0).count(),
+            chrono::duration<double, milli>(t2 - t1).count(), plan.replays);
+        printf("  %-10s %14s %14s %14s %14s\n", "", "sets bound", "bind calls", "sets written", "descriptors");
+        auto row = [](const char* name, const SetOrderPlan::Work& w) {
+            printf("  %-10s %14llu %14llu %14llu %14llu\n", name, (unsigned long long) w.setsBound,
+                (unsigned long long) w.bindCalls, (unsigned long long) w.setsWritten,
+                (unsigned long long) w.descriptorsWritten);
+        };
+        row("as is", plan.current);
+        row("reordered", plan.reordered);
+        row("planned", plan.planned);
+        if (plan.current.total()) {
+            printf("  %.1f%% less work\n", 100.0 * (plan.current.total() - plan.planned.total()) / plan.current.total());
+        }
+        printf("set order:");
+        for (int s: plan.order) printf(" %s", model.names().c_str(model.dsets()[s]));
+        printf("\n");
+        for (auto& m: plan.moves) {
+            printf("  move %s from %s to %s\n", model.names().c_str(model.dlayouts()[m.binding]->name),
+                model.names().c_str(model.dsets()[m.from]), model.names().c_str(model.dsets()[m.to]));
+        }
+        if (out) {
+            ApplySetOrderPlan(model, plan);
+            model.save(out);
+        }
+    } catch (const exception& e) {
+        fprintf(stderr, "vkplc: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
+
+// vkplc limits [-n N] IN PROFILE...: checks every pipeline layout of IN, per shader stage and as a whole,
+// against the descriptor limits of device profiles read from the PROFILE files, and from the .json files
+// below PROFILE directories. Prints each profile's violations and the uses nearest their limits; exits
+// with 1 if anything is over.
+static int Limits(int argc, char** argv)
+{
+    size_t numWorst = 20;
+    if (argc > 2 && !strcmp(argv[0], "-n")) {
+        numWorst = (size_t) atoi(argv[1]);
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 2) {
+        PrintUsage();
+        return 2;
+    }
+    size_t violations = 0;
+    try {
+        PipelineLayoutModel model;
+        model.load(argv[0]);
+        auto t0 = chrono::steady_clock::now();
+        vector<DeviceProfile> profiles;
+        for (int i = 1; i < argc; i++) {
+            struct stat sb;
+            if (stat(argv[i], &sb) != 0 || !S_ISDIR(sb.st_mode)) {
+                LoadDeviceProfiles(argv[i], profiles);
+                continue;
+            }
+            vector<string> files;
+            g_scanResult = &files;
+            g_scanSuffix = ".json";
+            nftw(argv[i], ScanCallback, 32, FTW_PHYS);
+            g_scanResult = nullptr;
+            g_scanSuffix = ".vkpipeline.json";
+            sort(files.begin(), files.end());
+            for (auto& f: files) LoadDeviceProfiles(f, profiles);
+        }
+        auto t1 = chrono::steady_clock::now();
+        DeviceLimitsReport report;
+        CheckDeviceLimits(model, profiles, numWorst, report);
+        auto t2 = chrono::steady_clock::now();
+        printf("%zu pipeline layouts, %zu device profiles: read in %.1f ms, checked in %.1f ms\n", model.layouts().size(),
+            profiles.size(), chrono::duration<double, milli>(t1 - t0).count(), chrono::duration<double, milli>(t2 - t1).count());
+
+        auto describe = [&model](const DeviceLimitUse& use) {
+            string text = model.names().str(model.layouts()[use.layout].name);
+            if (use.stage >= 0) text += string(" ") + shaderStageNames[use.stage];
+            text += string(": ") + deviceLimitNames[use.limit] + " " + to_string(use.used) + " of " + to_string(use.max);
+            if (use.set >= 0) text += ", " + to_string(use.setCount) + " in " + model.names().str(model.dsets()[use.set]);
+            return text;
+        };
+        printf("  %-40s %8s %8s  %s\n", "profile", "over", "layouts", "tightest");
+        for (size_t p = 0; p < profiles.size(); p++) {
+            violations += report.violations[p];
+            printf("  %-40s %8zu %8zu  %s\n", profiles[p].name.c_str(), report.violations[p], report.layoutsOver[p],
+                report.tightest[p].layout < 0 ? "-" : describe(report.tightest[p]).c_str());
+        }
+        if (!report.worst.empty()) printf("nearest their limits:\n  %8s\n", "headroom");
+        for (auto& use: report.worst) {
+            printf("  %8lld  %s on %s\n", (long long) use.headroom(), describe(use).c_str(), profiles[use.profile].name.c_str());
+        }
+    } catch (const exception& e) {
+        fprintf(stderr, "vkplc: %s\n", e.what());
+        return 1;
+    }
+    return violations ? 1 : 0;
+}
+
+static bool ParseOptions(int argc, char** argv, Options& opts)
+{
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            opts.numThreads = (size_t) atoi(argv[++i]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            opts.outDir = argv[++i];
+        } else if (arg == "-c" && i + 1 < argc) {
+            opts.cacheDir = argv[++i];
+        } else if (arg == "-w" && i + 1 < argc) {
+            opts.watchDir = argv[++i];
+        } else if (arg == "-i") {
+            opts.inPlace = true;
+        } else if (arg == "-z") {
+            opts.style = JsonStreamWriter::STYLE_COMPACT;
+        } else if (arg == "-f" && i + 1 < argc) {
+            opts.format = atoi(argv[++i]);
+            if (opts.format != PROJECT_FORMAT_INDEXED && opts.format != PROJECT_FORMAT_NAMED) {
+                fprintf(stderr, "vkplc: unknown project format %s\n", argv[i]);
+                return false;
+            }
+        } else if (arg == "-q") {
+            opts.quiet = true;
+        } else if (arg == "-h" || arg == "--help") {
+            return false;
+        } else if (!arg.empty() && arg[0] == '-') {
+            fprintf(stderr, "vkplc: unknown option %s\n", arg.c_str());
+            return false;
+        } else {
+            opts.inputs.push_back(arg);
+        }
+    }
+    if (opts.inPlace && !opts.outDir.empty()) {
+        fprintf(stderr, "vkplc: -i and -o are mutually exclusive\n");
+        return false;
+    }
+    if (!opts.watchDir.empty()) {
+        if (opts.outDir.empty() || opts.inPlace || !opts.inputs.empty()) {
+            fprintf(stderr, "vkplc: -w takes a single directory and requires -o\n");
+            return false;
+        }
+        return true;
+    }
+    return !opts.inputs.empty();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 2 && !strcmp(argv[1], "bench")) {
+        return RunBenchmark(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "convert")) {
+        return Convert(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "numbers")) {
+        return Numbers(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "pools")) {
+        return Pools(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "compat")) {
+        return Compat(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "setorder")) {
+        return SetOrder(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && !strcmp(argv[1], "limits")) {
+        return Limits(argc - 2, argv + 2);
+    }
+
+    Options opts;
+    if (!ParseOptions(argc, argv, opts)) {
+        PrintUsage();
+        return 2;
+    }
+
+    if (!opts.watchDir.empty()) {
+        try {
+            LayoutWatcher watcher(opts.watchDir, opts.outDir, opts.quiet);
+            return watcher.run();
+        } catch (const exception& e) {
+            fprintf(stderr, "vkplc: %s\n", e.what());
+            return 1;
+        }
+    }
+
+    vector<pair<string, string>> inputs;
+    for (auto& in: opts.inputs) CollectInputs(in, inputs);
+
+    vector<CompileJob> jobs(inputs.size());
+    for (size_t i = 0; i < inputs.size(); i++) {
+        jobs[i].input = inputs[i].first;
+        if (opts.inPlace) {
+            jobs[i].output = inputs[i].first;
+        } else if (!opts.outDir.empty()) {
+            jobs[i].output = opts.outDir + "/" + inputs[i].second;
+            if (!MakeDirs(DirName(jobs[i].output))) {
+                fprintf(stderr, "vkplc: could not create %s\n", DirName(jobs[i].output).c_str());
+                return 1;
+            }
+        }
+    }
+
+    unique_ptr<BuildCache> cache;
+    if (!opts.cacheDir.empty()) {
+        try {
+            cache = make_unique<BuildCache>(opts.cacheDir, string(PIPELINE_LAYOUT_TOOL_VERSION) +
+                (opts.style == JsonStreamWriter::STYLE_COMPACT ? "-z" : "") +
+                (opts.format ? "-f" + to_string(opts.format) : string()));
+        } catch (const exception& e) {
+            fprintf(stderr, "vkplc: %s\n", e.what());
+            return 1;
+        }
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    size_t numThreads = 0;
+    {
+        ThreadPool pool(opts.numThreads);
+        numThreads = pool.size();
+        for (auto& job: jobs) {
+            const BuildCache* c = cache.get();
+            pool.submit([&job, &opts, c]() { RunJob(job, opts, c); });
+        }
+        pool.wait();
+    }
+    auto t1 = chrono::steady_clock::now();
+    double wallMs = chrono::duration<double, milli>(t1 - t0).count();
+
+    size_t numFailed = 0, numHits = 0, numWritten = 0;
+    double savedMs = 0.0;
+    vector<double> latencies;
+    for (auto& job: jobs) {
+        latencies.push_back(job.latencyMs);
+        if (!job.ok) numFailed++;
+        if (job.written) numWritten++;
+        if (job.cacheHit) {
+            numHits++;
+            savedMs += max(0.0, job.savedMs - job.latencyMs);
+        }
+        if (!job.ok || !opts.quiet) {
+            printf("%s %s (%.2f ms%s)\n", job.ok ? "OK  " : "FAIL", job.input.c_str(), job.latencyMs,
+                job.cacheHit ? ", cached" : "");
+        }
+        for (auto& err: job.errors) {
+            printf("    %s\n", err.c_str());
+        }
+    }
+    sort(latencies.begin(), latencies.end());
+
+    double sumMs = 0.0;
+    for (auto l: latencies) sumMs += l;
+    printf("\n%zu files, %zu failed, %zu threads, %.2f ms wall, %.1f files/s\n",
+        jobs.size(), numFailed, numThreads, wallMs, wallMs > 0.0 ? jobs.size() * 1000.0 / wallMs : 0.0);
+    if (!latencies.empty()) {
+        printf("per-file latency ms: min %.3f  avg %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+            latencies.front(), sumMs / latencies.size(), Percentile(latencies, 0.5),
+            Percentile(latencies, 0.95), Percentile(latencies, 0.99), latencies.back());
+    }
+    if (cache) {
+        printf("cache: %zu/%zu hits (%.1f%%), ~%.2f ms of work saved\n",
+            numHits, jobs.size(), jobs.empty() ? 0.0 : numHits * 100.0 / jobs.size(), savedMs);
+    }
+    if (opts.inPlace || !opts.outDir.empty()) {
+        printf("outputs: %zu written, %zu unchanged\n", numWritten, jobs.size() - numFailed - numWritten);
+    }
+    return numFailed ? 1 : 0;
+}
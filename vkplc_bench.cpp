@@ -0,0 +1,1624 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "vkplc_bench.hpp"
+#include "build_cache.hpp"
+#include "pipelinelayout_binary.hpp"
+#include "background_save.hpp"
+#include "edit_journal.hpp"
+#include "undo_history.hpp"
+#include "binding_numbers.hpp"
+#include "descriptor_pools.hpp"
+#include "layout_compat.hpp"
+#include "set_order.hpp"
+#include "device_limits.hpp"
+#include "thread_pool.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <malloc.h>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// -------------------------------------------------------- SyntheticProject -----------------------------------------------
+
+void SyntheticProject::generate(int numLayouts, int numSets, int numBindings, int bindingsPerSet, uint32_t seed)
+{
+    clear();
+    uint32_t state = seed * 2654435761u + 1;
+    auto next = [&state]() {
+        state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+        return state;
+    };
+
+    for (int s = 0; s < numSets; s++) {
+        m_dsets.push_back(m_names.intern("PSET_" + to_string(s)));
+    }
+    for (int b = 0; b < numBindings; b++) {
+        auto dl = makeBinding(m_names.intern("BINDING_" + to_string(b)));
+        dl->typeIdx = (int) (next() % descLayoutTypes.size());
+        dl->stageFlagBits = (next() & 0x1FFFF) | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        dl->data = "layout(std140) uniform Block" + to_string(b) + " { vec4 v[" + to_string(next() % 64) + "]; };";
+        dl->comment = (b % 4 == 0) ? "Generated binding " + to_string(b) : "";
+        appendBinding(move(dl));
+    }
+    m_layouts.reserve(numLayouts);
+    for (int l = 0; l < numLayouts; l++) {
+        m_layouts.push_back(PipelineLayout(m_names.intern("PIPELINE_" + to_string(l))));
+        auto& pl = m_layouts.editBack();
+        for (int s = 0; s < numSets && numBindings > 0; s++) {
+            int count = bindingsPerSet ? (int) (next() % (bindingsPerSet * 2 + 1)) : 0;
+            int start = (int) (next() % numBindings);
+            if (!count) continue;
+            auto& dst = pl.descsets.edit(s).dlayouts;
+            for (int k = 0; k < count && k < numBindings; k++) {
+                dst.push_back(m_dlayouts[(start + k) % numBindings]->handle);
+            }
+        }
+    }
+}
+
+void SyntheticProject::generatePayloads(int bytesPerBinding, uint32_t seed)
+{
+    static const char* types[] = { "float", "vec2", "vec4", "mat4", "ivec4", "uint" };
+    static const char* roles[] = { "albedo", "roughness", "offset", "scale", "weight", "bias", "tint", "matrix" };
+    uint32_t state = seed * 2654435761u + 7;
+    auto next = [&state]() {
+        state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+        return state;
+    };
+    string text;
+    for (int b = 0; b < (int) m_dlayouts.size(); b++) {
+        DescriptorLayout* dl = &editBinding(b);
+        text = "// Generated for ";
+        m_names.appendTo(dl->name, text);
+        text += ". Do not edit.\n";
+        text += "layout(std140, set = " + to_string(next() % 8) + ", binding = " + to_string(b % 32) + ") uniform Block" +
+            to_string(b) + " {\n";
+        for (int m = 0; text.size() < (size_t) bytesPerBinding; m++) {
+            text += string("    ") + types[next() % 6] + " " + roles[next() % 8] + "_" + to_string(m);
+            if (next() % 4 == 0) text += "[" + to_string(1 + next() % 16) + "]";
+            text += ";\n";
+        }
+        text += "};\n";
+        dl->data = text;
+        dl->comment = "Generated binding " + to_string(b) + ", " + to_string(text.size()) + " bytes of payload";
+    }
+}
+
+// -------------------------------------------------------- Helpers -----------------------------------------------
+
+struct ChildResult {
+    double ms = 0.0;
+    long maxRssKb = 0;
+};
+
+// Runs fn in a forked child so that its peak RSS is measured on its own. fn returns elapsed ms.
+static bool RunIsolated(const function<double(void)>& fn, ChildResult& result)
+{
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        close(fds[0]);
+        double ms = -1.0;
+        try {
+            ms = fn();
+        } catch (const exception& e) {
+            fprintf(stderr, "bench: %s\n", e.what());
+        }
+        if (write(fds[1], &ms, sizeof(ms)) != sizeof(ms)) _exit(1);
+        _exit(0);
+    }
+    close(fds[1]);
+    double ms = -1.0;
+    ssize_t n = read(fds[0], &ms, sizeof(ms));
+    close(fds[0]);
+    int status = 0;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) != pid || n != sizeof(ms) || ms < 0.0) return false;
+    result.ms = ms;
+    result.maxRssKb = ru.ru_maxrss;
+    return true;
+}
+
+template <typename F>
+static double TimeMs(F fn, int iterations)
+{
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        auto t0 = chrono::steady_clock::now();
+        fn();
+        auto t1 = chrono::steady_clock::now();
+        best = min(best, chrono::duration<double, milli>(t1 - t0).count());
+    }
+    return best;
+}
+
+static string TempPath(const char* suffix)
+{
+    const char* tmp = getenv("TMPDIR");
+    return string(tmp ? tmp : "/tmp") + "/vkplc_bench_" + to_string(getpid()) + suffix;
+}
+
+// -------------------------------------------------------- Benchmarks -----------------------------------------------
+
+// Load time and peak RSS of the streaming loader against the Json::Value DOM loader.
+static int BenchLoad(int numLayouts)
+{
+    string path = TempPath(".vkpipeline.json");
+    ChildResult gen;
+    // Generate in a child too, so this process stays small and every fork starts from the same RSS.
+    if (!RunIsolated([&]() {
+        SyntheticProject project;
+        project.generate(numLayouts, 6, 2000, 4);
+        project.save(path);
+        return 0.0;
+    }, gen)) {
+        fprintf(stderr, "bench load: could not write %s\n", path.c_str());
+        return 1;
+    }
+    string text;
+    ReadFile(path, text);
+    printf("bench load: %d pipeline layouts, %.1f MB of JSON\n", numLayouts, text.size() / 1e6);
+    text.clear();
+    text.shrink_to_fit();
+
+    auto loadWith = [&path](bool stream) {
+        return [&path, stream]() {
+            string text;
+            ReadFile(path, text);
+            double best = 1e30;
+            for (int i = 0; i < 3; i++) {
+                // Fresh model per run, torn down outside the timed region.
+                PipelineLayoutModel model;
+                best = min(best, TimeMs([&]() {
+                    if (stream) model.deserialize(text.data(), text.data() + text.size());
+                    else model.deserializeDom(text.data(), text.data() + text.size());
+                }, 1));
+            }
+            return best;
+        };
+    };
+    auto readOnly = [&path]() {
+        string text;
+        ReadFile(path, text);
+        return 0.0;
+    };
+
+    ChildResult base, dom, stream;
+    bool ok = RunIsolated(readOnly, base) && RunIsolated(loadWith(false), dom) && RunIsolated(loadWith(true), stream);
+    remove(path.c_str());
+    if (!ok) {
+        fprintf(stderr, "bench load: child failed\n");
+        return 1;
+    }
+
+    printf("  %-22s %10s %14s\n", "loader", "time ms", "peak RSS MB");
+    printf("  %-22s %10.2f %14.1f\n", "Json::Value DOM", dom.ms, (dom.maxRssKb - base.maxRssKb) / 1024.0);
+    printf("  %-22s %10.2f %14.1f\n", "streaming", stream.ms, (stream.maxRssKb - base.maxRssKb) / 1024.0);
+    printf("  (peak RSS above a baseline that has only read the file: %.1f MB)\n", base.maxRssKb / 1024.0);
+    printf("  speedup %.2fx, peak memory %.2fx smaller\n", dom.ms / stream.ms,
+        (double) (dom.maxRssKb - base.maxRssKb) / max(1L, stream.maxRssKb - base.maxRssKb));
+    return 0;
+}
+
+// Save time of the streaming writer against the Json::Value DOM writer, at doubling project sizes
+// so that the growth rate shows. Bindings scale with pipelines, as they do in real projects.
+static int BenchSave(int numLayouts)
+{
+    string path = TempPath(".vkpipeline.json");
+    printf("bench save: up to %d pipeline layouts\n", numLayouts);
+    printf("  %-10s %-10s %12s %12s %12s %12s %10s\n", "pipelines", "bindings", "DOM ms", "pretty ms", "compact ms",
+        "save() ms", "speedup");
+    for (int n = max(1, numLayouts / 8); ; n *= 2) {
+        n = min(n, numLayouts);
+        int numBindings = max(64, n / 4);
+        ChildResult dom, pretty, compact, file;
+        auto run = [&](int which) {
+            return [&, which]() {
+                SyntheticProject project;
+                project.generate(n, 6, numBindings, 4);
+                string out;
+                return TimeMs([&]() {
+                    switch (which) {
+                        case 0: project.serializeDom(out); break;
+                        case 1: project.serialize(out); break;
+                        case 2: project.serialize(out, JsonStreamWriter::STYLE_COMPACT); break;
+                        default: project.save(path); break;
+                    }
+                }, 3);
+            };
+        };
+        if (!RunIsolated(run(0), dom) || !RunIsolated(run(1), pretty) || !RunIsolated(run(2), compact) ||
+            !RunIsolated(run(3), file)) {
+            fprintf(stderr, "bench save: child failed\n");
+            remove(path.c_str());
+            return 1;
+        }
+        printf("  %-10d %-10d %12.2f %12.2f %12.2f %12.2f %9.1fx\n", n, numBindings, dom.ms, pretty.ms, compact.ms,
+            file.ms, dom.ms / pretty.ms);
+        if (n == numLayouts) break;
+    }
+    remove(path.c_str());
+    return 0;
+}
+
+// Every writer's output read back and written again, byte for byte, with two bindings of an invalid
+// type among the rest: they must come through as they are, written with VK_DESCRIPTOR_TYPE_MAX_ENUM
+// where a type name goes, and still fail validate(). Prints the time of each round trip.
+static int BenchRoundTrip(int numBindings)
+{
+    SyntheticProject project;
+    project.generate(numBindings / 10, 4, numBindings, 4);
+    project.setDesclayoutType(0, 99);
+    project.setDesclayoutType(1, -1);
+    printf("bench roundtrip: %d bindings, two of an invalid type\n", numBindings);
+
+    struct Writer { const char* name; function<void(const PipelineLayoutModel&, string&)> write; bool dom; };
+    vector<Writer> writers = {
+        { "indexed", [](const PipelineLayoutModel& m, string& out) { m.serialize(out); }, false },
+        { "indexed compact", [](const PipelineLayoutModel& m, string& out) { m.serialize(out, JsonStreamWriter::STYLE_COMPACT); }, false },
+        { "named", [](const PipelineLayoutModel& m, string& out) {
+            PipelineLayoutModel named;
+            PipelineLayoutSnapshot snap;
+            m.snapshot(snap);
+            named.restore(snap);
+            named.setFileFormat(PROJECT_FORMAT_NAMED);
+            named.serialize(out);
+        }, false },
+        { "Json::Value", [](const PipelineLayoutModel& m, string& out) { m.serializeDom(out); }, true },
+        { "binary", [](const PipelineLayoutModel& m, string& out) { m.serializeBinary(out); }, false },
+    };
+    bool ok = true;
+    vector<string> errors;
+    for (auto& w: writers) {
+        string first, second;
+        PipelineLayoutModel back;
+        double ms = TimeMs([&]() {
+            w.write(project, first);
+            if (!strcmp(w.name, "binary")) {
+                back.deserializeBinary(PipelineLayoutBinary(first.data(), first.size()));
+            } else if (w.dom) {
+                back.deserializeDom(first.data(), first.data() + first.size());
+            } else {
+                back.deserialize(first.data(), first.data() + first.size());
+            }
+            w.write(back, second);
+        }, 1);
+        errors.clear();
+        bool same = first == second && back.dlayouts()[0]->typeIdx == 99 && back.dlayouts()[1]->typeIdx == -1 &&
+            !back.validate(errors);
+        if (strcmp(w.name, "binary")) same = same && first.find("VK_DESCRIPTOR_TYPE_MAX_ENUM") != string::npos;
+        printf("  %-16s %8.1f ms  %s\n", w.name, ms, same ? "matches" : "DIFFERS");
+        ok = ok && same;
+    }
+    return ok ? 0 : 1;
+}
+
+// Time from "open the project" to the answer of one query (the bindings of set 0 of a pipeline in the
+// middle of the project): full JSON parse vs the mapped binary view, plus a full binary materialization.
+static int BenchOpen(int numLayouts)
+{
+    string json = TempPath(".vkpipeline.json");
+    string bin = TempPath(".vkpipeline.bin");
+    ChildResult gen;
+    if (!RunIsolated([&]() {
+        SyntheticProject project;
+        project.generate(numLayouts, 6, 2000, 4);
+        project.save(json);
+        project.save(bin);
+        return 0.0;
+    }, gen)) {
+        fprintf(stderr, "bench open: could not write the projects\n");
+        return 1;
+    }
+    struct stat jsb, bsb;
+    stat(json.c_str(), &jsb);
+    stat(bin.c_str(), &bsb);
+    printf("bench open: %d pipeline layouts, %.1f MB of JSON, %.1f MB binary\n", numLayouts,
+        jsb.st_size / 1e6, bsb.st_size / 1e6);
+
+    string target = "PIPELINE_" + to_string(numLayouts / 2);
+    size_t sink = 0;
+    auto queryJson = [&]() {
+        return TimeMs([&]() {
+            string text;
+            ReadFile(json, text);
+            PipelineLayoutModel model;
+            model.deserialize(text.data(), text.data() + text.size());
+            for (auto& pl: model.layouts()) {
+                if (model.names().str(pl.name) != target) continue;
+                for (BindingHandle dl: pl.descsets[0].dlayouts) sink += model.names().size(model.binding(dl)->name);
+                break;
+            }
+        }, 3);
+    };
+    auto queryBinary = [&]() {
+        return TimeMs([&]() {
+            PipelineLayoutBinary view(bin);
+            const uint32_t* refs;
+            uint32_t n = view.setBindings(view.findLayout(target), 0, refs);
+            for (uint32_t i = 0; i < n; i++) sink += view.text(view.binding(refs[i]).name).size;
+        }, 3);
+    };
+    auto materialize = [&]() {
+        return TimeMs([&]() {
+            PipelineLayoutModel model;
+            model.deserializeBinary(PipelineLayoutBinary(bin));
+        }, 3);
+    };
+    auto baseline = []() { return 0.0; };
+
+    ChildResult base, rj, rb, rm;
+    bool ok = RunIsolated(baseline, base) && RunIsolated(queryJson, rj) && RunIsolated(queryBinary, rb) &&
+              RunIsolated(materialize, rm);
+    remove(json.c_str());
+    remove(bin.c_str());
+    if (!ok) {
+        fprintf(stderr, "bench open: child failed\n");
+        return 1;
+    }
+    printf("  %-28s %10s %14s\n", "path", "time ms", "peak RSS MB");
+    printf("  %-28s %10.3f %14.1f\n", "JSON parse + query", rj.ms, (rj.maxRssKb - base.maxRssKb) / 1024.0);
+    printf("  %-28s %10.3f %14.1f\n", "mmap .bin + query", rb.ms, (rb.maxRssKb - base.maxRssKb) / 1024.0);
+    printf("  %-28s %10.3f %14.1f\n", "mmap .bin + materialize", rm.ms, (rm.maxRssKb - base.maxRssKb) / 1024.0);
+    printf("  time to first query %.0fx faster\n", rj.ms / rb.ms);
+    return 0;
+}
+
+// An editor frame loop at 60 Hz that keeps editing while a large project saves in the background,
+// against the frame the synchronous save() used to stall.
+static int BenchBackgroundSave(int numBindings)
+{
+    string path = TempPath(".vkpipeline.json");
+    SyntheticProject project;
+    project.generate(numBindings / 5, 6, numBindings, 16);
+
+    double syncMs = TimeMs([&]() { project.save(path); }, 1);
+    struct stat sb;
+    stat(path.c_str(), &sb);
+    printf("bench bgsave: %d bindings, %d pipeline layouts, %.1f MB of JSON\n", numBindings, numBindings / 5,
+        sb.st_size / 1e6);
+    printf("  synchronous save(): the frame that saves takes %.1f ms\n", syncMs);
+
+    // Two saves in a row: the second snapshots a model that the first one's edits have partly unshared.
+    BackgroundSaver saver;
+    for (int pass = 0; pass < 2; pass++) {
+        vector<double> frames;
+        BackgroundSaver::Result result;
+        bool done = false;
+        auto start = chrono::steady_clock::now();
+        for (int frame = 0; !done; frame++) {
+            auto t0 = chrono::steady_clock::now();
+            if (frame == 0) {
+                saver.save(project, path);
+            } else {
+                // A typical small edit per frame.
+                project.renameLayout(frame % project.layouts().size(), ("EDITED_" + to_string(frame)).c_str());
+            }
+            done = saver.poll(result);
+            auto t1 = chrono::steady_clock::now();
+            frames.push_back(chrono::duration<double, milli>(t1 - t0).count());
+            this_thread::sleep_until(start + chrono::microseconds(16667 * (frame + 1)));
+        }
+        if (!result.ok) {
+            fprintf(stderr, "bench bgsave: %s\n", result.error.c_str());
+            remove(path.c_str());
+            return 1;
+        }
+
+        vector<double> edits(frames.begin() + 1, frames.end());
+        sort(edits.begin(), edits.end());
+        double p99 = edits.empty() ? 0.0 : edits[min(edits.size() - 1, edits.size() * 99 / 100)];
+        printf("  background save #%d: snapshot %.1f ms on the UI thread, restore + write %.1f ms on the worker\n",
+            pass + 1, result.snapshotMs, result.writeMs);
+        printf("    %zu frames edited while saving: frame work p99 %.3f ms, max %.3f ms\n", edits.size(), p99,
+            edits.empty() ? 0.0 : edits.back());
+    }
+    remove(path.c_str());
+    return 0;
+}
+
+// Cost of journaling each edit of a large project, against making the same edit durable with save().
+static int BenchJournal(int numBindings, int numEdits)
+{
+    string path = TempPath(".vkpipeline.json");
+    string journalPath = EditJournal::journalFileName(path);
+    SyntheticProject project;
+    project.generate(numBindings / 5, 6, numBindings, 16);
+    printf("bench journal: %d bindings, %d pipeline layouts, %d edits\n", numBindings, numBindings / 5, numEdits);
+
+    int numLayouts = (int) project.layouts().size();
+    auto edit = [&](int i) {
+        int binding = (i * 7919) % numBindings;
+        switch (i % 5) {
+        case 0: project.renameDesclayout(binding, ("BINDING_EDITED_" + to_string(i)).c_str()); break;
+        case 1: project.setDesclayoutStages(binding, (uint32_t) i | 1); break;
+        case 2: project.setDesclayoutData(binding, ("layout(std140) uniform block_" + to_string(i) + " { vec4 v; };").c_str()); break;
+        case 3: project.addDescsetlayout(i % numLayouts, i % 6, binding); break;
+        case 4: project.delDescsetlayout(i % numLayouts, i % 6, 0); break;
+        }
+    };
+    auto run = [&](int first, vector<double>& us) {
+        us.clear();
+        for (int i = first; i < first + numEdits; i++) {
+            auto t0 = chrono::steady_clock::now();
+            edit(i);
+            us.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count());
+        }
+        sort(us.begin(), us.end());
+    };
+    auto report = [&](const char* what, const vector<double>& us) {
+        double sum = 0.0;
+        for (double u: us) sum += u;
+        printf("  %-22s mean %7.2f us  p50 %7.2f us  p99 %7.2f us  max %9.2f us\n", what, sum / us.size(),
+            us[us.size() / 2], us[min(us.size() - 1, us.size() * 99 / 100)], us.back());
+    };
+
+    vector<double> us;
+    run(0, us);
+    report("edit, no journal", us);
+    double saveMs = TimeMs([&]() { project.save(path); }, 1);
+    printf("  %-22s %.1f ms\n", "edit + save()", saveMs);
+
+    remove(journalPath.c_str());
+    EditJournal journal;
+    journal.setCompactBytes(256 << 10);
+    try {
+        journal.open(project, path);
+        run(numEdits, us);
+        journal.sync();
+    } catch (const std::exception& e) {
+        fprintf(stderr, "bench journal: %s\n", e.what());
+        remove(path.c_str());
+        return 1;
+    }
+    report("edit + journal append", us);
+    journal.close();    // Lets a running compaction finish.
+    EditJournal::Stats stats = journal.stats();
+    struct stat sb;
+    stat(journalPath.c_str(), &sb);
+    printf("  %llu records, %.1f KB appended, %llu fsyncs (%.0f records each), journal now %.1f KB\n",
+        (unsigned long long) stats.records, stats.bytes / 1024.0, (unsigned long long) stats.syncs,
+        stats.syncs ? (double) stats.records / stats.syncs : 0.0, sb.st_size / 1024.0);
+    printf("  %llu compactions, last %.1f ms on the writer thread\n", (unsigned long long) stats.compactions,
+        stats.compactMs);
+
+    // Recovery: what the next session does before showing the project.
+    SyntheticProject recovered;
+    size_t replayed = 0;
+    double loadMs = TimeMs([&]() { recovered.load(path); }, 1);
+    double replayMs = TimeMs([&]() { replayed = journal.open(recovered, path); }, 1);
+    journal.close();
+    string a, b;
+    project.serialize(a);
+    recovered.serialize(b);
+    printf("  recovery: load %.1f ms, replay %zu edits %.1f ms, %s\n", loadMs, replayed, replayMs,
+        a == b ? "state matches" : "STATE DIFFERS");
+    remove(journalPath.c_str());
+    remove(path.c_str());
+    return a == b ? 0 : 1;
+}
+
+// Memory held by binding data and comments, packed as the model keeps them against plain strings,
+// and what reading them back costs.
+static int BenchBlobs(int numBindings, int payloadBytes)
+{
+    string path = TempPath(".vkpipeline.json");
+    {
+        SyntheticProject project;
+        project.generate(numBindings / 5, 6, numBindings, 16);
+        project.generatePayloads(payloadBytes);
+        project.save(path);
+    }
+    struct stat sb;
+    stat(path.c_str(), &sb);
+    printf("bench blobs: %d bindings with ~%d bytes of data each, %.1f MB of JSON\n", numBindings, payloadBytes,
+        sb.st_size / 1e6);
+
+    auto heapInUse = []() { return (double) mallinfo2().uordblks; };
+    double heap0 = heapInUse();
+    PipelineLayoutModel model;
+    double loadMs = TimeMs([&]() { model.load(path); }, 1);
+    remove(path.c_str());
+    malloc_trim(0);
+    double modelBytes = heapInUse() - heap0;
+
+    size_t decoded, stored;
+    model.blobUsage(decoded, stored);
+    // What the same text costs as the std::strings bindings used to hold.
+    double heap1 = heapInUse();
+    vector<string> plain;
+    plain.reserve(model.dlayouts().size() * 2);
+    double decodeAllMs = TimeMs([&]() {
+        for (auto& dl: model.dlayouts()) {
+            plain.push_back(dl->data.str());
+            plain.push_back(dl->comment.str());
+        }
+    }, 1);
+    double plainBytes = heapInUse() - heap1 - plain.capacity() * sizeof(string) + plain.size() * 2 * sizeof(string);
+    plain.clear();
+    plain.shrink_to_fit();
+
+    string text;
+    const PackedText& one = model.dlayouts()[numBindings / 2]->data;
+    double oneUs = TimeMs([&]() { one.decode(text); }, 100) * 1000.0;
+
+    double unpackedModel = modelBytes - stored - model.dlayouts().size() * 2 * sizeof(PackedText) + plainBytes;
+    printf("  %-34s %10.1f MB\n", "data + comment text", decoded / 1e6);
+    printf("  %-34s %10.1f MB  (%.1fx smaller)\n", "  as stored (packed)", stored / 1e6, (double) decoded / max<size_t>(stored, 1));
+    printf("  %-34s %10.1f MB\n", "  as std::string", plainBytes / 1e6);
+    printf("  %-34s %10.1f MB\n", "model heap after load, packed", modelBytes / 1e6);
+    printf("  %-34s %10.1f MB  (%.1f MB saved)\n", "  with plain std::string blobs", unpackedModel / 1e6,
+        (unpackedModel - modelBytes) / 1e6);
+    printf("  load %.1f ms; decode one binding's data %.2f us; decode all %.1f ms\n", loadMs, oneUs, decodeAllMs);
+    return 0;
+}
+
+// The editor's add / lookup paths as they were before the name indexes, for BenchNames.
+class LinearNameModel : public PipelineLayoutModel
+{
+public:
+    void addLayout(const char* name)
+    {
+        for (auto layout: m_layouts) {
+            if (strcmp(m_names.c_str(layout.name), name) == 0) return;
+        }
+        m_layouts.push_back(PipelineLayout(m_names.intern(name)));
+    }
+    void addDescset(const char* name)
+    {
+        for (auto descset: m_dsets) {
+            if (strcmp(m_names.c_str(descset), name) == 0) return;
+        }
+        m_dsets.push_back(m_names.intern(name));
+    }
+    const DescriptorLayout* findDescLayoutByName(const string& name)
+    {
+        for (auto& dl: m_dlayouts) {
+            if (m_names.str(dl->name) == name) return dl.get();
+        }
+        return nullptr;
+    }
+};
+
+// Bulk-adds numNames pipeline layouts and bindings over 8 sets through the editor actions, then
+// resolves every binding by name; against the linear scans those used to do.
+static int BenchNames(int numNames)
+{
+    vector<string> names(numNames);
+    for (int i = 0; i < numNames; i++) names[i] = "NAME_" + to_string((uint32_t) (i * 2654435761u));
+    printf("bench names: %d layouts, %d bindings, 8 sets\n", numNames, numNames);
+    printf("  %-28s %12s %12s %12s\n", "", "indexed", "linear", "speedup");
+
+    auto run = [&](const char* what, double indexed, double linear) {
+        printf("  %-28s %9.1f ms %9.1f ms %11.1fx\n", what, indexed, linear, linear / max(indexed, 1e-6));
+    };
+
+    PipelineLayoutModel model;
+    LinearNameModel linear;
+    model.clear();
+    linear.clear();
+    for (int i = 0; i < 8; i++) {
+        model.addDescset(0, names[i].c_str());
+        linear.addDescset(names[i].c_str());
+    }
+    double layoutsIndexed = TimeMs([&]() { for (auto& n: names) model.addLayout(n.c_str()); }, 1);
+    double layoutsLinear = TimeMs([&]() { for (auto& n: names) linear.addLayout(n.c_str()); }, 1);
+    // One more, and a duplicate, at full size: what a single add in the editor costs.
+    double oneIndexed = TimeMs([&]() { model.addLayout("ONE_MORE"); model.addLayout(names[0].c_str()); }, 1);
+    double oneLinear = TimeMs([&]() { linear.addLayout("ONE_MORE"); linear.addLayout(names[0].c_str()); }, 1);
+    for (auto& n: names) {
+        model.addDesclayout(n.c_str());
+        linear.addDesclayout(n.c_str());
+    }
+    size_t found = 0;
+    double findIndexed = TimeMs([&]() { for (auto& n: names) found += model.findDesclayout(n) >= 0; }, 1);
+    double findLinear = TimeMs([&]() { for (auto& n: names) found += linear.findDescLayoutByName(n) != nullptr; }, 1);
+
+    run("add layouts", layoutsIndexed, layoutsLinear);
+    run("resolve every binding", findIndexed, findLinear);
+    printf("  one more layout at full size: %.3f ms indexed, %.3f ms linear\n", oneIndexed, oneLinear);
+    printf("  layout adds/s: %.0f indexed, %.0f linear\n", numNames / (layoutsIndexed / 1000.0),
+        numNames / (layoutsLinear / 1000.0));
+    if (found != 2 * names.size() || model.layouts().size() != linear.layouts().size()) {
+        printf("  RESULTS DIFFER\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Loads a project with numBindings bindings under editor-length names, then sets what the names cost
+// interned (pool, ids, name indexes) against what they cost before: a std::string per layout, set and
+// binding, and an unordered_map<string, int> per kind for lookups.
+static int BenchStrings(int numBindings)
+{
+    static const char* prefixes[] = { "UBO_MATERIAL_PARAMS_", "SAMPLER_DIFFUSE_MAP_", "SSBO_LIGHT_GRID_DATA_",
+                                      "UBO_OBJECT_PARAMS_", "SAMPLER_SHADOW_CASCADE_", "SSBO_BATCHED_DRAWCALL_" };
+    string path = TempPath(".vkpipeline.json");
+    {
+        SyntheticProject project;
+        project.generate(numBindings / 5, 6, numBindings, 4);
+        for (int b = 0; b < numBindings; b++) {
+            project.renameDesclayout(b, (prefixes[b % 6] + to_string(b)).c_str());
+        }
+        for (int l = 0; l < numBindings / 5; l++) {
+            project.renameLayout(l, ("PIPELINE_FORWARD_OPAQUE_" + to_string(l)).c_str());
+        }
+        project.save(path);
+    }
+
+    auto heapInUse = []() { return (double) mallinfo2().uordblks; };
+    PipelineLayoutModel model;
+    model.load(path);
+    remove(path.c_str());
+    const NamePool& pool = model.names();
+    size_t numNames = model.layouts().size() + model.dsets().size() + model.dlayouts().size();
+    size_t textBytes = 0;
+    for (NameId id = 0; id < pool.count(); id++) textBytes += pool.size(id);
+    printf("bench strings: %zu names (%zu distinct), %.1f MB of name text\n", numNames, pool.count(), textBytes / 1e6);
+
+    // The indexes are built on first lookup.
+    size_t found = 0;
+    double heap0 = heapInUse();
+    double indexMs = TimeMs([&]() {
+        found += model.findLayout(model.layouts()[0].name) == 0;
+        found += model.findDescset(model.dsets()[0]) == 0;
+        found += model.findDesclayout(model.dlayouts()[0]->name) == 0;
+    }, 1);
+    double indexBytes = heapInUse() - heap0;
+    double interned = pool.heapBytes() + numNames * sizeof(NameId) + indexBytes;
+
+    vector<string> plain;
+    unordered_map<string, int> layoutIndex, setIndex, bindingIndex;
+    double heap1 = heapInUse();
+    double plainMs = TimeMs([&]() {
+        plain.reserve(numNames);
+        for (auto& pl: model.layouts()) plain.push_back(pool.str(pl.name));
+        for (NameId s: model.dsets()) plain.push_back(pool.str(s));
+        for (auto& dl: model.dlayouts()) plain.push_back(pool.str(dl->name));
+        auto build = [&](unordered_map<string, int>& index, size_t from, size_t count) {
+            index.reserve(count);
+            for (size_t i = 0; i < count; i++) index.emplace(plain[from + i], (int) i);
+        };
+        build(layoutIndex, 0, model.layouts().size());
+        build(setIndex, model.layouts().size(), model.dsets().size());
+        build(bindingIndex, model.layouts().size() + model.dsets().size(), model.dlayouts().size());
+    }, 1);
+    double strings = heapInUse() - heap1;
+    found += layoutIndex.size() + setIndex.size() + bindingIndex.size() == numNames;
+
+    // Equality: what a duplicate check or a lookup compares.
+    vector<NameId> ids;
+    for (auto& dl: model.dlayouts()) ids.push_back(dl->name);
+    uint64_t equal = 0;
+    double idCmpMs = TimeMs([&]() {
+        for (size_t i = 1; i < ids.size(); i++) equal += ids[i] == ids[i - 1];
+    }, 5);
+    size_t first = model.layouts().size() + model.dsets().size();
+    double strCmpMs = TimeMs([&]() {
+        for (size_t i = first + 1; i < plain.size(); i++) equal += plain[i] == plain[i - 1];
+    }, 5);
+
+    printf("  %-34s %10.1f MB\n", "interned: pool", pool.heapBytes() / 1e6);
+    printf("  %-34s %10.1f MB\n", "  ids in layouts, sets, bindings", numNames * sizeof(NameId) / 1e6);
+    printf("  %-34s %10.1f MB  (built in %.1f ms)\n", "  name indexes", indexBytes / 1e6, indexMs);
+    printf("  %-34s %10.1f MB\n", "  total", interned / 1e6);
+    printf("  %-34s %10.1f MB  (built in %.1f ms)\n", "std::string names + string maps", strings / 1e6, plainMs);
+    printf("  %-34s %10.1f MB  (%.1fx less)\n", "saved", (strings - interned) / 1e6, strings / max(interned, 1.0));
+    printf("  compare every neighbouring binding name: %.2f ms by id, %.2f ms by string\n", idCmpMs, strCmpMs);
+    if (found != 4 || equal != 0) {
+        printf("  RESULTS DIFFER\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Makes every binding of a loaded project again, with its data and comment, once out of a SlabArena
+// and once with a heap allocation per object and text as before; then destroys both. Allocations are
+// the arena's own counts: each one it serves is one the heap version makes.
+static int BenchArena(int numBindings, int payloadBytes)
+{
+    string path = TempPath(".vkpipeline.json");
+    {
+        SyntheticProject project;
+        project.generate(numBindings / 5, 6, numBindings, 16);
+        project.generatePayloads(payloadBytes);
+        project.save(path);
+    }
+    printf("bench arena: %d bindings with ~%d bytes of data each\n", numBindings, payloadBytes);
+
+    double loadMs = 0.0, closeMs = 0.0;
+    SlabArena::Stats loadStats;
+    vector<string> data, comments;
+    vector<NameId> names;
+    {
+        PipelineLayoutModel model;
+        loadMs = TimeMs([&]() { model.load(path); }, 1);
+        loadStats = model.arenaStats();
+        for (auto& dl: model.dlayouts()) {
+            data.push_back(dl->data.str());
+            comments.push_back(dl->comment.str());
+            names.push_back(dl->name);
+        }
+        auto t0 = chrono::steady_clock::now();
+        model.clear();
+        closeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    }
+    remove(path.c_str());
+
+    struct Result {
+        double makeMs, freeMs;
+        uint64_t allocs;        // From the system.
+        uint64_t objects;       // Made in the arena.
+    };
+    auto run = [&](bool arena) {
+        Result r;
+        SlabArena slabs;
+        vector< shared_ptr<DescriptorLayout> > pooled, separate;
+        pooled.reserve(numBindings);
+        separate.reserve(numBindings);
+        r.makeMs = TimeMs([&]() {
+            for (size_t i = 0; i < names.size(); i++) {
+                if (arena) {
+                    pooled.push_back(slabs.makeShared<DescriptorLayout>(names[i]));
+                    pooled.back()->data.assign(data[i].data(), data[i].size(), &slabs);
+                    pooled.back()->comment.assign(comments[i].data(), comments[i].size(), &slabs);
+                } else {
+                    separate.push_back(make_shared<DescriptorLayout>(names[i]));
+                    separate.back()->data.assign(data[i].data(), data[i].size());
+                    separate.back()->comment.assign(comments[i].data(), comments[i].size());
+                }
+            }
+        }, 1);
+        r.allocs = slabs.stats().slabs;
+        r.objects = slabs.stats().allocations;
+        r.freeMs = TimeMs([&]() {
+            pooled.clear();
+            separate.clear();
+        }, 1);
+        return r;
+    };
+    Result heap = run(false), pooled = run(true);
+    heap.allocs = pooled.objects;
+
+    printf("  %-28s %12s %12s %12s\n", "", "slab arena", "heap", "");
+    printf("  %-28s %9.1f ms %9.1f ms %11.1fx\n", "make bindings", pooled.makeMs, heap.makeMs, heap.makeMs / max(pooled.makeMs, 1e-6));
+    printf("  %-28s %9.1f ms %9.1f ms %11.1fx\n", "destroy bindings", pooled.freeMs, heap.freeMs, heap.freeMs / max(pooled.freeMs, 1e-6));
+    printf("  %-28s %12llu %12llu %11.1fx\n", "allocations", (unsigned long long) pooled.allocs,
+        (unsigned long long) heap.allocs, (double) heap.allocs / max<uint64_t>(pooled.allocs, 1));
+    printf("  load(): %.1f ms, %llu bindings and texts in %llu slabs; closing the project %.1f ms\n", loadMs,
+        (unsigned long long) loadStats.allocations, (unsigned long long) loadStats.slabs, closeMs);
+    return 0;
+}
+
+// Binding queries and a bulk stage edit over the DescriptorLayout objects one by one, and over the
+// model's type / stage columns with the scalar and the vectorized passes.
+static int BenchColumns(int numBindings)
+{
+    SyntheticProject model;
+    model.generate(10, 6, numBindings, 0);
+    auto& dlayouts = model.dlayouts();
+    printf("bench columns: %d bindings\n", numBindings);
+
+    struct Query {
+        const char* name;
+        uint32_t typeMask, stageMask;
+    };
+    const Query queries[] = {
+        { "fragment-visible", BINDING_TYPES_ANY, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT },
+        { "storage buffers", (1u << 7) | (1u << 9), 0 },
+        { "compute storage buffers", (1u << 7) | (1u << 9), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT },
+    };
+    vector<int> first;
+    double buildMs = TimeMs([&]() { model.filterBindings(0, 0, first); }, 1);
+    const ModelBindingColumns& cols = model.bindingColumns();
+    size_t n = cols.types.size();
+
+    bool same = true;
+    printf("  %-26s %10s %12s %12s %12s %9s\n", "", "matches", "objects", "scalar", "vectorized", "");
+    for (auto& q: queries) {
+        vector<int> objects, scalar, simd;
+        auto reset = [](vector<int>& v) { v.clear(); v.reserve(1024); };
+        double objectsMs = TimeMs([&]() {
+            reset(objects);
+            for (size_t i = 0; i < dlayouts.size(); i++) {
+                auto* dl = dlayouts[i].get();
+                bool type = q.typeMask == BINDING_TYPES_ANY || (dl->typeIdx >= 0 && dl->typeIdx < 32 && ((q.typeMask >> dl->typeIdx) & 1));
+                if (type && (!q.stageMask || (dl->stageFlagBits & q.stageMask))) objects.push_back((int) i);
+            }
+        }, 10);
+        double scalarMs = TimeMs([&]() {
+            reset(scalar);
+            FilterBindingsScalar(cols.types.data(), cols.stages.data(), n, q.typeMask, q.stageMask, scalar);
+        }, 10);
+        double simdMs = TimeMs([&]() {
+            reset(simd);
+            model.filterBindings(q.typeMask, q.stageMask, simd);
+        }, 10);
+        printf("  %-26s %10zu %9.2f ms %9.2f ms %9.2f ms %8.1fx\n", q.name, simd.size(), objectsMs, scalarMs, simdMs,
+            objectsMs / max(simdMs, 1e-6));
+    }
+
+    // Add, then take away, the geometry stage on every fragment-visible storage buffer.
+    const uint32_t typeMask = (1u << 7) | (1u << 9), stageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    const uint32_t bit = VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+    int changedOne = 0, changedBulk = 0;
+    auto perBinding = [&](uint32_t set, uint32_t clear) {
+        for (size_t i = 0; i < dlayouts.size(); i++) {
+            auto* dl = dlayouts[i].get();
+            if (dl->typeIdx < 0 || dl->typeIdx >= 32 || !((typeMask >> dl->typeIdx) & 1) || !(dl->stageFlagBits & stageMask)) continue;
+            uint32_t bits = (dl->stageFlagBits & ~clear) | set;
+            if (bits == dl->stageFlagBits) continue;
+            model.setDesclayoutStages((int) i, bits);
+            changedOne++;
+        }
+    };
+    // Start both from no binding in the selection having it.
+    perBinding(0, bit);
+    changedOne = 0;
+    double oneMs = TimeMs([&]() { perBinding(bit, 0); perBinding(0, bit); }, 1);
+    vector<uint32_t> afterOne;
+    for (auto& dl: dlayouts) afterOne.push_back(dl->stageFlagBits);
+    double bulkMs = TimeMs([&]() {
+        changedBulk += model.updateBindingStages(typeMask, stageMask, bit, 0);
+        changedBulk += model.updateBindingStages(typeMask, stageMask, 0, bit);
+    }, 1);
+    vector<uint32_t> afterBulk;
+    for (auto& dl: dlayouts) afterBulk.push_back(dl->stageFlagBits);
+    same = same && changedOne == changedBulk && afterOne == afterBulk && cols.stages == afterBulk;
+
+    printf("  set and clear a stage bit on %d bindings: %.2f ms with setDesclayoutStages(), %.2f ms with updateBindingStages() (%.1fx)\n",
+        changedBulk / 2, oneMs, bulkMs, oneMs / max(bulkMs, 1e-6));
+
+    // The bulk edit is one notification and one undo step, which puts every binding back.
+    class Counter : public ModelEditListener
+    {
+    public:
+        int edits = 0;
+        void onEdit(const ModelEdit&) override { edits++; }
+    } counter;
+    UndoHistory history;
+    history.attach(model);
+    model.addEditListener(&counter);
+    model.updateBindingStages(typeMask, stageMask, bit, 0);
+    vector<uint32_t> afterSet;
+    for (auto& dl: dlayouts) afterSet.push_back(dl->stageFlagBits);
+    double undoMs = TimeMs([&]() { history.undo(); }, 1);
+    vector<uint32_t> afterUndo;
+    for (auto& dl: dlayouts) afterUndo.push_back(dl->stageFlagBits);
+    history.redo();
+    vector<uint32_t> afterRedo;
+    for (auto& dl: dlayouts) afterRedo.push_back(dl->stageFlagBits);
+    model.removeEditListener(&counter);
+    history.detach();
+    bool undone = counter.edits == 3 && afterUndo == afterBulk && afterRedo == afterSet && cols.stages == afterRedo;
+    printf("  one edit each for the update, its undo (%.2f ms) and redo: %s\n", undoMs, undone ? "matches" : "DIFFERS");
+    same = same && undone;
+    printf("  columns: %.1f MB, built on the first query in %.2f ms\n", n * (sizeof(int32_t) + sizeof(uint32_t)) / 1e6, buildMs);
+    if (!same) {
+        printf("  RESULTS DIFFER\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Snapshots and layout clones on a large project: what one costs the UI thread, what the first edit
+// after one costs, and the memory a run of near-identical snapshots holds. The flat copy snapshots
+// used to be is stood in for by the .vkpipeline.bin image, which holds the same records.
+static int BenchSnapshot(int numBindings)
+{
+    auto heapInUse = []() { struct mallinfo2 mi = mallinfo2(); return (double) (mi.uordblks + mi.hblkhd); };
+    double heap0 = heapInUse();
+    SyntheticProject model;
+    model.generate(numBindings / 5, 6, numBindings, 16);
+    model.generatePayloads(256);
+    malloc_trim(0);
+    double modelBytes = heapInUse() - heap0;
+    printf("bench snapshot: %d bindings, %d pipeline layouts, %.1f MB of model heap\n", numBindings, numBindings / 5,
+        modelBytes / 1e6);
+
+    string image;
+    double flatMs = TimeMs([&]() { model.serializeBinary(image); }, 3);
+    PipelineLayoutSnapshot snap;
+    double snapMs = TimeMs([&]() { model.snapshot(snap); }, 10);
+    printf("  take a snapshot: %.2f us, against %.1f ms for a flat copy (%.1f MB)\n", snapMs * 1000.0, flatMs, image.size() / 1e6);
+    image.clear();
+    image.shrink_to_fit();
+
+    // The first edit after a snapshot copies what it writes to; later ones run in place again.
+    int n = (int) model.dlayouts().size();
+    auto editMs = [&](int i) {
+        return TimeMs([&]() {
+            model.setDesclayoutType(i, (model.dlayouts()[i]->typeIdx + 1) % (int) descLayoutTypes.size());
+            model.renameLayout(i % (int) model.layouts().size(), ("EDITED_" + to_string(i)).c_str());
+        }, 1) * 1000.0;
+    };
+    double sharedUs = 0.0, ownUs = 0.0;
+    const int EDITS = 100;
+    for (int k = 0; k < EDITS; k++) {
+        model.snapshot(snap);
+        sharedUs += editMs((k * 7919) % n);
+        ownUs += editMs((k * 7919) % n);
+    }
+    printf("  edit a binding and rename a layout: %.1f us just after a snapshot, %.1f us after that\n",
+        sharedUs / EDITS, ownUs / EDITS);
+
+    // A history of snapshots, one small edit apart.
+    const int COPIES = 100;
+    vector<PipelineLayoutSnapshot> history(COPIES);
+    double heap1 = heapInUse();
+    for (int k = 0; k < COPIES; k++) {
+        model.snapshot(history[k]);
+        editMs((k * 104729) % n);
+    }
+    double historyBytes = heapInUse() - heap1;
+    printf("  %d snapshots one edit apart: %.1f MB on top of the model, %.1f KB each; %.0f MB as full copies\n",
+        COPIES, historyBytes / 1e6, historyBytes / COPIES / 1e3, COPIES * modelBytes / 1e6);
+    history.clear();
+
+    int numClones = min(1000, (int) model.layouts().size());
+    size_t layoutsBefore = model.layouts().size();
+    double cloneMs = TimeMs([&]() {
+        for (int k = 0; k < numClones; k++) model.cloneLayout(k, ("CLONE_" + to_string(k)).c_str());
+    }, 1);
+    printf("  clone %d pipeline layouts: %.2f ms, %.2f us each\n", numClones, cloneMs, cloneMs * 1000.0 / numClones);
+    if (model.layouts().size() != layoutsBefore + numClones ||
+        model.layouts().back().descsets[0].dlayouts.size() != model.layouts()[numClones - 1].descsets[0].dlayouts.size()) {
+        printf("  CLONES DIFFER\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Undo and redo on projects of two sizes: what recording, undoing and redoing an edit cost and what the
+// history holds per step, against a flat copy per edit. The .vkpipeline.bin image stands in for the copy,
+// as in bench snapshot. A second model applies the edit stream, undo and redo included, the way journal
+// recovery replays it; the times include its share.
+static int BenchUndo(int numBindings)
+{
+    class Mirror : public ModelEditListener
+    {
+        PipelineLayoutModel& m_model;
+    public:
+        Mirror(PipelineLayoutModel& model) : m_model(model) {}
+        void onEdit(const ModelEdit& edit) override { m_model.applyEdit(edit); }
+    };
+
+    printf("bench undo: up to %d bindings\n", numBindings);
+    const int EDITS = 2000;
+    bool ok = true;
+    for (int size: { numBindings / 10, numBindings }) {
+        SyntheticProject model, mirror;
+        model.generate(size / 5, 6, size, 16);
+        model.generatePayloads(256);
+        mirror.generate(size / 5, 6, size, 16);
+        mirror.generatePayloads(256);
+        Mirror mirrorListener(mirror);
+        model.addEditListener(&mirrorListener);
+
+        // The indexes the edits keep current are built up front, so that only the edits are timed.
+        vector< pair<int, int> > usages;
+        for (PipelineLayoutModel* m: { (PipelineLayoutModel*) &model, (PipelineLayoutModel*) &mirror }) {
+            m->findUsages(m->dlayouts()[0].get(), usages);
+            m->findLayout("");
+            m->findDesclayout("");
+        }
+        string original, image;
+        model.serialize(original);
+        double flatMs = TimeMs([&]() { model.serializeBinary(image); }, 1);
+
+        int numLayouts = (int) model.layouts().size();
+        auto edit = [&](int i) {
+            int binding = (i * 7919) % size;
+            switch (i % 7) {
+            case 0: model.renameDesclayout(binding, ("BINDING_EDITED_" + to_string(i)).c_str()); break;
+            case 1: model.setDesclayoutStages(binding, (uint32_t) i | 1); break;
+            case 2: model.setDesclayoutData(binding, ("layout(std140) uniform block_" + to_string(i) + " { vec4 v; };").c_str()); break;
+            case 3: model.addDescsetlayout(i % numLayouts, i % 6, binding); break;
+            case 4: model.delDescsetlayout(i % numLayouts, i % 6, 0); break;
+            case 5: model.renameLayout(i % numLayouts, ("LAYOUT_EDITED_" + to_string(i)).c_str()); break;
+            case 6: model.delDesclayout((int) model.dlayouts().size() - 1); break;
+            }
+        };
+
+        UndoHistory history;
+        history.attach(model);
+        history.setCoalesceMs(0);
+        double editMs = TimeMs([&]() { for (int i = 0; i < EDITS; i++) edit(i); }, 1);
+        UndoHistory::Stats stats = history.stats();
+        size_t steps = stats.undoSteps;
+        double undoMs = TimeMs([&]() { while (history.undo()) {} }, 1);
+        string state;
+        model.serialize(state);
+        bool undone = state == original;
+        double redoMs = TimeMs([&]() { while (history.redo()) {} }, 1);
+        string mirrored;
+        model.serialize(state);
+        mirror.serialize(mirrored);
+        printf("  %7d bindings: edit %.2f us, undo %.2f us, redo %.2f us per step; %.0f bytes per step\n", size,
+            editMs * 1000.0 / EDITS, undoMs * 1000.0 / steps, redoMs * 1000.0 / steps, (double) stats.bytes / steps);
+        printf("  %7s           a flat copy per edit instead: %.1f ms and %.1f MB each\n", "", flatMs, image.size() / 1e6);
+        if (!undone || state != mirrored) {
+            printf("  %s\n", !undone ? "UNDO DID NOT RESTORE THE PROJECT" : "REPLAYED EDITS DIFFER");
+            ok = false;
+        }
+        model.removeEditListener(&mirrorListener);
+    }
+
+    // Typing into a data field, then a memory limit well under what the edits would take.
+    SyntheticProject model;
+    model.generate(1000, 6, 5000, 16);
+    UndoHistory history;
+    history.attach(model);
+    string typed;
+    for (int i = 0; i < 2000; i++) {
+        typed += "vec4 v;\n"[i % 8];
+        model.setDesclayoutData(42, typed.c_str());
+    }
+    UndoHistory::Stats stats = history.stats();
+    printf("  2000 keystrokes into one data field: %zu undo step, %.1f KB\n", stats.undoSteps, stats.bytes / 1e3);
+    history.clear();
+    history.setMemoryLimit(1 << 20);
+    history.setCoalesceMs(0);
+    for (int i = 0; i < 50000; i++) model.setDesclayoutData(i % 5000, ("uniform float u" + to_string(i) + ";").c_str());
+    stats = history.stats();
+    printf("  50000 edits under a 1 MB limit: %zu steps kept in %.1f KB, %llu dropped\n", stats.undoSteps,
+        stats.bytes / 1e3, (unsigned long long) stats.dropped);
+    return ok ? 0 : 1;
+}
+
+// A scripted bulk edit (retire pipeline layouts and bindings, then retag stages twice over) on a project
+// with a journal open and its indexes built, as the editor has them: call by call, in one transaction,
+// and in one transaction that is then aborted.
+static int BenchTransaction(int numBindings, int numEdits)
+{
+    string path = TempPath(".vkpipeline.json");
+    string journalPath = EditJournal::journalFileName(path);
+    printf("bench txn: %d bindings, %d pipeline layouts, %d edits\n", numBindings, numBindings / 5, numEdits);
+
+    auto script = [&](PipelineLayoutModel& model) {
+        int retire = numEdits / 4;
+        for (int i = 0; i < retire; i++) {
+            if (i % 2) model.delLayout((i * 7919) % (int) model.layouts().size());
+            else model.delDesclayout((i * 7919) % (int) model.dlayouts().size());
+        }
+        int size = (int) model.dlayouts().size();
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < numEdits / 2 - retire / 2; i++) {
+                model.setDesclayoutStages((i * 104729) % size, (uint32_t) (i + pass) | 1);
+            }
+        }
+    };
+
+    enum { PER_CALL, COMMIT, ABORT };
+    string states[3];
+    bool ok = true;
+    for (int mode: { PER_CALL, COMMIT, ABORT }) {
+        SyntheticProject project;
+        project.generate(numBindings / 5, 6, numBindings, 16);
+        project.save(path);
+        remove(journalPath.c_str());
+        EditJournal journal;
+        UndoHistory history;
+        history.attach(project);
+        vector<int> filtered;
+        vector< pair<int, int> > usages;
+        project.findUsages(project.dlayouts()[0].get(), usages);
+        project.filterBindings(BINDING_TYPES_ANY, 0, filtered);
+        string original;
+        project.serialize(original);
+        double ms, firstUseMs;
+        try {
+            journal.open(project, path);
+            ms = TimeMs([&]() {
+                if (mode != PER_CALL) project.beginTransaction();
+                script(project);
+                if (mode == COMMIT) project.commitTransaction();
+                if (mode == ABORT) project.abortTransaction();
+            }, 1);
+            // What the transaction left for later: the first filter and usage query after it.
+            firstUseMs = TimeMs([&]() {
+                project.findUsages(project.dlayouts()[0].get(), usages);
+                project.filterBindings(BINDING_TYPES_ANY, 0, filtered);
+            }, 1);
+            journal.sync();
+        } catch (const std::exception& e) {
+            fprintf(stderr, "bench txn: %s\n", e.what());
+            remove(path.c_str());
+            return 1;
+        }
+        journal.close();
+        EditJournal::Stats stats = journal.stats();
+        project.serialize(states[mode]);
+        static const char* names[] = { "call by call", "one transaction", "transaction, aborted" };
+        printf("  %-22s %9.1f ms, then %6.1f ms to first use; %6llu journal records, %zu undo steps\n", names[mode], ms,
+            firstUseMs, (unsigned long long) stats.records, history.stats().undoSteps);
+        if (mode == ABORT && states[mode] != original) {
+            printf("  ABORT DID NOT RESTORE THE PROJECT\n");
+            ok = false;
+        }
+    }
+    if (states[PER_CALL] != states[COMMIT]) {
+        printf("  TRANSACTION DIFFERS FROM CALL BY CALL\n");
+        ok = false;
+    }
+    remove(journalPath.c_str());
+    remove(path.c_str());
+    return ok ? 0 : 1;
+}
+
+// Many pipeline layouts, many global sets, each layout using a few of them: model heap and load time
+// from .vkpipeline.json and .vkpipeline.bin, and what adding or removing a global set costs.
+static int BenchSets(int numLayouts, int numSets)
+{
+    const int SETS_USED = 3, BINDINGS_PER_SET = 8, NUM_BINDINGS = 2000;
+    string jsonPath = TempPath(".vkpipeline.json"), binPath = TempPath(".vkpipeline.bin");
+    printf("bench sets: %d pipeline layouts, %d global sets, %d of them used by each\n", numLayouts, numSets, SETS_USED);
+    {
+        PipelineLayoutModel project;
+        project.clear();
+        for (int s = 0; s < numSets; s++) project.addDescset(0, ("PSET_" + to_string(s)).c_str());
+        for (int b = 0; b < NUM_BINDINGS; b++) project.addDesclayout(("BINDING_" + to_string(b)).c_str());
+        uint32_t seed = 1;
+        auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+        for (int l = 0; l < numLayouts; l++) {
+            project.addLayout(("PIPELINE_" + to_string(l)).c_str());
+            for (int k = 0; k < SETS_USED; k++) {
+                int set = (int) (next() % numSets), start = (int) (next() % NUM_BINDINGS);
+                for (int b = 0; b < BINDINGS_PER_SET; b++) project.addDescsetlayout(l, set, (start + b) % NUM_BINDINGS);
+            }
+        }
+        project.save(jsonPath);
+        project.save(binPath);
+    }
+
+    auto heapInUse = []() { struct mallinfo2 mi = mallinfo2(); return (double) (mi.uordblks + mi.hblkhd); };
+    malloc_trim(0);
+    double heap0 = heapInUse();
+    PipelineLayoutModel model;
+    double jsonMs = TimeMs([&]() { model.load(jsonPath); }, 3);
+    malloc_trim(0);
+    double modelBytes = heapInUse() - heap0;
+    double binMs = TimeMs([&]() { model.load(binPath); }, 3);
+    remove(jsonPath.c_str());
+    remove(binPath.c_str());
+    printf("  model heap %.2f MB (%.0f bytes per pipeline layout)\n", modelBytes / 1e6, modelBytes / numLayouts);
+    printf("  load .vkpipeline.json %.1f ms, .vkpipeline.bin %.1f ms\n", jsonMs, binMs);
+
+    // A set nobody uses yet, added and removed again.
+    const int ROUNDS = 200;
+    double addMs = 0.0, delMs = 0.0;
+    for (int i = 0; i < ROUNDS; i++) {
+        addMs += TimeMs([&]() { model.addDescset(0, "PSET_SCRATCH"); }, 1);
+        delMs += TimeMs([&]() { model.delDescset(0, (int) model.dsets().size() - 1); }, 1);
+    }
+    printf("  add a global set %.2f us, remove it %.2f us\n", addMs * 1000.0 / ROUNDS, delMs * 1000.0 / ROUNDS);
+    return model.dsets().size() == (size_t) numSets ? 0 : 1;
+}
+
+// Shared per-set binding numbers vs numbering by position in each layout's set: assignment cost, then
+// over a run of single-entry edits, how many bindings change number and how many pipeline layouts
+// that invalidates under each scheme.
+static int BenchNumbers(int numLayouts)
+{
+    const int NUM_EDITS = 400;
+    SyntheticProject project;
+    project.generate(numLayouts, 8, numLayouts * 2, 6);
+    printf("bench numbers: %d pipeline layouts, 8 sets, %zu bindings\n", numLayouts, project.dlayouts().size());
+
+    BindingNumbers numbers;
+    double assignMs = TimeMs([&]() { numbers.assign(project, nullptr); }, 3);
+    size_t numbered = numbers.numAdded();
+    printf("  assign %.2f ms for %zu set / binding pairs\n", assignMs, numbered);
+
+    // Per layout: binding name -> position, for each set; a layout is invalidated by position when a
+    // binding it keeps changes place.
+    typedef vector< unordered_map<NameId, int> > Positions;
+    auto positions = [&project](int l, Positions& out) {
+        out.assign(project.dsets().size(), unordered_map<NameId, int>());
+        for (auto& dset: project.layouts()[l].descsets) {
+            for (size_t i = 0; i < dset.dlayouts.size(); i++) out[dset.index][project.binding(dset.dlayouts[i])->name] = (int) i;
+        }
+    };
+
+    uint32_t seed = 3;
+    auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+    size_t sharedMoved = 0, sharedInvalidated = 0, posMoved = 0, posInvalidated = 0;
+    double reassignMs = 0.0;
+    vector<int> invalidated;
+    Positions before, after;
+    for (int e = 0; e < NUM_EDITS; e++) {
+        int l = (int) (next() % project.layouts().size()), s = (int) (next() % project.dsets().size());
+        int n = (int) project.layouts()[l].descsets[s].dlayouts.size();
+        positions(l, before);
+        if (n && (next() & 1)) {
+            project.delDescsetlayout(l, s, (int) (next() % n));
+        } else {
+            project.insertDescsetlayout(l, s, n ? (int) (next() % n) : 0, (int) (next() % project.dlayouts().size()));
+        }
+        positions(l, after);
+        size_t moved = 0;
+        for (size_t k = 0; k < before.size(); k++) {
+            for (auto& b: before[k]) {
+                auto a = after[k].find(b.first);
+                if (a != after[k].end() && a->second != b.second) moved++;
+            }
+        }
+        posMoved += moved;
+        posInvalidated += moved ? 1 : 0;
+
+        BindingNumbers previous = move(numbers);
+        reassignMs += TimeMs([&]() { numbers.assign(project, &previous); }, 1);
+        numbers.invalidatedLayouts(project, invalidated);
+        sharedMoved += numbers.renumbered().size();
+        sharedInvalidated += invalidated.size();
+    }
+    printf("  %d single-entry edits, reassigned in %.2f ms each on average\n", NUM_EDITS, reassignMs / NUM_EDITS);
+    printf("  %-26s %8zu bindings moved, %8zu pipeline layouts invalidated\n", "by position in the layout", posMoved, posInvalidated);
+    printf("  %-26s %8zu bindings moved, %8zu pipeline layouts invalidated\n", "shared per set", sharedMoved, sharedInvalidated);
+    return 0;
+}
+
+// Exact pool sizes vs the usual hand count, every set allocated with room for as many descriptors of each
+// type as the largest set of any kind has. The synthetic sets have thousands of variants each, so the
+// instance counts, which are per variant, are kept small.
+static int BenchPools(int numLayouts)
+{
+    static const struct { uint32_t instances; bool perFrame; } counts[] = {
+        { 1, true }, { 1, false }, { 2, true }, { 8, false }, { 32, true }
+    };
+    const int NUM_SETS = sizeof(counts) / sizeof(counts[0]);
+    SyntheticProject project;
+    project.generate(numLayouts, NUM_SETS, numLayouts, 6);
+    PoolSizingInput input;
+    input.framesInFlight = 3;
+    for (int s = 0; s < NUM_SETS; s++) {
+        input.sets[project.names().str(project.dsets()[s])] = PoolSizingInput::SetCount{ counts[s].instances, counts[s].perFrame };
+    }
+    printf("bench pools: %d pipeline layouts, %d sets, %u frames in flight\n", numLayouts, NUM_SETS, input.framesInFlight);
+
+    DescriptorPoolPlan plan;
+    double planMs = TimeMs([&]() { PlanDescriptorPools(project, input, plan); }, 3);
+    printf("  planned %zu set variants in %.2f ms\n", plan.variants.size(), planMs);
+    for (auto& s: plan.strategies) {
+        printf("  %-14s %3zu pools, %10llu sets, %10.2f MB\n", s.name.c_str(), s.pools.size(),
+            (unsigned long long) s.totalSets, s.totalBytes / 1e6);
+    }
+
+    vector<uint32_t> most(descLayoutTypes.size(), 0);
+    for (auto& v: plan.variants) {
+        for (size_t t = 0; t < most.size(); t++) most[t] = max(most[t], v.descriptors[t]);
+    }
+    uint64_t handBytes = 0;
+    for (size_t t = 0; t < most.size(); t++) handBytes += plan.strategies[0].totalSets * most[t] * input.descriptorBytes[t];
+    printf("  %-14s %3d pools, %10llu sets, %10.2f MB\n", "by hand", 1, (unsigned long long) plan.strategies[0].totalSets,
+        handBytes / 1e6);
+
+    // Each strategy splits the same allocations differently: a set allocated once is not multiplied by
+    // the frames in flight anywhere.
+    uint64_t expectSets = 0;
+    for (auto& v: plan.variants) expectSets += (uint64_t) v.instances * (v.perFrame ? input.framesInFlight : 1);
+    bool same = true;
+    for (auto& s: plan.strategies) {
+        same = same && s.totalSets == expectSets && s.totalBytes == plan.strategies[0].totalBytes;
+    }
+    printf("  sets per strategy against the per-frame and shared counts %s\n", same ? "match" : "DIFFER");
+
+    // With every set allocated once, per_frame has nothing per frame: no pool may be left empty.
+    PoolSizingInput once = input;
+    for (auto& set: once.sets) set.second.perFrame = false;
+    DescriptorPoolPlan oncePlan;
+    PlanDescriptorPools(project, once, oncePlan);
+    bool noEmpty = true;
+    for (auto* p: { &plan, &oncePlan }) {
+        for (auto& s: p->strategies) {
+            for (auto& pool: s.pools) noEmpty = noEmpty && pool.maxSets > 0;
+        }
+    }
+    noEmpty = noEmpty && oncePlan.strategies[1].pools.size() == 1;
+    printf("  pools with no sets, mixed and with every set allocated once: %s\n", noEmpty ? "none" : "SOME");
+    return same && noEmpty ? 0 : 1;
+}
+
+// Compatibility matrix over pipeline layouts whose sets change at decreasing frequency: one frame set,
+// a few pass sets, more material sets, per-object sets. Times the matrix on growing thread counts against
+// comparing every pair, then the sets rebound for a draw sequence in submission and in compatible order.
+static int BenchCompat(int numLayouts)
+{
+    static const int variants[] = { 1, 4, 64, 512 };
+    const int NUM_SETS = sizeof(variants) / sizeof(variants[0]) + 1, BINDINGS_PER_SET = 4, NUM_DRAWS = 200000;
+    PipelineLayoutModel project;
+    project.clear();
+    for (int s = 0; s < NUM_SETS; s++) project.addDescset(0, ("PSET_" + to_string(s)).c_str());
+    int numBindings = 0;
+    for (int s = 0; s < NUM_SETS; s++) numBindings += (s < NUM_SETS - 1 ? variants[s] : 1) * BINDINGS_PER_SET;
+    for (int b = 0; b < numBindings; b++) project.addDesclayout(("BINDING_" + to_string(b)).c_str());
+    uint32_t seed = 1;
+    auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+    for (int l = 0; l < numLayouts; l++) {
+        project.addLayout(("PIPELINE_" + to_string(l)).c_str());
+        int first = 0;
+        for (int s = 0; s < NUM_SETS - 1; s++) {
+            int v = (int) (next() % variants[s]);
+            for (int b = 0; b < BINDINGS_PER_SET; b++) project.addDescsetlayout(l, s, first + v * BINDINGS_PER_SET + b);
+            first += variants[s] * BINDINGS_PER_SET;
+        }
+        // The last set is optional, and its bindings come in any order.
+        if (next() % 2) continue;
+        for (int b = 0; b < BINDINGS_PER_SET; b++) project.addDescsetlayout(l, NUM_SETS - 1, first + (b + l) % BINDINGS_PER_SET);
+    }
+    printf("bench compat: %d pipeline layouts, %d sets\n", numLayouts, NUM_SETS);
+
+    LayoutCompatibility compat;
+    double buildMs = TimeMs([&]() { compat.build(project); }, 3);
+    printf("  build %.2f ms, %zu distinct set layouts, %zu fully compatible groups\n", buildMs, compat.numSetLayouts(),
+        compat.numGroups(NUM_SETS));
+    LayoutCompatibility unordered;
+    unordered.build(project, LayoutCompatibility::SETS_UNORDERED);
+    printf("  with shared binding numbers: %zu distinct set layouts, %zu fully compatible groups\n",
+        unordered.numSetLayouts(), unordered.numGroups(NUM_SETS));
+
+    size_t n = (size_t) numLayouts;
+    vector<uint8_t> pairwise(n * n);
+    double pairMs = TimeMs([&]() {
+        for (size_t a = 0; a < n; a++) {
+            for (size_t b = 0; b < n; b++) pairwise[a * n + b] = (uint8_t) compat.prefix((int) a, (int) b);
+        }
+    }, 1);
+    printf("  every pair compared: %.1f ms\n", pairMs);
+    vector<uint8_t> matrix;
+    size_t hardware = max(1u, thread::hardware_concurrency());
+    for (size_t threads = 1;; threads = min(threads * 2, hardware)) {
+        ThreadPool pool(threads);
+        double ms = TimeMs([&]() { compat.matrix(pool, matrix); }, 3);
+        printf("  matrix on %2zu threads: %.1f ms%s\n", threads, ms, matrix == pairwise ? "" : " (MISMATCH)");
+        if (matrix != pairwise) return 1;
+        if (threads == hardware) break;
+    }
+
+    vector<int> draws(NUM_DRAWS);
+    for (auto& d: draws) d = (int) (next() % n);
+    auto report = [](const char* name, const LayoutCompatibility::RebindCost& cost) {
+        printf("  %-22s %7zu switches, %8zu sets in %8zu calls (every set: %8zu in %8zu)\n", name, cost.switches,
+            cost.setsBound, cost.bindCalls, cost.setsBoundAll, cost.bindCallsAll);
+    };
+    report("submission order", compat.rebindCost(draws));
+    sort(draws.begin(), draws.end());
+    report("by pipeline layout", compat.rebindCost(draws));
+    sort(draws.begin(), draws.end(), [&compat](int a, int b) { return compat.rank(a) < compat.rank(b); });
+    report("by compatibility", compat.rebindCost(draws));
+    return 0;
+}
+
+// A renderer's pipeline layouts with their sets in the worst order, per-draw set first, and a per-frame
+// and a never-updated binding stuck in the per-draw set; a trace of frames of passes of draws over
+// them, updating bindings at their rates. Times reading the trace and planning, then checks a replay of
+// the applied plan does the work the plan promised.
+static int BenchSetOrder(int numLayouts, int numEvents)
+{
+    const int NUM_PASSES = 4, NUM_MATERIALS = 64, DRAWS_PER_PASS = 500;
+    static const char* sets[] = { "PSET_PER_DRAW", "PSET_PER_MATERIAL", "PSET_PER_PASS", "PSET_PER_FRAME" };
+    PipelineLayoutModel project;
+    project.clear();
+    for (auto name: sets) project.addDescset(0, name);
+    for (auto name: { "OBJECT_TRANSFORM", "FRAME_TIME", "SHADOW_MAP", "FRAME_CONSTANTS" }) project.addDesclayout(name);
+    for (int p = 0; p < NUM_PASSES; p++) project.addDesclayout(("PASS_TARGET_" + to_string(p)).c_str());
+    for (int m = 0; m < NUM_MATERIALS; m++) {
+        project.addDesclayout(("MATERIAL_ALBEDO_" + to_string(m)).c_str());
+        project.addDesclayout(("MATERIAL_PARAMS_" + to_string(m)).c_str());
+    }
+    int firstPass = 4, firstMaterial = firstPass + NUM_PASSES;
+    for (int l = 0; l < numLayouts; l++) {
+        project.addLayout(("PIPELINE_" + to_string(l)).c_str());
+        int pass = l % NUM_PASSES, material = (l / NUM_PASSES) % NUM_MATERIALS;
+        for (int b = 0; b < 3; b++) project.addDescsetlayout(l, 0, b);
+        project.addDescsetlayout(l, 1, firstMaterial + material * 2);
+        project.addDescsetlayout(l, 1, firstMaterial + material * 2 + 1);
+        project.addDescsetlayout(l, 2, firstPass + pass);
+        project.addDescsetlayout(l, 3, 3);
+    }
+
+    string path = TempPath(".trace");
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        fprintf(stderr, "bench setorder: could not write %s\n", path.c_str());
+        return 1;
+    }
+    uint32_t seed = 1;
+    auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+    string text;
+    int events = 0, frames = 0;
+    while (events < numEvents) {
+        text = "# frame " + to_string(frames++) + "\nu FRAME_TIME\nu FRAME_CONSTANTS\n";
+        events += 2;
+        for (int p = 0; p < NUM_PASSES; p++) {
+            text += "u PASS_TARGET_" + to_string(p) + "\n";
+            events++;
+            int layouts = (numLayouts - p + NUM_PASSES - 1) / NUM_PASSES;
+            for (int d = 0; d < DRAWS_PER_PASS && layouts > 0; d++) {
+                text += "p PIPELINE_" + to_string((next() % layouts) * NUM_PASSES + p) + "\n";
+                if (next() % 64 == 0) text += "u MATERIAL_ALBEDO_" + to_string(next() % NUM_MATERIALS) + "\n", events++;
+                text += "u OBJECT_TRANSFORM\nd\n";
+                events += 3;
+            }
+        }
+        fwrite(text.data(), 1, text.size(), f);
+    }
+    fclose(f);
+    struct stat sb;
+    stat(path.c_str(), &sb);
+    printf("bench setorder: %d pipeline layouts, %d frames, %d events, %.1f MB of trace\n", numLayouts, frames, events,
+        sb.st_size / 1e6);
+
+    DrawTrace trace;
+    SetOrderPlan plan;
+    double readMs = TimeMs([&]() { trace.load(project, path); }, 1);
+    remove(path.c_str());
+    double planMs = TimeMs([&]() { PlanSetOrder(project, trace, plan); }, 1);
+    printf("  read %.0f ms, planned %.0f ms over %d replays\n", readMs, planMs, plan.replays);
+    auto row = [](const char* name, const SetOrderPlan::Work& w) {
+        printf("  %-10s %10llu sets bound in %10llu calls, %10llu sets / %10llu descriptors written\n", name,
+            (unsigned long long) w.setsBound, (unsigned long long) w.bindCalls, (unsigned long long) w.setsWritten,
+            (unsigned long long) w.descriptorsWritten);
+    };
+    row("as is", plan.current);
+    row("reordered", plan.reordered);
+    row("planned", plan.planned);
+    printf("  order:");
+    for (int s: plan.order) printf(" %s", project.names().c_str(project.dsets()[s]));
+    printf("\n");
+    for (auto& m: plan.moves) {
+        printf("  move %s from %s to %s\n", project.names().c_str(project.dlayouts()[m.binding]->name),
+            project.names().c_str(project.dsets()[m.from]), project.names().c_str(project.dsets()[m.to]));
+    }
+
+    ApplySetOrderPlan(project, plan);
+    SetOrderPlan again;
+    PlanSetOrder(project, trace, again, 1);
+    bool same = again.current.total() == plan.planned.total() && again.current.bindCalls == plan.planned.bindCalls;
+    printf("  replay of the applied plan %s\n", same ? "matches" : "DIFFERS");
+    return same ? 0 : 1;
+}
+
+// Device limit checks of a large project against dozens of profiles, each a device report padded out
+// to the size of a gpuinfo.org dump with the features, formats and extensions the check skips.
+static int BenchLimits(int numLayouts, int numProfiles)
+{
+    const int PADDING_ENTRIES = 20000;
+    SyntheticProject project;
+    project.generate(numLayouts, 6, numLayouts, 4);
+    vector<string> reports(numProfiles);
+    uint32_t seed = 1;
+    auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+    size_t bytes = 0;
+    for (int p = 0; p < numProfiles; p++) {
+        string& text = reports[p];
+        text = "{\n\t\"extensions\" : [\n";
+        for (int e = 0; e < PADDING_ENTRIES; e++) {
+            text += "\t\t{ \"extensionName\" : \"VK_EXT_extension_" + to_string(e) + "\", \"specVersion\" : " +
+                to_string(next() % 100) + " },\n";
+        }
+        text += "\t\t{}\n\t],\n\t\"properties\" : {\n\t\t\"deviceName\" : \"GPU " + to_string(p) + "\",\n\t\t\"limits\" : {\n";
+        for (int l = 0; l < NUM_DEVICE_LIMITS; l++) {
+            uint64_t v = l == LIMIT_BOUND_DESCRIPTOR_SETS ? 4 + next() % 29 : 8u << (next() % 12);
+            text += string("\t\t\t\"") + deviceLimitNames[l] + "\" : " + to_string(v) + (l + 1 < NUM_DEVICE_LIMITS ? ",\n" : "\n");
+        }
+        text += "\t\t}\n\t}\n}\n";
+        bytes += text.size();
+    }
+    printf("bench limits: %d pipeline layouts, %d profiles, %.1f MB of profiles\n", numLayouts, numProfiles, bytes / 1e6);
+
+    vector<DeviceProfile> profiles;
+    double readMs = TimeMs([&]() {
+        profiles.clear();
+        for (int p = 0; p < numProfiles; p++) {
+            ParseDeviceProfiles(reports[p].data(), reports[p].data() + reports[p].size(), "bench.json", profiles);
+        }
+    }, 3);
+    DeviceLimitsReport report;
+    double checkMs = TimeMs([&]() { CheckDeviceLimits(project, profiles, 20, report); }, 3);
+    size_t violations = 0;
+    for (size_t v: report.violations) violations += v;
+    printf("  read %.1f ms, checked %.1f ms: %zu uses over a limit\n", readMs, checkMs, violations);
+    return 0;
+}
+
+static void PrintBenchUsage(void)
+{
+    fprintf(stderr,
+        "usage: vkplc bench <name> [args]\n"
+        "  load [pipelines=10000]      streaming loader vs Json::Value DOM: time and peak RSS\n"
+        "  save [pipelines=40000]      streaming writer vs Json::Value DOM at doubling sizes\n"
+        "  open [pipelines=10000]      time to first query: JSON parse vs mapped .vkpipeline.bin\n"
+        "  roundtrip [bindings=20000]  every writer read back and written again, invalid binding types included\n"
+        "  bgsave [bindings=80000]     frame times while a large project saves in the background\n"
+        "  blobs [bindings=20000] [bytes=4096]\n"
+        "                              memory held by packed binding data and comments vs plain strings\n"
+        "  journal [bindings=80000] [edits=20000]\n"
+        "                              per-edit journal append vs save(), group commit, compaction, recovery\n"
+        "  names [count=10000]         bulk add and name lookup: hash indexes vs linear scans\n"
+        "  strings [bindings=200000]   memory held by interned names vs std::string names and string-keyed maps\n"
+        "  arena [bindings=100000] [bytes=512]\n"
+        "                              load / teardown time and allocation count: slab arena vs heap per binding\n"
+        "  columns [bindings=1000000]  binding filters and bulk stage edits: per object vs scalar and SIMD over columns\n"
+        "  snapshot [bindings=200000]  snapshot and clone cost, first edit after a snapshot, memory of a snapshot history\n"
+        "  undo [bindings=200000]      undo / redo cost and history size per edit at two project sizes, coalescing, memory limit\n"
+        "  txn [bindings=200000] [edits=8000]\n"
+        "                              a scripted bulk edit call by call vs in one transaction, committed and aborted\n"
+        "  sets [pipelines=5000] [sets=40]\n"
+        "                              model heap, load time and global set add / remove with few sets used per layout\n"
+        "  numbers [pipelines=2000]    binding number assignment, and renumbering over edits: shared per set vs by position\n"
+        "  pools [pipelines=2000]      descriptor pool sizes per strategy vs sizing every set for the largest\n"
+        "  compat [pipelines=10000]    set compatibility matrix on 1..N threads vs every pair, sets rebound per draw order\n"
+        "  setorder [pipelines=2000] [events=20000000]\n"
+        "                              draw trace read and set order / binding move planning, work before and after\n"
+        "  limits [pipelines=10000] [profiles=48]\n"
+        "                              device limit checks of every pipeline layout against gpuinfo-sized profiles\n");
+}
+
+int RunBenchmark(int argc, char** argv)
+{
+    if (argc < 1) {
+        PrintBenchUsage();
+        return 2;
+    }
+    string name = argv[0];
+    auto intArg = [&](int i, int def) { return argc > i ? atoi(argv[i]) : def; };
+    if (name == "load") return BenchLoad(intArg(1, 10000));
+    if (name == "save") return BenchSave(intArg(1, 40000));
+    if (name == "open") return BenchOpen(intArg(1, 10000));
+    if (name == "roundtrip") return BenchRoundTrip(intArg(1, 20000));
+    if (name == "bgsave") return BenchBackgroundSave(intArg(1, 80000));
+    if (name == "blobs") return BenchBlobs(intArg(1, 20000), intArg(2, 4096));
+    if (name == "journal") return BenchJournal(intArg(1, 80000), intArg(2, 20000));
+    if (name == "names") return BenchNames(intArg(1, 10000));
+    if (name == "strings") return BenchStrings(intArg(1, 200000));
+    if (name == "arena") return BenchArena(intArg(1, 100000), intArg(2, 512));
+    if (name == "columns") return BenchColumns(intArg(1, 1000000));
+    if (name == "snapshot") return BenchSnapshot(intArg(1, 200000));
+    if (name == "undo") return BenchUndo(intArg(1, 200000));
+    if (name == "txn") return BenchTransaction(intArg(1, 200000), intArg(2, 8000));
+    if (name == "sets") return BenchSets(intArg(1, 5000), intArg(2, 40));
+    if (name == "numbers") return BenchNumbers(intArg(1, 2000));
+    if (name == "pools") return BenchPools(intArg(1, 2000));
+    if (name == "compat") return BenchCompat(intArg(1, 10000));
+    if (name == "setorder") return BenchSetOrder(intArg(1, 2000), intArg(2, 20000000));
+    if (name == "limits") return BenchLimits(intArg(1, 10000), intArg(2, 48));
+    PrintBenchUsage();
+    return 2;
+}
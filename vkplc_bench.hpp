@@ -0,0 +1,45 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _VKPLC_BENCH_
+#define _VKPLC_BENCH_
+
+#include "pipelinelayout_model.hpp"
+
+// Deterministic synthetic project for benchmarks: numLayouts pipelines over numSets global sets,
+// each set slot referencing bindingsPerSet of numBindings global bindings.
+class SyntheticProject : public PipelineLayoutModel
+{
+public:
+    void generate(int numLayouts, int numSets, int numBindings, int bindingsPerSet, uint32_t seed = 1);
+    // Replaces every binding's data with about bytesPerBinding of generated GLSL, the kind of payload
+    // shader generators attach, and gives each a short comment.
+    void generatePayloads(int bytesPerBinding, uint32_t seed = 1);
+    // The columns filterBindings() runs over, built if they are not yet.
+    const ModelBindingColumns& bindingColumns(void) const { return columns(); }
+};
+
+// vkplc bench <name> [args]. Prints results to stdout and returns the process exit code.
+int RunBenchmark(int argc, char** argv);
+
+#endif // _VKPLC_BENCH_
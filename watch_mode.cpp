@@ -0,0 +1,296 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "watch_mode.hpp"
+#include "pipelinelayout_model.hpp"
+#include "layout_export.hpp"
+#include "build_cache.hpp"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+using namespace std;
+
+static const char* PROJECT_EXT = ".vkpipeline.json";
+static const char* NUMBERS_FILE = "binding_numbers.json";
+static const uint32_t DIR_WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_DELETE_SELF;
+
+static bool IsProjectFile(const string& path)
+{
+    size_t n = strlen(PROJECT_EXT);
+    return path.size() > n && path.compare(path.size() - n, n, PROJECT_EXT) == 0;
+}
+
+static bool MakeDirs(const string& path)
+{
+    for (size_t pos = 1; pos <= path.size(); pos++) {
+        if (pos == path.size() || path[pos] == '/') {
+            string sub = path.substr(0, pos);
+            if (mkdir(sub.c_str(), 0755) != 0 && errno != EEXIST) return false;
+        }
+    }
+    return true;
+}
+
+static double MsSince(const struct timespec& ts)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (now.tv_sec - ts.tv_sec) * 1000.0 + (now.tv_nsec - ts.tv_nsec) / 1e6;
+}
+
+// -------------------------------------------------------- LayoutWatcher -----------------------------------------------
+
+LayoutWatcher::LayoutWatcher(const std::string& root, const std::string& outDir, bool quiet)
+    : m_root(root), m_outDir(outDir), m_quiet(quiet)
+{
+    while (m_root.size() > 1 && m_root.back() == '/') m_root.pop_back();
+    m_fd = inotify_init1(IN_CLOEXEC);
+    if (m_fd < 0) {
+        throw std::runtime_error(string("inotify_init1 failed: ") + strerror(errno));
+    }
+}
+
+LayoutWatcher::~LayoutWatcher()
+{
+    if (m_fd >= 0) close(m_fd);
+}
+
+std::string LayoutWatcher::outputDir(const std::string& project) const
+{
+    string rel = project.substr(m_root.size() + 1);
+    return m_outDir + "/" + rel.substr(0, rel.size() - strlen(PROJECT_EXT));
+}
+
+void LayoutWatcher::watchTree(const std::string& dir, std::vector<std::string>& projects)
+{
+    int wd = inotify_add_watch(m_fd, dir.c_str(), DIR_WATCH_MASK);
+    if (wd < 0) {
+        fprintf(stderr, "vkplc: cannot watch %s: %s\n", dir.c_str(), strerror(errno));
+        return;
+    }
+    m_watchDirs[wd] = dir;
+
+    DIR* d = opendir(dir.c_str());
+    if (!d) return;
+    while (auto* ent = readdir(d)) {
+        if (!strcmp(ent->d_name, ".") || !strcmp(ent->d_name, "..")) continue;
+        string path = dir + "/" + ent->d_name;
+        struct stat sb;
+        if (lstat(path.c_str(), &sb) != 0) continue;
+        if (S_ISDIR(sb.st_mode)) {
+            watchTree(path, projects);
+        } else if (S_ISREG(sb.st_mode) && IsProjectFile(path)) {
+            projects.push_back(path);
+        }
+    }
+    closedir(d);
+}
+
+void LayoutWatcher::update(const std::string& project, bool initial)
+{
+    auto t0 = chrono::steady_clock::now();
+
+    string text;
+    struct stat sb;
+    if (stat(project.c_str(), &sb) != 0 || !ReadFile(project, text)) {
+        forget(project);
+        return;
+    }
+
+    PipelineLayoutModel model;
+    vector<string> errors;
+    try {
+        model.deserialize(text.data(), text.data() + text.size());
+        model.validate(errors);
+    } catch (const exception& e) {
+        errors.push_back(e.what());
+    }
+    auto t1 = chrono::steady_clock::now();
+    if (!errors.empty()) {
+        // Keep the last good outputs around until the file is fixed.
+        printf("[watch] %s: not regenerated\n", project.c_str());
+        for (auto& err: errors) printf("    %s\n", err.c_str());
+        fflush(stdout);
+        return;
+    }
+
+    string dir = outputDir(project);
+    if (!MakeDirs(dir)) {
+        fprintf(stderr, "vkplc: could not create %s\n", dir.c_str());
+        return;
+    }
+
+    auto& state = m_projects[project];
+    if (state.numbersPath.empty()) {
+        // Pick up the numbers an earlier run left.
+        state.numbersPath = dir + "/" + NUMBERS_FILE;
+        string saved;
+        if (ReadFile(state.numbersPath, saved)) {
+            try {
+                state.numbers.deserialize(saved.data(), saved.data() + saved.size());
+            } catch (const exception& e) {
+                fprintf(stderr, "vkplc: %s: %s; numbering afresh\n", state.numbersPath.c_str(), e.what());
+                state.numbers.clear();
+            }
+        }
+    }
+    BindingNumbers numbers;
+    numbers.assign(model, &state.numbers);
+    state.numbers = move(numbers);
+    string numbersText;
+    state.numbers.serialize(numbersText);
+    // A failed write is reported and retried on the next change; the watcher keeps running.
+    vector<string> writeErrors;
+    try {
+        WriteFileIfChanged(state.numbersPath, numbersText);
+    } catch (const exception& e) {
+        writeErrors.push_back(e.what());
+    }
+
+    unordered_map<string, uint64_t> outputs;
+    size_t regenerated = 0, removed = 0;
+    string header;
+    for (int i = 0; i < (int) model.layouts().size(); i++) {
+        string path = dir + "/" + ExportHeaderName(model, i);
+        uint64_t digest = ExportDigest(model, i, &state.numbers);
+        outputs[path] = digest;
+        auto prev = state.outputs.find(path);
+        if (prev != state.outputs.end() && prev->second == digest) continue;
+        ExportPipelineLayoutHeader(model, i, project, header, &state.numbers);
+        try {
+            if (WriteFileIfChanged(path, header)) regenerated++;
+        } catch (const exception& e) {
+            writeErrors.push_back(e.what());
+            // Not up to date: keep the old digest, or none, so the next change writes it again.
+            if (prev != state.outputs.end()) outputs[path] = prev->second;
+            else outputs.erase(path);
+        }
+    }
+    for (auto& prev: state.outputs) {
+        if (outputs.find(prev.first) == outputs.end()) {
+            unlink(prev.first.c_str());
+            removed++;
+        }
+    }
+    state.outputs.swap(outputs);
+    auto t2 = chrono::steady_clock::now();
+
+    if (!initial || !m_quiet || !writeErrors.empty()) {
+        printf("[watch] %s: %zu/%zu headers regenerated, %zu removed, parse %.3f ms, total %.3f ms",
+            project.c_str(), regenerated, state.outputs.size(), removed,
+            chrono::duration<double, milli>(t1 - t0).count(), chrono::duration<double, milli>(t2 - t0).count());
+        if (!initial) printf(" (%.3f ms since save)", MsSince(sb.st_mtim));
+        if (!writeErrors.empty()) printf(", %zu writes failed", writeErrors.size());
+        printf("\n");
+        for (auto& err: writeErrors) printf("    %s\n", err.c_str());
+        fflush(stdout);
+    }
+    auto& renumbered = state.numbers.renumbered();
+    if (!renumbered.empty()) {
+        vector<int> invalidated;
+        state.numbers.invalidatedLayouts(model, invalidated);
+        printf("[watch] %s: %zu bindings renumbered, shaders of %zu pipeline layouts invalidated\n",
+            project.c_str(), renumbered.size(), invalidated.size());
+        for (auto& r: renumbered) printf("    %s %s: %d -> %d\n", r.set.c_str(), r.binding.c_str(), r.from, r.to);
+        for (int l: invalidated) printf("    %s\n", model.names().c_str(model.layouts()[l].name));
+        fflush(stdout);
+    }
+}
+
+void LayoutWatcher::forget(const std::string& project)
+{
+    auto it = m_projects.find(project);
+    if (it == m_projects.end()) return;
+    for (auto& out: it->second.outputs) unlink(out.first.c_str());
+    if (!it->second.numbersPath.empty()) unlink(it->second.numbersPath.c_str());
+    printf("[watch] %s: removed, %zu headers deleted\n", project.c_str(), it->second.outputs.size());
+    fflush(stdout);
+    m_projects.erase(it);
+}
+
+int LayoutWatcher::run(void)
+{
+    vector<string> projects;
+    watchTree(m_root, projects);
+    sort(projects.begin(), projects.end());
+    auto t0 = chrono::steady_clock::now();
+    for (auto& p: projects) update(p, true);
+    auto t1 = chrono::steady_clock::now();
+    printf("[watch] watching %zu directories, %zu projects (initial build %.2f ms). Ctrl-C to stop.\n",
+        m_watchDirs.size(), projects.size(), chrono::duration<double, milli>(t1 - t0).count());
+    fflush(stdout);
+
+    alignas(struct inotify_event) char buf[64 * 1024];
+    while (true) {
+        ssize_t len = read(m_fd, buf, sizeof(buf));
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "vkplc: inotify read failed: %s\n", strerror(errno));
+            return 1;
+        }
+
+        // Coalesce the batch: an editor save is often several events for the same file.
+        vector<string> changed, gone, newDirs;
+        for (char* p = buf; p < buf + len; ) {
+            auto* ev = (struct inotify_event*) p;
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                fprintf(stderr, "vkplc: inotify queue overflow, rescanning\n");
+                for (auto& proj: m_projects) changed.push_back(proj.first);
+                continue;
+            }
+            auto dir = m_watchDirs.find(ev->wd);
+            if (dir == m_watchDirs.end()) continue;
+            if (ev->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+                m_watchDirs.erase(dir);
+                continue;
+            }
+            if (!ev->len) continue;
+            string path = dir->second + "/" + ev->name;
+            if (ev->mask & IN_ISDIR) {
+                if (ev->mask & (IN_CREATE | IN_MOVED_TO)) newDirs.push_back(path);
+                continue;
+            }
+            if (!IsProjectFile(path)) continue;
+            if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) changed.push_back(path);
+            if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) gone.push_back(path);
+        }
+
+        for (auto& d: newDirs) watchTree(d, changed);
+        sort(changed.begin(), changed.end());
+        changed.erase(unique(changed.begin(), changed.end()), changed.end());
+        for (auto& g: gone) {
+            if (!binary_search(changed.begin(), changed.end(), g)) forget(g);
+        }
+        for (auto& c: changed) update(c, false);
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ Copyright (c) 2016 UAA Software
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be
+ included in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef _WATCH_MODE_
+#define _WATCH_MODE_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "binding_numbers.hpp"
+
+// Long-running vkplc mode (Linux, inotify). Watches a directory tree of .vkpipeline.json files and keeps
+// one generated header per pipeline layout under the output directory up to date. A changed project is
+// re-parsed on its own, and only the headers whose ExportDigest() changed are regenerated. Binding numbers
+// are kept stable from one build to the next, and across runs through binding_numbers.json beside the
+// headers; a build that has to renumber lists the pipeline layouts whose shaders it invalidates.
+class LayoutWatcher
+{
+    struct Project {
+        std::unordered_map<std::string, uint64_t> outputs;  // header path -> digest it was generated from
+        BindingNumbers numbers;
+        std::string numbersPath;                            // Empty until the first good build.
+    };
+
+    std::string m_root;
+    std::string m_outDir;
+    bool m_quiet = false;
+    int m_fd = -1;
+    std::unordered_map<int, std::string> m_watchDirs;       // inotify wd -> directory
+    std::unordered_map<std::string, Project> m_projects;    // project path -> generated outputs
+
+    std::string outputDir(const std::string& project) const;
+    void watchTree(const std::string& dir, std::vector<std::string>& projects);
+    void update(const std::string& project, bool initial);
+    void forget(const std::string& project);
+
+public:
+    LayoutWatcher(const std::string& root, const std::string& outDir, bool quiet);
+    ~LayoutWatcher();
+
+    // Builds every project once, then blocks processing file system events. Returns on a fatal error.
+    int run(void);
+};
+
+#endif // _WATCH_MODE_